@@ -32,6 +32,8 @@
 #include <gtkmm.h>
 #include "main.h"
 #include "framebuf.h"
+#include "pacedbuf.h"
+#include "replaybuf.h"
 #include "plotting.h"
 #include "appFrame.h"
 #include "displayTab.h"
@@ -46,6 +48,9 @@ static const char *const appFrameDate = "$Date: 2015/12/03 21:39:53 $";
 
 FrameBuffer *appFrame::fb = NULL;
 int appFrame::headless = 0;
+const char *appFrame::replayPath = NULL;
+double appFrame::replaySpeed = 1.0;
+int appFrame::replayLoop = 0;
 char appFrame::dailyDir[MAXPATHLEN];
 
 
@@ -90,6 +95,27 @@ appFrame::appFrame(int h)
     registerSourceFile(displayTabDate);
     registerSourceFile(ecsDataTabDate);
     registerSourceFile(framebufDate);
+    registerSourceFile(frameringDate);
+    registerSourceFile(pipelineDate);
+    registerSourceFile(frameopsDate);
+    registerSourceFile(darkmodelDate);
+    registerSourceFile(bandstatsDate);
+    registerSourceFile(stretchlutDate);
+    registerSourceFile(navdecoderDate);
+    registerSourceFile(quicklookwriterDate);
+    registerSourceFile(rawwriterDate);
+    registerSourceFile(stripeindexDate);
+    registerSourceFile(stripewriterDate);
+    registerSourceFile(ricecodecDate);
+    registerSourceFile(cmpwriterDate);
+    registerSourceFile(manifestDate);
+    registerSourceFile(framehasherDate);
+    registerSourceFile(flightlineDate);
+    registerSourceFile(pacedbufDate);
+    registerSourceFile(replaybufDate);
+    registerSourceFile(tracerDate);
+    registerSourceFile(latencyhistDate);
+    registerSourceFile(diagsrecorderDate);
     registerSourceFile(libftpDate);
     registerSourceFile(mainDate);
     registerSourceFile(maxonDate);
@@ -162,10 +188,16 @@ appFrame::appFrame(int h)
 
     lastOBCState = OBC_BRIGHT;
 
-	/* connect to frame buffer, and reset OBC control lines in case it
- 	   was previously left in odd position */
+	/* connect to frame buffer, or the flight line we're replaying, and
+ 	   reset OBC control lines in case it was previously left in odd
+ 	   position */
 
-    fb = new AlphaDataFrameBuffer(m_settingsBlock->currentFrameHeightLines(),
+    if (replayPath != NULL)
+	fb = new ReplayFrameBuffer(m_settingsBlock->currentFrameHeightLines(),
+	    m_settingsBlock->currentFrameWidthSamples(), NULL, replayPath,
+	    replaySpeed, replayLoop);
+    else fb = new AlphaDataFrameBuffer(
+	m_settingsBlock->currentFrameHeightLines(),
 	m_settingsBlock->currentFrameWidthSamples(), NULL);
     if (fb->failed) {
 	if (!headless) {
@@ -262,6 +294,11 @@ appFrame::appFrame(int h)
 	"%m/%d/%Y at %H:%M:%S GMT.\n", tm_struct);
     (void)sprintf(versionString+strlen(versionString),
 	"FPGA is version hx%x.\n", fb->fpgaVersion());
+    if (replayPath != NULL)
+	(void)sprintf(versionString+strlen(versionString),
+	    "Replaying %u frames at %.1f Hz%s.\n",
+	    ((ReplayFrameBuffer *)fb)->recordedFrames(), fb->getFrameRateHz(),
+	    (replaySpeed > 0.0)? "":" (unpaced)");
 }
 
 
@@ -46,6 +46,27 @@ extern const char *const plotsTabDate;
 extern const char *const displayTabDate;
 extern const char *const ecsDataTabDate;
 extern const char *const framebufDate;
+extern const char *const frameringDate;
+extern const char *const pipelineDate;
+extern const char *const frameopsDate;
+extern const char *const darkmodelDate;
+extern const char *const bandstatsDate;
+extern const char *const stretchlutDate;
+extern const char *const navdecoderDate;
+extern const char *const quicklookwriterDate;
+extern const char *const rawwriterDate;
+extern const char *const stripeindexDate;
+extern const char *const stripewriterDate;
+extern const char *const ricecodecDate;
+extern const char *const cmpwriterDate;
+extern const char *const manifestDate;
+extern const char *const framehasherDate;
+extern const char *const flightlineDate;
+extern const char *const pacedbufDate;
+extern const char *const replaybufDate;
+extern const char *const tracerDate;
+extern const char *const latencyhistDate;
+extern const char *const diagsrecorderDate;
 extern const char *const libftpDate;
 extern const char *const mainDate;
 extern const char *const maxonDate;
@@ -110,6 +131,12 @@ public:
     static FrameBuffer *fb;
     static int headless;
 
+	/* flight line to play back in place of the camera, if any */
+
+    static const char *replayPath;
+    static double replaySpeed;		/* 0 for as fast as possible */
+    static int replayLoop;
+
 	/* data dir */
 
     static char dailyDir[MAXPATHLEN];
@@ -0,0 +1,162 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <string.h>
+#include <sys/types.h>
+#include "bandstats.h"
+
+extern const char *const bandstatsDate = "$Date: 2015/12/22 10:14:37 $";
+
+
+BandStats::BandStats(int lines, int samples)
+{
+    int i;
+
+    m_lines = lines;
+    m_samples = samples;
+    for (i=0;i < NUM_BANDSTATS_CHANNELS;i++)
+	m_hist[i] = new u_int[BANDSTATS_BINS];
+
+	/* the frame histogram sees a grid of samples from every sampled
+	   line; a band histogram sees one line's worth per frame */
+
+    m_window[BANDSTATS_FRAME] = BANDSTATS_WINDOW_FRAMES *
+	((lines-2) / BANDSTATS_DECIMATION + 1) *
+	((samples-1) / BANDSTATS_DECIMATION + 1);
+    for (i=BANDSTATS_RED;i <= BANDSTATS_BLUE;i++)
+	m_window[i] = BANDSTATS_WINDOW_FRAMES *
+	    ((samples-1) / BANDSTATS_DECIMATION + 1);
+    reset();
+}
+
+
+BandStats::~BandStats()
+{
+    int i;
+
+    for (i=0;i < NUM_BANDSTATS_CHANNELS;i++)
+	delete[] m_hist[i];
+}
+
+
+void BandStats::reset(void)
+{
+    int i;
+
+    for (i=0;i < NUM_BANDSTATS_CHANNELS;i++) {
+	(void)memset(m_hist[i], 0, BANDSTATS_BINS * sizeof(u_int));
+	m_count[i] = 0;
+    }
+    m_frames = 0;
+}
+
+
+void BandStats::addLine(int channel, const u_short *pixels,
+    const u_short *dark, const u_char *mask)
+{
+    u_int *hist;
+    int j, value, n;
+
+	/* with a dark, sample what the display shows -- dark subtracted,
+	   bad pixels left out */
+
+    hist = m_hist[channel];
+    n = 0;
+    for (j=0;j < m_samples;j += BANDSTATS_DECIMATION) {
+	value = pixels[j];
+	if (dark != NULL) {
+	    if (mask[j])
+		continue;
+	    value -= dark[j];
+	    if (value < 0) value = 0;
+	}
+	if (value >= BANDSTATS_BINS)
+	    value = BANDSTATS_BINS-1;
+	hist[value]++;
+	n++;
+    }
+    m_count[channel] += n;
+    if (m_count[channel] >= m_window[channel])
+	decay(channel);
+}
+
+
+void BandStats::decay(int channel)
+{
+    u_int *hist;
+    u_int count;
+    int i;
+
+    hist = m_hist[channel];
+    count = 0;
+    for (i=0;i < BANDSTATS_BINS;i++) {
+	hist[i] >>= 1;
+	count += hist[i];
+    }
+    m_count[channel] = count;
+}
+
+
+void BandStats::addFrame(const u_short *image, const u_short *dark,
+    const u_char *mask, int redBand, int greenBand, int blueBand)
+{
+    int i, offset;
+
+	/* pass a NULL dark for raw statistics.  bands count from 1, just
+	   after the header line */
+
+    for (i=1;i < m_lines;i += BANDSTATS_DECIMATION) {
+	offset = i * m_samples;
+	addLine(BANDSTATS_FRAME, image + offset,
+	    (dark != NULL)? dark + offset:NULL, mask + offset);
+    }
+
+    offset = redBand * m_samples;
+    addLine(BANDSTATS_RED, image + offset,
+	(dark != NULL)? dark + offset:NULL, mask + offset);
+    offset = greenBand * m_samples;
+    addLine(BANDSTATS_GREEN, image + offset,
+	(dark != NULL)? dark + offset:NULL, mask + offset);
+    offset = blueBand * m_samples;
+    addLine(BANDSTATS_BLUE, image + offset,
+	(dark != NULL)? dark + offset:NULL, mask + offset);
+    m_frames++;
+}
+
+
+int BandStats::percentile(int channel, double pct) const
+{
+    const u_int *hist;
+    double target, sum;
+    int i;
+
+	/* the DN at or below which pct percent of the samples fall, or -1
+	   if there's nothing to go on yet */
+
+    if (m_count[channel] == 0)
+	return -1;
+    hist = m_hist[channel];
+    target = m_count[channel] * pct / 100.0;
+    sum = 0.0;
+    for (i=0;i < BANDSTATS_BINS-1;i++) {
+	sum += hist[i];
+	if (sum >= target)
+	    break;
+    }
+    return i;
+}
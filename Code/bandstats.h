@@ -0,0 +1,61 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* streaming band statistics for the automatic stretch.  frames are
+       sampled on a coarse grid into one histogram for the frame as a
+       whole (what the frame view shows) and one for each of the
+       waterfall's red, green and blue bands.  each channel's histogram
+       holds about BANDSTATS_WINDOW_FRAMES frames' worth of samples; once
+       it's full the counts are halved, so old frames fade out rather
+       than dropping off all at once and the percentiles track the scene
+       as it changes.  the header line is never sampled */
+
+#define BANDSTATS_DECIMATION	4	/* every 4th sample of every 4th line */
+#define BANDSTATS_WINDOW_FRAMES	16
+#define BANDSTATS_BINS		(1<<14)	/* one per DN */
+
+#define BANDSTATS_FRAME		0
+#define BANDSTATS_RED		1
+#define BANDSTATS_GREEN		2
+#define BANDSTATS_BLUE		3
+#define NUM_BANDSTATS_CHANNELS	4
+
+class BandStats
+{
+protected:
+    int m_lines;
+    int m_samples;
+    u_int *m_hist[NUM_BANDSTATS_CHANNELS];
+    u_int m_count[NUM_BANDSTATS_CHANNELS];
+    u_int m_window[NUM_BANDSTATS_CHANNELS];
+    u_int m_frames;
+
+    void addLine(int channel, const u_short *pixels, const u_short *dark,
+	const u_char *mask);
+    void decay(int channel);
+public:
+    BandStats(int lines, int samples);
+    ~BandStats();
+    void reset(void);
+    void addFrame(const u_short *image, const u_short *dark,
+	const u_char *mask, int redBand, int greenBand, int blueBand);
+    int percentile(int channel, double pct) const;
+    u_int count(int channel) const { return m_count[channel]; }
+    const u_int *histogram(int channel) const { return m_hist[channel]; }
+    u_int frames(void) const { return m_frames; }
+};
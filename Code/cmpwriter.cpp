@@ -0,0 +1,447 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "pipeline.h"
+#include "tracer.h"
+#include "ricecodec.h"
+#include "cmpwriter.h"
+
+extern const char *const cmpwriterDate = "$Date: 2015/12/23 16:05:48 $";
+
+#define SLOT_FREE	0
+#define SLOT_FILLED	1
+#define SLOT_ENCODING	2
+#define SLOT_ENCODED	3
+
+#define INITIAL_INDEX_FRAMES	(100 * 60 * 10)	/* 10 min, 100 Hz */
+
+
+CompressedImageWriter::CompressedImageWriter()
+{
+    int i;
+
+    m_fd = -1;
+    m_path[0] = '\0';
+    m_lines = 0;
+    m_samples = 0;
+    m_frameBytes = 0;
+    for (i=0;i < CMPWRITER_NUM_SLOTS;i++) {
+	m_raw[i] = NULL;
+	m_packed[i] = NULL;
+	m_packedBytes[i] = 0;
+	m_method[i] = 0;
+	m_frame[i] = 0;
+	m_state[i] = SLOT_FREE;
+    }
+    m_fillSlot = 0;
+    m_encodeSlot = 0;
+    m_writeSlot = 0;
+    m_frames = 0;
+    m_offsets = NULL;
+    m_maxOffsets = 0;
+    m_nextOffset = 0;
+    m_numThreads = 0;
+    m_haveWriteThread = false;
+    m_shutdown = 0;
+    m_error = 0;
+    m_openTime = 0.0;
+    m_encodeSecs = 0.0;
+    m_packedTotal = 0.0;
+    m_framesWritten = 0;
+    m_storedFrames = 0;
+    (void)pthread_mutex_init(&m_lock, NULL);
+    (void)pthread_cond_init(&m_workCond, NULL);
+    (void)pthread_cond_init(&m_encodedCond, NULL);
+    (void)pthread_cond_init(&m_freeCond, NULL);
+}
+
+
+CompressedImageWriter::~CompressedImageWriter()
+{
+    int i;
+
+    if (m_fd != -1)
+	(void)close();
+    for (i=0;i < CMPWRITER_NUM_SLOTS;i++) {
+	delete[] m_raw[i];
+	delete[] m_packed[i];
+    }
+    delete[] m_offsets;
+    (void)pthread_cond_destroy(&m_freeCond);
+    (void)pthread_cond_destroy(&m_encodedCond);
+    (void)pthread_cond_destroy(&m_workCond);
+    (void)pthread_mutex_destroy(&m_lock);
+}
+
+
+int CompressedImageWriter::open(const char *path, int lines, int samples)
+{
+    cmp_header_t header;
+    int i, saveErrno;
+
+    if (m_fd != -1) {
+	errno = EBUSY;
+	return -1;
+    }
+
+	/* slot buffers hang around between recordings unless the frame
+	   size changes.  a packed frame no bigger than the raw one is all
+	   we'll keep -- anything bigger gets stored instead */
+
+    if ((size_t)lines * samples * sizeof(u_short) != m_frameBytes) {
+	m_frameBytes = (size_t)lines * samples * sizeof(u_short);
+	for (i=0;i < CMPWRITER_NUM_SLOTS;i++) {
+	    delete[] m_raw[i];
+	    delete[] m_packed[i];
+	    m_raw[i] = new u_short[(size_t)lines * samples];
+	    m_packed[i] = new u_char[m_frameBytes];
+	}
+    }
+    m_lines = lines;
+    m_samples = samples;
+    if (m_offsets == NULL) {
+	m_maxOffsets = INITIAL_INDEX_FRAMES;
+	m_offsets = new u_int64_t[m_maxOffsets];
+    }
+
+    if ((m_fd=::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+	return -1;
+    (void)strcpy(m_path, path);
+    (void)memset(&header, 0, sizeof(header));
+    (void)memcpy(header.magic, CMP_MAGIC, sizeof(header.magic));
+    header.version = CMP_VERSION;
+    header.lines = lines;
+    header.samples = samples;
+    m_error = 0;
+    if (writeAll(&header, sizeof(header)) == -1) {
+	saveErrno = errno;
+	(void)::close(m_fd);
+	m_fd = -1;
+	errno = saveErrno;
+	return -1;
+    }
+
+    for (i=0;i < CMPWRITER_NUM_SLOTS;i++)
+	m_state[i] = SLOT_FREE;
+    m_fillSlot = 0;
+    m_encodeSlot = 0;
+    m_writeSlot = 0;
+    m_frames = 0;
+    m_nextOffset = sizeof(header);
+    m_shutdown = 0;
+    m_openTime = pipelineNow();
+    m_encodeSecs = 0.0;
+    m_packedTotal = 0.0;
+    m_framesWritten = 0;
+    m_storedFrames = 0;
+
+    m_haveWriteThread = (pthread_create(&m_writeThread, NULL, writeMain,
+	this) == 0);
+    for (m_numThreads=0;m_haveWriteThread &&
+	    m_numThreads < CMPWRITER_NUM_THREADS;m_numThreads++)
+	if (pthread_create(&m_threads[m_numThreads], NULL, encodeMain,
+		this) != 0)
+	    break;
+    if (m_numThreads == 0) {
+	saveErrno = errno;
+	stopThreads();
+	(void)::close(m_fd);
+	m_fd = -1;
+	errno = saveErrno;
+	return -1;
+    }
+    return 0;
+}
+
+
+int CompressedImageWriter::writeAll(const void *buf, size_t bytes)
+{
+    const char *cp = (const char *)buf;
+    ssize_t n;
+    u_int64_t t0;
+
+    t0 = traceStart();
+    while (bytes > 0) {
+	n = write(m_fd, cp, bytes);
+	if (n == -1 && errno == EINTR)
+	    continue;
+	if (n <= 0) {
+	    if (n == 0)
+		errno = ENOSPC;
+	    return -1;
+	}
+	cp += n;
+	bytes -= n;
+    }
+    traceEnd(TRACE_WRITE, t0);
+    return 0;
+}
+
+
+int CompressedImageWriter::writeFrame(const void *frame)
+{
+    int slot;
+
+    if (m_fd == -1) {
+	errno = EBADF;
+	return -1;
+    }
+
+	/* wait for the next slot to come free.  if the encoders or the
+	   disk can't keep up, this is where we back up */
+
+    (void)pthread_mutex_lock(&m_lock);
+    while (m_state[m_fillSlot] != SLOT_FREE && !m_error)
+	(void)pthread_cond_wait(&m_freeCond, &m_lock);
+    if (m_error) {
+	errno = m_error;
+	(void)pthread_mutex_unlock(&m_lock);
+	return -1;
+    }
+    slot = m_fillSlot;
+    (void)pthread_mutex_unlock(&m_lock);
+
+	/* only we fill slots, so the copy can happen unlocked */
+
+    (void)memcpy(m_raw[slot], frame, m_frameBytes);
+
+    (void)pthread_mutex_lock(&m_lock);
+    m_frame[slot] = m_frames++;
+    m_state[slot] = SLOT_FILLED;
+    m_fillSlot = (m_fillSlot + 1) % CMPWRITER_NUM_SLOTS;
+    (void)pthread_cond_signal(&m_workCond);
+    (void)pthread_mutex_unlock(&m_lock);
+    return 0;
+}
+
+
+void *CompressedImageWriter::encodeMain(void *arg)
+{
+    CompressedImageWriter *me = (CompressedImageWriter *)arg;
+    int slot;
+    size_t bytes;
+    double start;
+
+	/* slots are filled in order, so the next one to encode is always
+	   the one after the last one taken */
+
+    (void)pthread_mutex_lock(&me->m_lock);
+    for (;;) {
+	while (me->m_state[me->m_encodeSlot] != SLOT_FILLED &&
+		!me->m_shutdown)
+	    (void)pthread_cond_wait(&me->m_workCond, &me->m_lock);
+	if (me->m_state[me->m_encodeSlot] != SLOT_FILLED)
+	    break;
+	slot = me->m_encodeSlot;
+	me->m_state[slot] = SLOT_ENCODING;
+	me->m_encodeSlot = (me->m_encodeSlot + 1) % CMPWRITER_NUM_SLOTS;
+	(void)pthread_mutex_unlock(&me->m_lock);
+
+	start = pipelineNow();
+	bytes = riceEncodeFrame(me->m_packed[slot], me->m_frameBytes,
+	    me->m_raw[slot], me->m_lines, me->m_samples);
+	if (bytes == 0) {
+	    me->m_method[slot] = RICE_METHOD_STORED;
+	    me->m_packedBytes[slot] = me->m_frameBytes;
+	}
+	else {
+	    me->m_method[slot] = RICE_METHOD_RICE;
+	    me->m_packedBytes[slot] = bytes;
+	}
+
+	(void)pthread_mutex_lock(&me->m_lock);
+	me->m_encodeSecs += pipelineNow() - start;
+	me->m_state[slot] = SLOT_ENCODED;
+	(void)pthread_cond_broadcast(&me->m_encodedCond);
+    }
+    (void)pthread_mutex_unlock(&me->m_lock);
+    return NULL;
+}
+
+
+void *CompressedImageWriter::writeMain(void *arg)
+{
+    CompressedImageWriter *me = (CompressedImageWriter *)arg;
+    cmp_record_t record;
+    u_int64_t *offsets;
+    const void *data;
+    int slot, failed;
+
+    (void)pthread_mutex_lock(&me->m_lock);
+    for (;;) {
+	while (me->m_state[me->m_writeSlot] != SLOT_ENCODED &&
+		!me->m_shutdown)
+	    (void)pthread_cond_wait(&me->m_encodedCond, &me->m_lock);
+	if (me->m_state[me->m_writeSlot] != SLOT_ENCODED)
+	    break;
+	slot = me->m_writeSlot;
+	(void)pthread_mutex_unlock(&me->m_lock);
+
+	    /* after a failure we keep taking frames so nobody waits on
+	       us forever, but don't write them */
+
+	failed = 0;
+	if (!me->m_error) {
+	    record.sync = CMP_RECORD_SYNC;
+	    record.frame = me->m_frame[slot];
+	    record.method = me->m_method[slot];
+	    record.bytes = me->m_packedBytes[slot];
+	    data = (record.method == RICE_METHOD_STORED)?
+		(const void *)me->m_raw[slot]:(const void *)me->m_packed[slot];
+	    if (me->writeAll(&record, sizeof(record)) == -1 ||
+		    me->writeAll(data, record.bytes) == -1)
+		failed = errno;
+	    else {
+		if (record.frame >= me->m_maxOffsets) {
+		    offsets = new u_int64_t[2 * me->m_maxOffsets];
+		    (void)memcpy(offsets, me->m_offsets,
+			me->m_maxOffsets * sizeof(u_int64_t));
+		    delete[] me->m_offsets;
+		    me->m_offsets = offsets;
+		    me->m_maxOffsets *= 2;
+		}
+		me->m_offsets[record.frame] = me->m_nextOffset;
+		me->m_nextOffset += sizeof(record) + record.bytes;
+	    }
+	}
+
+	(void)pthread_mutex_lock(&me->m_lock);
+	if (failed && me->m_error == 0)
+	    me->m_error = failed;
+	if (!failed && !me->m_error) {
+	    me->m_packedTotal += sizeof(record) + me->m_packedBytes[slot];
+	    me->m_framesWritten++;
+	    if (me->m_method[slot] == RICE_METHOD_STORED)
+		me->m_storedFrames++;
+	}
+	me->m_state[slot] = SLOT_FREE;
+	me->m_writeSlot = (me->m_writeSlot + 1) % CMPWRITER_NUM_SLOTS;
+	(void)pthread_cond_broadcast(&me->m_freeCond);
+    }
+    (void)pthread_mutex_unlock(&me->m_lock);
+    return NULL;
+}
+
+
+void CompressedImageWriter::stopThreads(void)
+{
+    int i;
+
+    (void)pthread_mutex_lock(&m_lock);
+    m_shutdown = 1;
+    (void)pthread_cond_broadcast(&m_workCond);
+    (void)pthread_cond_broadcast(&m_encodedCond);
+    (void)pthread_mutex_unlock(&m_lock);
+    for (i=0;i < m_numThreads;i++)
+	(void)pthread_join(m_threads[i], NULL);
+    m_numThreads = 0;
+    if (m_haveWriteThread)
+	(void)pthread_join(m_writeThread, NULL);
+    m_haveWriteThread = false;
+}
+
+
+int CompressedImageWriter::close(void)
+{
+    cmp_record_t record;
+    cmp_trailer_t trailer;
+    int i, result, saveErrno;
+
+    if (m_fd == -1)
+	return 0;
+
+	/* let everything in the slots get written, then stop the threads.
+	   the write thread frees slots even after an error, so this
+	   always finishes */
+
+    (void)pthread_mutex_lock(&m_lock);
+    for (i=0;i < CMPWRITER_NUM_SLOTS;i++)
+	while (m_state[i] != SLOT_FREE)
+	    (void)pthread_cond_wait(&m_freeCond, &m_lock);
+    (void)pthread_mutex_unlock(&m_lock);
+    stopThreads();
+
+	/* then the index, if there's something to index */
+
+    result = 0;
+    saveErrno = m_error;
+    if (m_error)
+	result = -1;
+    else {
+	record.sync = CMP_RECORD_SYNC;
+	record.frame = m_framesWritten;
+	record.method = CMP_METHOD_INDEX;
+	record.bytes = m_framesWritten * sizeof(u_int64_t);
+	(void)memset(&trailer, 0, sizeof(trailer));
+	(void)memcpy(trailer.magic, CMP_INDEX_MAGIC, sizeof(trailer.magic));
+	trailer.indexOffset = m_nextOffset;
+	trailer.frames = m_framesWritten;
+	if (writeAll(&record, sizeof(record)) == -1 ||
+		writeAll(m_offsets, record.bytes) == -1 ||
+		writeAll(&trailer, sizeof(trailer)) == -1) {
+	    saveErrno = errno;
+	    result = -1;
+	}
+    }
+    if (::close(m_fd) == -1 && result == 0) {
+	saveErrno = errno;
+	result = -1;
+    }
+    m_fd = -1;
+    if (result == -1)
+	errno = saveErrno;
+    return result;
+}
+
+
+void CompressedImageWriter::removeFile(void)
+{
+    if (m_path[0] != '\0')
+	(void)unlink(m_path);
+}
+
+
+void CompressedImageWriter::getStats(CmpWriterStats *stats_p)
+{
+    double now;
+    int i;
+
+	/* since open, like RawImageWriter::getRecordingStats */
+
+    (void)pthread_mutex_lock(&m_lock);
+    now = pipelineNow();
+    stats_p->frames = m_framesWritten;
+    stats_p->storedFrames = m_storedFrames;
+    stats_p->ratio = (m_packedTotal > 0.0)?
+	(double)m_framesWritten * m_frameBytes / m_packedTotal:0.0;
+    stats_p->mbPerSec = (now > m_openTime)?
+	m_packedTotal / (now - m_openTime) / (1024.0 * 1024.0):0.0;
+    stats_p->encodeMsPerFrame = (m_framesWritten > 0)?
+	1000.0 * m_encodeSecs / m_framesWritten:0.0;
+    stats_p->slotsBusy = 0;
+    for (i=0;i < CMPWRITER_NUM_SLOTS;i++)
+	if (m_state[i] != SLOT_FREE)
+	    stats_p->slotsBusy++;
+    (void)pthread_mutex_unlock(&m_lock);
+}
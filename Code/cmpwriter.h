@@ -0,0 +1,141 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/param.h>
+
+    /* compressed flight-line writer.  frames handed to writeFrame are
+       copied into one of CMPWRITER_NUM_SLOTS slots, compressed (see
+       ricecodec.h) by a pool of encoder threads, and written out in order
+       by one more thread.  slots are filled, encoded and written in
+       turn, so frames never get reordered however the encoders finish;
+       if the encoders or the disk fall behind, writeFrame waits for a
+       slot, which backs up the record stage as the raw writer does.
+       output is ordinary buffered writes since records aren't a fixed
+       size.
+
+       the _raw.cmp file is a cmp_header_t, then for each frame a
+       cmp_record_t and its data, so it can be read straight through as
+       it's being written.  at close an index record follows the last
+       frame, holding the file offset of each frame's record, and then a
+       cmp_trailer_t saying where the index is.  a file that was never
+       closed has no index, but the frame records can still be read
+       through to the end.  all values are in host byte order */
+
+#define CMP_FILE_SUFFIX		".cmp"	/* after the _raw */
+#define CMP_MAGIC		"NGDCSCMP"
+#define CMP_INDEX_MAGIC		"NGDCSIDX"
+#define CMP_VERSION		1
+#define CMP_RECORD_SYNC		0x43524543
+#define CMP_METHOD_INDEX	0xff	/* else a RICE_METHOD_* */
+
+#define CMPWRITER_NUM_SLOTS	8
+#define CMPWRITER_NUM_THREADS	4
+
+typedef struct {
+    char magic[8];
+    u_int version;
+    u_int lines;
+    u_int samples;
+    u_int reserved;
+} cmp_header_t;
+
+typedef struct {
+    u_int sync;
+    u_int frame;
+    u_int method;
+    u_int bytes;		/* of data following */
+} cmp_record_t;
+
+typedef struct {
+    char magic[8];
+    u_int64_t indexOffset;	/* of the index's cmp_record_t */
+    u_int frames;
+    u_int reserved;
+} cmp_trailer_t;
+
+struct CmpWriterStats {
+    double ratio;		/* raw bytes to compressed */
+    double mbPerSec;		/* compressed, since open */
+    double encodeMsPerFrame;
+    u_int frames;
+    u_int storedFrames;		/* that didn't compress */
+    int slotsBusy;
+};
+
+class CompressedImageWriter
+{
+protected:
+    int m_fd;
+    char m_path[MAXPATHLEN+sizeof(CMP_FILE_SUFFIX)];
+    int m_lines;
+    int m_samples;
+    size_t m_frameBytes;
+
+	/* slots.  each moves from free to filled (by writeFrame) to
+	   encoding to encoded and back to free (by the write thread) */
+
+    u_short *m_raw[CMPWRITER_NUM_SLOTS];
+    u_char *m_packed[CMPWRITER_NUM_SLOTS];
+    size_t m_packedBytes[CMPWRITER_NUM_SLOTS];
+    u_int m_method[CMPWRITER_NUM_SLOTS];
+    u_int m_frame[CMPWRITER_NUM_SLOTS];
+    int m_state[CMPWRITER_NUM_SLOTS];
+    int m_fillSlot;
+    int m_encodeSlot;
+    int m_writeSlot;
+    u_int m_frames;
+
+	/* where each frame went, for the index */
+
+    u_int64_t *m_offsets;
+    u_int m_maxOffsets;
+    off_t m_nextOffset;
+
+    pthread_t m_threads[CMPWRITER_NUM_THREADS];
+    int m_numThreads;
+    pthread_t m_writeThread;
+    bool m_haveWriteThread;
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_workCond;
+    pthread_cond_t m_encodedCond;
+    pthread_cond_t m_freeCond;
+    int m_shutdown;
+    int m_error;		/* errno of first failed write, or 0 */
+
+    double m_openTime;
+    double m_encodeSecs;
+    double m_packedTotal;
+    u_int m_framesWritten;
+    u_int m_storedFrames;
+
+    static void *encodeMain(void *arg);
+    static void *writeMain(void *arg);
+    int writeAll(const void *buf, size_t bytes);
+    void stopThreads(void);
+public:
+    CompressedImageWriter();
+    ~CompressedImageWriter();
+    int open(const char *path, int lines, int samples);
+    int writeFrame(const void *frame);
+    int close(void);
+    void removeFile(void);
+    int isOpen(void) const { return m_fd != -1; }
+    void getStats(CmpWriterStats *stats_p);
+};
@@ -0,0 +1,393 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/param.h>
+#include "frameops.h"
+#include "darkmodel.h"
+
+extern const char *const darkmodelDate = "$Date: 2015/12/22 10:14:37 $";
+
+#define SIGMA_HIST_SCALE	16	/* histogram bins per DN of noise */
+
+
+DarkModel::DarkModel(int lines, int samples)
+{
+    int n;
+
+    m_lines = lines;
+    m_samples = samples;
+    m_pixels = (lines - 1) * samples;
+    m_accumulate = darkAccumulator(-1);
+
+    n = lines * samples;
+    m_sum = new u_int[n];
+    m_sumSq = new u_int64_t[n];
+    m_clipSum = new u_int[n];
+    m_clipSumSq = new u_int64_t[n];
+    m_clipCount = new u_short[n];
+    m_clipLow = new u_short[n];
+    m_clipHigh = new u_short[n];
+    m_mean = new float[n];
+    m_sigma = new float[n];
+    m_clipped = new u_short[n];
+    m_clippedSigma = new float[n];
+    m_mask = new u_char[n];
+    (void)memset(m_mean, 0, n * sizeof(float));
+    (void)memset(m_sigma, 0, n * sizeof(float));
+    (void)memset(m_clipped, 0, n * sizeof(u_short));
+    (void)memset(m_clippedSigma, 0, n * sizeof(float));
+    (void)memset(m_mask, 0, n);
+    m_modelFrames = 0;
+    m_timestamp = 0;
+    m_numHot = m_numDead = m_numNoisy = 0;
+    reset();
+}
+
+
+DarkModel::~DarkModel()
+{
+    delete[] m_sum;
+    delete[] m_sumSq;
+    delete[] m_clipSum;
+    delete[] m_clipSumSq;
+    delete[] m_clipCount;
+    delete[] m_clipLow;
+    delete[] m_clipHigh;
+    delete[] m_mean;
+    delete[] m_sigma;
+    delete[] m_clipped;
+    delete[] m_clippedSigma;
+    delete[] m_mask;
+}
+
+
+void DarkModel::reset(void)
+{
+    int n;
+
+    n = m_lines * m_samples;
+    (void)memset(m_sum, 0, n * sizeof(u_int));
+    (void)memset(m_sumSq, 0, n * sizeof(u_int64_t));
+    (void)memset(m_clipSum, 0, n * sizeof(u_int));
+    (void)memset(m_clipSumSq, 0, n * sizeof(u_int64_t));
+    (void)memset(m_clipCount, 0, n * sizeof(u_short));
+    m_frames = 0;
+}
+
+
+void DarkModel::setClipBounds(void)
+{
+    double recip, mean, sigma, bound;
+    int i, offset;
+
+	/* don't let a pixel that happened to hold still through the priming
+	   frames reject everything after */
+
+    recip = 1.0 / m_frames;
+    offset = m_samples;
+    for (i=offset;i < offset + m_pixels;i++) {
+	mean = m_sum[i] * recip;
+	sigma = m_sumSq[i] * recip - mean * mean;
+	sigma = (sigma > 1.0)? sqrt(sigma):1.0;
+	bound = mean - DARKMODEL_CLIP_SIGMAS * sigma;
+	m_clipLow[i] = (bound < 0.0)? 0:(u_short)bound;
+	bound = mean + DARKMODEL_CLIP_SIGMAS * sigma + 1.0;
+	m_clipHigh[i] = (bound > 65535.0)? 65535:(u_short)bound;
+    }
+}
+
+
+void DarkModel::addFrame(const u_short *image)
+{
+    const u_short *usp, *lo, *hi;
+    u_int *sum;
+    u_int64_t *sumSq;
+    u_short *count;
+    u_int x, in;
+    int i, n;
+
+    if (m_frames >= DARKMODEL_MAX_FRAMES)
+	return;
+    (*m_accumulate)(m_sum + m_samples, m_sumSq + m_samples,
+	image + m_samples, m_pixels);
+
+	/* once we know roughly where each pixel sits, start the clipped
+	   sums.  this is written without branches so the compiler can
+	   vectorize it */
+
+    if (m_frames >= DARKMODEL_PRIME_FRAMES) {
+	usp = image + m_samples;
+	lo = m_clipLow + m_samples;
+	hi = m_clipHigh + m_samples;
+	sum = m_clipSum + m_samples;
+	sumSq = m_clipSumSq + m_samples;
+	count = m_clipCount + m_samples;
+	n = m_pixels;
+	for (i=0;i < n;i++) {
+	    x = usp[i];
+	    in = -(u_int)((x >= lo[i]) & (x <= hi[i]));
+	    x &= in;
+	    sum[i] += x;
+	    sumSq[i] += x * x;
+	    count[i] -= (u_short)in;
+	}
+    }
+    m_frames++;
+    if (m_frames == DARKMODEL_PRIME_FRAMES)
+	setClipBounds();
+}
+
+
+int DarkModel::finish(void)
+{
+    double recip, mean, var;
+    int i, offset;
+    u_int n;
+
+    if (m_frames < DARKMODEL_MIN_FRAMES)
+	return -1;
+
+	/* average by multiplying by the reciprocal.  if we never got past
+	   priming, or a pixel had every sample clipped, the plain statistics
+	   will have to do */
+
+    recip = 1.0 / m_frames;
+    offset = m_samples;
+    for (i=offset;i < offset + m_pixels;i++) {
+	mean = m_sum[i] * recip;
+	var = m_sumSq[i] * recip - mean * mean;
+	m_mean[i] = (float)mean;
+	m_sigma[i] = (var > 0.0)? (float)sqrt(var):0.0f;
+	if ((n=m_clipCount[i]) > 0) {
+	    mean = m_clipSum[i] / (double)n;
+	    var = m_clipSumSq[i] / (double)n - mean * mean;
+	}
+	m_clipped[i] = (u_short)(mean + 0.5);
+	m_clippedSigma[i] = (var > 0.0)? (float)sqrt(var):0.0f;
+    }
+    m_modelFrames = m_frames;
+    m_timestamp = time(NULL);
+    findBadPixels();
+    return 0;
+}
+
+
+	/* median of a histogram, as a bin number */
+
+static int histogramMedian(const u_int *hist, int bins, int count)
+{
+    int i, n;
+
+    n = 0;
+    for (i=0;i < bins;i++) {
+	n += hist[i];
+	if (2 * n >= count)
+	    return i;
+    }
+    return bins - 1;
+}
+
+
+void DarkModel::findBadPixels(void)
+{
+    u_int *hist;
+    int i, offset, bin, medianDark, spread;
+    double medianSigma, hotLevel;
+
+    offset = m_samples;
+    (void)memset(m_mask, 0, m_lines * m_samples);
+    m_numHot = m_numDead = m_numNoisy = 0;
+
+	/* the typical dark level, and its spread across the frame from the
+	   median absolute deviation (scaled to match a gaussian sigma) */
+
+    hist = new u_int[65536];
+    (void)memset(hist, 0, 65536 * sizeof(u_int));
+    for (i=offset;i < offset + m_pixels;i++)
+	hist[m_clipped[i]]++;
+    medianDark = histogramMedian(hist, 65536, m_pixels);
+    (void)memset(hist, 0, 65536 * sizeof(u_int));
+    for (i=offset;i < offset + m_pixels;i++)
+	hist[abs((int)m_clipped[i] - medianDark)]++;
+    spread = histogramMedian(hist, 65536, m_pixels);
+    hotLevel = medianDark + DARKMODEL_HOT_SIGMAS *
+	((spread > 0)? 1.4826 * spread:1.0);
+
+	/* the typical noise.  use the clipped noise so a pixel that took a
+	   cosmic ray during the dark period isn't called noisy */
+
+    (void)memset(hist, 0, 65536 * sizeof(u_int));
+    for (i=offset;i < offset + m_pixels;i++) {
+	bin = (int)(m_clippedSigma[i] * SIGMA_HIST_SCALE + 0.5);
+	hist[(bin > 65535)? 65535:bin]++;
+    }
+    medianSigma = histogramMedian(hist, 65536, m_pixels) /
+	(double)SIGMA_HIST_SCALE;
+    delete[] hist;
+
+    for (i=offset;i < offset + m_pixels;i++) {
+	if (m_clipped[i] > hotLevel) {
+	    m_mask[i] |= DARKPIXEL_HOT;
+	    m_numHot++;
+	}
+
+	    /* noise-based checks only make sense if there's noise -- there
+	       isn't with simulated data */
+
+	if (medianSigma > 0.0) {
+	    if (m_clippedSigma[i] < DARKMODEL_DEAD_FRACTION * medianSigma) {
+		m_mask[i] |= DARKPIXEL_DEAD;
+		m_numDead++;
+	    }
+	    else if (m_clippedSigma[i] >
+		    DARKMODEL_NOISY_FACTOR * medianSigma) {
+		m_mask[i] |= DARKPIXEL_NOISY;
+		m_numNoisy++;
+	    }
+	}
+    }
+}
+
+
+void DarkModel::setFromDark(const u_short *dark)
+{
+    int i, n;
+
+	/* for a plain dark frame saved before we kept models.  we know
+	   nothing about noise, so nothing is masked */
+
+    n = m_lines * m_samples;
+    (void)memcpy(m_clipped, dark, n * sizeof(u_short));
+    for (i=0;i < n;i++)
+	m_mean[i] = dark[i];
+    (void)memset(m_sigma, 0, n * sizeof(float));
+    (void)memset(m_clippedSigma, 0, n * sizeof(float));
+    (void)memset(m_mask, 0, n);
+    m_modelFrames = 0;
+    m_timestamp = 0;
+    m_numHot = m_numDead = m_numNoisy = 0;
+}
+
+
+int DarkModel::write(const char *path)
+{
+    darkmodel_header_t hdr;
+    char temp[MAXPATHLEN+10];
+    FILE *fp;
+    size_t n;
+    int saveErrno;
+
+	/* write to a temporary and rename, so we never leave a partial
+	   model where the last good one was */
+
+    (void)memset(&hdr, 0, sizeof(hdr));
+    (void)memcpy(hdr.magic, DARKMODEL_MAGIC, sizeof(hdr.magic));
+    hdr.version = DARKMODEL_VERSION;
+    hdr.lines = m_lines;
+    hdr.samples = m_samples;
+    hdr.frames = m_modelFrames;
+    hdr.timestamp = m_timestamp;
+    hdr.clipSigmas = DARKMODEL_CLIP_SIGMAS;
+    hdr.numHot = m_numHot;
+    hdr.numDead = m_numDead;
+    hdr.numNoisy = m_numNoisy;
+
+    n = m_lines * m_samples;
+    (void)sprintf(temp, "%s.tmp", path);
+    if ((fp=fopen(temp, "wb")) == NULL)
+	return -1;
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    fwrite(m_mean, sizeof(float), n, fp) != n ||
+	    fwrite(m_sigma, sizeof(float), n, fp) != n ||
+	    fwrite(m_clipped, sizeof(u_short), n, fp) != n ||
+	    fwrite(m_clippedSigma, sizeof(float), n, fp) != n ||
+	    fwrite(m_mask, sizeof(u_char), n, fp) != n) {
+	saveErrno = errno;
+	(void)fclose(fp);
+	(void)unlink(temp);
+	errno = saveErrno;
+	return -1;
+    }
+    if (fclose(fp) == EOF || rename(temp, path) == -1) {
+	saveErrno = errno;
+	(void)unlink(temp);
+	errno = saveErrno;
+	return -1;
+    }
+    return 0;
+}
+
+
+int DarkModel::read(const char *path, char *errorMsg)
+{
+    darkmodel_header_t hdr;
+    FILE *fp;
+    size_t n;
+
+    if ((fp=fopen(path, "rb")) == NULL) {
+	(void)sprintf(errorMsg, "Can't open dark model \"%s\".", path);
+	return -1;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    memcmp(hdr.magic, DARKMODEL_MAGIC, sizeof(hdr.magic)) != 0) {
+	(void)sprintf(errorMsg, "\"%s\" isn't a dark model.", path);
+	(void)fclose(fp);
+	return -1;
+    }
+    if (hdr.version != DARKMODEL_VERSION) {
+	(void)sprintf(errorMsg, "Unsupported dark model version %u in \"%s\".",
+	    hdr.version, path);
+	(void)fclose(fp);
+	return -1;
+    }
+    if ((int)hdr.lines != m_lines || (int)hdr.samples != m_samples) {
+	(void)sprintf(errorMsg, "Dark model \"%s\" is %ux%u, not %dx%d.",
+	    path, hdr.lines, hdr.samples, m_lines, m_samples);
+	(void)fclose(fp);
+	return -1;
+    }
+
+    n = m_lines * m_samples;
+    if (fread(m_mean, sizeof(float), n, fp) != n ||
+	    fread(m_sigma, sizeof(float), n, fp) != n ||
+	    fread(m_clipped, sizeof(u_short), n, fp) != n ||
+	    fread(m_clippedSigma, sizeof(float), n, fp) != n ||
+	    fread(m_mask, sizeof(u_char), n, fp) != n) {
+	(void)sprintf(errorMsg, "Dark model \"%s\" is too short.", path);
+	(void)fclose(fp);
+	(void)memset(m_mean, 0, n * sizeof(float));
+	(void)memset(m_sigma, 0, n * sizeof(float));
+	(void)memset(m_clipped, 0, n * sizeof(u_short));
+	(void)memset(m_clippedSigma, 0, n * sizeof(float));
+	(void)memset(m_mask, 0, n);
+	m_modelFrames = 0;
+	return -1;
+    }
+    (void)fclose(fp);
+    m_modelFrames = hdr.frames;
+    m_timestamp = hdr.timestamp;
+    m_numHot = hdr.numHot;
+    m_numDead = hdr.numDead;
+    m_numNoisy = hdr.numNoisy;
+    return 0;
+}
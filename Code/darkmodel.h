@@ -0,0 +1,127 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+#include <sys/types.h>
+#include <time.h>
+
+    /* dark model.  dark frames are added one at a time as they arrive, and
+       the model keeps running sums, so nothing is held per frame.  the
+       sums are exact integers, so the mean and standard deviation come out
+       right without needing Welford's update.  the first
+       DARKMODEL_PRIME_FRAMES frames set clip bounds of DARKMODEL_CLIP_SIGMAS
+       around each pixel's mean, and every later frame also goes into a
+       second set of sums that leaves out samples beyond those bounds
+       (cosmic rays, the shutter still settling).  the clipped mean is
+       what we subtract.
+
+       when the model is finished, pixels are checked against the rest of
+       the frame.  hot pixels have a dark level well above everyone else's,
+       dead pixels don't fluctuate at all, and noisy pixels fluctuate far
+       more than the rest (judged by the clipped noise, so one cosmic ray
+       doesn't condemn a pixel).  any of these is masked on display.
+
+       the first line of each frame is header data, so it's left out of
+       the model (zero dark, nothing masked).
+
+       the model is saved as a binary file -- a darkmodel_header_t, then
+       the mean and standard deviation (floats), the clipped mean
+       (u_shorts), the clipped standard deviation (floats) and the mask
+       (bytes), each a full frame in the host's byte order */
+
+#define DARKMODEL_MAGIC		"NGDCSDRK"
+#define DARKMODEL_VERSION	1
+#define DARKMODEL_PRIME_FRAMES	16
+#define DARKMODEL_MIN_FRAMES	4
+#define DARKMODEL_MAX_FRAMES	65535
+#define DARKMODEL_CLIP_SIGMAS	3.0
+#define DARKMODEL_HOT_SIGMAS	8.0	/* robust spatial sigmas */
+#define DARKMODEL_DEAD_FRACTION	0.05	/* of the median noise */
+#define DARKMODEL_NOISY_FACTOR	5.0	/* times the median noise */
+
+#define DARKPIXEL_HOT		0x01
+#define DARKPIXEL_DEAD		0x02
+#define DARKPIXEL_NOISY		0x04
+
+typedef struct {
+    char magic[8];		/* DARKMODEL_MAGIC, no terminator */
+    u_int version;
+    u_int lines;
+    u_int samples;
+    u_int frames;
+    u_int64_t timestamp;	/* secs since 1970, when finished */
+    float clipSigmas;
+    u_int numHot;
+    u_int numDead;
+    u_int numNoisy;
+} darkmodel_header_t;
+
+class DarkModel
+{
+protected:
+    int m_lines;
+    int m_samples;
+    int m_pixels;		/* in a frame, less the header line */
+    void (*m_accumulate)(u_int *sum, u_int64_t *sumSq,
+	const u_short *pixels, int n);
+
+	/* accumulation */
+
+    u_int *m_sum;
+    u_int64_t *m_sumSq;
+    u_int *m_clipSum;
+    u_int64_t *m_clipSumSq;
+    u_short *m_clipCount;
+    u_short *m_clipLow;
+    u_short *m_clipHigh;
+    int m_frames;
+
+	/* the finished model */
+
+    float *m_mean;
+    float *m_sigma;
+    u_short *m_clipped;
+    float *m_clippedSigma;
+    u_char *m_mask;
+    int m_modelFrames;
+    time_t m_timestamp;
+    int m_numHot;
+    int m_numDead;
+    int m_numNoisy;
+
+    void setClipBounds(void);
+    void findBadPixels(void);
+public:
+    DarkModel(int lines, int samples);
+    ~DarkModel();
+    void reset(void);
+    void addFrame(const u_short *image);
+    int framesAdded(void) const { return m_frames; }
+    int finish(void);
+    void setFromDark(const u_short *dark);
+    int write(const char *path);
+    int read(const char *path, char *errorMsg);
+
+    const float *mean(void) const { return m_mean; }
+    const float *sigma(void) const { return m_sigma; }
+    const u_short *clippedMean(void) const { return m_clipped; }
+    const float *clippedSigma(void) const { return m_clippedSigma; }
+    const u_char *mask(void) const { return m_mask; }
+    int frames(void) const { return m_modelFrames; }
+    time_t timestamp(void) const { return m_timestamp; }
+    int numHot(void) const { return m_numHot; }
+    int numDead(void) const { return m_numDead; }
+    int numNoisy(void) const { return m_numNoisy; }
+};
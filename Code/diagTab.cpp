@@ -16,6 +16,8 @@
 
 
 #include <unistd.h>
+#include <string.h>
+#include <time.h>
 #include <sys/param.h>
 #include <sys/mount.h>
 #include <sys/time.h>
@@ -27,6 +29,8 @@
 #include <gtkmm.h>
 #include "main.h"
 #include "framebuf.h"
+#include "tracer.h"
+#include "latencyhist.h"
 #include "plotting.h"
 #include "appFrame.h"
 #include "displayTab.h"
@@ -43,10 +47,14 @@ extern const char *const diagTabDate = "$Date: 2015/02/24 20:19:58 $";
 
 DiagTab::DiagTab(SettingsBlock *sb, appFrame *app) :
     m_framebufferStatsTable(4, 2, false),
+    m_latencyTable(3, 2, false),
     m_metadataStatsTable(2, 2, false),
     m_firstLineDataTable(1, 2, false),
     m_tempsTable(5, 2, false),
-    m_fpgaRegsTable(8, 4, false)
+    m_fpgaRegsTable(8, 4, false),
+    m_pipelineTable(7, 2, false),
+    m_rawWriterTable(2, 2, false),
+    m_traceTable(2, 3, false)
 {
         /* save pointer to the settings block */
 
@@ -86,6 +94,28 @@ DiagTab::DiagTab(SettingsBlock *sb, appFrame *app) :
 
     m_leftBox.pack_start(m_framebufferStatsFrame, Gtk::PACK_SHRINK);
 
+	/* set up frame-latency displays -- p50/p99/max since the last update,
+	   then over the last minute */
+
+    m_latencyTable.set_row_spacings(5);
+    m_latencyTable.set_col_spacings(15);
+    m_latencyTable.set_border_width(10);
+
+    m_latencyFrame.add(m_latencyTable);
+    m_latencyFrame.set_label("Frame latency (ms p50/p99/max, now  1 min)");
+
+    m_pickupLatencyEntry.set_width_chars(30);
+    m_writeLatencyEntry.set_width_chars(30);
+    m_arrivalJitterEntry.set_width_chars(30);
+    addDisplay(m_latencyTable, 0, "Card to pickup", m_pickupLatencyEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    addDisplay(m_latencyTable, 1, "Pickup to write", m_writeLatencyEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    addDisplay(m_latencyTable, 2, "Arrival jitter", m_arrivalJitterEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+
+    m_leftBox.pack_start(m_latencyFrame, Gtk::PACK_SHRINK);
+
 	/* set up metadata stats */
 
     m_metadataStatsTable.set_row_spacings(5);
@@ -144,6 +174,42 @@ DiagTab::DiagTab(SettingsBlock *sb, appFrame *app) :
 
     m_leftBox.pack_start(m_tempsFrame, Gtk::PACK_SHRINK);
 
+	/* set up hot-path tracing controls.  tracing is cheap enough to
+	   leave on; the rings keep the last few seconds of each thread,
+	   which Save writes to the daily directory for Perfetto or
+	   chrome://tracing */
+
+    m_traceTable.set_row_spacings(5);
+    m_traceTable.set_col_spacings(15);
+    m_traceTable.set_border_width(10);
+
+    m_traceFrame.add(m_traceTable);
+    m_traceFrame.set_label("Tracing");
+
+    m_traceDumpEntry.set_width_chars(28);
+    addDisplay(m_traceTable, 0, "Tracing", m_traceStateEntry,
+	traceEnabled? "On":"Off",
+	(m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    m_traceButton.set_label(traceEnabled? "Stop":"Start");
+    m_traceTable.attach(m_traceButton, 2, 3, 0, 1,
+	(Gtk::AttachOptions)0, (Gtk::AttachOptions)0);
+    m_traceButton.set_sensitive(
+	m_block->currentDiagOption() == DIAGOPTION_ON? true:false);
+    (void)m_traceButton.signal_clicked().connect(sigc::mem_fun(*this,
+	&DiagTab::onTraceButton));
+
+    addDisplay(m_traceTable, 1, "Last Trace", m_traceDumpEntry, "",
+	(m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    m_traceSaveButton.set_label("Save");
+    m_traceTable.attach(m_traceSaveButton, 2, 3, 1, 2,
+	(Gtk::AttachOptions)0, (Gtk::AttachOptions)0);
+    m_traceSaveButton.set_sensitive(
+	m_block->currentDiagOption() == DIAGOPTION_ON? true:false);
+    (void)m_traceSaveButton.signal_clicked().connect(sigc::mem_fun(*this,
+	&DiagTab::onTraceSaveButton));
+
+    m_leftBox.pack_start(m_traceFrame, Gtk::PACK_SHRINK);
+
 	/* set up FPGA register displays */
 
     m_fpgaRegsTable.set_row_spacings(5);
@@ -188,6 +254,57 @@ DiagTab::DiagTab(SettingsBlock *sb, appFrame *app) :
 
     m_rightBox.pack_start(m_fpgaRegsFrame, Gtk::PACK_SHRINK);
 
+	/* set up capture-pipeline displays -- queue depth now/max, latency
+	   from acquisition avg/max, frames dropped since the last update */
+
+    m_pipelineTable.set_row_spacings(5);
+    m_pipelineTable.set_col_spacings(15);
+    m_pipelineTable.set_border_width(10);
+
+    m_pipelineFrame.add(m_pipelineTable);
+    m_pipelineFrame.set_label("Pipeline (depth/max, ms avg/max, drops)");
+
+    m_processStageEntry.set_width_chars(28);
+    m_recordStageEntry.set_width_chars(28);
+    m_displayStageEntry.set_width_chars(28);
+    m_darkStageEntry.set_width_chars(28);
+    m_statsStageEntry.set_width_chars(28);
+    m_quicklookStageEntry.set_width_chars(28);
+    m_hashStageEntry.set_width_chars(28);
+    addDisplay(m_pipelineTable, 0, "Process", m_processStageEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    addDisplay(m_pipelineTable, 1, "Record", m_recordStageEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    addDisplay(m_pipelineTable, 2, "Display", m_displayStageEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    addDisplay(m_pipelineTable, 3, "Dark", m_darkStageEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    addDisplay(m_pipelineTable, 4, "Stats", m_statsStageEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    addDisplay(m_pipelineTable, 5, "Quicklook", m_quicklookStageEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    addDisplay(m_pipelineTable, 6, "Hash", m_hashStageEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+
+    m_rightBox.pack_start(m_pipelineFrame, Gtk::PACK_SHRINK);
+
+	/* set up image-writer displays */
+
+    m_rawWriterTable.set_row_spacings(5);
+    m_rawWriterTable.set_col_spacings(15);
+    m_rawWriterTable.set_border_width(10);
+
+    m_rawWriterFrame.add(m_rawWriterTable);
+    m_rawWriterFrame.set_label("Image writer");
+
+    addDisplay(m_rawWriterTable, 0, "MB/s", m_rawWriterRateEntry,
+	"0", (m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+    addDisplay(m_rawWriterTable, 1, "ms p50/p99/max",
+	m_rawWriterLatencyEntry, "0",
+	(m_block->currentDiagOption() == DIAGOPTION_ON? true:false));
+
+    m_rightBox.pack_start(m_rawWriterFrame, Gtk::PACK_SHRINK);
+
 	/* just place left and right columns and we're done */
 
     m_screenBox.pack_start(m_leftBox);
@@ -250,6 +367,9 @@ void DiagTab::disableDiagChanges(void)
     m_framesDroppedEntry.set_sensitive(false);
     m_frameBacklogEntry.set_sensitive(false);
     m_maxFrameBacklogEntry.set_sensitive(false);
+    m_pickupLatencyEntry.set_sensitive(false);
+    m_writeLatencyEntry.set_sensitive(false);
+    m_arrivalJitterEntry.set_sensitive(false);
     m_msg3CountEntry.set_sensitive(false);
     m_gpsCountEntry.set_sensitive(false);
     m_localFrameCountEntry.set_sensitive(false);
@@ -268,6 +388,19 @@ void DiagTab::disableDiagChanges(void)
     m_fpgaBufferDepthEntry.set_sensitive(false);
     m_fpgaMaxBuffersUsedEntry.set_sensitive(false);
     m_fpgaMaxBuffersUsedButton.set_sensitive(false);
+    m_processStageEntry.set_sensitive(false);
+    m_recordStageEntry.set_sensitive(false);
+    m_displayStageEntry.set_sensitive(false);
+    m_darkStageEntry.set_sensitive(false);
+    m_statsStageEntry.set_sensitive(false);
+    m_quicklookStageEntry.set_sensitive(false);
+    m_hashStageEntry.set_sensitive(false);
+    m_rawWriterRateEntry.set_sensitive(false);
+    m_rawWriterLatencyEntry.set_sensitive(false);
+    m_traceStateEntry.set_sensitive(false);
+    m_traceButton.set_sensitive(false);
+    m_traceDumpEntry.set_sensitive(false);
+    m_traceSaveButton.set_sensitive(false);
 }
 
 
@@ -278,6 +411,9 @@ void DiagTab::enableDiagChanges(void)
 	m_framesDroppedEntry.set_sensitive(true);
 	m_frameBacklogEntry.set_sensitive(true);
 	m_maxFrameBacklogEntry.set_sensitive(true);
+	m_pickupLatencyEntry.set_sensitive(true);
+	m_writeLatencyEntry.set_sensitive(true);
+	m_arrivalJitterEntry.set_sensitive(true);
 	m_msg3CountEntry.set_sensitive(true);
 	m_gpsCountEntry.set_sensitive(true);
 	m_localFrameCountEntry.set_sensitive(true);
@@ -296,6 +432,19 @@ void DiagTab::enableDiagChanges(void)
 	m_fpgaBufferDepthEntry.set_sensitive(true);
 	m_fpgaMaxBuffersUsedEntry.set_sensitive(true);
 	m_fpgaMaxBuffersUsedButton.set_sensitive(true);
+	m_processStageEntry.set_sensitive(true);
+	m_recordStageEntry.set_sensitive(true);
+	m_displayStageEntry.set_sensitive(true);
+	m_darkStageEntry.set_sensitive(true);
+	m_statsStageEntry.set_sensitive(true);
+	m_quicklookStageEntry.set_sensitive(true);
+	m_hashStageEntry.set_sensitive(true);
+	m_rawWriterRateEntry.set_sensitive(true);
+	m_rawWriterLatencyEntry.set_sensitive(true);
+	m_traceStateEntry.set_sensitive(true);
+	m_traceButton.set_sensitive(true);
+	m_traceDumpEntry.set_sensitive(true);
+	m_traceSaveButton.set_sensitive(true);
     }
 }
 
@@ -490,7 +639,115 @@ void DiagTab::setFPGAMaxBuffersUsed(int n)
 }
 
 
+void DiagTab::setPipelineStats(int stage, int depth, int maxDepth,
+    double avgMs, double maxMs, u_int dropped)
+{
+    char buf[80];
+    if (m_block->currentDiagOption() == DIAGOPTION_ON) {
+	(void)sprintf(buf, "%d/%d  %.1f/%.1f  %u", depth, maxDepth, avgMs,
+	    maxMs, dropped);
+	switch (stage) {
+	    case PIPELINE_STAGE_PROCESS:
+		m_processStageEntry.set_text(buf);
+		break;
+	    case PIPELINE_STAGE_RECORD:
+		m_recordStageEntry.set_text(buf);
+		break;
+	    case PIPELINE_STAGE_DISPLAY:
+		m_displayStageEntry.set_text(buf);
+		break;
+	    case PIPELINE_STAGE_DARK:
+		m_darkStageEntry.set_text(buf);
+		break;
+	    case PIPELINE_STAGE_STATS:
+		m_statsStageEntry.set_text(buf);
+		break;
+	    case PIPELINE_STAGE_QUICKLOOK:
+		m_quicklookStageEntry.set_text(buf);
+		break;
+	    case PIPELINE_STAGE_HASH:
+		m_hashStageEntry.set_text(buf);
+		break;
+	    default:
+		break;
+	}
+    }
+}
+
+
+void DiagTab::setRawWriterStats(double mbPerSec, double p50Ms, double p99Ms,
+    double maxMs)
+{
+    char buf[80];
+    if (m_block->currentDiagOption() == DIAGOPTION_ON) {
+	(void)sprintf(buf, "%.1f", mbPerSec);
+	m_rawWriterRateEntry.set_text(buf);
+	(void)sprintf(buf, "%.1f/%.1f/%.1f", p50Ms, p99Ms, maxMs);
+	m_rawWriterLatencyEntry.set_text(buf);
+    }
+}
+
+
+void DiagTab::setFrameLatencyStats(int which, const LatencySummary *now,
+    const LatencySummary *minute)
+{
+    char buf[80];
+    if (m_block->currentDiagOption() == DIAGOPTION_ON) {
+	(void)sprintf(buf, "%.2f/%.2f/%.2f  %.2f/%.2f/%.2f", now->p50Ms,
+	    now->p99Ms, now->maxMs, minute->p50Ms, minute->p99Ms,
+	    minute->maxMs);
+	switch (which) {
+	    case FRAME_LATENCY_PICKUP:
+		m_pickupLatencyEntry.set_text(buf);
+		break;
+	    case FRAME_LATENCY_WRITE:
+		m_writeLatencyEntry.set_text(buf);
+		break;
+	    case FRAME_LATENCY_JITTER:
+		m_arrivalJitterEntry.set_text(buf);
+		break;
+	    default:
+		break;
+	}
+    }
+}
+
+
 void DiagTab::onFPGAMaxBuffersUsedButton()
 {
     appFrame::fb->clearFPGAMaxBuffersUsed();
 }
+
+
+void DiagTab::onTraceButton()
+{
+    traceEnable(!traceEnabled);
+    m_traceStateEntry.set_text(traceEnabled? "On":"Off");
+    m_traceButton.set_label(traceEnabled? "Stop":"Start");
+}
+
+
+void DiagTab::onTraceSaveButton()
+{
+    char path[MAXPATHLEN], errorMsg[MAXPATHLEN+100], buf[MAXPATHLEN+40];
+    char timestring[20];
+    struct tm tm_struct;
+    time_t now;
+    int n;
+
+	/* named like the other products of the day, but by the time of
+	   the dump.  tracing can stay on while we write */
+
+    now = time(NULL);
+    (void)gmtime_r(&now, &tm_struct);
+    (void)strftime(timestring, sizeof(timestring), "%Y%m%dt%H%M%S",
+	&tm_struct);
+    (void)sprintf(path, "%s/%s%s_trace.json", appFrame::dailyDir,
+	m_block->currentPrefix(), timestring);
+    if ((n=traceDump(path, errorMsg)) == -1)
+	m_traceDumpEntry.set_text(errorMsg);
+    else {
+	(void)sprintf(buf, "%d spans, %s", n, strrchr(path, '/') + 1);
+	m_traceDumpEntry.set_text(buf);
+    }
+}
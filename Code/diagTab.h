@@ -40,6 +40,12 @@ protected:
     Gtk::Entry m_frameBacklogEntry;
     Gtk::Entry m_maxFrameBacklogEntry;
 
+    Gtk::Frame m_latencyFrame;
+    Gtk::Table m_latencyTable;
+    Gtk::Entry m_pickupLatencyEntry;
+    Gtk::Entry m_writeLatencyEntry;
+    Gtk::Entry m_arrivalJitterEntry;
+
     Gtk::Frame m_metadataStatsFrame;
     Gtk::Table m_metadataStatsTable;
     Gtk::Entry m_msg3CountEntry;
@@ -75,6 +81,28 @@ protected:
     Gtk::Entry m_fpgaMaxBuffersUsedEntry;
     Gtk::Button m_fpgaMaxBuffersUsedButton;
 
+    Gtk::Frame m_pipelineFrame;
+    Gtk::Table m_pipelineTable;
+    Gtk::Entry m_processStageEntry;
+    Gtk::Entry m_recordStageEntry;
+    Gtk::Entry m_displayStageEntry;
+    Gtk::Entry m_darkStageEntry;
+    Gtk::Entry m_statsStageEntry;
+    Gtk::Entry m_quicklookStageEntry;
+    Gtk::Entry m_hashStageEntry;
+
+    Gtk::Frame m_rawWriterFrame;
+    Gtk::Table m_rawWriterTable;
+    Gtk::Entry m_rawWriterRateEntry;
+    Gtk::Entry m_rawWriterLatencyEntry;
+
+    Gtk::Frame m_traceFrame;
+    Gtk::Table m_traceTable;
+    Gtk::Entry m_traceStateEntry;
+    Gtk::Button m_traceButton;
+    Gtk::Entry m_traceDumpEntry;
+    Gtk::Button m_traceSaveButton;
+
 	/* support routines */
 
     void addDisplay(Gtk::Table &table, u_int row, const char *descr,
@@ -83,6 +111,8 @@ protected:
 	Gtk::Entry &entry, const char *initialValue, bool enabled) const;
     void onFPGASerialErrorsButton(void);
     void onFPGAMaxBuffersUsedButton(void);
+    void onTraceButton(void);
+    void onTraceSaveButton(void);
 public:
     DiagTab(SettingsBlock *sb, appFrame *app);
 
@@ -107,6 +137,13 @@ public:
     void setFPGABufferDepth(int n);
     void setFPGAMaxBuffersUsed(int n);
 
+    void setPipelineStats(int stage, int depth, int maxDepth, double avgMs,
+	double maxMs, u_int dropped);
+    void setRawWriterStats(double mbPerSec, double p50Ms, double p99Ms,
+	double maxMs);
+    void setFrameLatencyStats(int which, const LatencySummary *now,
+	const LatencySummary *minute);
+
     void disableDiagChanges(void);
     void enableDiagChanges(void);
 
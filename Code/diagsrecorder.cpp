@@ -0,0 +1,420 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "diagsrecorder.h"
+
+extern const char *const diagsrecorderDate = "$Date: 2016/01/06 15:48:12 $";
+
+const char *const diagsColorNames[DIAGS_NUM_COLORS] = {
+    "UNKNOWN", "RED", "GREEN", "GRAY", "YELLOW", "unused"
+};
+
+    /* column names, as they were in the CSV log */
+
+static const char *const lightNames[DIAGS_NUM_LIGHTS] = {
+    "Imager light", "GPS Comm light", "FPIE PPS light", "Msg 3 light",
+    "CPU light", "Temp light", "Air Nav light", "GPS Valid light",
+    "FPGA PPS light", "Mount light", "FMS light"
+};
+static const char *const countNames[DIAGS_NUM_COUNTS] = {
+    "Alpha Data frame count", "Alpha Data frames dropped",
+    "Max Alpha Data frame backlog", "Msg3 count", "GPS count"
+};
+static const char *const fpgaRegNames[DIAGS_NUM_FPGA_REGS] = {
+    "FPGA frame count", "FPGA PPS count", "FPGA 81ff count",
+    "FPGA frames dropped", "FPGA serial errors",
+    "FPGA serial port control word", "Local frame count",
+    "FPGA buffer depth", "FPGA max buffers used"
+};
+static const char *const navNames[DIAGS_NUM_NAV] = {
+    "Latitude", "Longitude", "Altitude", "Heading", "Velocity north",
+    "Velocity east", "Velocity up", "Velocity magnitude"
+};
+static const char *const latencyNames[DIAGS_NUM_LATENCIES] = {
+    "Pickup latency", "Write latency", "Arrival jitter"
+};
+static const char *const latencyStatNames[DIAGS_LATENCY_STATS] = {
+    "p50 ms", "p99 ms", "max ms", "1 min p50 ms", "1 min p99 ms",
+    "1 min max ms"
+};
+
+
+int diagsTypeSize(int type)
+{
+    switch (type) {
+	case DIAGS_TYPE_TIME:
+	case DIAGS_TYPE_DOUBLE:
+	    return sizeof(double);
+	case DIAGS_TYPE_COLOR:
+	    return sizeof(u_char);
+	case DIAGS_TYPE_INT:
+	    return sizeof(int);
+	case DIAGS_TYPE_FLOAT:
+	    return sizeof(float);
+	default:
+	    return 0;
+    }
+}
+
+
+static double monotonicNow(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+
+static int writeAll(int fd, const void *buf, size_t n)
+{
+    const u_char *p = (const u_char *)buf;
+    ssize_t written;
+
+    while (n > 0) {
+	if ((written=write(fd, p, n)) == -1) {
+	    if (errno == EINTR)
+		continue;
+	    return -1;
+	}
+	p += written;
+	n -= written;
+    }
+    return 0;
+}
+
+
+DiagsRecorder::DiagsRecorder()
+{
+    pthread_condattr_t attr;
+
+    m_fd = -1;
+    m_numColumns = 0;
+    m_haveColumns = false;
+    m_headerWritten = false;
+    (void)pthread_mutex_init(&m_lock, NULL);
+    (void)pthread_condattr_init(&attr);
+    (void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    (void)pthread_cond_init(&m_wake, &attr);
+    (void)pthread_condattr_destroy(&attr);
+    (void)pthread_cond_init(&m_flushed, NULL);
+    m_queueHead = 0;
+    m_queueCount = 0;
+    m_flushRequests = 0;
+    m_flushesDone = 0;
+    m_stopping = false;
+    m_dropped = 0;
+    m_writeErrors = 0;
+    m_blockRecords = 0;
+    m_blockStart = 0.0;
+    m_columnBuf = new u_char[DIAGS_BLOCK_RECORDS * sizeof(double)];
+    m_started = false;
+}
+
+
+DiagsRecorder::~DiagsRecorder()
+{
+    (void)close();
+    delete[] m_columnBuf;
+    (void)pthread_cond_destroy(&m_flushed);
+    (void)pthread_cond_destroy(&m_wake);
+    (void)pthread_mutex_destroy(&m_lock);
+}
+
+
+int DiagsRecorder::open(const char *path)
+{
+    int saveErrno;
+
+    if (m_fd != -1) {
+	errno = EBUSY;
+	return -1;
+    }
+    if ((m_fd=::open(path, O_WRONLY|O_CREAT|O_TRUNC, 0644)) == -1)
+	return -1;
+    m_numColumns = 0;
+    m_haveColumns = false;
+    m_headerWritten = false;
+    m_queueHead = 0;
+    m_queueCount = 0;
+    m_flushRequests = 0;
+    m_flushesDone = 0;
+    m_stopping = false;
+    m_dropped = 0;
+    m_writeErrors = 0;
+    m_blockRecords = 0;
+    if (pthread_create(&m_thread, NULL, writerMain, this) != 0) {
+	saveErrno = errno;
+	(void)::close(m_fd);
+	m_fd = -1;
+	errno = saveErrno;
+	return -1;
+    }
+    m_started = true;
+    return 0;
+}
+
+
+void DiagsRecorder::addColumn(const char *name, int type, int decimals,
+    size_t offset)
+{
+    diags_column_t *c;
+
+    c = &m_columns[m_numColumns++];
+    (void)memset(c, 0, sizeof(diags_column_t));
+    (void)snprintf(c->name, DIAGS_NAME_LEN, "%s", name);
+    c->type = type;
+    c->decimals = decimals;
+    c->offset = offset;
+}
+
+
+void DiagsRecorder::setSensorNames(int numSensors, char **sensorNames)
+{
+    char name[DIAGS_NAME_LEN];
+    int i, j;
+
+	/* the columns are settled by the first record; the temperature
+	   sensors are the only ones that vary from card to card */
+
+    if (m_haveColumns)
+	return;
+    if (numSensors > DIAGS_MAX_TEMPS)
+	numSensors = DIAGS_MAX_TEMPS;
+    m_numColumns = 0;
+    addColumn("Time", DIAGS_TYPE_TIME, 0, offsetof(diag_record_t, time));
+    for (i=0;i < DIAGS_NUM_LIGHTS;i++)
+	addColumn(lightNames[i], DIAGS_TYPE_COLOR, 0,
+	    offsetof(diag_record_t, lights) + i * sizeof(u_char));
+    for (i=0;i < DIAGS_NUM_COUNTS;i++)
+	addColumn(countNames[i], DIAGS_TYPE_INT, 0,
+	    offsetof(diag_record_t, counts) + i * sizeof(int));
+    for (i=0;i < numSensors;i++)
+	addColumn(sensorNames[i], DIAGS_TYPE_FLOAT, 1,
+	    offsetof(diag_record_t, temps) + i * sizeof(float));
+    for (i=0;i < DIAGS_NUM_FPGA_REGS;i++)
+	addColumn(fpgaRegNames[i], DIAGS_TYPE_INT, 0,
+	    offsetof(diag_record_t, fpgaRegs) + i * sizeof(int));
+    for (i=0;i < DIAGS_NUM_NAV;i++)
+	addColumn(navNames[i], DIAGS_TYPE_DOUBLE, 6,
+	    offsetof(diag_record_t, nav) + i * sizeof(double));
+    for (i=0;i < DIAGS_NUM_LATENCIES;i++)
+	for (j=0;j < DIAGS_LATENCY_STATS;j++) {
+	    (void)snprintf(name, DIAGS_NAME_LEN, "%s %s", latencyNames[i],
+		latencyStatNames[j]);
+	    addColumn(name, DIAGS_TYPE_FLOAT, 3,
+		offsetof(diag_record_t, latencies) +
+		    (i * DIAGS_LATENCY_STATS + j) * sizeof(float));
+	}
+    m_haveColumns = true;
+}
+
+
+void DiagsRecorder::add(const diag_record_t *record)
+{
+    if (m_fd == -1)
+	return;
+    if (!m_haveColumns)
+	setSensorNames(0, NULL);
+
+	/* never wait on the writer.  the queue holds several seconds of
+	   samples at the fastest rate, so if it's full the disk is in
+	   trouble anyway */
+
+    (void)pthread_mutex_lock(&m_lock);
+    if (m_queueCount == DIAGS_QUEUE_RECORDS)
+	m_dropped++;
+    else {
+	m_queue[(m_queueHead + m_queueCount) % DIAGS_QUEUE_RECORDS] =
+	    *record;
+	m_queueCount++;
+	(void)pthread_cond_signal(&m_wake);
+    }
+    (void)pthread_mutex_unlock(&m_lock);
+}
+
+
+void DiagsRecorder::flush(void)
+{
+    int request;
+
+	/* get everything added so far into the file, for when we might be
+	   powered off */
+
+    if (m_fd == -1)
+	return;
+    (void)pthread_mutex_lock(&m_lock);
+    request = ++m_flushRequests;
+    (void)pthread_cond_signal(&m_wake);
+    while (m_flushesDone < request)
+	(void)pthread_cond_wait(&m_flushed, &m_lock);
+    (void)pthread_mutex_unlock(&m_lock);
+}
+
+
+int DiagsRecorder::close(void)
+{
+    int result;
+
+    if (m_fd == -1)
+	return 0;
+
+	/* the writer empties the queue before it goes */
+
+    (void)pthread_mutex_lock(&m_lock);
+    m_stopping = true;
+    (void)pthread_cond_signal(&m_wake);
+    (void)pthread_mutex_unlock(&m_lock);
+    if (m_started)
+	(void)pthread_join(m_thread, NULL);
+    m_started = false;
+    if (!m_headerWritten && m_haveColumns && writeHeader() == -1)
+	m_writeErrors++;
+    result = (m_writeErrors > 0)? -1:0;
+    if (::close(m_fd) == -1)
+	result = -1;
+    m_fd = -1;
+    return result;
+}
+
+
+int DiagsRecorder::writeHeader(void)
+{
+    diags_header_t header;
+
+    (void)memset(&header, 0, sizeof(header));
+    (void)memcpy(header.magic, DIAGS_MAGIC, sizeof(header.magic));
+    header.version = DIAGS_VERSION;
+    header.numColumns = m_numColumns;
+    if (writeAll(m_fd, &header, sizeof(header)) == -1 ||
+	    writeAll(m_fd, m_columns,
+		m_numColumns * sizeof(diags_column_t)) == -1)
+	return -1;
+    m_headerWritten = true;
+    return 0;
+}
+
+
+int DiagsRecorder::writeBlock(void)
+{
+    diags_block_t block;
+    const diags_column_t *c;
+    int i, j, size;
+
+    if (m_blockRecords == 0)
+	return 0;
+    if (!m_headerWritten && writeHeader() == -1)
+	return -1;
+
+	/* turn the block's rows into columns */
+
+    block.magic = DIAGS_BLOCK_MAGIC;
+    block.records = m_blockRecords;
+    if (writeAll(m_fd, &block, sizeof(block)) == -1)
+	return -1;
+    for (i=0;i < m_numColumns;i++) {
+	c = &m_columns[i];
+	size = diagsTypeSize(c->type);
+	for (j=0;j < m_blockRecords;j++)
+	    (void)memcpy(m_columnBuf + j * size,
+		(const u_char *)&m_block[j] + c->offset, size);
+	if (writeAll(m_fd, m_columnBuf, m_blockRecords * size) == -1)
+	    return -1;
+    }
+    m_blockRecords = 0;
+    return 0;
+}
+
+
+void *DiagsRecorder::writerMain(void *arg)
+{
+    DiagsRecorder *me = (DiagsRecorder *)arg;
+    struct timespec deadline;
+    double due;
+    int flushRequests;
+    bool stopping;
+
+    (void)pthread_mutex_lock(&me->m_lock);
+    for (;;) {
+
+	    /* sleep until there's something to do, or the partial block
+	       has waited long enough */
+
+	while (me->m_queueCount == 0 && !me->m_stopping &&
+		me->m_flushRequests == me->m_flushesDone) {
+	    if (me->m_blockRecords == 0)
+		(void)pthread_cond_wait(&me->m_wake, &me->m_lock);
+	    else {
+		due = me->m_blockStart + DIAGS_FLUSH_SECS;
+		if (monotonicNow() >= due)
+		    break;
+		deadline.tv_sec = (time_t)due;
+		deadline.tv_nsec = (long)((due - deadline.tv_sec) * 1.0e9);
+		(void)pthread_cond_timedwait(&me->m_wake, &me->m_lock,
+		    &deadline);
+	    }
+	}
+
+	    /* take what's queued.  a full block goes out right away */
+
+	while (me->m_queueCount > 0 &&
+		me->m_blockRecords < DIAGS_BLOCK_RECORDS) {
+	    if (me->m_blockRecords == 0)
+		me->m_blockStart = monotonicNow();
+	    me->m_block[me->m_blockRecords++] =
+		me->m_queue[me->m_queueHead];
+	    me->m_queueHead = (me->m_queueHead + 1) % DIAGS_QUEUE_RECORDS;
+	    me->m_queueCount--;
+	}
+	flushRequests = me->m_flushRequests;
+	stopping = me->m_stopping && me->m_queueCount == 0;
+	if (me->m_blockRecords == DIAGS_BLOCK_RECORDS ||
+		(me->m_blockRecords > 0 &&
+		    (flushRequests != me->m_flushesDone || stopping ||
+		    monotonicNow() >= me->m_blockStart + DIAGS_FLUSH_SECS))) {
+	    (void)pthread_mutex_unlock(&me->m_lock);
+	    if (me->writeBlock() == -1) {
+		me->m_blockRecords = 0;
+		(void)pthread_mutex_lock(&me->m_lock);
+		me->m_writeErrors++;
+	    }
+	    else (void)pthread_mutex_lock(&me->m_lock);
+	}
+
+	    /* a flush is done once everything before it is written */
+
+	if (me->m_queueCount == 0 && me->m_blockRecords == 0 &&
+		me->m_flushesDone != flushRequests) {
+	    me->m_flushesDone = flushRequests;
+	    (void)pthread_cond_broadcast(&me->m_flushed);
+	}
+	if (stopping && me->m_blockRecords == 0)
+	    break;
+    }
+    (void)pthread_mutex_unlock(&me->m_lock);
+    return NULL;
+}
@@ -0,0 +1,153 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <pthread.h>
+#include <sys/types.h>
+
+    /* end-to-end diagnostics log.  the data thread fills in a
+       diag_record_t at each sample and hands it to add(), which only
+       copies it into a queue; a writer thread does all the file work.
+
+       the file is columnar.  a header lists the columns, then come blocks
+       of up to DIAGS_BLOCK_RECORDS records, each block holding one column
+       after another (every time in the block, then every imager light,
+       ...), so pulling a few columns out of a long flight means reading
+       only those.  a block goes out when it fills or DIAGS_FLUSH_SECS
+       after its first record, whichever comes first, so a crash costs at
+       most that much.  numbers are in host order (little-endian on
+       every machine we fly).  tools/diagsconv turns a file into CSV.
+
+	   header:	diags_header_t, then numColumns diags_column_t
+	   block:	diags_block_t, then for each column in order,
+			records values of that column's type
+
+       the record layout is fixed; the header is what a reader goes by,
+       so columns can be added later without breaking old readers */
+
+#define DIAGS_MAGIC		"NGDCSDG1"
+#define DIAGS_VERSION		1
+#define DIAGS_BLOCK_MAGIC	0x4b4c4244	/* "DBLK" */
+#define DIAGS_BLOCK_RECORDS	256
+#define DIAGS_FLUSH_SECS	10.0
+#define DIAGS_QUEUE_RECORDS	64
+#define DIAGS_NAME_LEN		40
+
+    /* column types.  a color is a StatusDisplay::color_t, named by
+       diagsColorNames */
+
+#define DIAGS_TYPE_TIME		0	/* double, secs since 1970 */
+#define DIAGS_TYPE_COLOR	1	/* u_char */
+#define DIAGS_TYPE_INT		2	/* int */
+#define DIAGS_TYPE_FLOAT	3	/* float */
+#define DIAGS_TYPE_DOUBLE	4	/* double */
+#define DIAGS_NUM_TYPES		5
+#define DIAGS_NUM_COLORS	6
+
+    /* what's in a record.  lights, counts, FPGA registers, and nav are in
+       the order of the column names in diagsrecorder.cpp; latencies are
+       in FRAME_LATENCY_* order (see displayTab.h), each with p50, p99,
+       and max for the last interval and then for the last minute */
+
+#define DIAGS_NUM_LIGHTS	11
+#define DIAGS_NUM_COUNTS	5
+#define DIAGS_MAX_TEMPS		8
+#define DIAGS_NUM_FPGA_REGS	9
+#define DIAGS_NUM_NAV		8
+#define DIAGS_NUM_LATENCIES	3
+#define DIAGS_LATENCY_STATS	6
+
+typedef struct {
+    double time;
+    u_char lights[DIAGS_NUM_LIGHTS];
+    int counts[DIAGS_NUM_COUNTS];
+    float temps[DIAGS_MAX_TEMPS];		/* C */
+    int fpgaRegs[DIAGS_NUM_FPGA_REGS];
+    double nav[DIAGS_NUM_NAV];
+    float latencies[DIAGS_NUM_LATENCIES][DIAGS_LATENCY_STATS];	/* ms */
+} diag_record_t;
+
+typedef struct {
+    char magic[8];
+    u_int version;
+    u_int numColumns;
+} diags_header_t;
+
+typedef struct {
+    char name[DIAGS_NAME_LEN];
+    u_char type;
+    u_char decimals;		/* for CSV */
+    u_short offset;		/* in diag_record_t; not used by readers */
+} diags_column_t;
+
+typedef struct {
+    u_int magic;
+    u_int records;
+} diags_block_t;
+
+extern const char *const diagsColorNames[DIAGS_NUM_COLORS];
+extern int diagsTypeSize(int type);
+
+class DiagsRecorder
+{
+protected:
+    int m_fd;
+    diags_column_t m_columns[1+DIAGS_NUM_LIGHTS+DIAGS_NUM_COUNTS+
+	DIAGS_MAX_TEMPS+DIAGS_NUM_FPGA_REGS+DIAGS_NUM_NAV+
+	DIAGS_NUM_LATENCIES*DIAGS_LATENCY_STATS];
+    int m_numColumns;
+    bool m_haveColumns;
+    bool m_headerWritten;
+
+	/* shared with the writer thread, under m_lock */
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_wake;
+    pthread_cond_t m_flushed;
+    diag_record_t m_queue[DIAGS_QUEUE_RECORDS];
+    int m_queueHead;
+    int m_queueCount;
+    int m_flushRequests;
+    int m_flushesDone;
+    bool m_stopping;
+    u_int m_dropped;
+    u_int m_writeErrors;
+
+	/* the writer thread's own */
+
+    diag_record_t m_block[DIAGS_BLOCK_RECORDS];
+    int m_blockRecords;
+    double m_blockStart;
+    u_char *m_columnBuf;
+    pthread_t m_thread;
+    bool m_started;
+
+    void addColumn(const char *name, int type, int decimals, size_t offset);
+    int writeHeader(void);
+    int writeBlock(void);
+    static void *writerMain(void *arg);
+public:
+    DiagsRecorder();
+    ~DiagsRecorder();
+    int open(const char *path);
+    void setSensorNames(int numSensors, char **sensorNames);
+    void add(const diag_record_t *record);
+    void flush(void);
+    int close(void);
+    bool isOpen(void) const { return m_fd != -1; }
+    u_int dropped(void) const { return m_dropped; }
+};
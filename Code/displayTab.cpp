@@ -16,12 +16,14 @@
 
 
 #include <unistd.h>
+#include <errno.h>
 #include <sys/param.h>
 #include <sys/mount.h>
 #include <sys/time.h>
 #if !defined(__APPLE__)
 #include <sys/vfs.h>
 #endif
+#include <stdlib.h>
 #include <math.h>
 #include <gtkmm.h>
 #include <aiousb.h>
@@ -29,6 +31,21 @@
 #include <libusb-1.0/libusb.h>
 #include "main.h"
 #include "framebuf.h"
+#include "pipeline.h"
+#include "frameops.h"
+#include "darkmodel.h"
+#include "bandstats.h"
+#include "stretchlut.h"
+#include "quicklookwriter.h"
+#include "rawwriter.h"
+#include "stripeindex.h"
+#include "stripewriter.h"
+#include "cmpwriter.h"
+#include "manifest.h"
+#include "framehasher.h"
+#include "tracer.h"
+#include "latencyhist.h"
+#include "diagsrecorder.h"
 #include "plotting.h"
 #include "appFrame.h"
 #include "displayTab.h"
@@ -86,6 +103,7 @@ DisplayTab::DisplayTab(SettingsBlock *sb, appFrame *app) :
     char msg[MAX_ERROR_LEN + 2 * MAXPATHLEN];
     struct timeval timebuffer;
     struct tm *tm_struct;
+    const char *descr;
 
         /* save pointer to the settings block */
 
@@ -177,7 +195,14 @@ DisplayTab::DisplayTab(SettingsBlock *sb, appFrame *app) :
 
     m_recordState = RECORD_STATE_NOT_RECORDING;
     m_wait = 0;
-    m_imageFP = m_imageHdrFP = m_gpsFP = m_ppsFP = NULL;
+    m_imageWriter = new StripedImageWriter;
+    m_cmpWriter = new CompressedImageWriter;
+    m_swCompression = SWCOMPRESSION_OFF;
+    m_manifest = MANIFESTOPTION_OFF;
+    m_rawWriterStats = new RawWriterStats;
+    (void)memset(m_rawWriterStats, 0, sizeof(RawWriterStats));
+    m_imageHdrFP = m_gpsFP = m_ppsFP = NULL;
+    m_hdrCheckpointFrames = 1;
     m_framesWritten = 0;
     m_stopRequested = 0;
     m_stopIsAbort = 0;
@@ -191,6 +216,13 @@ DisplayTab::DisplayTab(SettingsBlock *sb, appFrame *app) :
     (void)memset(m_gpsInitCommand, 0, sizeof(m_gpsInitCommand));
     m_gpsInitBytesSent = ~0;
 
+	/* init nav-message decoding */
+
+    m_navDecoder = new NavDecoder;
+    (void)m_navDecoder->subscribe(3500, navStatusHandler, this);
+    (void)m_navDecoder->subscribe(3501, navSolutionHandler, this);
+    m_gps3501Skip = 0;
+
 	/* init diagnostics */
 
     m_frameCount = 0;
@@ -239,43 +271,83 @@ DisplayTab::DisplayTab(SettingsBlock *sb, appFrame *app) :
 
 	/* init image buffer */
 
-    m_imageBuffer =
-	new unsigned short[m_frameWidthSamples * m_frameHeightLines];
-    (void)memset(m_imageBuffer, 0,
-	m_frameWidthSamples * m_frameHeightLines * sizeof(short));
+    m_framePool = new FramePool(appFrame::fb, PIPELINE_POOL_FRAMES,
+	m_frameWidthSamples * m_frameHeightLines);
+    m_processStage = NULL;
+    m_recordStage = NULL;
+    m_displayStage = NULL;
+    m_darkStage = NULL;
+    m_statsStage = NULL;
+    m_quicklookStage = NULL;
+    m_hasher = NULL;
+    m_stageStats = new PipelineStats[NUM_PIPELINE_STAGES];
+    (void)memset(m_stageStats, 0, NUM_PIPELINE_STAGES * sizeof(PipelineStats));
+    for (i=0;i < NUM_FRAME_LATENCIES;i++)
+	m_latencyHists[i] = new LatencyHistogram;
+    m_latencyNow = new LatencySummary[NUM_FRAME_LATENCIES];
+    (void)memset(m_latencyNow, 0,
+	NUM_FRAME_LATENCIES * sizeof(LatencySummary));
+    m_latencyMinute = new LatencySummary[NUM_FRAME_LATENCIES];
+    (void)memset(m_latencyMinute, 0,
+	NUM_FRAME_LATENCIES * sizeof(LatencySummary));
+    m_lastArrivalTime = 0.0;
+    m_indicatorsDirty = 0;
+    m_navDisplayDirty = 0;
+    m_darkResetPending = 0;
+
+	/* pick the fastest way to assemble frames on this CPU.  this only
+	   matters when we can't use frames where they sit */
+
+    m_assembleFrame = frameAssembler(-1, m_frameHeightLines,
+	m_frameWidthSamples, &descr);
+    (void)sprintf(msg, "Frame assembly is %s.", descr);
+    log(msg);
 
     m_incr = 1;
 
-    m_framePixels = new unsigned char[m_frameWidthSamples *
-	(m_frameHeightLines-1) * 3];
-    (void)memset(m_framePixels, 0,
-	m_frameWidthSamples * (m_frameHeightLines-1) * 3);
-
     m_waterfallPixels = new unsigned char[m_frameWidthSamples * 3];
     (void)memset(m_waterfallPixels, 0, m_frameWidthSamples * 3);
 
 	/* init image correction */
 
-    m_framesUntilDark = -1;
-    m_darkFramesAccumulated = 0;
+    m_darkFramesWanted = 0;
+    m_darkWantedDuringCal = 0;
+    m_darkRequestTime = 0.0;
+    m_darkSettledTime = 0.0;
+    m_darkFramesLeft = 0;
+    m_darkDuringCal = 0;
+    m_darkModelReset = 0;
+    m_darkModel = new DarkModel(m_frameHeightLines, m_frameWidthSamples);
     m_darkFrame = new u_short[m_frameHeightLines * m_frameWidthSamples];
-    m_darkFrameAccumulation =
-	new u_int[m_frameHeightLines * m_frameWidthSamples];
+    m_darkMask = new u_char[m_frameHeightLines * m_frameWidthSamples];
     m_darkFrameBuffered = 0;
 
     readDarkFrame();
 
-	/* init for stretch -- init all the way to 65536 in case we somehow
-   	   get 16-bit data, so that we don't run off the end of the array.
-           we have one primary stretch LUT, and then two more that take green
-           and blue gain settings into account */
-
-    m_stretchLUT = new unsigned char[65536];
-    (void)memset(m_stretchLUT, 255, 65536);
-    m_stretchLUTGreen = new unsigned char[65536];
-    (void)memset(m_stretchLUTGreen, 255, 65536);
-    m_stretchLUTBlue = new unsigned char[65536];
-    (void)memset(m_stretchLUTBlue, 255, 65536);
+	/* init for stretch -- each waterfall channel and the frame view
+	   has its own LUT, each covering all 65536 values in case we somehow
+	   get 16-bit data, so that we don't run off the end of the array */
+
+    m_stretchRed = new StretchLUT;
+    m_stretchGreen = new StretchLUT;
+    m_stretchBlue = new StretchLUT;
+    m_stretchFrame = new StretchLUT;
+    m_bandStats = new BandStats(m_frameHeightLines, m_frameWidthSamples);
+    m_autoStretchLow = new int[NUM_BANDSTATS_CHANNELS];
+    m_autoStretchHigh = new int[NUM_BANDSTATS_CHANNELS];
+    for (i=0;i < NUM_BANDSTATS_CHANNELS;i++)
+	m_autoStretchLow[i] = m_autoStretchHigh[i] = -1;
+
+	/* init for quicklook */
+
+    m_quicklook = new QuicklookWriter(m_frameWidthSamples);
+    m_quicklookPath[0] = '\0';
+    m_quicklookActive = 0;
+    m_quicklookGeneration = 0;
+    m_quicklookSeen = 0;
+    m_statsFed = 0;
+    m_autoStretchReset = 1;
+    m_stretchRebuild = 0;
     updateStretch();
 
 	/* init end-to-end files, created in a temp directory so that
@@ -324,10 +396,10 @@ DisplayTab::DisplayTab(SettingsBlock *sb, appFrame *app) :
         strcat(m_diagsName, "/");
         strcat(m_diagsName, m_block->currentPrefix());
         strcat(m_diagsName, m_endtoendStartTime);
-        strcat(m_diagsName, "_diags.csv");
+        strcat(m_diagsName, "_diags.bin");
     }
-    m_diagsFP = fopen(m_diagsName, "w");
-    if (!m_diagsFP) {
+    m_diagsRecorder = new DiagsRecorder;
+    if (m_diagsRecorder->open(m_diagsName) == -1) {
 	(void)sprintf(msg,
 	    "Can't open end-to-end diagnostics file \"%s\".", m_diagsName);
 	warn(msg);
@@ -678,14 +750,6 @@ DisplayTab::DisplayTab(SettingsBlock *sb, appFrame *app) :
 	/* set up dispatchers */
 
     if (!appFrame::headless) {
-	m_refreshIndicators.connect(sigc::mem_fun(*this,
-	    &DisplayTab::indicatorUpdateWork));
-	m_refreshFrameDisplay.connect(sigc::mem_fun(*this,
-	    &DisplayTab::frameUpdateWork));
-	m_refreshWaterfallDisplay.connect(sigc::mem_fun(*this,
-	    &DisplayTab::waterfallUpdateWork));
-	m_refreshNavDisplay.connect(sigc::mem_fun(*this,
-	    &DisplayTab::navDisplayUpdateWork));
 	m_refreshRecordControls.connect(sigc::mem_fun(*this,
 	    &DisplayTab::recordControlsUpdateWork));
 	m_refreshDiags.connect(sigc::mem_fun(*this,
@@ -736,6 +800,31 @@ DisplayTab::DisplayTab(SettingsBlock *sb, appFrame *app) :
 	   any display because the windowing event engine hangs temporarily if
 	   the user grabs the window, e.g., to move it */
 
+    m_displayStage = new PipelineStage("Display", m_framePool,
+	PIPELINE_DISPLAY_QUEUE, true, displayStageHandler, this,
+	PIPELINE_WAIT_FOREVER, 0, 10);
+    m_recordStage = new PipelineStage("Record", m_framePool,
+	PIPELINE_RECORD_QUEUE, false, recordStageHandler, this,
+	DATA_WAIT_TIMEOUT_USECS, 10, -10);
+    m_processStage = new PipelineStage("Process", m_framePool,
+	PIPELINE_PROCESS_QUEUE, false, processStageHandler, this,
+	PIPELINE_WAIT_FOREVER, 0, 0);
+    m_darkStage = new PipelineStage("Dark", m_framePool,
+	PIPELINE_DARK_QUEUE, true, darkStageHandler, this,
+	DARK_IDLE_FINISH_USECS, 0, 15);
+    m_statsStage = new PipelineStage("Stats", m_framePool,
+	PIPELINE_STATS_QUEUE, true, statsStageHandler, this,
+	PIPELINE_WAIT_FOREVER, 0, 15);
+    m_quicklookStage = new PipelineStage("Quicklook", m_framePool,
+	PIPELINE_QUICKLOOK_QUEUE, true, quicklookStageHandler, this,
+	QUICKLOOK_IDLE_USECS, 0, 19);
+    m_hasher = new FrameHasher(m_framePool);
+    if (m_displayStage->start() == -1 || m_recordStage->start() == -1 ||
+	    m_processStage->start() == -1 || m_darkStage->start() == -1 ||
+	    m_statsStage->start() == -1 || m_quicklookStage->start() == -1 ||
+	    m_hasher->start() == -1)
+	error("Linux error: Can't create capture-pipeline threads.");
+
     m_dataThreadEnabled = 1;
     m_dataThreadMutex.lock();
     m_dataThread = Glib::Thread::create(sigc::mem_fun(*this,
@@ -752,6 +841,14 @@ DisplayTab::DisplayTab(SettingsBlock *sb, appFrame *app) :
     m_resourcesCheckTimer = Glib::signal_timeout().connect(sigc::mem_fun(*this,
 	&DisplayTab::performResourcesCheck), 60000);
 
+	/* show new frames and waterfall lines at a steady rate rather than
+	   waking the GUI for every one */
+
+    if (!appFrame::headless)
+	m_displayRefreshTimer = Glib::signal_timeout().connect(
+	    sigc::mem_fun(*this, &DisplayTab::displayRefreshWork),
+	    DISPLAY_REFRESH_MSECS);
+
 	/* handle the mount as we're able, making sure to start it in idle
            mode */
 
@@ -795,9 +892,10 @@ void DisplayTab::onLogEntryChange(void)
 
 DisplayTab::~DisplayTab()
 {
+    int i;
+
 	/* files are already known to be closed */
 
-    m_imageFP = NULL;
     m_imageHdrFP = NULL;
     m_gpsFP = NULL;
     m_ppsFP = NULL;
@@ -805,14 +903,35 @@ DisplayTab::~DisplayTab()
 	/* timers are stopped in the exit routine, so we should be able to
 	   safely free up storage */
 
-    delete[] m_imageBuffer;
+    delete m_processStage;
+    delete m_recordStage;
+    delete m_displayStage;
+    delete m_darkStage;
+    delete m_statsStage;
+    delete m_quicklookStage;
+    delete m_hasher;
+    delete m_framePool;
+    delete[] m_stageStats;
+    for (i=0;i < NUM_FRAME_LATENCIES;i++)
+	delete m_latencyHists[i];
+    delete[] m_latencyNow;
+    delete[] m_latencyMinute;
+    delete m_imageWriter;
+    delete m_cmpWriter;
+    delete m_rawWriterStats;
+    delete m_darkModel;
     delete[] m_darkFrame;
-    delete[] m_darkFrameAccumulation;
-    delete[] m_framePixels;
+    delete[] m_darkMask;
     delete[] m_waterfallPixels;
-    delete[] m_stretchLUT;
-    delete[] m_stretchLUTGreen;
-    delete[] m_stretchLUTBlue;
+    delete m_stretchRed;
+    delete m_stretchGreen;
+    delete m_stretchBlue;
+    delete m_stretchFrame;
+    delete m_bandStats;
+    delete m_quicklook;
+    delete m_navDecoder;
+    delete[] m_autoStretchLow;
+    delete[] m_autoStretchHigh;
 
 	/* end-to-end stuff is cleaned up through the exit routine */
 
@@ -823,7 +942,7 @@ DisplayTab::~DisplayTab()
     m_allppsName = NULL;
     m_allppsFP = NULL;
     m_diagsName = NULL;
-    m_diagsFP = NULL;
+    m_diagsRecorder = NULL;
     m_logName = NULL;
     m_logFP = NULL;
 
@@ -1030,16 +1149,50 @@ SliderDialog::SliderDialog(DisplayTab *parent) :
 void DisplayTab::readDarkFrame(void)
 {
     char filename[MAXPATHLEN], msg[MAXPATHLEN+100];
+    char timestring[40];
     FILE *fp;
     int pixelsRead;
+    time_t timestamp;
+    struct tm tm_struct;
+
+    Glib::Mutex::Lock lock(m_darkMutex);
 
 	/* zero out dark frame -- this isn't strictly necessary but might 
            help make bugs clearer */
 
     (void)memset(m_darkFrame, 0, m_frameHeightLines * m_frameWidthSamples *
 	sizeof(short));
+    (void)memset(m_darkMask, 0, m_frameHeightLines * m_frameWidthSamples);
 
-	/* construct filename from path and frame size */
+	/* use the dark model if we have one */
+
+    sprintf(filename, "%s/ngdcs-darkmodel.%dhx%dw",
+	m_block->currentDarkSubDir(), m_frameHeightLines,
+	m_frameWidthSamples);
+    if (access(filename, F_OK) == 0) {
+	if (m_darkModel->read(filename, msg) == -1)
+	    warn(msg);
+	else {
+	    (void)memcpy(m_darkFrame, m_darkModel->clippedMean(),
+		m_frameHeightLines * m_frameWidthSamples * sizeof(short));
+	    (void)memcpy(m_darkMask, m_darkModel->mask(),
+		m_frameHeightLines * m_frameWidthSamples);
+	    m_darkFrameBuffered = 1;
+	    timestamp = m_darkModel->timestamp();
+	    (void)gmtime_r(&timestamp, &tm_struct);
+	    (void)strftime(timestring, sizeof(timestring),
+		"%Y-%m-%d %H:%M:%S UTC", &tm_struct);
+	    sprintf(msg,
+		"Read dark model from %s (%d frames, %d pixels masked).",
+		timestring, m_darkModel->frames(), m_darkModel->numHot() +
+		m_darkModel->numDead() + m_darkModel->numNoisy());
+	    log(msg);
+	    return;
+	}
+    }
+
+	/* otherwise fall back on a plain dark frame.  construct filename
+	   from path and frame size */
 
     sprintf(filename, "%s/ngdcs-dark.%dhx%dw", m_block->currentDarkSubDir(),
 	m_frameHeightLines, m_frameWidthSamples);
@@ -1068,6 +1221,7 @@ void DisplayTab::readDarkFrame(void)
 
 	m_darkFrameBuffered = 1;
     }
+    m_darkModel->setFromDark(m_darkFrame);
 }
 
 
@@ -1077,6 +1231,8 @@ void DisplayTab::writeDarkFrame(void)
     FILE *fp;
     int pixelsWritten;
 
+    Glib::Mutex::Lock lock(m_darkMutex);
+
 	/* if we have a dark frame buffered... */
 
     if (m_darkFrameBuffered) {
@@ -1094,6 +1250,7 @@ void DisplayTab::writeDarkFrame(void)
 	    sprintf(msg, "Dark frame can't be saved to \"%s\".",
 		m_block->currentDarkSubDir());
 	    warn(msg);
+	    return;
 	}
 
 	    /* otherwise write the file out and we're done */
@@ -1107,8 +1264,23 @@ void DisplayTab::writeDarkFrame(void)
 		warn(msg);
 		(void)fclose(fp);
 		(void)unlink(filename);
+		return;
+	    }
+	    (void)fclose(fp);
+	}
+
+	    /* save the model alongside, if we built one.  the plain dark
+	       frame is kept for anything that reads it */
+
+	if (m_darkModel->frames() > 0) {
+	    sprintf(filename, "%s/ngdcs-darkmodel.%dhx%dw",
+		m_block->currentDarkSubDir(), m_frameHeightLines,
+		m_frameWidthSamples);
+	    if (m_darkModel->write(filename) == -1) {
+		sprintf(msg, "Dark model can't be written to \"%s\".",
+		    filename);
+		warn(msg);
 	    }
-	    else (void)fclose(fp);
 	}
     }
 }
@@ -1166,12 +1338,12 @@ void DisplayTab::cleanupForExit()
 
 	/* if we've been logging to a diags file... */
 
-    if (m_diagsFP) {
+    if (m_diagsRecorder && m_diagsRecorder->isOpen()) {
 
-	    /* close the temp file */
+	    /* close the temp file.  this waits for the writer thread to
+	       get the last records out */
 
-	(void)fclose(m_diagsFP);
-	m_diagsFP = NULL;
+	(void)m_diagsRecorder->close();
 
 	    /* determine filename for product */
 
@@ -1179,7 +1351,7 @@ void DisplayTab::cleanupForExit()
 	strcat(newname, "/");
 	strcat(newname, m_block->currentPrefix());
 	strcat(newname, m_endtoendStartTime);
-	strcat(newname, "_diags.csv");
+	strcat(newname, "_diags.bin");
 
 	    /* copy our temp files to the correct names */
 
@@ -1290,13 +1462,18 @@ ImageDisplay::ImageDisplay(int fh, int fw, DisplayTab *dt)
     if (!appFrame::headless) {
 	m_surface = Cairo::ImageSurface::create(Cairo::FORMAT_RGB24,
 	    fw + 2*NON_COMBO_MARGIN, fh-1);
-	m_context = Cairo::Context::create(m_surface);
     }
+    m_renderLevel = frameOpsLevel();
 
 	/* initialize clipping dimensions.  we'll set these to the proper
 	   values as we do the different displays (frame or waterfall). */
 
     m_currentWaterfallHeight = 0;
+    m_waterfallHead = 0;
+
+	/* nothing drawn yet */
+
+    m_frameDirty = m_waterfallDirty = false;
 
 	/* note that we haven't yet seen any data */
 
@@ -1319,15 +1496,64 @@ void ImageDisplay::reset(void)
 	/* cut waterfall area down -- code will increment this with each
 	   line until it reaches the full window height */
 
+    Glib::Mutex::Lock lock(m_surfaceMutex);
     m_currentWaterfallHeight = 0;
+    m_waterfallHead = 0;
 }
 
 
-void ImageDisplay::displayFrame(const u_char *image, int height, int width,
-    int redBand, int greenBand, int blueBand)
+void ImageDisplay::drawFrame(const u_short *image, const u_short *dark,
+    const u_char *mask, const u_char *lut, int darkSub, int incr)
 {
-    Glib::RefPtr<Gdk::Window> win = get_window();
+    frame_renderer_t render;
     int xImageOffset, reflect;
+    u_int64_t t0;
+
+    if (!m_surface)
+	return;
+
+	/* render the frame straight onto the surface, skipping the header
+	   line.  the combo view is the decimated one, to the right of the
+	   waterfall.  this runs on the display stage, so the surface is
+	   locked against the waterfall and the expose handler */
+
+    if (incr == 1)
+	xImageOffset = NON_COMBO_MARGIN;
+    else xImageOffset = m_frameWidthSamples/2 + 2 * NON_COMBO_MARGIN;
+    reflect = (m_displayTab->m_block->currentReflectionOption() ==
+	REFLECTIONOPTION_ON? 1:0);
+    render = frameRenderer(m_renderLevel, darkSub, incr);
+
+    Glib::Mutex::Lock lock(m_surfaceMutex);
+    m_surface->flush();
+    t0 = traceStart();
+    (*render)((u_int *)m_surface->get_data() + xImageOffset,
+	m_surface->get_stride() / sizeof(u_int), reflect,
+	image + m_frameWidthSamples, dark + m_frameWidthSamples,
+	mask + m_frameWidthSamples, lut, m_frameHeightLines-1,
+	m_frameWidthSamples);
+    traceEnd(TRACE_RENDER, t0);
+    m_surface->mark_dirty();
+    m_frameDirty = true;
+}
+
+
+void ImageDisplay::takeUpdates(bool *frame_p, bool *waterfall_p)
+{
+	/* collect what's been drawn since the last refresh */
+
+    Glib::Mutex::Lock lock(m_surfaceMutex);
+    *frame_p = m_frameDirty;
+    *waterfall_p = m_waterfallDirty;
+    m_frameDirty = m_waterfallDirty = false;
+}
+
+
+void ImageDisplay::displayFrame(int height, int width, int redBand,
+    int greenBand, int blueBand)
+{
+    Glib::RefPtr<Gdk::Window> win = get_window();
+    int xImageOffset;
 
 	/* note that we've now seen data */
 
@@ -1345,69 +1571,26 @@ void ImageDisplay::displayFrame(const u_char *image, int height, int width,
     if (!win)
 	return;
 
-	/* create a pixbuf with image contents.  this is a very low-cost
-	   operation, and it needs to be done whenever we change image
-	   size, so I'm just doing it for every frame */
-
-    m_pixbuf = Gdk::Pixbuf::create_from_data(image,
-	Gdk::COLORSPACE_RGB, false, 8, width, height, width*3);
+	/* the frame is already on the surface (see drawFrame), so all
+	   that's left is to force a redraw */
 
-	/* copy the pixbuf onto the surface.  this is the equivalent of
-	   writing it to a server-side Pixbuf.  we could write the
-	   the image directly in the on-expose handler but this doesn't
-	   seem to cost much and might make display smoother or the 
-	   images more coherent.  after the copy, force redraw. */
-
-    reflect = (m_displayTab->m_block->currentReflectionOption() ==
-	REFLECTIONOPTION_ON? 1:0);
-    if (m_displayTab->m_block->currentViewerType() == VIEWERTYPE_FRAME) {
-	if (reflect) { /* from cairographics.org/matrix_transform */
-	    Cairo::Matrix reflection(-1, 0, 0, 1, 2*NON_COMBO_MARGIN+width, 0);
-	    m_context->set_identity_matrix();
-	    m_context->transform(reflection);
-	}
-	else m_context->set_identity_matrix();
-	Gdk::Cairo::set_source_pixbuf(m_context, m_pixbuf,
-	    (double)NON_COMBO_MARGIN, 0.0);
-	m_context->paint();
-	Gdk::Rectangle r(NON_COMBO_MARGIN, 0, width, height);
-	win->invalidate_rect(r, false);
-    }
-    else /* VIEWERTYPE_COMBO */ {
+    if (m_displayTab->m_block->currentViewerType() == VIEWERTYPE_FRAME)
+	xImageOffset = NON_COMBO_MARGIN;
+    else /* VIEWERTYPE_COMBO */
 	xImageOffset = m_frameWidthSamples/2 + 2 * NON_COMBO_MARGIN;
-	if (reflect) { /* from cairographics.org/matrix_transform */
-	    Cairo::Matrix reflection(-1, 0, 0, 1, 2*xImageOffset+width, 0);
-	    m_context->set_identity_matrix();
-	    m_context->transform(reflection);
-	}
-	else m_context->set_identity_matrix();
-	Gdk::Cairo::set_source_pixbuf(m_context, m_pixbuf,
-	    (double)xImageOffset, 0.0);
-	m_context->rectangle((double)xImageOffset, (double)0, (double)width,
-	    (double)height);
-	m_context->fill();
-	Gdk::Rectangle r(xImageOffset, 0, width, height);
-	win->invalidate_rect(r, false);
-    }
+    Gdk::Rectangle r(xImageOffset, 0, width, height);
+    win->invalidate_rect(r, false);
 }
 
 
-void ImageDisplay::displayLine(const u_char *image, u_short width)
+void ImageDisplay::drawLine(const u_char *image, u_short width)
 {
-    Glib::RefPtr<Gdk::Window> win = get_window();
     const u_char *dataPtr;
     u_char *surfacePtr;
-    int i, margin, bytesPerLine, reflect;
+    int i, margin, reflect;
     const u_char rgbSize = 4;
 
-	/* note that we've now seen data */
-
-    m_dataSeen = true;
-
-	/* if we're not fully initialized yet, ignore this.  it's not
-	   necessary */
-
-    if (!win)
+    if (!m_surface)
 	return;
 
 	/* determine whether or not we have a margin on our surface. */
@@ -1421,17 +1604,18 @@ void ImageDisplay::displayLine(const u_char *image, u_short width)
     reflect = (m_displayTab->m_block->currentReflectionOption() ==
 	REFLECTIONOPTION_ON? 1:0);
 
-	/* shift the image down one line.  I couldn't get this to work with
-	   the surface primitives so I'm brute-forcing it using get_data().
-	   according to the cairomm doc, this is acceptable. */
+	/* rather than shift the image down a line, treat the waterfall
+	   rows of the surface as a circular buffer and back the head up a
+	   row.  the expose handler unwraps it (see paintWaterfall).  I
+	   couldn't get this working with the surface primitives so I'm
+	   writing the line using get_data().  according to the cairomm doc,
+	   this is acceptable. */
 
-    bytesPerLine = (m_frameWidthSamples + 2 * NON_COMBO_MARGIN) * rgbSize;
-    for (i=m_frameHeightLines-2;i > 0;i--)
-	memmove(m_surface->get_data() + margin * rgbSize + i * bytesPerLine,
-	    m_surface->get_data() + margin * rgbSize + (i-1) * bytesPerLine,
-	    width * rgbSize);
+    Glib::Mutex::Lock lock(m_surfaceMutex);
+    if (--m_waterfallHead < 0)
+	m_waterfallHead = m_frameHeightLines-2;
 
-	/* add a new top line.  this isn't entirely portable because it
+	/* add the new top line.  this isn't entirely portable because it
 	   assumes a particular RGB ordering within the surface pixels, i.e., 
 	   a little-endian ordering where the blue value is the first byte
 	   in the surface pixel and the last byte is 0.  but seeing as how I
@@ -1442,7 +1626,8 @@ void ImageDisplay::displayLine(const u_char *image, u_short width)
 	   initializing to ensure the results are predictable. */
 
     dataPtr = image + (reflect? (width-1)*3:0);
-    surfacePtr = m_surface->get_data() + margin * rgbSize;
+    surfacePtr = m_surface->get_data() +
+	m_waterfallHead * m_surface->get_stride() + margin * rgbSize;
 
     for (i=0;i < width;i++) {
 	*(surfacePtr+2) = *dataPtr;     /* red   */
@@ -1460,6 +1645,23 @@ void ImageDisplay::displayLine(const u_char *image, u_short width)
 
     if (m_currentWaterfallHeight < m_frameHeightLines-1)
 	m_currentWaterfallHeight++;
+    m_waterfallDirty = true;
+}
+
+
+void ImageDisplay::displayWaterfall(void)
+{
+    Glib::RefPtr<Gdk::Window> win = get_window();
+
+	/* note that we've now seen data */
+
+    m_dataSeen = true;
+
+	/* if we're not fully initialized yet, ignore this.  it's not
+	   necessary */
+
+    if (!win)
+	return;
 
 	/* force redraw */
 
@@ -1469,6 +1671,37 @@ void ImageDisplay::displayLine(const u_char *image, u_short width)
 }
 
 
+void ImageDisplay::paintWaterfall(Cairo::RefPtr<Cairo::Context> cr,
+    double x, double width)
+{
+    int wrap;
+
+	/* the newest line is at the head row and goes at the top of the
+	   window.  rows from the head to the bottom of the surface come
+	   first, then the rows above the head, so it takes two blits */
+
+    wrap = m_frameHeightLines-1 - m_waterfallHead;
+    cr->save();
+    cr->rectangle(x, 0.0, width,
+	(double)((m_currentWaterfallHeight < wrap)?
+	    m_currentWaterfallHeight:wrap));
+    cr->clip();
+    cr->set_source(m_surface, 0.0, (double)-m_waterfallHead);
+    cr->paint();
+    cr->restore();
+
+    if (m_currentWaterfallHeight > wrap) {
+	cr->save();
+	cr->rectangle(x, (double)wrap, width,
+	    (double)(m_currentWaterfallHeight - wrap));
+	cr->clip();
+	cr->set_source(m_surface, 0.0, (double)wrap);
+	cr->paint();
+	cr->restore();
+    }
+}
+
+
 bool ImageDisplay::on_expose_event(GdkEventExpose *e)
 {
     int frameBottom, xImageOffset, y;
@@ -1482,6 +1715,7 @@ bool ImageDisplay::on_expose_event(GdkEventExpose *e)
 	/* otherwise, if we've initialized our window... */
 
     if (win) {
+	Glib::Mutex::Lock lock(m_surfaceMutex);
 
 	    /* associate a Cairo context with our DrawingArea */
 
@@ -1514,25 +1748,14 @@ bool ImageDisplay::on_expose_event(GdkEventExpose *e)
 
 		/* draw waterfall line */
 
-	    cr->save();
-	    cr->rectangle((double)NON_COMBO_MARGIN, 0.0,
-		(double)m_frameWidthSamples, (double)m_currentWaterfallHeight);
-	    cr->clip();
-	    cr->set_source(m_surface, 0.0, 0.0);
-	    cr->paint();
-	    cr->restore();
+	    paintWaterfall(cr, (double)NON_COMBO_MARGIN,
+		(double)m_frameWidthSamples);
 	}
 	else /* VIEWERTYPE_COMBO */ {
 
 		/* draw waterfall line */
 
-	    cr->save();
-	    cr->rectangle(0.0, 0.0, (double)m_frameWidthSamples/2,
-		(double)m_currentWaterfallHeight);
-	    cr->clip();
-	    cr->set_source(m_surface, 0.0, 0.0);
-	    cr->paint();
-	    cr->restore();
+	    paintWaterfall(cr, 0.0, (double)m_frameWidthSamples/2);
 
 		/* draw frame */
 
@@ -1686,38 +1909,31 @@ char *StatusDisplay::color(void)
 
 void DisplayTab::updateStretch(void)
 {
-    int i, dn, min, max;
-    double gain;
-
-    min = m_block->currentStretchMin();
-    max = m_block->currentStretchMax();
-    for (i=0;i < min && i <= MAX_DN;i++)
-	m_stretchLUT[i] = 0;
-    if (min != max)
-	for (;i <= max && i <= MAX_DN;i++) {
-	    dn = 256 * (i-min)/(max-min);
-	    if (dn == 256)
-		dn = 255;
-	    m_stretchLUT[i] = (unsigned char)dn;
-	}
-    for (;i <= MAX_DN;i++)
-	m_stretchLUT[i] = 255;
-
-    gain = m_block->currentGreenGain();
-    for (i=0;i <= MAX_DN;i++) {
-	dn = (int)(m_stretchLUT[i] * gain + 0.5);
-	if (dn > 255)
-	    dn = 255;
-	m_stretchLUTGreen[i] = dn;
-    }
-
-    gain = m_block->currentBlueGain();
-    for (i=0;i <= MAX_DN;i++) {
-	dn = (int)(m_stretchLUT[i] * gain + 0.5);
-	if (dn > 255)
-	    dn = 255;
-	m_stretchLUTBlue[i] = dn;
-    }
+    int min, max, redCurve;
+    double redGamma;
+
+	/* build the manual stretch.  in auto mode this is only a starting
+	   point until the stats stage has something better; after that the
+	   stats stage owns the tables.  equalized curves need a histogram,
+	   which only the stats stage touches, so they start out linear */
+
+    if (m_block->currentStretchMode() == STRETCHMODE_MANUAL ||
+	    m_autoStretchLow[BANDSTATS_FRAME] < 0) {
+	min = m_block->currentStretchMin();
+	max = m_block->currentStretchMax();
+	redCurve = m_block->currentRedCurve();
+	redGamma = m_block->currentRedGamma();
+	m_stretchRed->build(redCurve, min, max, 1.0, redGamma, NULL);
+	m_stretchGreen->build(m_block->currentGreenCurve(), min, max,
+	    m_block->currentGreenGain(), m_block->currentGreenGamma(), NULL);
+	m_stretchBlue->build(m_block->currentBlueCurve(), min, max,
+	    m_block->currentBlueGain(), m_block->currentBlueGamma(), NULL);
+	m_stretchFrame->build(redCurve, min, max, 1.0, redGamma, NULL);
+    }
+
+	/* have the stats stage catch up with the change */
+
+    m_stretchRebuild = 1;
 }
 
 
@@ -1917,39 +2133,39 @@ void DisplayTab::showEndingCalMode(void)
 }
 
 
-#if defined(DEBUG)
-#define TRACE_SPEED(x) { struct timeval t; \
-    (void)gettimeofday(&t, NULL); printf("%c: %d\n", x, (int)t.tv_usec); }
-#else
-#define TRACE_SPEED(x)
-#endif
-
 void DisplayTab::dataThread(void)
 {
+    u_int64_t t0;
+
 	/* wait for parent's enable */
 
     m_dataThreadMutex.lock();
 
-	/* this thread is calibrated to run every 10 ms with the -O3 compile
-           option.  data/discrete reading takes 3 ms in that case.  with -g and
-	   without -O3, the data lookup takes 8 ms.  waits aren't critical
-	   though: they just improve GUI response time */
+	/* with real data, block until the framebuffer has a frame for us or
+	   it's time for housekeeping, so frames are picked up as soon as
+	   they arrive and we don't spin when there aren't any.  when
+	   simulating there's nothing to wait on, so we poll as before.  this
+	   was calibrated to run every 10 ms with the -O3 compile option;
+	   data/discrete reading takes 3 ms in that case.  each pass shows
+	   up in a trace (see tracer.h) as an "acquire" span */
 
     while (m_dataThreadEnabled) {
-	TRACE_SPEED('1')
+	t0 = traceStart();
 	lookForImageData();
-	TRACE_SPEED('2')
+	traceEnd(TRACE_ACQUIRE, t0);
 	if (!appFrame::headless) {
 	    if (m_recordToggleAttached)
 		testDigitalLineTransition(); // We used 1 ms to read the USB
-	    Glib::usleep(6000);
 	}
 	else {
 	    if (m_headlessDevFd != -1)
 		checkHeadlessInterface();
-	    Glib::usleep(4000);  //  We allow 3 ms to read the serial line
 	}
-	TRACE_SPEED('3')
+	if (m_block->currentImageSim() == IMAGESIM_NONE)
+	    (void)appFrame::fb->waitForFrame(DATA_WAIT_TIMEOUT_USECS);
+	else if (!appFrame::headless)
+	    Glib::usleep(6000);
+	else Glib::usleep(4000);  //  We allow 3 ms to read the serial line
     }
 
 	/* clean up */
@@ -1978,16 +2194,19 @@ void DisplayTab::startDataThreadAndBlock(void)
 
 void DisplayTab::lookForImageData(void)
 {
-    int i, j, framesExpected, dataAvailable;
+    int i, framesExpected, dataAvailable;
     static u_int diagsUpdateIter = 0;
-    unsigned short *usp;
-    unsigned int *uip;
-    unsigned char *ucp;
+    static struct timeval lastDiagsUpdate = { 0, 0 };
+    static struct timeval lastDIOCheck = { 0, 0 };
+    static struct timeval lastDiagsSample = { 0, 0 };
+    struct timeval now;
+    int diagsDue, dioDue, diagsSampleDue;
     static int imageAcquisitionFailures = 0;
     struct timeval recordEndTime;
     double secs;
     int consecutiveFrames;
     int maxSensorRange;
+    FrameHandle *h;
 
 	/* if simulating, set initial dataAvailable to keep up with expected
 	   data rate.  otherwise just ask framebuffer whether or not something
@@ -2009,34 +2228,14 @@ void DisplayTab::lookForImageData(void)
     }
     consecutiveFrames = 0;
 
-	/* if no data is available... */
+	/* if no data is available, and it looks like we have a problem,
+	   update indicator.  stop requests are otherwise only checked when
+	   recording data; the record stage checks them when it's idle */
 
     if (!dataAvailable) {
-
-	    /* check to make sure stop wasn't requested.  stop is otherwise
- 	       only checked when displaying data */
-
-	if (m_stopRequested) {
-	    m_stopRequested = 0;
-
-	    if (m_mostRecentOBCMode != OBC_AUTO || m_stopIsAbort ||
-		    m_block->currentOBCInterface() == OBCINTERFACE_NONE)
-		enterIdleState();
-	    else if (m_block->currentDark2CalPeriodInSecs() > 0)
-		enterDark2CalState();
-	    else if (m_block->currentMediumCalPeriodInSecs() > 0)
-		enterMediumCalState();
-	    else if (m_block->currentBrightCalPeriodInSecs() > 0)
-		enterBrightCalState();
-	    else if (m_block->currentLaserCalPeriodInSecs() > 0)
-		enterLaserCalState();
-	    else enterIdleState();
-	}
-
-	    /* if it looks like we have a problem, update indicator */
-
 	imageAcquisitionFailures++;
 	if (imageAcquisitionFailures > 40) {
+	    m_lastArrivalTime = 0.0;	/* the gap isn't jitter */
 	    m_imagerCheckColor = StatusDisplay::COLOR_RED;
 	    m_fpiePPSCheckColor = StatusDisplay::COLOR_YELLOW;
 	    m_gpsCommCheckColor = StatusDisplay::COLOR_YELLOW;
@@ -2046,7 +2245,11 @@ void DisplayTab::lookForImageData(void)
 	}
     }
 
-	/* otherwise, while data is available... */
+	/* otherwise, while data is available, get it into a frame handle and
+	   hand it off to the processing stage.  everything else that used to
+	   happen here -- dark accumulation, timing and GPS checks, recording,
+	   display -- happens downstream on other threads, so a slow write
+	   can't hold up acquisition */
 
     else while (dataAvailable) {
 
@@ -2055,181 +2258,67 @@ void DisplayTab::lookForImageData(void)
 	imageAcquisitionFailures = 0;
 	m_imagerCheckColor = StatusDisplay::COLOR_GREEN;
 	
-	    /* get data from FPGA or simulation */
+	    /* get data from FPGA or simulation.  if simulating GPS data,
+	       modify image -- this goes a little more often than the clock
+	       rate if simulating and not recording, because of the way the
+	       data-available flag is set above */
 
-	m_frameCount++;
-	consecutiveFrames++;
-	if (m_block->currentImageSim() == IMAGESIM_NONE)
-	    getImageFrame();
-	else simImageFrame();
+	if ((h=m_framePool->alloc(PIPELINE_WAIT_FOREVER)) == NULL)
+	    break;
+	if (m_block->currentImageSim() != IMAGESIM_NONE)
+	    simImageFrame(h->pixels);
 
-	    /* if simulating GPS data, modify image -- this goes a little more
- 	       often than the clock rate if simulating and not recording,
-	       because of the way the data-available flag is set above */
+	    /* if the card said a frame was there but we couldn't get it, the
+	       handle still holds whatever it last did, so it can't go
+	       downstream.  we'll try again next pass */
 
-	if (m_block->currentGPSSim() != GPSSIM_NONE)
-	    addGPSSimToFrame();
-
-	    /* update dark frame, if applicable.  accumulate dark frames only
- 	       through first second.  any longer and the dark-frame period may
-	       be over, depending on user settings */
-
-	if (m_framesUntilDark > 0)
-	    m_framesUntilDark--;
-	if (m_framesUntilDark == 0) {
-	    if (m_darkFramesAccumulated < appFrame::fb->getFrameRateHz() *
-		    DARK_ACCUM_TIME_SECS) {
-		usp = m_imageBuffer + m_frameWidthSamples;
-		uip = m_darkFrameAccumulation + m_frameWidthSamples;
-		for (i = m_frameHeightLines - 1;i > 0;i--)
-		    for (j = m_frameWidthSamples;j > 0;j--)
-			*uip++ += *usp++;
-		m_darkFramesAccumulated++;
-	    }
-	    else {
-		usp = m_darkFrame + m_frameWidthSamples;
-		uip = m_darkFrameAccumulation + m_frameWidthSamples;
-		for (i = m_frameHeightLines - 1;i > 0;i--)
-		    for (j = m_frameWidthSamples;j > 0;j--)
-			*usp++ = *uip++ /
-			    (appFrame::fb->getFrameRateHz() *
-				DARK_ACCUM_TIME_SECS);
-		m_framesUntilDark = -1;
-		m_darkFrameBuffered = 1;
-	    }
+	else if (getImageFrame(h) == -1) {
+	    m_framePool->unref(h);
+	    break;
 	}
+	m_frameCount++;
+	consecutiveFrames++;
+	h->frameCount = m_frameCount;
 
-	    /* update indicators for FPIE PPS and Msg3 from imagery */
-
-	processImageTimingData();
-
-	    /* note local frame count */
-
-	ucp = (u_char *)m_imageBuffer + LOCAL_FRAME_COUNT_IMAGE_OFFSET;
-	m_localFrameCount = *(ucp+1) << 24;
-	m_localFrameCount += *ucp << 16;
-	m_localFrameCount += *(ucp+3) << 8;
-	m_localFrameCount += *(ucp+2);
-
-	    /* if we've got a waterfall display we need to display the new
-	       data for continuity in the display.  this is an easy enough
-	       task that we can afford to do this.  we defer full-frame
-	       displays to after we catch up with the data rate.  note that
-	       the downtrack-skip option lets up skip some lines to preserve
-	       the correct aspect ratio in the display */
-
-	if (!appFrame::headless)
-	    if (m_block->currentViewerType() == VIEWERTYPE_WATERFALL ||
-		    m_block->currentViewerType() == VIEWERTYPE_COMBO)
-		displayWaterfallLine();
-
-	    /* process GPS-data area of image */
-
-	processImageGPSData();
+	if (m_block->currentGPSSim() != GPSSIM_NONE)
+	    addGPSSimToFrame(h->pixels);
 
-	    /* handle according to current record state */
-
-	if (m_outOfSpace) {
-	    if (m_recordState != RECORD_STATE_NOT_RECORDING) {
-		log("Out of storage space.  Stopping record.");
-		enterIdleState();
-	    }
-	}
-	else if (m_recordState == RECORD_STATE_NOT_RECORDING) {
-	    (void)writeAllgpsData();
-	    (void)writeAllppsData();
-	}
-	else {
-	    (void)writeAllgpsData();
-	    (void)writeAllppsData();
-
-	    if (writeFlightlineGPSData() == -1 || writePPSData() == -1 ||
-		    writeImageFrame() == -1) {
-		enterIdleState();
-		m_outOfSpace = 1;
-	    }
-	    else if (m_stopRequested && m_stopIsAbort) {
-		m_stopRequested = 0;
-		enterIdleState();
-	    }
-	    else switch (m_recordState) {
-		case RECORD_STATE_DARK1CAL:
-		    if (--m_wait == 0)
-			enterScienceState();
-		    break;
-		case RECORD_STATE_SCIENCE:
-		    if (m_stopRequested) {
-			m_stopRequested = 0;
-			if (m_mostRecentOBCMode != OBC_AUTO ||
-				m_block->currentOBCInterface() ==
-				    OBCINTERFACE_NONE)
-			    enterIdleState();
-			else if (m_block->currentDark2CalPeriodInSecs() > 0)
-			    enterDark2CalState();
-			else if (m_block->currentMediumCalPeriodInSecs() > 0)
-			    enterMediumCalState();
-			else if (m_block->currentBrightCalPeriodInSecs() > 0)
-			    enterBrightCalState();
-			else if (m_block->currentLaserCalPeriodInSecs() > 0)
-			    enterLaserCalState();
-			else enterIdleState();
-		    }
-		    break;
-		case RECORD_STATE_DARK2CAL:
-		    if (--m_wait == 0) {
-			if (m_block->currentMediumCalPeriodInSecs() > 0)
-			    enterMediumCalState();
-			else if (m_block->currentBrightCalPeriodInSecs() > 0)
-			    enterBrightCalState();
-			else if (m_block->currentLaserCalPeriodInSecs() > 0)
-			    enterLaserCalState();
-			else enterIdleState();
-		    }
-		    break;
-		case RECORD_STATE_MEDIUMCAL:
-		    if (--m_wait == 0) {
-			if (m_block->currentBrightCalPeriodInSecs() > 0)
-			    enterBrightCalState();
-			else if (m_block->currentLaserCalPeriodInSecs() > 0)
-			    enterLaserCalState();
-			else enterIdleState();
-		    }
-		    break;
-		case RECORD_STATE_BRIGHTCAL:
-		    if (--m_wait == 0) {
-			if (m_block->currentLaserCalPeriodInSecs() > 0)
-			    enterLaserCalState();
-			else enterIdleState();
-		    }
-		    break;
-		case RECORD_STATE_LASERCAL:
-		    if (--m_wait == 0)
-			enterIdleState();
-		    break;
-		default:
-		    error("Internal error in DisplayTab::lookForImageData");
-		    break;
-	    }
-	}
+	(void)m_processStage->submit(h);
+	m_framePool->unref(h);
 
 	    /* see if we've got more data available, either real or simulated */
 
 	dataAvailable = checkForMoreImageData(consecutiveFrames);
-
-	    /* if we've caught up with the data and we're displaying whole
-	       frames, show the most recent one */
-
-	if (!dataAvailable &&
-		(m_block->currentViewerType() == VIEWERTYPE_FRAME ||
-		    m_block->currentViewerType() == VIEWERTYPE_COMBO))
-	    if (!appFrame::headless)
-		displayCurrentFrame();
     }
 // printf("%d\n", consecutiveFrames);
 
+	/* the data thread now wakes when frames arrive rather than on a fixed
+	   period, so pace the slower housekeeping by the clock rather than
+	   by iteration count */
+
+    (void)gettimeofday(&now, NULL);
+    diagsDue = (diagsUpdateIter == 0 ||
+	(now.tv_sec - lastDiagsUpdate.tv_sec) * 1000000.0 +
+	    (now.tv_usec - lastDiagsUpdate.tv_usec) >=
+		DIAGS_UPDATE_INTERVAL_USECS);
+    if (diagsDue)
+	lastDiagsUpdate = now;
+    dioDue = (diagsUpdateIter == 0 ||
+	(now.tv_sec - lastDIOCheck.tv_sec) * 1000000.0 +
+	    (now.tv_usec - lastDIOCheck.tv_usec) >=
+		DIO_REATTACH_INTERVAL_USECS);
+    if (dioDue)
+	lastDIOCheck = now;
+    diagsSampleDue = (diagsUpdateIter == 0 ||
+	(now.tv_sec - lastDiagsSample.tv_sec) * 1000000.0 +
+	    (now.tv_usec - lastDiagsSample.tv_usec) >=
+		1000000.0 / m_block->currentDiagsRateHz());
+    if (diagsSampleDue)
+	lastDiagsSample = now;
+
 	/* check temps */
 
-    if (diagsUpdateIter % 100 == 0) {
+    if (diagsDue) {
 
 	    /* read the sensors */
 
@@ -2259,6 +2348,24 @@ void DisplayTab::lookForImageData(void)
 		break;
 	}
 
+	    /* get pipeline stage stats for the period since last time */
+
+	m_processStage->getStats(&m_stageStats[PIPELINE_STAGE_PROCESS]);
+	m_recordStage->getStats(&m_stageStats[PIPELINE_STAGE_RECORD]);
+	m_displayStage->getStats(&m_stageStats[PIPELINE_STAGE_DISPLAY]);
+	m_darkStage->getStats(&m_stageStats[PIPELINE_STAGE_DARK]);
+	m_statsStage->getStats(&m_stageStats[PIPELINE_STAGE_STATS]);
+	m_quicklookStage->getStats(&m_stageStats[PIPELINE_STAGE_QUICKLOOK]);
+	m_hasher->getStats(&m_stageStats[PIPELINE_STAGE_HASH]);
+	m_imageWriter->getStats(m_rawWriterStats);
+
+	    /* and the latency histograms, for the same period and for the
+	       last minute */
+
+	for (i=0;i < NUM_FRAME_LATENCIES;i++)
+	    m_latencyHists[i]->rollover(&m_latencyNow[i],
+		&m_latencyMinute[i]);
+
 	    /* get FPGA registers */
 
 	appFrame::fb->readFPGARegs(&m_fpgaFrameCount, &m_fpgaPPSCount,
@@ -2272,29 +2379,29 @@ void DisplayTab::lookForImageData(void)
     }
 
 	/* update indicator display -- for non-headless mode we want to do
- 	   this rapidly to capture transient events */
+ 	   this rapidly to capture transient events, but it's only shown
+	   with the next display refresh */
 
     if (!appFrame::headless)
-	m_refreshIndicators();
-    else if (diagsUpdateIter % 100 == 0) {
+	m_indicatorsDirty = 1;
+    else if (diagsDue) {
 	indicatorUpdateWork();
 	updateHeadlessIndicators();
     }
 
-	/* update CSV */
+	/* sample for the diags file.  this goes at its own rate, set in
+	   the settings; the sensors, FPGA registers, and latencies in each
+	   sample are as of the last diags update */
 
-    if (diagsUpdateIter % 100 == 0) {
-	if (diagsUpdateIter == 0)
-	    saveCSVHeader();
-	saveStateToCSV();
-    }
+    if (diagsSampleDue)
+	saveStateToDiags();
 
 	/* if DIO is supposed to be in use but failed, and if we're not
  	   recording, attempt to reinit.  we don't do this if recording 
 	   because it creates a popup which could block data storage if
 	   ignored */
 
-    if (diagsUpdateIter % 500 == 0) { /* i.e., every 5 seconds for AVIRISng */
+    if (dioDue) {
 	if (!m_recordToggleAttached &&
 		m_block->currentFMSControlOption() == FMSCONTROL_YES &&
 		m_recordState == RECORD_STATE_NOT_RECORDING) {
@@ -2316,38 +2423,559 @@ void DisplayTab::lookForImageData(void)
 }
 
 
-void DisplayTab::getImageFrame(void)
+void DisplayTab::processStageHandler(void *arg, FrameHandle *h)
 {
-    u_char *ucp;
-    u_short *usp;
-    int i, j;
+    if (h != NULL)
+	((DisplayTab *)arg)->processFrame(h);
+}
+
+
+void DisplayTab::recordStageHandler(void *arg, FrameHandle *h)
+{
+    if (h != NULL)
+	((DisplayTab *)arg)->recordFrame(h);
+    else ((DisplayTab *)arg)->checkStopRequest();
+}
+
+
+void DisplayTab::displayStageHandler(void *arg, FrameHandle *h)
+{
+    if (h != NULL)
+	((DisplayTab *)arg)->displayFrame(h);
+}
+
+
+void DisplayTab::statsStageHandler(void *arg, FrameHandle *h)
+{
+    ((DisplayTab *)arg)->statsFrame(h);
+}
+
+
+void DisplayTab::quicklookStageHandler(void *arg, FrameHandle *h)
+{
+    ((DisplayTab *)arg)->quicklookFrame(h);
+}
+
+
+void DisplayTab::darkStageHandler(void *arg, FrameHandle *h)
+{
+    if (h != NULL)
+	((DisplayTab *)arg)->darkFrame(h);
+    else ((DisplayTab *)arg)->finishDarkModel();
+}
+
+
+void DisplayTab::processFrame(FrameHandle *h)
+{
+    const unsigned char *ucp;
+    u_int64_t t0;
+
+	/* update indicators for FPIE PPS and Msg3 from imagery */
+
+    t0 = traceStart();
+    processImageTimingData(h->pixels);
+    traceEnd(TRACE_TIMING, t0);
+
+	/* note local frame count */
+
+    ucp = (const u_char *)h->pixels + LOCAL_FRAME_COUNT_IMAGE_OFFSET;
+    m_localFrameCount = *(ucp+1) << 24;
+    m_localFrameCount += *ucp << 16;
+    m_localFrameCount += *(ucp+3) << 8;
+    m_localFrameCount += *(ucp+2);
+
+	/* process GPS-data area of image */
+
+    t0 = traceStart();
+    processImageGPSData(h->pixels);
+    traceEnd(TRACE_GPS, t0);
+
+	/* pass the frame on.  the record stage sees every frame, since the
+	   end-to-end GPS and PPS files are written whether or not we're
+	   recording, and blocks us if it falls behind.  the display stage
+	   just drops frames it can't get to */
+
+    (void)m_recordStage->submit(h);
+    if (!appFrame::headless)
+	(void)m_displayStage->submit(h);
+}
+
+
+void DisplayTab::recordFrame(FrameHandle *h)
+{
+	/* handle according to current record state */
+
+    if (m_outOfSpace) {
+	if (m_recordState != RECORD_STATE_NOT_RECORDING) {
+	    log("Out of storage space.  Stopping record.");
+	    enterIdleState();
+	}
+    }
+    else if (m_recordState == RECORD_STATE_NOT_RECORDING) {
+	(void)writeAllgpsData(h->pixels);
+	(void)writeAllppsData(h->pixels);
+    }
+    else {
+	(void)writeAllgpsData(h->pixels);
+	(void)writeAllppsData(h->pixels);
+
+	    /* the quicklook only wants every so many frames, and is the
+	       first thing to go if the pool is getting low -- it mustn't
+	       ever cost us a frame of the recording */
+
+	if (m_quicklookActive && h->frameCount % QUICKLOOK_DECIMATION == 0 &&
+		m_framePool->numFree() > PIPELINE_POOL_FRAMES/2)
+	    (void)m_quicklookStage->submit(h);
+
+	if (writeFlightlineGPSData(h->pixels) == -1 ||
+		writePPSData(h->pixels) == -1 ||
+		writeImageFrame(h) == -1) {
+	    enterIdleState();
+	    m_outOfSpace = 1;
+	}
+	else if (m_stopRequested && m_stopIsAbort) {
+	    m_stopRequested = 0;
+	    enterIdleState();
+	}
+	else switch (m_recordState) {
+	    case RECORD_STATE_DARK1CAL:
+		if (--m_wait == 0)
+		    enterScienceState();
+		break;
+	    case RECORD_STATE_SCIENCE:
+		if (m_stopRequested) {
+		    m_stopRequested = 0;
+		    if (m_mostRecentOBCMode != OBC_AUTO ||
+			    m_block->currentOBCInterface() ==
+				OBCINTERFACE_NONE)
+			enterIdleState();
+		    else if (m_block->currentDark2CalPeriodInSecs() > 0)
+			enterDark2CalState();
+		    else if (m_block->currentMediumCalPeriodInSecs() > 0)
+			enterMediumCalState();
+		    else if (m_block->currentBrightCalPeriodInSecs() > 0)
+			enterBrightCalState();
+		    else if (m_block->currentLaserCalPeriodInSecs() > 0)
+			enterLaserCalState();
+		    else enterIdleState();
+		}
+		break;
+	    case RECORD_STATE_DARK2CAL:
+		if (--m_wait == 0) {
+		    if (m_block->currentMediumCalPeriodInSecs() > 0)
+			enterMediumCalState();
+		    else if (m_block->currentBrightCalPeriodInSecs() > 0)
+			enterBrightCalState();
+		    else if (m_block->currentLaserCalPeriodInSecs() > 0)
+			enterLaserCalState();
+		    else enterIdleState();
+		}
+		break;
+	    case RECORD_STATE_MEDIUMCAL:
+		if (--m_wait == 0) {
+		    if (m_block->currentBrightCalPeriodInSecs() > 0)
+			enterBrightCalState();
+		    else if (m_block->currentLaserCalPeriodInSecs() > 0)
+			enterLaserCalState();
+		    else enterIdleState();
+		}
+		break;
+	    case RECORD_STATE_BRIGHTCAL:
+		if (--m_wait == 0) {
+		    if (m_block->currentLaserCalPeriodInSecs() > 0)
+			enterLaserCalState();
+		    else enterIdleState();
+		}
+		break;
+	    case RECORD_STATE_LASERCAL:
+		if (--m_wait == 0)
+		    enterIdleState();
+		break;
+	    default:
+		error("Internal error in DisplayTab::recordFrame");
+		break;
+	}
+    }
+
+    feedDarkModel(h);
+}
+
+
+void DisplayTab::startDarkModel(int frames, int duringCal)
+{
+	/* called from whoever moves the shutter, with how many frames to
+	   take (or -1 to take them until the cal period ends).  the record
+	   stage picks this up on its next frame */
+
+    m_darkRequestTime = pipelineNow();
+    m_darkFramesWanted = frames;
+    m_darkWantedDuringCal = duringCal;
+    m_darkResetPending = 1;
+}
+
+
+void DisplayTab::feedDarkModel(FrameHandle *h)
+{
+	/* start a new dark period if asked */
+
+    if (m_darkResetPending) {
+	m_darkResetPending = 0;
+	m_darkSettledTime = m_darkRequestTime + OBC_SETTLING_TIME_SECS;
+	m_darkFramesLeft = m_darkFramesWanted;
+	m_darkDuringCal = m_darkWantedDuringCal;
+	m_darkModelReset = 1;
+    }
+
+	/* a cal period's dark frames end when the record state moves on,
+	   which it does on the frame the shutter is told to open */
+
+    if (m_darkDuringCal && m_recordState != RECORD_STATE_DARK1CAL &&
+	    m_recordState != RECORD_STATE_DARK2CAL)
+	m_darkFramesLeft = 0;
+
+	/* hand dark frames to the dark stage once the shutter has settled.
+	   go by when the frame was taken, since frames acquired before the
+	   shutter moved may still be coming through the pipeline.  the dark
+	   stage drops what it can't get to, which only costs us samples */
+
+    if (m_darkFramesLeft != 0 && h->acquireTime >= m_darkSettledTime) {
+	(void)m_darkStage->submit(h);
+	if (m_darkFramesLeft > 0)
+	    m_darkFramesLeft--;
+    }
+}
+
+
+void DisplayTab::darkFrame(FrameHandle *h)
+{
+    u_int64_t t0;
+
+	/* a new dark period finishes off any model still pending from the
+	   last one */
+
+    if (m_darkModelReset) {
+	m_darkModelReset = 0;
+	finishDarkModel();
+    }
+    t0 = traceStart();
+    m_darkModel->addFrame(h->pixels);
+    traceEnd(TRACE_DARK, t0);
+}
+
+
+void DisplayTab::finishDarkModel(void)
+{
+    char msg[MAX_ERROR_LEN];
+    int frames;
+
+	/* called once the dark frames stop coming.  nothing to do if we
+	   have nothing new */
+
+    frames = m_darkModel->framesAdded();
+    if (frames == 0)
+	return;
+
+    Glib::Mutex::Lock lock(m_darkMutex);
+    if (m_darkModel->finish() == -1) {
+	(void)sprintf(msg, "Only %d dark frames; keeping the old dark.",
+	    frames);
+	log(msg);
+    }
+    else {
+	(void)memcpy(m_darkFrame, m_darkModel->clippedMean(),
+	    m_frameHeightLines * m_frameWidthSamples * sizeof(short));
+	(void)memcpy(m_darkMask, m_darkModel->mask(),
+	    m_frameHeightLines * m_frameWidthSamples);
+	m_darkFrameBuffered = 1;
+	(void)sprintf(msg,
+	    "Dark model from %d frames: %d hot, %d dead, %d noisy pixels.",
+	    frames, m_darkModel->numHot(), m_darkModel->numDead(),
+	    m_darkModel->numNoisy());
+	log(msg);
+    }
+    lock.release();
+    m_darkModel->reset();
+}
+
+
+void DisplayTab::statsFrame(FrameHandle *h)
+{
+    int i, darkSub;
+
+    if (m_autoStretchReset) {
+	m_autoStretchReset = 0;
+	m_bandStats->reset();
+	for (i=0;i < NUM_BANDSTATS_CHANNELS;i++)
+	    m_autoStretchLow[i] = m_autoStretchHigh[i] = -1;
+    }
+
+	/* gather statistics on what's displayed, i.e., after any dark
+	   subtraction */
+
+    darkSub = (m_block->currentDarkSubOption() == DARKSUBOPTION_YES);
+    Glib::Mutex::Lock lock(m_darkMutex);
+    m_bandStats->addFrame(h->pixels, darkSub? m_darkFrame:NULL, m_darkMask,
+	m_block->currentRedBand(), m_block->currentGreenBand(),
+	m_block->currentBlueBand());
+    lock.release();
+
+    if (m_bandStats->frames() % STRETCH_CHECK_FRAMES == 0 ||
+	    m_stretchRebuild)
+	updateAutoStretch();
+}
+
+
+void DisplayTab::quicklookFrame(FrameHandle *h)
+{
+    int bands[3], darkSub;
+    const u_char *luts[3];
+    char msg[MAXPATHLEN+100];
+
+	/* open or close the quicklook if a recording has started or
+	   stopped since we last looked.  this is done under the lock so
+	   that an aborted recording can't remove the file out from under
+	   an open */
+
+    Glib::Mutex::Lock qlock(m_quicklookMutex);
+    if (m_quicklookSeen != m_quicklookGeneration) {
+	m_quicklookSeen = m_quicklookGeneration;
+	if (m_quicklook->isOpen()) {
+	    if (m_quicklook->close() == -1)
+		log("Quicklook write failed at close.");
+	}
+	if (m_quicklookActive && m_quicklook->open(m_quicklookPath) == -1) {
+	    (void)sprintf(msg, "Can't open quicklook \"%s\".",
+		m_quicklookPath);
+	    log(msg);
+	}
+    }
+    qlock.release();
+    if (h == NULL || !m_quicklook->isOpen())
+	return;
+
+	/* same bands, stretch, and dark subtraction as the waterfall */
+
+    bands[0] = m_block->currentRedBand();
+    bands[1] = m_block->currentGreenBand();
+    bands[2] = m_block->currentBlueBand();
+    darkSub = (m_block->currentDarkSubOption() == DARKSUBOPTION_YES);
+    luts[0] = m_stretchRed->acquire();
+    luts[1] = m_stretchGreen->acquire();
+    luts[2] = m_stretchBlue->acquire();
+    Glib::Mutex::Lock lock(m_darkMutex);
+    if (m_quicklook->addFrame(h->pixels, h->frameCount, bands,
+	    darkSub? m_darkFrame:NULL, darkSub? m_darkMask:NULL,
+	    luts) == -1) {
+	(void)m_quicklook->close();
+	log("Quicklook write failed; quicklook stopped.");
+    }
+    lock.release();
+    m_stretchRed->release(luts[0]);
+    m_stretchGreen->release(luts[1]);
+    m_stretchBlue->release(luts[2]);
+}
+
+
+void DisplayTab::updateAutoStretch(void)
+{
+    StretchLUT *luts[NUM_BANDSTATS_CHANNELS];
+    int curves[NUM_BANDSTATS_CHANNELS];
+    double gains[NUM_BANDSTATS_CHANNELS];
+    double gammas[NUM_BANDSTATS_CHANNELS];
+    int i, low, high, autoStretch, rebuildAll, equalizeDue, rebuild;
+    double drift;
+
+    luts[BANDSTATS_FRAME] = m_stretchFrame;
+    luts[BANDSTATS_RED] = m_stretchRed;
+    luts[BANDSTATS_GREEN] = m_stretchGreen;
+    luts[BANDSTATS_BLUE] = m_stretchBlue;
+    curves[BANDSTATS_FRAME] = curves[BANDSTATS_RED] =
+	m_block->currentRedCurve();
+    curves[BANDSTATS_GREEN] = m_block->currentGreenCurve();
+    curves[BANDSTATS_BLUE] = m_block->currentBlueCurve();
+    gains[BANDSTATS_FRAME] = gains[BANDSTATS_RED] = 1.0;
+    gains[BANDSTATS_GREEN] = m_block->currentGreenGain();
+    gains[BANDSTATS_BLUE] = m_block->currentBlueGain();
+    gammas[BANDSTATS_FRAME] = gammas[BANDSTATS_RED] =
+	m_block->currentRedGamma();
+    gammas[BANDSTATS_GREEN] = m_block->currentGreenGamma();
+    gammas[BANDSTATS_BLUE] = m_block->currentBlueGamma();
+    autoStretch = (m_block->currentStretchMode() == STRETCHMODE_AUTO);
+    rebuildAll = m_stretchRebuild;
+    m_stretchRebuild = 0;
+    equalizeDue = (m_bandStats->frames() % STRETCH_EQUALIZE_FRAMES == 0);
+
+	/* in auto mode, rebuild only the LUTs whose percentiles have moved
+	   appreciably.  each channel gets its own stretch, so the green and
+	   blue gains don't apply.  otherwise the stretch is the manual one
+	   and only equalized curves change with the data */
+
+    for (i=0;i < NUM_BANDSTATS_CHANNELS;i++) {
+	if (autoStretch) {
+	    low = m_bandStats->percentile(i, STRETCH_LOW_PERCENTILE);
+	    high = m_bandStats->percentile(i, STRETCH_HIGH_PERCENTILE);
+	    if (low < 0)
+		continue;
+	    if (high <= low)
+		high = low + 1;
+	    drift = STRETCH_DRIFT_FRACTION *
+		(m_autoStretchHigh[i] - m_autoStretchLow[i]);
+	    rebuild = (m_autoStretchLow[i] < 0 ||
+		abs(low - m_autoStretchLow[i]) > drift ||
+		abs(high - m_autoStretchHigh[i]) > drift);
+	    gains[i] = 1.0;
+	}
+	else {
+	    low = m_block->currentStretchMin();
+	    high = m_block->currentStretchMax();
+	    rebuild = 0;
+	}
+	if (rebuild || rebuildAll ||
+		(curves[i] == STRETCHCURVE_EQUALIZE && equalizeDue)) {
+	    luts[i]->build(curves[i], low, high, gains[i], gammas[i],
+		m_bandStats->histogram(i));
+	    if (autoStretch) {
+		m_autoStretchLow[i] = low;
+		m_autoStretchHigh[i] = high;
+	    }
+	}
+    }
+}
+
+
+void DisplayTab::checkStopRequest(void)
+{
+	/* no data is arriving, so make sure stop wasn't requested.  stop is
+ 	   otherwise only checked when recording data */
+
+    if (m_stopRequested) {
+	m_stopRequested = 0;
+
+	if (m_mostRecentOBCMode != OBC_AUTO || m_stopIsAbort ||
+		m_block->currentOBCInterface() == OBCINTERFACE_NONE)
+	    enterIdleState();
+	else if (m_block->currentDark2CalPeriodInSecs() > 0)
+	    enterDark2CalState();
+	else if (m_block->currentMediumCalPeriodInSecs() > 0)
+	    enterMediumCalState();
+	else if (m_block->currentBrightCalPeriodInSecs() > 0)
+	    enterBrightCalState();
+	else if (m_block->currentLaserCalPeriodInSecs() > 0)
+	    enterLaserCalState();
+	else enterIdleState();
+    }
+}
+
+
+void DisplayTab::displayFrame(FrameHandle *h)
+{
+    int statsWanted;
+    u_int64_t t0;
+
+	/* the stats stage keeps the automatic stretch and any equalized
+	   curves up to date.  it only needs a sampling of frames, so it
+	   drops what it can't keep up with.  if it's been idle its
+	   histograms are stale, so it starts over */
+
+    statsWanted = (m_block->currentStretchMode() == STRETCHMODE_AUTO ||
+	m_block->currentRedCurve() == STRETCHCURVE_EQUALIZE ||
+	m_block->currentGreenCurve() == STRETCHCURVE_EQUALIZE ||
+	m_block->currentBlueCurve() == STRETCHCURVE_EQUALIZE);
+    if (statsWanted) {
+	if (!m_statsFed)
+	    m_autoStretchReset = 1;
+	(void)m_statsStage->submit(h);
+    }
+    m_statsFed = statsWanted;
+
+	/* if we've got a waterfall display we need to display the new data
+	   for continuity in the display.  this is an easy enough task that we
+	   can afford to do this.  we defer full-frame displays to when we've
+	   caught up with the data.  note that the downtrack-skip option lets
+	   up skip some lines to preserve the correct aspect ratio in the
+	   display */
+
+    if (m_block->currentViewerType() == VIEWERTYPE_WATERFALL ||
+	    m_block->currentViewerType() == VIEWERTYPE_COMBO) {
+	t0 = traceStart();
+	displayWaterfallLine(h->pixels);
+	traceEnd(TRACE_WATERFALL, t0);
+    }
+
+	/* if we've caught up with the data and we're displaying whole frames,
+	   show the most recent one */
+
+    if (m_displayStage->depth() == 0 &&
+	    (m_block->currentViewerType() == VIEWERTYPE_FRAME ||
+		m_block->currentViewerType() == VIEWERTYPE_COMBO))
+	displayCurrentFrame(h->pixels);
+}
+
+
+int DisplayTab::getImageFrame(FrameHandle *h)
+{
+    void *frame;
+    u_int64_t t0;
+    double arrival, rateHz;
 
 	/* get data from FPGA.  data should only be 14-bit but I'm not masking
   	   off because the first line will have larger values and the
 	   electronics team doesn't want me to mask incorrect pixel values
 	   from appearing in saved data files */
 
-    ucp = (u_char *)appFrame::fb->getFrame();
-    usp = m_imageBuffer;
-    for (i = m_frameHeightLines;i > 0;i--) {
-	for (j = m_frameWidthSamples;j > 0;j--) {
-	    *usp = (*(ucp+1) << 8) | *ucp;
-	    usp++;
-	    ucp += sizeof(short);
-	}
+    t0 = traceStart();
+    frame = m_framePool->getFrame();
+    traceEnd(TRACE_FETCH, t0);
+    if (frame == NULL) {
+	m_lastArrivalTime = 0.0;	/* the gap isn't jitter */
+	return -1;
     }
+
+	/* note how long the frame sat between the card and us, and how far
+	   its arrival was off the frame period.  a backlog building in the
+	   framebuffer shows up here well before frames are dropped */
+
+    arrival = appFrame::fb->frameArrivalTime();
+    if (arrival > 0.0) {
+	m_latencyHists[FRAME_LATENCY_PICKUP]->record(h->acquireTime -
+	    arrival);
+	rateHz = appFrame::fb->getFrameRateHz();
+	if (m_lastArrivalTime > 0.0 && rateHz > 0.0)
+	    m_latencyHists[FRAME_LATENCY_JITTER]->record(
+		fabs(arrival - m_lastArrivalTime - 1.0 / rateHz));
+	m_lastArrivalTime = arrival;
+    }
+
+	/* the frame is little-endian, so on a little-endian host we can work
+	   on it where it sits and hold onto it until every stage is done
+	   with it.  we can't if we're simulating GPS data, since that writes
+	   into the frame */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (m_block->currentGPSSim() == GPSSIM_NONE) {
+	h->lease = frame;
+	h->pixels = (u_short *)frame;
+	return 0;
+    }
+#endif
+    t0 = traceStart();
+    (*m_assembleFrame)(h->storage, frame, m_frameHeightLines,
+	m_frameWidthSamples);
+    traceEnd(TRACE_ASSEMBLE, t0);
+    m_framePool->releaseFrame(frame);
+    return 0;
 }
 
 
-void DisplayTab::simImageFrame(void)
+void DisplayTab::simImageFrame(u_short *image)
 {
     u_short *usp;
     int i, j, caldn;
     double pct;
     static u_short dn = 0;
 
-    memset(m_imageBuffer, 0, m_frameWidthSamples * sizeof(short));
-    usp = m_imageBuffer + m_frameWidthSamples;
+    memset(image, 0, m_frameWidthSamples * sizeof(short));
+    usp = image + m_frameWidthSamples;
     if (m_app->lastOBCState == OBC_DARK1 ||
 	    m_app->lastOBCState == OBC_DARK2) {
 	for (i = m_frameHeightLines - 1;i > 0;i--)
@@ -2400,7 +3028,7 @@ void DisplayTab::simImageFrame(void)
 }
 
 
-void DisplayTab::addGPSSimToFrame(void)
+void DisplayTab::addGPSSimToFrame(u_short *image)
 {
     u_short *usp;
     int ppsInterval, msg3Interval, chunk, i;
@@ -2418,7 +3046,7 @@ void DisplayTab::addGPSSimToFrame(void)
 
     if (m_block->currentGPSSim() == GPSSIM_ALL) {
 	if ((m_frameCount % ppsInterval) == 0) {
-	    usp = m_imageBuffer + PPS_IMAGE_OFFSET / sizeof(short);
+	    usp = image + PPS_IMAGE_OFFSET / sizeof(short);
 	    *usp++ = 0xBABE;
 	    *usp++ = 2;
 	    *usp++ = m_frameCount & 0xffff;
@@ -2545,7 +3173,7 @@ void DisplayTab::addGPSSimToFrame(void)
 	chunk = msgSimWordsLeft;
 	if (chunk > 21)
 	    chunk = 21;
-	usp = m_imageBuffer + GPS_IMAGE_OFFSET / sizeof(short);
+	usp = image + GPS_IMAGE_OFFSET / sizeof(short);
 	*usp++ = 0xBABE;
 	*usp++ = chunk;
 	memset(usp, 0, 21 * sizeof(short));
@@ -2554,12 +3182,12 @@ void DisplayTab::addGPSSimToFrame(void)
 	    msgSimBuf[i] = msgSimBuf[i+chunk];
 	msgSimWordsLeft -= chunk;
     }
-    *(m_imageBuffer + TIMESTAMP_IMAGE_OFFSET / sizeof(short)) =
+    *(image + TIMESTAMP_IMAGE_OFFSET / sizeof(short)) =
 	m_frameCount & 0xffff;
 }
 
 
-void DisplayTab::processImageTimingData(void)
+void DisplayTab::processImageTimingData(const u_short *image)
 {
     u_short thisTimeStamp;
     static u_short lastTimeStamp = 0;
@@ -2572,7 +3200,7 @@ void DisplayTab::processImageTimingData(void)
 	/* check timestamp within image to verify PPS-FPIE connection */
 
     (void)memcpy(&thisTimeStamp,
-	m_imageBuffer + TIMESTAMP_IMAGE_OFFSET / sizeof(short),
+	image + TIMESTAMP_IMAGE_OFFSET / sizeof(short),
 	sizeof(short));
     if (thisTimeStamp == 0 || thisTimeStamp == lastTimeStamp) {
 	fpiePPSAcquisitionFailures++;
@@ -2589,7 +3217,7 @@ void DisplayTab::processImageTimingData(void)
 
 	/* check PPS data within image to verify time message receipt */
 
-    if (*(m_imageBuffer + PPS_IMAGE_OFFSET / sizeof(short)) == 0xDEAD) {
+    if (*(image + PPS_IMAGE_OFFSET / sizeof(short)) == 0xDEAD) {
 	msg3AcquisitionFailures++;
 	if (msg3AcquisitionFailures > 1.5 * appFrame::fb->getFrameRateHz())
 	    m_msg3CheckColor = StatusDisplay::COLOR_RED;
@@ -2617,23 +3245,16 @@ void DisplayTab::processImageTimingData(void)
 }
 
 
-void DisplayTab::processImageGPSData(void)
+void DisplayTab::processImageGPSData(const u_short *image)
 {
-    u_short *usp, wordCount, cs;
-    int i, j;
-    static int gpsMsgParseState = 0;
-    static int gpsMsgWordsBuffered = 0;
-    static u_short lastGPSMsg[GPS_MSG_MAX_WORDS];
-    static int gps3501skip = 0;
+    const u_short *usp;
+    u_short wordCount;
     static int gpsCommFailures = 0;
 
-	/* if we've got the start of a GPS update, buffer it.  if we've
-	   got a full GPS update, process it.  I need to use a state
-	   machine to parse nav messages here because the magic number
-	   (81ff) can occur naturally as part of the data, at least in
-	   theory */
+	/* whatever part of the nav message stream came in with this frame
+	   goes to the decoder, which calls us back as messages complete */
 
-    usp = m_imageBuffer + GPS_IMAGE_OFFSET / sizeof(short);
+    usp = image + GPS_IMAGE_OFFSET / sizeof(short);
     if (*usp++ == 0xDEAD) {
 	gpsCommFailures++;
 	if (gpsCommFailures > 1.5 * appFrame::fb->getFrameRateHz()) {
@@ -2648,240 +3269,159 @@ void DisplayTab::processImageGPSData(void)
 	m_gpsCount++;
 
 	wordCount = *usp++;
-	for (i=0;i < wordCount;i++,usp++) {
-	    switch (gpsMsgParseState) {
-		case 0: /* look for 81ff */
-		    if (*usp == GPS_MAGIC_NUMBER) {
-			gpsMsgWordsBuffered = 0;
-			lastGPSMsg[gpsMsgWordsBuffered++] = *usp;
-			gpsMsgParseState = 1;
-		    }
-		    break;
-		case 1: /* look for message type */
-		    if (*usp == 3500 || *usp == 3501) {
-			lastGPSMsg[gpsMsgWordsBuffered++] = *usp;
-			gpsMsgParseState = 2;
-		    }
-		    else if (*usp == GPS_MAGIC_NUMBER)
-			/* do nothing */ ;
-		    else gpsMsgParseState = 0;
-		    break;
-		case 2: /* look for length - 6 */
-		    if (*usp == GPS_MAGIC_NUMBER) { /* not valid length */
-			gpsMsgWordsBuffered = 1;
-			gpsMsgParseState = 1;
-		    }
-		    else if ((*(usp-1) == 3500 &&
-				*usp == GPS_MSG_3500_WORDS-6) ||
-			    (*(usp-1) == 3501 &&
-				*usp == GPS_MSG_3501_WORDS-6)) {
-			lastGPSMsg[gpsMsgWordsBuffered++] = *usp;
-			gpsMsgParseState = 3;
-		    }
-		    else gpsMsgParseState = 0;
-		    break;
-		case 3: /* look for flags word */
-		    if (*usp == GPS_MAGIC_NUMBER) { /* not valid word */
-			gpsMsgWordsBuffered = 1;
-			gpsMsgParseState = 1;
-		    }
-		    else {
-			lastGPSMsg[gpsMsgWordsBuffered++] = *usp;
-			gpsMsgParseState = 4;
-		    }
-		    break;
-		case 4: /* look for checksum */
-		    lastGPSMsg[gpsMsgWordsBuffered++] = *usp;
-		    gpsMsgParseState = 5;
-		    break;
-		case 5: /* validate checksum */
-		    cs = 0;
-		    for (j=0;j < 4;j++)
-			cs += lastGPSMsg[j];
-		    cs = (~cs)+1;
-		    if (cs == lastGPSMsg[4]) {
-			lastGPSMsg[gpsMsgWordsBuffered++] = *usp;
-			gpsMsgParseState = 6;
-		    }
-		    else if (lastGPSMsg[4] == GPS_MAGIC_NUMBER) {
-			if (*usp == 3500 || *usp == 3501) {
-			    gpsMsgWordsBuffered = 2;
-			    lastGPSMsg[1] = *usp;
-			    gpsMsgParseState = 2;
-			}
-			else if (*usp == GPS_MAGIC_NUMBER) {
-			    gpsMsgWordsBuffered = 1;
-			    gpsMsgParseState = 1;
-			}
-			else gpsMsgParseState = 0;
-		    }
-		    else if (*usp == GPS_MAGIC_NUMBER) {
-			gpsMsgWordsBuffered = 1;
-			gpsMsgParseState = 1;
-		    }
-		    else gpsMsgParseState = 0;
-		    break;
-		case 6:
-		    lastGPSMsg[gpsMsgWordsBuffered++] = *usp;
-		    if (lastGPSMsg[1] == 3500 &&
-			    gpsMsgWordsBuffered == GPS_MSG_3500_WORDS) {
-			switch (lastGPSMsg[9]) {
-			    case GPS_MODE_FINE_ALIGNMENT:
-			    case GPS_MODE_AIR_ALIGNMENT:
-				m_airNavCheckColor =
-				    StatusDisplay::COLOR_YELLOW;
-				break;
-			    case GPS_MODE_AIR_NAVIGATION:
-				m_airNavCheckColor =
-				    StatusDisplay::COLOR_GREEN;
-				break;
-			    default:
-				m_airNavCheckColor =
-				    StatusDisplay::COLOR_RED;
-				break;
-			}
-			if (lastGPSMsg[10] & 0x1)
-			    m_gpsValidCheckColor =
-				StatusDisplay::COLOR_GREEN;
-			else m_gpsValidCheckColor =
-			    StatusDisplay::COLOR_RED;
-			gpsMsgParseState = 0;
-		    }
-		    else if (lastGPSMsg[1] == 3501 &&
-			    gpsMsgWordsBuffered == GPS_MSG_3501_WORDS) {
-			if (gps3501skip <= 0) {
-			    add3501(lastGPSMsg);
-			    if (!appFrame::headless)
-				m_refreshNavDisplay();
-			    gps3501skip = m_block->currentNavDurationSkip();
-			}
-			else gps3501skip--;
-			gpsMsgParseState = 0;
-		    }
-		    break;
-		default:
-		    gpsMsgParseState = 0; /* should never happen */
-		    break;
-	    }
-	}
+	if (wordCount > MAX_GPSDATA_BYTES / sizeof(short))
+	    wordCount = MAX_GPSDATA_BYTES / sizeof(short);
+	m_navDecoder->decode(usp, wordCount);
     }
 }
 
 
-void DisplayTab::displayCurrentFrame(void)
+void DisplayTab::navStatusHandler(void *arg, const nav_record_t *rec)
 {
-    int nLines, i, j, pixel;
-    u_short *usp, *dfp;
-    u_char *ucp;
+    ((DisplayTab *)arg)->navStatus(&rec->u.status);
+}
+
+
+void DisplayTab::navSolutionHandler(void *arg, const nav_record_t *rec)
+{
+    DisplayTab *tab;
+
+    tab = (DisplayTab *)arg;
+    if (tab->m_gps3501Skip <= 0) {
+	tab->add3501(&rec->u.solution);
+	if (!appFrame::headless)
+	    tab->m_navDisplayDirty = 1;
+	tab->m_gps3501Skip = tab->m_block->currentNavDurationSkip();
+    }
+    else tab->m_gps3501Skip--;
+}
+
+
+void DisplayTab::navStatus(const nav_status_t *status)
+{
+    switch (status->mode) {
+	case GPS_MODE_FINE_ALIGNMENT:
+	case GPS_MODE_AIR_ALIGNMENT:
+	    m_airNavCheckColor = StatusDisplay::COLOR_YELLOW;
+	    break;
+	case GPS_MODE_AIR_NAVIGATION:
+	    m_airNavCheckColor = StatusDisplay::COLOR_GREEN;
+	    break;
+	default:
+	    m_airNavCheckColor = StatusDisplay::COLOR_RED;
+	    break;
+    }
+    if (status->status & 0x1)
+	m_gpsValidCheckColor = StatusDisplay::COLOR_GREEN;
+    else m_gpsValidCheckColor = StatusDisplay::COLOR_RED;
+}
+
+
+void DisplayTab::displayCurrentFrame(const u_short *image)
+{
+    const u_char *lut;
+    int darkSub;
 
     if (m_block->currentViewerType() == VIEWERTYPE_FRAME)
 	m_incr = 1;
     else /* VIEWERTYPE_COMBO */ m_incr = 2;
-    nLines = m_frameHeightLines - 1;
-    ucp = m_framePixels;
-    usp = m_imageBuffer + m_frameWidthSamples;
-    dfp = m_darkFrame + m_frameWidthSamples;
-    for (i = nLines;i > 0;i-=m_incr) {
-	for (j = m_frameWidthSamples;j > 0;j-=m_incr) {
-	    pixel = *usp;
-	    if (m_block->currentDarkSubOption() == DARKSUBOPTION_YES) {
-		pixel -= *dfp;
-		if (pixel < 0) pixel = 0;
-	    }
-	    u_char value = m_stretchLUT[pixel];
-	    *ucp++ = value;
-	    *ucp++ = value;
-	    *ucp++ = value;
-	    usp += m_incr;
-	    dfp += m_incr;
-	}
-	usp += (m_incr-1) * m_frameWidthSamples;
-	dfp += (m_incr-1) * m_frameWidthSamples;
-    }
-#if defined(LINETEST)
-    ucp = m_framePixels;
-    *(ucp+3) = *(ucp+5) = 0;
-    *(ucp+4) = 255;
-    ucp += m_frameWidthSamples/incr*3;
-    *(ucp-6) = *(ucp-4) = 0;
-    *(ucp-5) = 255;
-    for (j = m_frameWidthSamples;j > 0;j-=incr) {
-	*ucp = *(ucp+2) = 0;
-	*(ucp+1) = 255;
-	ucp += 3;
-    }
-    if (nLines % 2 == 1 && incr == 2)
-	nLines--;
-    for (i = nLines-4*incr;i > 0;i-=incr) {
-	*(ucp+3) = *(ucp+5) = 0;
-	*(ucp+4) = 255;
-	ucp += 6;
-	ucp += 3 * ((m_frameWidthSamples-4*incr)/incr);
-	*ucp = *(ucp+2) = 0;
-	*(ucp+1) = 255;
-	ucp += 6;
-    }
-    for (j = m_frameWidthSamples;j > 0;j-=incr) {
-	*ucp = *(ucp+2) = 0;
-	*(ucp+1) = 255;
-	ucp += 3;
-    }
-    *(ucp+3) = *(ucp+5) = 0;
-    *(ucp+4) = 255;
-    ucp += m_frameWidthSamples/incr*3;
-    *(ucp-6) = *(ucp-4) = 0;
-    *(ucp-5) = 255;
-#endif
-    m_refreshFrameDisplay();
+    darkSub = (m_block->currentDarkSubOption() == DARKSUBOPTION_YES);
+
+	/* subtract the dark, mask bad pixels, stretch and draw in one pass.
+	   a bad pixel takes the value of its neighbor along the line.  the
+	   whole frame is drawn with the one stretch, even if a new one comes
+	   in partway */
+
+    lut = m_stretchFrame->acquire();
+    Glib::Mutex::Lock lock(m_darkMutex);
+    m_imageDisplay.drawFrame(image, m_darkFrame, m_darkMask, lut, darkSub,
+	m_incr);
+    lock.release();
+    m_stretchFrame->release(lut);
 }
 
 
-void DisplayTab::displayWaterfallLine(void)
+void DisplayTab::displayWaterfallLine(const u_short *image)
 {
     u_char *ucp;
-    u_short *usp_red, *usp_green, *usp_blue;
-    int red, green, blue, j;
+    const u_short *usp_red, *usp_green, *usp_blue;
+    int red, green, blue, j, lastRed, lastGreen, lastBlue, offset;
     unsigned short *df_red, *df_green, *df_blue;
+    u_char *mask_red, *mask_green, *mask_blue;
+    const u_char *lut_red, *lut_green, *lut_blue;
 
     if (m_skipLeft <= 0) {
 	if (m_block->currentViewerType() == VIEWERTYPE_COMBO)
 	    m_incr = 2;
 	else m_incr = 1;
 	ucp = m_waterfallPixels;
-	usp_red = m_imageBuffer + m_frameWidthSamples +
+	usp_red = image + m_frameWidthSamples +
 	    (m_block->currentRedBand() - 1) * m_frameWidthSamples;
-	usp_green = m_imageBuffer + m_frameWidthSamples +
+	usp_green = image + m_frameWidthSamples +
 	    (m_block->currentGreenBand() - 1) * m_frameWidthSamples;
-	usp_blue = m_imageBuffer + m_frameWidthSamples +
+	usp_blue = image + m_frameWidthSamples +
 	    (m_block->currentBlueBand() - 1) * m_frameWidthSamples;
-	df_red = m_darkFrame + m_frameWidthSamples +
+	offset = m_frameWidthSamples +
 	    (m_block->currentRedBand() - 1) * m_frameWidthSamples;
-	df_green = m_darkFrame + m_frameWidthSamples +
+	df_red = m_darkFrame + offset;
+	mask_red = m_darkMask + offset;
+	offset = m_frameWidthSamples +
 	    (m_block->currentGreenBand() - 1) * m_frameWidthSamples;
-	df_blue = m_darkFrame + m_frameWidthSamples +
+	df_green = m_darkFrame + offset;
+	mask_green = m_darkMask + offset;
+	offset = m_frameWidthSamples +
 	    (m_block->currentBlueBand() - 1) * m_frameWidthSamples;
+	df_blue = m_darkFrame + offset;
+	mask_blue = m_darkMask + offset;
+	lastRed = lastGreen = lastBlue = 0;
+	lut_red = m_stretchRed->acquire();
+	lut_green = m_stretchGreen->acquire();
+	lut_blue = m_stretchBlue->acquire();
+	Glib::Mutex::Lock lock(m_darkMutex);
 	for (j = m_frameWidthSamples;j > 0;j-=m_incr) {
 	    red = *usp_red;
 	    green = *usp_green;
 	    blue = *usp_blue;
 	    if (m_block->currentDarkSubOption() == DARKSUBOPTION_YES) {
-		red -= *df_red;
-		if (red < 0) red = 0;
-		green -= *df_green;
-		if (green < 0) green = 0;
-		blue -= *df_blue;
-		if (blue < 0) blue = 0;
+		if (*mask_red)
+		    red = lastRed;
+		else {
+		    red -= *df_red;
+		    if (red < 0) red = 0;
+		}
+		if (*mask_green)
+		    green = lastGreen;
+		else {
+		    green -= *df_green;
+		    if (green < 0) green = 0;
+		}
+		if (*mask_blue)
+		    blue = lastBlue;
+		else {
+		    blue -= *df_blue;
+		    if (blue < 0) blue = 0;
+		}
+		lastRed = red;
+		lastGreen = green;
+		lastBlue = blue;
 	    }
-	    *ucp++ = m_stretchLUT[red];
-	    *ucp++ = m_stretchLUTGreen[green];
-	    *ucp++ = m_stretchLUTBlue[blue];
+	    *ucp++ = lut_red[red];
+	    *ucp++ = lut_green[green];
+	    *ucp++ = lut_blue[blue];
 	    usp_red += m_incr;
 	    usp_green += m_incr;
 	    usp_blue += m_incr;
 	    df_red += m_incr;
 	    df_green += m_incr;
 	    df_blue += m_incr;
+	    mask_red += m_incr;
+	    mask_green += m_incr;
+	    mask_blue += m_incr;
 	}
+	lock.release();
+	m_stretchRed->release(lut_red);
+	m_stretchGreen->release(lut_green);
+	m_stretchBlue->release(lut_blue);
 #if defined(LINETEST)
 	ucp = m_waterfallPixels;
 	*(ucp+3) = *(ucp+5) = 0;
@@ -2891,7 +3431,7 @@ void DisplayTab::displayWaterfallLine(void)
 	*ucp = *(ucp+2) = 0;
 	*(ucp+1) = 255;
 #endif
-	m_refreshWaterfallDisplay();
+	m_imageDisplay.drawLine(m_waterfallPixels, m_frameWidthSamples / m_incr);
 
 	m_skipLeft = m_block->currentDowntrackSkip();
     }
@@ -3070,18 +3610,34 @@ void DisplayTab::writeSerialStringForColor(StatusDisplay::color_t color,
 }
 
 
-void DisplayTab::frameUpdateWork(void)
+bool DisplayTab::displayRefreshWork(void)
 {
-    m_imageDisplay.displayFrame(m_framePixels, (m_frameHeightLines-1) / m_incr,
-	m_frameWidthSamples / m_incr, (m_block->currentRedBand()-1) / m_incr,
-	(m_block->currentGreenBand()-1) / m_incr,
-	(m_block->currentBlueBand()-1) / m_incr);
-}
+    bool frame, waterfall;
 
+	/* show whatever the display stage has drawn since last time.  any
+	   number of waterfall lines go in one redraw, and only the newest
+	   frame is ever on the surface.  indicators and the nav display
+	   likewise catch up once per tick however often they change */
 
-void DisplayTab::waterfallUpdateWork(void)
-{
-    m_imageDisplay.displayLine(m_waterfallPixels, m_frameWidthSamples / m_incr);
+    if (m_indicatorsDirty) {
+	m_indicatorsDirty = 0;
+	indicatorUpdateWork();
+    }
+    if (m_navDisplayDirty) {
+	m_navDisplayDirty = 0;
+	navDisplayUpdateWork();
+    }
+
+    m_imageDisplay.takeUpdates(&frame, &waterfall);
+    if (frame)
+	m_imageDisplay.displayFrame((m_frameHeightLines-1 + m_incr-1) / m_incr,
+	    (m_frameWidthSamples + m_incr-1) / m_incr,
+	    (m_block->currentRedBand()-1) / m_incr,
+	    (m_block->currentGreenBand()-1) / m_incr,
+	    (m_block->currentBlueBand()-1) / m_incr);
+    if (waterfall)
+	m_imageDisplay.displayWaterfall();
+    return true;
 }
 
 
@@ -3105,6 +3661,7 @@ void DisplayTab::diagsUpdateWork(void)
     static int nextValue = 0;
     static double sum = 0.0;
     char buf[20];
+    int i;
 
     (void)gettimeofday(&currentTime, NULL);
     if (lastTime.tv_sec != 0) {
@@ -3142,6 +3699,16 @@ void DisplayTab::diagsUpdateWork(void)
 	m_diagTab->setFPGASerialPortCtl(m_fpgaSerialPortCtl);
 	m_diagTab->setFPGABufferDepth(m_fpgaBufferDepth);
 	m_diagTab->setFPGAMaxBuffersUsed(m_fpgaMaxBuffersUsed);
+	for (i=0;i < NUM_PIPELINE_STAGES;i++)
+	    m_diagTab->setPipelineStats(i, m_stageStats[i].depth,
+		m_stageStats[i].maxDepth, m_stageStats[i].avgLatencyMs,
+		m_stageStats[i].maxLatencyMs, m_stageStats[i].dropped);
+	m_diagTab->setRawWriterStats(m_rawWriterStats->mbPerSec,
+	    m_rawWriterStats->p50LatencyMs, m_rawWriterStats->p99LatencyMs,
+	    m_rawWriterStats->maxLatencyMs);
+	for (i=0;i < NUM_FRAME_LATENCIES;i++)
+	    m_diagTab->setFrameLatencyStats(i, &m_latencyNow[i],
+		&m_latencyMinute[i]);
     }
 
     lastTime = currentTime;
@@ -3286,27 +3853,53 @@ void DisplayTab::recordButtonWork(int userInvoked)
 }
 
 
-int DisplayTab::writeImageFrame(void)
+int DisplayTab::writeImageFrame(FrameHandle *h)
 {
+    const u_short *image = h->pixels;
     char msg[MAX_ERROR_LEN];
+    u_int64_t t0;
+
+	/* the write itself happens later on the writer's threads, so a
+	   failure shows up on some subsequent frame */
 
-    if (fwrite(m_imageBuffer, m_frameWidthSamples * sizeof(short),
-		(unsigned)m_frameHeightLines, m_imageFP) !=
-	    (unsigned)m_frameHeightLines) {
-	(void)sprintf(msg, "Image write failed -- is filesystem full?");
+    t0 = traceStart();
+    if (m_imageWriter->isOpen() && m_imageWriter->writeFrame(image) == -1) {
+	(void)sprintf(msg, "Image write failed -- is filesystem full? (%s)",
+	    strerror(errno));
 	error(msg);
 	return -1;
     }
+    if (m_cmpWriter->isOpen() && m_cmpWriter->writeFrame(image) == -1) {
+	(void)sprintf(msg, "Compressed image write failed -- is filesystem "
+	    "full? (%s)", strerror(errno));
+	error(msg);
+	return -1;
+    }
+
+	/* the hash lanes hold the frame until they've got to it */
+
+    m_hasher->addFrame(h);
+    traceEnd(TRACE_RECORD, t0);
+    m_latencyHists[FRAME_LATENCY_WRITE]->record(pipelineNow() -
+	h->acquireTime);
     m_framesWritten++;
+
+	/* bring the header up to what's known to be on disk, in case we
+	   never get to close */
+
+    if (m_imageWriter->isOpen() &&
+	    m_framesWritten % m_hdrCheckpointFrames == 0)
+	writeImageHeader(m_imageWriter->framesWritten());
     return 0;
 }
 
 
-int DisplayTab::writeFlightlineGPSData(void)
+int DisplayTab::writeFlightlineGPSData(const u_short *image)
 {
     static int suppressGPSErrors = 0;
 
-    if (writeDataFromLine1(m_gpsFP, GPS_IMAGE_OFFSET, MAX_GPSDATA_BYTES,
+    if (writeDataFromLine1(m_gpsFP, image, GPS_IMAGE_OFFSET,
+	    MAX_GPSDATA_BYTES,
 	    "Write of flight-line GPS data failed.", &suppressGPSErrors,
 	    0) == -1)
 	return -1;
@@ -3314,11 +3907,12 @@ int DisplayTab::writeFlightlineGPSData(void)
 }
 
 
-int DisplayTab::writePPSData(void)
+int DisplayTab::writePPSData(const u_short *image)
 {
     static int suppressPPSErrors = 0;
 
-    if (writeDataFromLine1(m_ppsFP, PPS_IMAGE_OFFSET, MAX_PPSDATA_BYTES,
+    if (writeDataFromLine1(m_ppsFP, image, PPS_IMAGE_OFFSET,
+	    MAX_PPSDATA_BYTES,
 	    "Write of flight-line PPS data failed.", &suppressPPSErrors,
 	    0) == -1)
 	return -1;
@@ -3326,33 +3920,36 @@ int DisplayTab::writePPSData(void)
 }
 
 
-void DisplayTab::writeAllgpsData(void)
+void DisplayTab::writeAllgpsData(const u_short *image)
 {
     static int suppressAllgpsErrors = 0;
 
-    (void)writeDataFromLine1(m_allgpsFP, GPS_IMAGE_OFFSET, MAX_GPSDATA_BYTES,
+    (void)writeDataFromLine1(m_allgpsFP, image, GPS_IMAGE_OFFSET,
+	MAX_GPSDATA_BYTES,
 	"Write to end-to-end GPS file failed.", &suppressAllgpsErrors, 0);
 }
 
 
-void DisplayTab::writeAllppsData(void)
+void DisplayTab::writeAllppsData(const u_short *image)
 {
     static int suppressAllppsErrors = 0;
 
-    (void)writeDataFromLine1(m_allppsFP, PPS_IMAGE_OFFSET, MAX_PPSDATA_BYTES,
+    (void)writeDataFromLine1(m_allppsFP, image, PPS_IMAGE_OFFSET,
+	MAX_PPSDATA_BYTES,
 	"Write to end-to-end PPS file failed.", &suppressAllppsErrors, 1);
 }
 
 
-int DisplayTab::writeDataFromLine1(FILE *fp, int imageOffset,
-    int maxByteCount, const char *failMsg, int *suppression_p, int flush)
+int DisplayTab::writeDataFromLine1(FILE *fp, const u_short *image,
+    int imageOffset, int maxByteCount, const char *failMsg,
+    int *suppression_p, int flush)
 {
     char msg[MAX_ERROR_LEN];
-    u_short *usp;
+    const u_short *usp;
     u_short magic, wordCount;
 
     if (fp != NULL) {
-	usp = m_imageBuffer + imageOffset / sizeof(short);
+	usp = image + imageOffset / sizeof(short);
 	magic = *usp++;
 	if (magic != 0xDEAD) {
 	    wordCount = *usp++;
@@ -3522,10 +4119,7 @@ void DisplayTab::enterDark1CalState(void)
 	writeSerialStringForColor(StatusDisplay::COLOR_YELLOW, "RE");
     m_app->setOBC(OBC_DARK1);
 
-    m_framesUntilDark = appFrame::fb->getFrameRateHz() * OBC_SETTLING_TIME_SECS;
-    memset(m_darkFrameAccumulation, 0,
-	m_frameWidthSamples * m_frameHeightLines * sizeof(int));
-    m_darkFramesAccumulated = 0;
+    startDarkModel(-1, 1);
 }
 
 
@@ -3564,10 +4158,7 @@ void DisplayTab::enterDark2CalState(void)
 	    m_mostRecentOBCMode == OBC_AUTO)
 	m_app->setOBC(OBC_DARK2);
 
-    m_framesUntilDark = appFrame::fb->getFrameRateHz() * OBC_SETTLING_TIME_SECS;
-    memset(m_darkFrameAccumulation, 0,
-	m_frameWidthSamples * m_frameHeightLines * sizeof(int));
-    m_darkFramesAccumulated = 0;
+    startDarkModel(-1, 1);
 }
 
 
@@ -3629,7 +4220,16 @@ void DisplayTab::enterIdleState(void)
 
     closeFiles(&closeTime);
     if (m_stopIsAbort) {
-	(void)unlink(m_currentRecording.imagepath);
+	if (m_swCompression != SWCOMPRESSION_ONLY)
+	    m_imageWriter->removeFiles();
+	if (m_swCompression != SWCOMPRESSION_OFF)
+	    m_cmpWriter->removeFile();
+	if (m_manifest == MANIFESTOPTION_ON)
+	    m_hasher->removeFile();
+	m_quicklookMutex.lock();
+	if (m_quicklookPath[0] != '\0')
+	    (void)unlink(m_quicklookPath);
+	m_quicklookMutex.unlock();
 	(void)unlink(m_currentRecording.imagehdrpath);
 	(void)unlink(m_currentRecording.ppspath);
 	(void)unlink(m_currentRecording.gpspath);
@@ -3676,7 +4276,7 @@ void DisplayTab::enterIdleState(void)
 	fflush(m_logFP);
 	fflush(m_allgpsFP);
 	fflush(m_allppsFP);
-	fflush(m_diagsFP);
+	m_diagsRecorder->flush();
     }
 }
 
@@ -3738,103 +4338,72 @@ void DisplayTab::saveStateToLog(void)
 }
 
 
-void DisplayTab::saveCSVHeader(void)
+void DisplayTab::saveStateToDiags(void)
 {
-    int i;
-
-    (void)fprintf(m_diagsFP, "Time,");
-    (void)fprintf(m_diagsFP, "Imager light,");
-    (void)fprintf(m_diagsFP, "GPS Comm light,");
-    (void)fprintf(m_diagsFP, "FPIE PPS light,");
-    (void)fprintf(m_diagsFP, "Msg 3 light,");
-    (void)fprintf(m_diagsFP, "CPU light,");
-    (void)fprintf(m_diagsFP, "Temp light,");
-    (void)fprintf(m_diagsFP, "Air Nav light,");
-    (void)fprintf(m_diagsFP, "GPS Valid light,");
-    (void)fprintf(m_diagsFP, "FPGA PPS light,");
-    (void)fprintf(m_diagsFP, "Mount light,");
-    (void)fprintf(m_diagsFP, "FMS light,");
-    (void)fprintf(m_diagsFP, "Alpha Data frame count,");
-    (void)fprintf(m_diagsFP, "Alpha Data frames dropped,");
-    (void)fprintf(m_diagsFP, "Max Alpha Data frame backlog,");
-    (void)fprintf(m_diagsFP, "Msg3 count,");
-    (void)fprintf(m_diagsFP, "GPS count,");
-    for (i=0;i < m_numSensors;i++)
-	(void)fprintf(m_diagsFP, "%s,", m_sensorNames[i]);
-    (void)fprintf(m_diagsFP, "FPGA frame count,");
-    (void)fprintf(m_diagsFP, "FPGA PPS count,");
-    (void)fprintf(m_diagsFP, "FPGA 81ff count,");
-    (void)fprintf(m_diagsFP, "FPGA frames dropped,");
-    (void)fprintf(m_diagsFP, "FPGA serial errors,");
-    (void)fprintf(m_diagsFP, "FPGA serial port control word,");
-    (void)fprintf(m_diagsFP, "Local frame count,");
-    (void)fprintf(m_diagsFP, "FPGA buffer depth,");
-    (void)fprintf(m_diagsFP, "FPGA max buffers used,");
-    (void)fprintf(m_diagsFP, "Latitude,");
-    (void)fprintf(m_diagsFP, "Longitude,");
-    (void)fprintf(m_diagsFP, "Altitude,");
-    (void)fprintf(m_diagsFP, "Heading,");
-    (void)fprintf(m_diagsFP, "Velocity north,");
-    (void)fprintf(m_diagsFP, "Velocity east,");
-    (void)fprintf(m_diagsFP, "Velocity up,");
-    (void)fprintf(m_diagsFP, "Velocity magnitude,");
-    (void)fprintf(m_diagsFP, "\n");
-}
-
-
-void DisplayTab::saveStateToCSV(void)
-{
-    time_t nowSecs;
-    struct tm *nowStruct;
-    char nowASCII[80];
-    int i;
-
-    (void)time(&nowSecs);
-    nowStruct = gmtime(&nowSecs);
-    (void)strftime(nowASCII, sizeof(nowASCII), "%H:%M:%S", nowStruct);
-    (void)fprintf(m_diagsFP, "%s,", nowASCII);
-
-    (void)fprintf(m_diagsFP, "%s,", m_imagerCheckDisplay.color());
-    (void)fprintf(m_diagsFP, "%s,", m_gpsCommCheckDisplay.color());
-    (void)fprintf(m_diagsFP, "%s,", m_fpiePPSCheckDisplay.color());
-    (void)fprintf(m_diagsFP, "%s,", m_msg3CheckDisplay.color());
-    (void)fprintf(m_diagsFP, "%s,", m_cpuCheckDisplay.color());
-    (void)fprintf(m_diagsFP, "%s,", m_tempCheckDisplay.color());
-    (void)fprintf(m_diagsFP, "%s,", m_airNavCheckDisplay.color());
-    (void)fprintf(m_diagsFP, "%s,", m_gpsValidCheckDisplay.color());
-    (void)fprintf(m_diagsFP, "%s,", m_fpgaPPSCheckDisplay.color());
-    (void)fprintf(m_diagsFP, "%s,", m_mountCheckDisplay.color());
-    (void)fprintf(m_diagsFP, "%s,", m_fmsCheckDisplay.color());
-
-    (void)fprintf(m_diagsFP, "%d,", m_frameCount);
-    (void)fprintf(m_diagsFP, "%d,", m_framesDropped);
-    (void)fprintf(m_diagsFP, "%d,", m_maxFrameBacklog);
-    (void)fprintf(m_diagsFP, "%d,", m_msg3Count);
-    (void)fprintf(m_diagsFP, "%d,", m_gpsCount);
-    for (i=0;i < m_numSensors;i++)
-	(void)fprintf(m_diagsFP, "%.1f,", m_sensorValues[i]);
-    (void)fprintf(m_diagsFP, "%d,", m_fpgaFrameCount);
-    (void)fprintf(m_diagsFP, "%d,", m_fpgaPPSCount);
-    (void)fprintf(m_diagsFP, "%d,", m_fpga81ffCount);
-    (void)fprintf(m_diagsFP, "%d,", m_fpgaFramesDropped);
-    (void)fprintf(m_diagsFP, "%d,", m_fpgaSerialErrors);
-    (void)fprintf(m_diagsFP, "%d,", m_fpgaSerialPortCtl);
-    (void)fprintf(m_diagsFP, "%d,", m_localFrameCount);
-    (void)fprintf(m_diagsFP, "%d,", m_fpgaBufferDepth);
-    (void)fprintf(m_diagsFP, "%d,", m_fpgaMaxBuffersUsed);
-
-    (void)fprintf(m_diagsFP, "%f,", m_lastLat);
-    (void)fprintf(m_diagsFP, "%f,", m_lastLon);
-    (void)fprintf(m_diagsFP, "%f,", m_lastAltitude);
-    (void)fprintf(m_diagsFP, "%f,", m_lastHeading);
-    (void)fprintf(m_diagsFP, "%f,", m_lastVelNorth);
-    (void)fprintf(m_diagsFP, "%f,", m_lastVelEast);
-    (void)fprintf(m_diagsFP, "%f,", m_lastVelUp);
-    (void)fprintf(m_diagsFP, "%f,", m_lastVelMag);
-    (void)fprintf(m_diagsFP, "\n");
-
-    if (appFrame::headless)
-	(void)fflush(m_diagsFP);
+    diag_record_t record;
+    struct timeval now;
+    int i, numTemps;
+
+	/* the sensor names are known by the first sample, which comes with
+	   the first diags update */
+
+    m_diagsRecorder->setSensorNames(m_numSensors, m_sensorNames);
+
+    (void)memset(&record, 0, sizeof(record));
+    (void)gettimeofday(&now, NULL);
+    record.time = now.tv_sec + now.tv_usec / 1000000.0;
+
+    record.lights[0] = m_imagerCheckDisplay.colorCode();
+    record.lights[1] = m_gpsCommCheckDisplay.colorCode();
+    record.lights[2] = m_fpiePPSCheckDisplay.colorCode();
+    record.lights[3] = m_msg3CheckDisplay.colorCode();
+    record.lights[4] = m_cpuCheckDisplay.colorCode();
+    record.lights[5] = m_tempCheckDisplay.colorCode();
+    record.lights[6] = m_airNavCheckDisplay.colorCode();
+    record.lights[7] = m_gpsValidCheckDisplay.colorCode();
+    record.lights[8] = m_fpgaPPSCheckDisplay.colorCode();
+    record.lights[9] = m_mountCheckDisplay.colorCode();
+    record.lights[10] = m_fmsCheckDisplay.colorCode();
+
+    record.counts[0] = m_frameCount;
+    record.counts[1] = m_framesDropped;
+    record.counts[2] = m_maxFrameBacklog;
+    record.counts[3] = m_msg3Count;
+    record.counts[4] = m_gpsCount;
+    numTemps = (m_numSensors < DIAGS_MAX_TEMPS)? m_numSensors:
+	DIAGS_MAX_TEMPS;
+    for (i=0;i < numTemps;i++)
+	record.temps[i] = m_sensorValues[i];
+    record.fpgaRegs[0] = m_fpgaFrameCount;
+    record.fpgaRegs[1] = m_fpgaPPSCount;
+    record.fpgaRegs[2] = m_fpga81ffCount;
+    record.fpgaRegs[3] = m_fpgaFramesDropped;
+    record.fpgaRegs[4] = m_fpgaSerialErrors;
+    record.fpgaRegs[5] = m_fpgaSerialPortCtl;
+    record.fpgaRegs[6] = m_localFrameCount;
+    record.fpgaRegs[7] = m_fpgaBufferDepth;
+    record.fpgaRegs[8] = m_fpgaMaxBuffersUsed;
+
+    record.nav[0] = m_lastLat;
+    record.nav[1] = m_lastLon;
+    record.nav[2] = m_lastAltitude;
+    record.nav[3] = m_lastHeading;
+    record.nav[4] = m_lastVelNorth;
+    record.nav[5] = m_lastVelEast;
+    record.nav[6] = m_lastVelUp;
+    record.nav[7] = m_lastVelMag;
+    for (i=0;i < NUM_FRAME_LATENCIES;i++) {
+	record.latencies[i][0] = m_latencyNow[i].p50Ms;
+	record.latencies[i][1] = m_latencyNow[i].p99Ms;
+	record.latencies[i][2] = m_latencyNow[i].maxMs;
+	record.latencies[i][3] = m_latencyMinute[i].p50Ms;
+	record.latencies[i][4] = m_latencyMinute[i].p99Ms;
+	record.latencies[i][5] = m_latencyMinute[i].maxMs;
+    }
+
+	/* this only queues the record; the recorder's thread writes it */
+
+    m_diagsRecorder->add(&record);
 }
 
 
@@ -3868,9 +4437,16 @@ int DisplayTab::openFiles(void)
     char imageHdrFilename[MAXPATHLEN];
     char gpsFilename[MAXPATHLEN];
     char ppsFilename[MAXPATHLEN];
+    char cmpFilename[MAXPATHLEN+sizeof(CMP_FILE_SUFFIX)];
+    char manifestFilename[MAXPATHLEN+sizeof(MANIFEST_SUFFIX)];
+    char stripeDirs[STRIPE_MAX_STRIPES][MAXPATHLEN];
+    char stripeFilenames[STRIPE_MAX_STRIPES][MAXPATHLEN];
+    char stripeDailyDir[MAXPATHLEN];
+    int numStripes, i;
     struct timeval timebuffer;
     struct tm tm_struct;
     char errorMsg[MAXPATHLEN+60];
+    double plannedSecs;
 
 	/* determine time string */
 
@@ -3915,29 +4491,68 @@ int DisplayTab::openFiles(void)
     strcat(m_currentRecording.ppsfile, "_pps");
     strcpy(m_currentRecording.ppspath, ppsFilename);
 
-	/* open files */
+	/* if striping, imagery goes to a daily dir under each stripe dir
+	   instead, with an index next to the header saying where */
 
-    m_imageFP = fopen(imageFilename, "wb");
-    if (!m_imageFP) {
-	sprintf(errorMsg, "Can't open output file \"%s\".", imageFilename);
-	error(errorMsg);
-	return -1;
+    numStripes = getStripeDirs(stripeDirs);
+    for (i=0;i < numStripes;i++) {
+	if (appFrame::makeDailyDir(stripeDirs[i], stripeDailyDir) == -1) {
+	    sprintf(errorMsg, "Can't find or create daily-data dir under "
+		"\"%s\".", stripeDirs[i]);
+	    error(errorMsg);
+	    return -1;
+	}
+	sprintf(stripeFilenames[i], "%s/%s%s_raw%s%d", stripeDailyDir,
+	    m_block->currentPrefix(), timeString, STRIPE_FILE_SUFFIX, i);
+    }
+
+	/* open files.  imagery gets preallocated for the calibration
+	   periods plus a margin for science; the writer extends it from
+	   there as needed.  if we're only keeping compressed imagery
+	   there's no _raw at all */
+
+    m_swCompression = m_block->currentSWCompressionOption();
+    plannedSecs = m_block->currentDark1CalPeriodInSecs() +
+	m_block->currentDark2CalPeriodInSecs() +
+	m_block->currentMediumCalPeriodInSecs() +
+	m_block->currentBrightCalPeriodInSecs() +
+	m_block->currentLaserCalPeriodInSecs() + RAWWRITER_EXTEND_SECS;
+    if (m_swCompression != SWCOMPRESSION_ONLY) {
+	if (m_imageWriter->open(imageFilename, stripeFilenames, numStripes,
+		m_frameWidthSamples * m_frameHeightLines * sizeof(short),
+		appFrame::fb->getFrameRateHz(), plannedSecs) == -1) {
+	    sprintf(errorMsg, "Can't open output file \"%s\".",
+		imageFilename);
+	    error(errorMsg);
+	    return -1;
+	}
+	if (!m_imageWriter->isDirect())
+	    log("Filesystem doesn't support direct I/O; recording buffered.");
+	if (numStripes > 0) {
+	    sprintf(errorMsg, "Striping imagery across %d dirs; index is "
+		"%s%s.", numStripes, m_currentRecording.imagefile,
+		STRIPE_INDEX_SUFFIX);
+	    log(errorMsg);
+	}
     }
     m_imageHdrFP = fopen(imageHdrFilename, "w");
     if (!m_imageHdrFP) {
 	sprintf(errorMsg, "Can't open output file \"%s\".", imageHdrFilename);
 	error(errorMsg);
-	fclose(m_imageFP);
-	m_imageFP = NULL;
+	(void)m_imageWriter->close();
 	return -1;
     }
+    writeImageHeader(0);
+    m_hdrCheckpointFrames = (int)(appFrame::fb->getFrameRateHz() *
+	IMAGE_HDR_CHECKPOINT_SECS);
+    if (m_hdrCheckpointFrames < 1)
+	m_hdrCheckpointFrames = 1;
     m_gpsFP = fopen(gpsFilename, "wb");
     if (!m_gpsFP) {
 	sprintf(errorMsg, "Can't open output file \"%s\".", gpsFilename);
 	error(errorMsg);
-	fclose(m_imageFP);
+	(void)m_imageWriter->close();
 	fclose(m_imageHdrFP);
-	m_imageFP = NULL;
 	m_imageHdrFP = NULL;
 	return -1;
     }
@@ -3945,44 +4560,149 @@ int DisplayTab::openFiles(void)
     if (!m_ppsFP) {
 	sprintf(errorMsg, "Can't open output file \"%s\".", ppsFilename);
 	error(errorMsg);
-	fclose(m_imageFP);
+	(void)m_imageWriter->close();
 	fclose(m_imageHdrFP);
 	fclose(m_gpsFP);
-	m_imageFP = NULL;
 	m_imageHdrFP = NULL;
 	m_gpsFP = NULL;
 	return -1;
     }
+    if (m_swCompression != SWCOMPRESSION_OFF) {
+	sprintf(cmpFilename, "%s%s", imageFilename, CMP_FILE_SUFFIX);
+	if (m_cmpWriter->open(cmpFilename, m_frameHeightLines,
+		m_frameWidthSamples) == -1) {
+	    sprintf(errorMsg, "Can't open output file \"%s\".",
+		cmpFilename);
+	    error(errorMsg);
+	    (void)m_imageWriter->close();
+	    fclose(m_imageHdrFP);
+	    fclose(m_gpsFP);
+	    fclose(m_ppsFP);
+	    m_imageHdrFP = NULL;
+	    m_gpsFP = NULL;
+	    m_ppsFP = NULL;
+	    return -1;
+	}
+    }
+    m_manifest = m_block->currentManifestOption();
+    if (m_manifest == MANIFESTOPTION_ON) {
+	sprintf(manifestFilename, "%s%s", imageFilename, MANIFEST_SUFFIX);
+	if (m_hasher->open(manifestFilename,
+		m_frameWidthSamples * m_frameHeightLines * sizeof(short)) ==
+		-1) {
+	    sprintf(errorMsg, "Can't open output file \"%s\".",
+		manifestFilename);
+	    error(errorMsg);
+	    (void)m_imageWriter->close();
+	    (void)m_cmpWriter->close();
+	    fclose(m_imageHdrFP);
+	    fclose(m_gpsFP);
+	    fclose(m_ppsFP);
+	    m_imageHdrFP = NULL;
+	    m_gpsFP = NULL;
+	    m_ppsFP = NULL;
+	    return -1;
+	}
+    }
+
+	/* the quicklook stage opens its file on its own time */
+
+    Glib::Mutex::Lock lock(m_quicklookMutex);
+    if (m_block->currentQuicklookOption() == QUICKLOOKOPTION_ON) {
+	(void)sprintf(m_quicklookPath, "%s%s", base, QUICKLOOK_SUFFIX);
+	m_quicklookActive = 1;
+	m_quicklookGeneration++;
+    }
+    else m_quicklookPath[0] = '\0';
     return 0;
 }
 
 
+void DisplayTab::writeImageHeader(int lines)
+{
+	/* the header is written when the files are opened, with no lines,
+	   and rewritten in place as the recording goes on.  the line count
+	   only grows, so each version is at least as long as the last */
+
+    rewind(m_imageHdrFP);
+    fprintf(m_imageHdrFP, "ENVI\n");
+    fprintf(m_imageHdrFP, "description= {}\n");
+    fprintf(m_imageHdrFP, "samples= %d\n", m_frameWidthSamples);
+    fprintf(m_imageHdrFP, "lines= %d\n", lines);
+    fprintf(m_imageHdrFP, "bands= %d\n", m_frameHeightLines);
+    fprintf(m_imageHdrFP, "header offset= 0\n");
+    fprintf(m_imageHdrFP, "file type= ENVI\n");
+    fprintf(m_imageHdrFP, "data type= 12\n");
+    fprintf(m_imageHdrFP, "interleave= bil\n");
+    fprintf(m_imageHdrFP, "byte order= 0\n");
+    fflush(m_imageHdrFP);
+}
+
+
 void DisplayTab::closeFiles(struct timespec *closeTime_p)
 {
     struct stat statbuf;
+    RawWriterStats stats;
+    CmpWriterStats cmpStats;
+    char msg[MAX_ERROR_LEN];
+    char indexPath[MAXPATHLEN+sizeof(STRIPE_INDEX_SUFFIX)];
+    char cmpPath[MAXPATHLEN+sizeof(CMP_FILE_SUFFIX)];
 
     if (closeTime_p)
 	closeTime_p->tv_sec = closeTime_p->tv_nsec = 0;
 
-    if (m_imageFP != NULL) {
-	if (closeTime_p != NULL && fstat(fileno(m_imageFP), &statbuf) != -1)
+    if (m_imageWriter->isOpen()) {
+	if (m_imageWriter->close() == -1) {
+	    (void)sprintf(msg, "Image write failed at close -- %s",
+		strerror(errno));
+	    error(msg);
+	}
+	m_imageWriter->getRecordingStats(&stats);
+	(void)sprintf(msg, "Imagery written at %.1f MB/s; write latency "
+	    "p50 %.1f ms, p99 %.1f ms, max %.1f ms.", stats.mbPerSec,
+	    stats.p50LatencyMs, stats.p99LatencyMs, stats.maxLatencyMs);
+	log(msg);
+	(void)sprintf(indexPath, "%s%s", m_currentRecording.imagepath,
+	    STRIPE_INDEX_SUFFIX);
+	if (closeTime_p != NULL &&
+		stat(m_imageWriter->numStripes() == 0?
+		    m_currentRecording.imagepath:indexPath, &statbuf) != -1)
 	    (void)memcpy(&closeTime_p->tv_sec, &statbuf.st_mtime,
 		sizeof(time_t));
-	fclose(m_imageFP);
-	m_imageFP = NULL;
+    }
+
+	/* with no _raw, the compressed file says when we stopped */
+
+    if (m_cmpWriter->isOpen()) {
+	if (m_cmpWriter->close() == -1) {
+	    (void)sprintf(msg, "Compressed image write failed at close -- %s",
+		strerror(errno));
+	    error(msg);
+	}
+	m_cmpWriter->getStats(&cmpStats);
+	(void)sprintf(msg, "Imagery compressed %.2f:1, %.1f ms/frame; %u of "
+	    "%u frames stored.", cmpStats.ratio, cmpStats.encodeMsPerFrame,
+	    cmpStats.storedFrames, cmpStats.frames);
+	log(msg);
+	(void)sprintf(cmpPath, "%s%s", m_currentRecording.imagepath,
+	    CMP_FILE_SUFFIX);
+	if (closeTime_p != NULL && m_swCompression == SWCOMPRESSION_ONLY &&
+		stat(cmpPath, &statbuf) != -1)
+	    (void)memcpy(&closeTime_p->tv_sec, &statbuf.st_mtime,
+		sizeof(time_t));
+    }
+
+	/* the manifest can only be finished once every frame has been
+	   hashed, which may take the lanes a moment yet */
+
+    if (m_hasher->isOpen()) {
+	if (m_hasher->close() == -1)
+	    error("Integrity manifest incomplete.");
+	else log("Integrity manifest written.");
     }
 
     if (m_imageHdrFP != NULL) {
-	fprintf(m_imageHdrFP, "ENVI\n");
-	fprintf(m_imageHdrFP, "description= {}\n");
-	fprintf(m_imageHdrFP, "samples= %d\n", m_frameWidthSamples);
-	fprintf(m_imageHdrFP, "lines= %d\n", m_framesWritten);
-	fprintf(m_imageHdrFP, "bands= %d\n", m_frameHeightLines);
-	fprintf(m_imageHdrFP, "header offset= 0\n");
-	fprintf(m_imageHdrFP, "file type= ENVI\n");
-	fprintf(m_imageHdrFP, "data type= 12\n");
-	fprintf(m_imageHdrFP, "interleave= bil\n");
-	fprintf(m_imageHdrFP, "byte order= 0\n");
+	writeImageHeader(m_framesWritten);
 	fclose(m_imageHdrFP);
 	m_imageHdrFP = NULL;
     }
@@ -3995,6 +4715,14 @@ void DisplayTab::closeFiles(struct timespec *closeTime_p)
 	fclose(m_ppsFP);
 	m_ppsFP = NULL;
     }
+
+	/* the quicklook stage closes its file when it next runs */
+
+    Glib::Mutex::Lock lock(m_quicklookMutex);
+    if (m_quicklookActive) {
+	m_quicklookActive = 0;
+	m_quicklookGeneration++;
+    }
 }
 
 
@@ -4172,15 +4900,20 @@ void DisplayTab::calcFreeSpace(const struct statfs *sb_p, double *usableSize_p,
 
 void DisplayTab::updateResourcesDisplay(void)
 {
-    int timeLeft, hrs, mins, i;
+    int timeLeft, hrs, mins, i, swCompression;
     char buf[50];
     enum { SPACE_OKAY, SPACE_WARNING, SPACE_ERROR } status;
     double imageBytesPerSecond, gpsBytesPerSecond, ppsBytesPerSecond,
 	allgpsBytesPerSecond, allppsBytesPerSecond, logBytesPerSecond, pct;
+    double cmpBytesPerSecond;
+    CmpWriterStats cmpStats;
     struct statfs dailyDirStat;
+    struct statfs stripeDirStats[STRIPE_MAX_STRIPES];
+    char stripeDirs[STRIPE_MAX_STRIPES][MAXPATHLEN];
+    int numStripes;
     static int displayBroken = 0;
     GdkColor red, green;
-    fs_descr_t fsDescrs[4];
+    fs_descr_t fsDescrs[STRIPE_MAX_STRIPES+1];
     int numFS;
 
 	/* calculate recording rates */
@@ -4193,6 +4926,18 @@ void DisplayTab::updateResourcesDisplay(void)
     allppsBytesPerSecond = (double)PPS_WORDS_PER_SECOND * sizeof(short);
     logBytesPerSecond = 0; /* placeholder */
 
+	/* compressed imagery always goes to the daily dir, next to the _raw
+	   or in place of it.  charge it at the ratio the last recording got,
+	   or at the raw rate until there's been one */
+
+    swCompression = (m_recordState == RECORD_STATE_NOT_RECORDING)?
+	m_block->currentSWCompressionOption():m_swCompression;
+    m_cmpWriter->getStats(&cmpStats);
+    cmpBytesPerSecond = (swCompression == SWCOMPRESSION_OFF)? 0.0:
+	imageBytesPerSecond / ((cmpStats.ratio > 1.0)? cmpStats.ratio:1.0);
+    if (swCompression == SWCOMPRESSION_ONLY)
+	imageBytesPerSecond = 0.0;
+
 	/* if resources can't be measured for some reason, do nothing.  this
 	   should never happen */
 
@@ -4216,14 +4961,32 @@ void DisplayTab::updateResourcesDisplay(void)
 	/* otherwise... */
 
     else {
-	    /* build up filesystem list */
+	    /* build up filesystem list.  if striping, imagery is spread
+	   evenly over the stripe dirs and everything else stays in the
+	   daily dir.  stripes sharing a filesystem add up */
 
 	numFS = 0;
 	(void)memset(fsDescrs, 0, sizeof(fsDescrs));
-	buildUpFilesystemList(fsDescrs, &numFS, &dailyDirStat,
-	    imageBytesPerSecond + gpsBytesPerSecond + ppsBytesPerSecond +
-		allgpsBytesPerSecond + allppsBytesPerSecond +
-		logBytesPerSecond);
+	numStripes = getStripeDirs(stripeDirs);
+	for (i=0;i < numStripes;i++)
+	    if (statfs(stripeDirs[i], &stripeDirStats[i]) == -1) {
+		numStripes = 0;
+		break;
+	    }
+	if (numStripes == 0)
+	    buildUpFilesystemList(fsDescrs, &numFS, &dailyDirStat,
+		imageBytesPerSecond + cmpBytesPerSecond + gpsBytesPerSecond +
+		    ppsBytesPerSecond + allgpsBytesPerSecond +
+		    allppsBytesPerSecond + logBytesPerSecond);
+	else {
+	    buildUpFilesystemList(fsDescrs, &numFS, &dailyDirStat,
+		cmpBytesPerSecond + gpsBytesPerSecond + ppsBytesPerSecond +
+		    allgpsBytesPerSecond + allppsBytesPerSecond +
+		    logBytesPerSecond);
+	    for (i=0;i < numStripes && imageBytesPerSecond > 0.0;i++)
+		buildUpFilesystemList(fsDescrs, &numFS, &stripeDirStats[i],
+		    imageBytesPerSecond / numStripes);
+	}
 
 	    /* figure out how much time we have left on each filesystem */
 
@@ -4334,6 +5097,32 @@ void DisplayTab::buildUpFilesystemList(DisplayTab::fs_descr_t *fsDescrs,
 }
 
 
+int DisplayTab::getStripeDirs(char (*dirs)[MAXPATHLEN])
+{
+    char *list, *p, *q;
+    int n;
+
+	/* stripe dirs setting is a colon-separated list; empty means we're
+	   not striping */
+
+    list = m_block->currentStripeDirs();
+    n = 0;
+    for (p=list;*p != '\0' && n < STRIPE_MAX_STRIPES;p=q) {
+	if ((q=strchr(p, ':')) == NULL)
+	    q = p + strlen(p);
+	if (q > p && q - p < MAXPATHLEN) {
+	    (void)strncpy(dirs[n], p, (size_t)(q - p));
+	    dirs[n][q - p] = '\0';
+	    n++;
+	}
+	if (*q == ':')
+	    q++;
+    }
+    delete[] list;
+    return n;
+}
+
+
 void DisplayTab::onShutterCombo(void)
 {
     int selection;
@@ -4466,16 +5255,12 @@ void DisplayTab::onOBCControlCombo(void)
 	else m_app->setOBC(obcControlCodes[selection]);
 
 	    /* if we're using a dark cal mode, prepare to acquire dark frames
- 	       which we can save for later subtraction.  wait for 100 ms worth
-	       of frames before starting accumulation */
-
-	if (obcControlCodes[selection] == OBC_DARK1) {
-	    m_framesUntilDark = appFrame::fb->getFrameRateHz() *
-		OBC_SETTLING_TIME_SECS;
-	    memset(m_darkFrameAccumulation, 0,
-		m_frameWidthSamples * m_frameHeightLines * sizeof(int));
-	    m_darkFramesAccumulated = 0;
-	}
+ 	       which we can save for later subtraction.  we don't know how
+	       long the shutter will stay closed, so take only a short run */
+
+	if (obcControlCodes[selection] == OBC_DARK1)
+	    startDarkModel((int)(appFrame::fb->getFrameRateHz() *
+		DARK_ACCUM_TIME_SECS + 0.5), 0);
 
 	    /* note the current OBC mode */
 
@@ -4537,7 +5322,20 @@ void DisplayTab::stopThreadsAndTimers(void)
     if (m_dataThread)
 	m_dataThread->join();
 
+	/* shut the pipeline down from the front, so everything acquired so
+	   far makes it through processing and gets written */
+
+    m_framePool->shutdown();
+    m_processStage->stop();
+    m_recordStage->stop();
+    m_displayStage->stop();
+    m_darkStage->stop();
+    m_statsStage->stop();
+    m_quicklookStage->stop();
+    m_hasher->stop();
+
     m_resourcesCheckTimer.disconnect();
+    m_displayRefreshTimer.disconnect();
     m_mountHandler.disconnect();
 }
 
@@ -4740,67 +5538,38 @@ void DisplayTab::showMsg(Glib::ustring msg, Glib::ustring secondaryMsg,
 }
 
 
-void DisplayTab::add3501(u_short *msg)
+void DisplayTab::add3501(const nav_solution_t *solution)
 {
-    u_short *usp;
-    int itemp;
     double pitchAndRoll[2];
 
-	/* extract and plot lat and lon */
-
-    usp = msg + 9;
-    memcpy(&itemp, usp, sizeof(int));
-    m_lastLat = itemp / pow(2.0, 31.0) * 180;
-
-    usp += 2;
-    memcpy(&itemp, usp, sizeof(int));
-    m_lastLon = itemp / pow(2.0, 31.0) * 180;
+	/* plot lat and lon */
 
+    m_lastLat = solution->latDeg;
+    m_lastLon = solution->lonDeg;
     if (!appFrame::headless)
 	m_plotsTab->addLatAndLon(m_lastLat, m_lastLon);
 
-	/* extract and plot altitude */
-
-    usp = msg + 13;
-    memcpy(&itemp, usp, sizeof(int));
-    m_lastAltitude = itemp / pow(2.0, 16.0); /* convert from fixed point */
-    m_lastAltitude = m_lastAltitude * 39.3701 / 12; /* m to ft */
+	/* plot altitude */
 
+    m_lastAltitude = solution->altitudeM * 39.3701 / 12; /* m to ft */
     if (!appFrame::headless)
 	m_plotsTab->addAltitude(m_lastAltitude);
 
-	/* extract and plot velocity */
-
-    usp = msg + 15;
-    memcpy(&itemp, usp, sizeof(int));
-    m_lastVelNorth = itemp / pow(2.0, 21.0) / 0.514444; /* convert to knots */
-
-    usp += 2;
-    memcpy(&itemp, usp, sizeof(int));
-    m_lastVelEast = itemp / pow(2.0, 21.0) / 0.514444; /* convert to knots */
-
-    usp += 2;
-    memcpy(&itemp, usp, sizeof(int));
-    m_lastVelUp = itemp / pow(2.0, 21.0) / 0.514444; /* convert to knots */
+	/* plot velocity */
 
+    m_lastVelNorth = solution->velNorthMps / 0.514444; /* convert to knots */
+    m_lastVelEast = solution->velEastMps / 0.514444;
+    m_lastVelUp = solution->velUpMps / 0.514444;
     m_lastVelMag = sqrt(m_lastVelNorth * m_lastVelNorth +
 	m_lastVelEast * m_lastVelEast + m_lastVelUp * m_lastVelUp);
     if (!appFrame::headless)
 	m_plotsTab->addVelocity(m_lastVelMag);
 
-	/* extract and plot pitch, roll, and heading */
-
-    usp = msg + 21;
-    memcpy(&itemp, usp, sizeof(int));
-    pitchAndRoll[0] = itemp / pow(2.0, 31.0) * 180;
-
-    usp += 2;
-    memcpy(&itemp, usp, sizeof(int));
-    pitchAndRoll[1] = itemp / pow(2.0, 31.0) * 180;
+	/* plot pitch, roll, and heading */
 
-    usp += 2;
-    memcpy(&itemp, usp, sizeof(int));
-    m_lastHeading = itemp / pow(2.0, 31.0) * 180;
+    pitchAndRoll[0] = solution->pitchDeg;
+    pitchAndRoll[1] = solution->rollDeg;
+    m_lastHeading = solution->headingDeg;
 
     if (!appFrame::headless) {
 	m_pitchAndRollPlots->addPoint(pitchAndRoll);
@@ -15,20 +15,13 @@
    author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */ 
 
 #include "dispatcher.h"
+#include "navdecoder.h"
 
-#define GPS_MSG_3_WORDS	    	82
-#define GPS_MSG_3500_WORDS	22
-#define GPS_MSG_3501_WORDS	28
-#define GPS_MSG_3510_WORDS	27
-#define GPS_MSG_3512_WORDS	22
-#define GPS_MSG_3623_WORDS      123
-#define GPS_MSG_MAX_WORDS	123
 #define GPS_WORDS_PER_SECOND    (GPS_MSG_3_WORDS + \
 				    GPS_MSG_3500_WORDS + \
 				    10 * GPS_MSG_3501_WORDS + \
 				    100 * GPS_MSG_3512_WORDS + \
 				    GPS_MSG_3623_WORDS)
-#define GPS_MAGIC_NUMBER	0x81ff
 #define GPS_MSG_3500_CHECKSUM	(~((GPS_MAGIC_NUMBER + 3500 + \
 				    (GPS_MSG_3500_WORDS-6) + 0x8000) & \
 				    0xffff) + 1)
@@ -45,14 +38,6 @@
 
 #define PPS_WORDS_PER_SECOND	13 /* from Didier's memo */
 
-#define TIMESTAMP_IMAGE_OFFSET		4
-#define OBC_STATE_IMAGE_OFFSET		640
-#define PPS_IMAGE_OFFSET		644
-#define MAX_PPSDATA_BYTES		40
-#define GPS_IMAGE_OFFSET		680
-#define MAX_GPSDATA_BYTES		600
-#define LOCAL_FRAME_COUNT_IMAGE_OFFSET	1248
-
 #define RECORD_BUTTON_HEIGHT	30
 #define RECORD_BUTTON_WIDTH	150
 #define STOP_BUTTON_HEIGHT	30
@@ -63,8 +48,85 @@
 #define NON_COMBO_MARGIN	15
 
 #define OBC_SETTLING_TIME_SECS  0.2
+
+    /* longest the data thread waits for a frame before doing housekeeping
+       (DIO toggle, headless serial), and how often the slower housekeeping
+       runs */
+
+#define DATA_WAIT_TIMEOUT_USECS		10000
+#define DIAGS_UPDATE_INTERVAL_USECS	1000000
+#define DIO_REATTACH_INTERVAL_USECS	5000000
 #define DARK_ACCUM_TIME_SECS	0.7
 
+    /* while recording, the image header is rewritten about this often
+       with the frames known to be on disk, so a recording that never
+       closes still has a header that's good that far */
+
+#define IMAGE_HDR_CHECKPOINT_SECS	5
+
+    /* the dark model is finished once frames stop coming for this long */
+
+#define DARK_IDLE_FINISH_USECS	250000
+
+    /* the quicklook stage picks up a start or stop of recording within
+       this long even if no frames are coming */
+
+#define QUICKLOOK_IDLE_USECS	200000
+
+    /* the frame view and waterfall are drawn as frames come in but only
+       shown this often, however high the frame rate.  the indicators and
+       nav display are brought up to date on the same tick */
+
+#define DISPLAY_REFRESH_MSECS	33
+
+    /* automatic stretch.  each LUT runs from the low to the high
+       percentile of its channel's recent samples (see bandstats.h), and
+       is only rebuilt once either end has drifted by more than the given
+       fraction of its range.  the check is made every few frames.
+       equalized curves, auto or not, are rebuilt from the latest
+       histograms every so often regardless */
+
+#define STRETCH_LOW_PERCENTILE	2.0
+#define STRETCH_HIGH_PERCENTILE	98.0
+#define STRETCH_DRIFT_FRACTION	0.05
+#define STRETCH_CHECK_FRAMES	4
+#define STRETCH_EQUALIZE_FRAMES	16
+
+    /* capture-pipeline stages downstream of acquisition (see pipeline.h) */
+
+#define PIPELINE_STAGE_PROCESS	0
+#define PIPELINE_STAGE_RECORD	1
+#define PIPELINE_STAGE_DISPLAY	2
+#define PIPELINE_STAGE_DARK	3
+#define PIPELINE_STAGE_STATS	4
+#define PIPELINE_STAGE_QUICKLOOK	5
+#define PIPELINE_STAGE_HASH	6
+#define NUM_PIPELINE_STAGES	7
+
+    /* per-frame latency histograms (see latencyhist.h), rolled over with
+       each diags update */
+
+#define FRAME_LATENCY_PICKUP	0	/* off the card to the data thread */
+#define FRAME_LATENCY_WRITE	1	/* data thread to frame recorded */
+#define FRAME_LATENCY_JITTER	2	/* arrival spacing less frame period */
+#define NUM_FRAME_LATENCIES	3
+
+class FramePool;
+class PipelineStage;
+struct FrameHandle;
+class DarkModel;
+class BandStats;
+class StretchLUT;
+struct PipelineStats;
+struct RawWriterStats;
+class LatencyHistogram;
+struct LatencySummary;
+class DiagsRecorder;
+class StripedImageWriter;
+class QuicklookWriter;
+class CompressedImageWriter;
+class FrameHasher;
+
 #define DIO_DEVICES_REQUIRED 1  // change this to 1 if only one device
 #define DIO_BITS_PER_BYTE 8
 #define MAX_DIO_BYTES 4     // a modest little assumption for convenience
@@ -81,6 +143,7 @@ public:
     StatusDisplay();
     void setColor(color_t color);
     char *color(void);
+    color_t colorCode(void) const { return m_color; }
     virtual ~StatusDisplay() { }
 protected:
     color_t m_color;
@@ -93,9 +156,13 @@ class ImageDisplay: public Gtk::DrawingArea
 public:
     ImageDisplay(int fh, int fw, DisplayTab *dt);
     void reset(void);
-    void displayFrame(const u_char *image, int height, int width,
-        int redBand, int greenBand, int blueBand);
-    void displayLine(const u_char *image, u_short width);
+    void drawFrame(const u_short *image, const u_short *dark,
+	const u_char *mask, const u_char *lut, int darkSub, int incr);
+    void drawLine(const u_char *image, u_short width);
+    void takeUpdates(bool *frame_p, bool *waterfall_p);
+    void displayFrame(int height, int width, int redBand, int greenBand,
+	int blueBand);
+    void displayWaterfall(void);
     void clearDataSeen() { m_dataSeen = false; }
     ~ImageDisplay();
 protected:
@@ -103,11 +170,15 @@ protected:
     int m_frameHeightLines;
     int m_frameWidthSamples;
     Cairo::RefPtr<Cairo::ImageSurface> m_surface;
-    Cairo::RefPtr<Cairo::Context> m_context;
-    Glib::RefPtr<Gdk::Pixbuf> m_pixbuf;
+    Glib::Mutex m_surfaceMutex;
+    int m_renderLevel;
     int m_currentWaterfallHeight;
+    int m_waterfallHead;	/* surface row holding the newest line */
+    bool m_frameDirty, m_waterfallDirty;
     bool m_dataSeen;
     int m_redBand, m_greenBand, m_blueBand;
+    void paintWaterfall(Cairo::RefPtr<Cairo::Context> cr, double x,
+	double width);
     virtual bool on_expose_event(GdkEventExpose *event);
 };
 
@@ -205,8 +276,14 @@ protected:
 	RECORD_STATE_LASERCAL
     } m_recordState;
     int m_wait;
-    FILE *m_imageFP;
+    StripedImageWriter *m_imageWriter;
+    CompressedImageWriter *m_cmpWriter;
+    int m_swCompression;		/* as of the current recording */
+    FrameHasher *m_hasher;
+    int m_manifest;			/* as of the current recording */
+    RawWriterStats *m_rawWriterStats;
     FILE *m_imageHdrFP;
+    int m_hdrCheckpointFrames;
     FILE *m_gpsFP;
     FILE *m_ppsFP;
     int m_framesWritten;
@@ -223,31 +300,78 @@ protected:
     u_short m_gpsInitCommand[GPS_MSG_3510_WORDS];
     u_int m_gpsInitBytesSent;
 
+	/* GPS/nav messages from the image stream */
+
+    NavDecoder *m_navDecoder;
+    int m_gps3501Skip;
+
 	/* image dimensions -- mirrors dimensions from settings */
 
     int m_frameHeightLines;
     int m_frameWidthSamples;
+    void (*m_assembleFrame)(u_short *dest, const void *src, int lines,
+	int samples);
+
+	/* capture pipeline.  the data thread acquires frames into handles
+	   from the pool and hands them to the process stage, which feeds the
+	   record and display stages */
+
+    FramePool *m_framePool;
+    PipelineStage *m_processStage;
+    PipelineStage *m_recordStage;
+    PipelineStage *m_displayStage;
+    PipelineStage *m_darkStage;
+    PipelineStage *m_statsStage;
+    PipelineStage *m_quicklookStage;
+    PipelineStats *m_stageStats;
+    LatencyHistogram *m_latencyHists[NUM_FRAME_LATENCIES];
+    LatencySummary *m_latencyNow;
+    LatencySummary *m_latencyMinute;
+    double m_lastArrivalTime;
 
-	/* image buffer */
-
-    unsigned short *m_imageBuffer;
-    unsigned char *m_framePixels;
     unsigned char m_incr;
     unsigned char *m_waterfallPixels;
 
 	/* image correction */
 
-    int m_framesUntilDark;
-    unsigned int *m_darkFrameAccumulation;
-    int m_darkFramesAccumulated;
+    volatile int m_darkResetPending;
+    volatile int m_darkFramesWanted;	/* -1 for the whole cal period */
+    volatile int m_darkWantedDuringCal;
+    double m_darkRequestTime;
+    double m_darkSettledTime;
+    int m_darkFramesLeft;
+    int m_darkDuringCal;
+    DarkModel *m_darkModel;
+    volatile int m_darkModelReset;
     unsigned short *m_darkFrame;
+    unsigned char *m_darkMask;
     int m_darkFrameBuffered;
-
-	/* stretch */
-
-    unsigned char *m_stretchLUT;
-    unsigned char *m_stretchLUTGreen;
-    unsigned char *m_stretchLUTBlue;
+    Glib::Mutex m_darkMutex;
+
+	/* stretch.  the frame view has its own LUT, which is the same as
+	   the red one unless stretching automatically */
+
+    StretchLUT *m_stretchRed;
+    StretchLUT *m_stretchGreen;
+    StretchLUT *m_stretchBlue;
+    StretchLUT *m_stretchFrame;
+    BandStats *m_bandStats;
+    int m_statsFed;
+    volatile int m_autoStretchReset;
+    volatile int m_stretchRebuild;
+
+	/* quicklook of the flight line being recorded.  the quicklook stage
+	   owns the writer; the record side just says what file, if any, it
+	   should be writing, and bumps the generation so the stage notices */
+
+    QuicklookWriter *m_quicklook;
+    Glib::Mutex m_quicklookMutex;
+    char m_quicklookPath[MAXPATHLEN+20];
+    volatile int m_quicklookActive;
+    int m_quicklookGeneration;
+    int m_quicklookSeen;
+    int *m_autoStretchLow;	/* one per BandStats channel */
+    int *m_autoStretchHigh;
 
 	/* plots */
 
@@ -265,7 +389,7 @@ protected:
     FILE *m_allppsFP;
 
     char *m_diagsName;
-    FILE *m_diagsFP;
+    DiagsRecorder *m_diagsRecorder;
 
     char *m_logName;
     FILE *m_logFP;
@@ -414,10 +538,6 @@ protected:
 
     int m_dataThreadEnabled;
     Glib::Thread *m_dataThread;
-    Glib::Dispatcher m_refreshIndicators;
-    Glib::Dispatcher m_refreshFrameDisplay;
-    Glib::Dispatcher m_refreshWaterfallDisplay;
-    Glib::Dispatcher m_refreshNavDisplay;
     Glib::Dispatcher m_refreshRecordControls;
     Glib::Dispatcher m_refreshDiags;
     Glib::Dispatcher m_refreshStopButton;
@@ -426,6 +546,9 @@ protected:
     Glib::Mutex m_dataThreadMutex;
 
     sigc::connection m_resourcesCheckTimer;
+    sigc::connection m_displayRefreshTimer;
+    volatile int m_indicatorsDirty;	/* for the next display refresh */
+    volatile int m_navDisplayDirty;
 
 	/* mount capability */
 
@@ -537,20 +660,39 @@ protected:
 
     void dataThread(void);
     void lookForImageData(void);
-    void getImageFrame(void);
-    void simImageFrame(void);
-    void addGPSSimToFrame(void);
-    void processImageTimingData(void);
-    void processImageGPSData(void);
-    void displayCurrentFrame(void);
-    void displayWaterfallLine(void);
+    int getImageFrame(FrameHandle *h);
+    void simImageFrame(u_short *image);
+    void addGPSSimToFrame(u_short *image);
+    void processImageTimingData(const u_short *image);
+    void processImageGPSData(const u_short *image);
+    static void navStatusHandler(void *arg, const nav_record_t *rec);
+    static void navSolutionHandler(void *arg, const nav_record_t *rec);
+    void navStatus(const nav_status_t *status);
+    void displayCurrentFrame(const u_short *image);
+    void displayWaterfallLine(const u_short *image);
+    static void processStageHandler(void *arg, FrameHandle *h);
+    static void recordStageHandler(void *arg, FrameHandle *h);
+    static void displayStageHandler(void *arg, FrameHandle *h);
+    static void darkStageHandler(void *arg, FrameHandle *h);
+    static void statsStageHandler(void *arg, FrameHandle *h);
+    static void quicklookStageHandler(void *arg, FrameHandle *h);
+    void processFrame(FrameHandle *h);
+    void recordFrame(FrameHandle *h);
+    void feedDarkModel(FrameHandle *h);
+    void darkFrame(FrameHandle *h);
+    void finishDarkModel(void);
+    void startDarkModel(int frames, int duringCal);
+    void statsFrame(FrameHandle *h);
+    void quicklookFrame(FrameHandle *h);
+    void updateAutoStretch(void);
+    void displayFrame(FrameHandle *h);
+    void checkStopRequest(void);
     int checkForMoreImageData(int consecutiveFrames);
 
     void attachIndicator(Gtk::Table& table, int row, Gtk::Alignment& alignment,
 	Gtk::Label& label, StatusDisplay& indicator);
     void indicatorUpdateWork(void);
-    void frameUpdateWork(void);
-    void waterfallUpdateWork(void);
+    bool displayRefreshWork(void);
     void navDisplayUpdateWork(void);
     void recordControlsUpdateWork(void);
     void diagsUpdateWork(void);
@@ -563,32 +705,33 @@ protected:
 
     void showSliderDialog(void);
 
-    int writeImageFrame(void);
-    void writeAllgpsData(void);
-    void writeAllppsData(void);
-    int writeFlightlineGPSData(void);
-    int writePPSData(void);
-    int writeDataFromLine1(FILE *fp, int imageOffset, int maxByteCount,
-	const char *failMsg, int *suppression_p, int flush);
+    int writeImageFrame(FrameHandle *h);
+    void writeAllgpsData(const u_short *image);
+    void writeAllppsData(const u_short *image);
+    int writeFlightlineGPSData(const u_short *image);
+    int writePPSData(const u_short *image);
+    int writeDataFromLine1(FILE *fp, const u_short *image, int imageOffset,
+	int maxByteCount, const char *failMsg, int *suppression_p, int flush);
     bool performResourcesCheck(void);
     bool handleMount(void);
     int setMount(int state);
     int openFiles(void);
     void closeFiles(struct timespec *closeTime_p);
+    void writeImageHeader(int lines);
     void copyFile(const char *to, const char *from);
     void calcFreeSpace(const struct statfs *sb_p, double *usableSize_p,
 	double *usableFree_p) const;
     void buildUpFilesystemList(DisplayTab::fs_descr_t *fsDescrs, int *numFS_p,
 	struct statfs *statbuf_p, double bytesPerSecond);
+    int getStripeDirs(char (*dirs)[MAXPATHLEN]);
 
-    void add3501(u_short *msg);
+    void add3501(const nav_solution_t *solution);
     void draw(void);
 
     void showMsg(Glib::ustring msg, Glib::ustring secondaryMsg,
 	Gtk::MessageType type, Glib::ustring description);
     void saveStateToLog(void);
-    void saveCSVHeader(void);
-    void saveStateToCSV(void);
+    void saveStateToDiags(void);
 
     bool attachRecordToggleSwitch(void);
     bool detachRecordToggleSwitch(void);
@@ -0,0 +1,400 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "stripeindex.h"
+#include "flightline.h"
+
+extern const char *const flightlineDate = "$Date: 2015/12/22 09:31:05 $";
+
+typedef struct {
+    const FlightLineReader *reader;
+    const int *lines;
+    int numLines;
+    u_int first;		/* of this thread's share, in output rows */
+    u_int count;
+    u_int firstFrame;
+    u_int step;
+    u_short **dest;
+} extract_job_t;
+
+
+FlightLineReader::FlightLineReader()
+{
+    int i;
+
+    m_samples = m_lines = 0;
+    m_frames = 0;
+    m_frameBytes = 0;
+    m_numFiles = 0;
+    m_striped = 0;
+    for (i=0;i < STRIPE_MAX_STRIPES;i++) {
+	m_maps[i] = NULL;
+	m_mapBytes[i] = 0;
+    }
+    m_headerOffset = 0;
+}
+
+
+FlightLineReader::~FlightLineReader()
+{
+    close();
+}
+
+
+int FlightLineReader::readHeader(const char *path, char *errorMsg)
+{
+    FILE *fp;
+    char buf[200], interleave[20];
+    int frames, dataType, byteOrder;
+    long headerOffset;
+
+    if ((fp=fopen(path, "r")) == NULL) {
+	(void)sprintf(errorMsg, "Can't open header \"%s\".", path);
+	return -1;
+    }
+    frames = 0;
+    dataType = 12;
+    byteOrder = 0;
+    headerOffset = 0;
+    (void)strcpy(interleave, "bil");
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+	if (sscanf(buf, "samples= %d", &m_samples) == 1) ;
+	else if (sscanf(buf, "lines= %d", &frames) == 1) ;
+	else if (sscanf(buf, "bands= %d", &m_lines) == 1) ;
+	else if (sscanf(buf, "header offset= %ld", &headerOffset) == 1) ;
+	else if (sscanf(buf, "data type= %d", &dataType) == 1) ;
+	else if (sscanf(buf, "byte order= %d", &byteOrder) == 1) ;
+	else (void)sscanf(buf, "interleave= %19s", interleave);
+    }
+    (void)fclose(fp);
+
+	/* only what we write.  we never write big-endian */
+
+    if (m_samples <= 0 || m_lines <= 0 || frames < 0 || headerOffset < 0 ||
+	    dataType != 12 || byteOrder != 0 ||
+	    strcmp(interleave, "bil") != 0) {
+	(void)sprintf(errorMsg, "\"%s\" doesn't describe a flight line.",
+	    path);
+	return -1;
+    }
+    m_frames = frames;
+    m_frameBytes = (size_t)m_samples * m_lines * sizeof(u_short);
+    m_headerOffset = headerOffset;
+    return 0;
+}
+
+
+int FlightLineReader::mapFile(int i, const char *path, char *errorMsg)
+{
+    struct stat statbuf;
+    void *map;
+    int fd;
+
+	/* the descriptor isn't needed once the file's mapped */
+
+    if ((fd=::open(path, O_RDONLY)) == -1 || fstat(fd, &statbuf) == -1) {
+	(void)sprintf(errorMsg, "Can't open \"%s\" (%s).", path,
+	    strerror(errno));
+	if (fd != -1)
+	    (void)::close(fd);
+	return -1;
+    }
+    if (statbuf.st_size == 0) {
+	(void)::close(fd);
+	m_maps[i] = NULL;
+	m_mapBytes[i] = 0;
+	return 0;
+    }
+    map = mmap(NULL, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    (void)::close(fd);
+    if (map == MAP_FAILED) {
+	(void)sprintf(errorMsg, "Can't map \"%s\" (%s).", path,
+	    strerror(errno));
+	return -1;
+    }
+    m_maps[i] = (u_char *)map;
+    m_mapBytes[i] = statbuf.st_size;
+    return 0;
+}
+
+
+int FlightLineReader::open(const char *rawPath, char *errorMsg)
+{
+    char path[MAXPATHLEN+sizeof(STRIPE_INDEX_SUFFIX)];
+    struct stat statbuf;
+    off_t offset;
+    u_int frames;
+    int i;
+
+    close();
+    (void)sprintf(path, "%s.hdr", rawPath);
+    if (readHeader(path, errorMsg) == -1)
+	return -1;
+
+	/* a striped recording has an index in place of the _raw file */
+
+    if (stat(rawPath, &statbuf) != -1) {
+	m_striped = 0;
+	m_numFiles = 1;
+	if (mapFile(0, rawPath, errorMsg) == -1)
+	    return -1;
+	frames = (m_mapBytes[0] > m_headerOffset)?
+	    (m_mapBytes[0] - m_headerOffset) / m_frameBytes:0;
+    }
+    else {
+	(void)sprintf(path, "%s%s", rawPath, STRIPE_INDEX_SUFFIX);
+	if (readStripeIndex(path, &m_stripes, errorMsg) == -1)
+	    return -1;
+	if (m_stripes.frameBytes != m_frameBytes) {
+	    (void)sprintf(errorMsg, "Stripe index \"%s\" doesn't match the "
+		"header.", path);
+	    return -1;
+	}
+	m_striped = 1;
+	m_headerOffset = 0;
+	for (i=0;i < m_stripes.numStripes;i++) {
+	    if (mapFile(i, m_stripes.paths[i], errorMsg) == -1) {
+		close();
+		return -1;
+	    }
+	    m_numFiles++;
+	}
+
+	    /* frames are dealt out a block at a time, so the first stripe
+	       to come up short marks the end */
+
+	for (frames=0;;frames++) {
+	    i = stripeForFrame(&m_stripes, frames, &offset);
+	    if ((size_t)offset + m_frameBytes > m_mapBytes[i])
+		break;
+	}
+	if (m_stripes.frames != 0 && m_stripes.frames < frames)
+	    frames = m_stripes.frames;
+    }
+    if (m_frames > frames)
+	m_frames = frames;
+    return 0;
+}
+
+
+void FlightLineReader::close(void)
+{
+    int i;
+
+    for (i=0;i < m_numFiles;i++)
+	if (m_maps[i] != NULL) {
+	    (void)munmap(m_maps[i], m_mapBytes[i]);
+	    m_maps[i] = NULL;
+	    m_mapBytes[i] = 0;
+	}
+    m_numFiles = 0;
+    m_frames = 0;
+}
+
+
+const u_short *FlightLineReader::frame(u_int f) const
+{
+    off_t offset;
+    int i;
+
+    if (f >= m_frames)
+	return NULL;
+    if (!m_striped)
+	return (const u_short *)(m_maps[0] + m_headerOffset +
+	    (size_t)f * m_frameBytes);
+    i = stripeForFrame(&m_stripes, f, &offset);
+    return (const u_short *)(m_maps[i] + offset);
+}
+
+
+const u_short *FlightLineReader::band(u_int f, int line) const
+{
+    const u_short *usp;
+
+    if (line < 0 || line >= m_lines || (usp=frame(f)) == NULL)
+	return NULL;
+    return usp + (size_t)line * m_samples;
+}
+
+
+	/* in BIL a spectrum is a column of the frame, so it's strided */
+
+int FlightLineReader::spectrum(u_int f, int sample,
+    spectrum_view_t *view) const
+{
+    const u_short *usp;
+
+    if (sample < 0 || sample >= m_samples || (usp=frame(f)) == NULL)
+	return -1;
+    view->first = usp + sample;
+    view->stride = m_samples;
+    view->count = m_lines;
+    return 0;
+}
+
+
+void FlightLineReader::advise(int advice)
+{
+    int i;
+
+    for (i=0;i < m_numFiles;i++)
+	if (m_maps[i] != NULL)
+	    (void)madvise(m_maps[i], m_mapBytes[i], advice);
+}
+
+
+	/* for frames taken in order, as by a quicklook */
+
+void FlightLineReader::adviseSequential(void)
+{
+    advise(MADV_SEQUENTIAL);
+}
+
+
+	/* for frames picked here and there, as by a nav lookup.  this stops
+	   the kernel reading ahead whole frames we'll never look at */
+
+void FlightLineReader::adviseRandom(void)
+{
+    advise(MADV_RANDOM);
+}
+
+
+void FlightLineReader::adviseFrames(u_int first, u_int count, int advice)
+{
+    const u_char *start;
+    size_t page, begin;
+    u_int f;
+
+    page = sysconf(_SC_PAGESIZE);
+    for (f=first;f < first+count && f < m_frames;f++) {
+	start = (const u_char *)frame(f);
+	begin = (size_t)start & ~(page-1);
+	(void)madvise((void *)begin, (size_t)start + m_frameBytes - begin,
+	    advice);
+    }
+}
+
+
+void FlightLineReader::adviseWillNeed(u_int first, u_int count)
+{
+    adviseFrames(first, count, MADV_WILLNEED);
+}
+
+
+	/* drop our hold on frames we're done with, so a pass over a flight
+	   line bigger than memory doesn't push everything else out first.
+	   they're still in the file, so touching them again just rereads */
+
+void FlightLineReader::release(u_int first, u_int count)
+{
+    adviseFrames(first, count, MADV_DONTNEED);
+}
+
+
+static void *extractThread(void *arg)
+{
+    extract_job_t *job;
+    const u_short *usp;
+    size_t lineBytes;
+    u_int row, f;
+    int k;
+
+    job = (extract_job_t *)arg;
+    lineBytes = job->reader->samples() * sizeof(u_short);
+    for (row=job->first;row < job->first + job->count;row++) {
+	f = job->firstFrame + row * job->step;
+	for (k=0;k < job->numLines;k++) {
+	    usp = job->reader->band(f, job->lines[k]);
+	    (void)memcpy(job->dest[k] + (size_t)row * job->reader->samples(),
+		usp, lineBytes);
+	}
+    }
+    return NULL;
+}
+
+
+	/* copy the given lines (bands) out of every step'th frame, starting
+	   at first, into one image per line, count rows of samples each.
+	   the rows are split among threads so that page faults on a cold
+	   flight line overlap */
+
+int FlightLineReader::extractBands(const int *lines, int numLines,
+    u_int first, u_int count, u_int step, u_short **dest, int threads)
+{
+    extract_job_t jobs[FLIGHTLINE_MAX_THREADS];
+    pthread_t tids[FLIGHTLINE_MAX_THREADS];
+    u_int share, row;
+    int i, k, started;
+
+    if (count == 0)
+	return 0;
+    if (step < 1 || first >= m_frames ||
+	    (m_frames - 1 - first) / step < count - 1) {
+	errno = EINVAL;
+	return -1;
+    }
+    for (k=0;k < numLines;k++)
+	if (lines[k] < 0 || lines[k] >= m_lines) {
+	    errno = EINVAL;
+	    return -1;
+	}
+    if (threads < 1)
+	threads = 1;
+    if (threads > FLIGHTLINE_MAX_THREADS)
+	threads = FLIGHTLINE_MAX_THREADS;
+    if ((u_int)threads > count)
+	threads = count;
+
+    share = (count + threads - 1) / threads;
+    row = 0;
+    for (i=0;i < threads;i++) {
+	jobs[i].reader = this;
+	jobs[i].lines = lines;
+	jobs[i].numLines = numLines;
+	jobs[i].first = row;
+	jobs[i].count = (count - row < share)? count - row:share;
+	jobs[i].firstFrame = first;
+	jobs[i].step = step;
+	jobs[i].dest = dest;
+	row += jobs[i].count;
+    }
+
+	/* if we can't get a thread, do its share ourselves */
+
+    started = 0;
+    for (i=1;i < threads;i++) {
+	if (pthread_create(&tids[i], NULL, extractThread, &jobs[i]) != 0)
+	    break;
+	started++;
+    }
+    for (i=started+1;i < threads;i++)
+	(void)extractThread(&jobs[i]);
+    (void)extractThread(&jobs[0]);
+    for (i=1;i <= started;i++)
+	(void)pthread_join(tids[i], NULL);
+    return 0;
+}
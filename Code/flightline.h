@@ -0,0 +1,75 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* read-only access to a recorded flight line, as written by
+       DisplayTab::writeImageFrame and described by its ENVI header (BIL,
+       data type 12).  each frame is a header line followed by the band
+       lines, so line n of a frame is band n in the sense of the red,
+       green, and blue band settings.  the _raw file, or each stripe file
+       of a striped recording, is mapped whole and frames, bands, and
+       spectra are handed out as pointers into the mapping; nothing is
+       read until it's touched, so flight lines bigger than memory are no
+       problem on a 64-bit host.  the header is written when recording
+       starts and its line count brought up to what's on disk every few
+       seconds, so a recording that never closed is read as far as the
+       header last said, and no further than there are whole frames */
+
+#define FLIGHTLINE_MAX_THREADS	16
+
+typedef struct {
+    const u_short *first;	/* value for the header line */
+    int stride;			/* in words, band to band */
+    int count;			/* header line included */
+} spectrum_view_t;
+
+class FlightLineReader
+{
+protected:
+    int m_samples;
+    int m_lines;		/* per frame, header line included */
+    u_int m_frames;
+    size_t m_frameBytes;
+    int m_numFiles;
+    int m_striped;
+    stripe_index_t m_stripes;
+    u_char *m_maps[STRIPE_MAX_STRIPES];
+    size_t m_mapBytes[STRIPE_MAX_STRIPES];
+    size_t m_headerOffset;	/* unstriped only */
+
+    int readHeader(const char *path, char *errorMsg);
+    int mapFile(int i, const char *path, char *errorMsg);
+    void adviseFrames(u_int first, u_int count, int advice);
+    void advise(int advice);
+public:
+    FlightLineReader();
+    ~FlightLineReader();
+    int open(const char *rawPath, char *errorMsg);
+    void close(void);
+    int samples(void) const { return m_samples; }
+    int lines(void) const { return m_lines; }
+    u_int frames(void) const { return m_frames; }
+    const u_short *frame(u_int f) const;
+    const u_short *band(u_int f, int line) const;
+    int spectrum(u_int f, int sample, spectrum_view_t *view) const;
+    void adviseSequential(void);
+    void adviseRandom(void);
+    void adviseWillNeed(u_int first, u_int count);
+    void release(u_int first, u_int count);
+    int extractBands(const int *lines, int numLines, u_int first,
+	u_int count, u_int step, u_short **dest, int threads);
+};
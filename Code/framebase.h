@@ -0,0 +1,84 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <sys/types.h>
+
+    /* the interface the rest of the program sees to the camera and its
+       framebuffer card.  AlphaDataFrameBuffer (framebuf.h) is the real
+       thing; the others stand in for it without the card -- see
+       pacedbuf.h.
+
+       frameArrivalTime() is when the frame last handed out by getFrame()
+       came off the card (secs, CLOCK_MONOTONIC, as pipelineNow()), or 0 if
+       that isn't known */
+
+#define SENSOR_NOMINAL	0
+#define SENSOR_WARM	1
+#define SENSOR_HOT	2
+
+#define NUM_FRAMERATES		7
+
+class FrameBuffer
+{
+protected:
+    int m_frameHeightLines;
+    int m_frameWidthSamples;
+    void (*m_errorReporter)(const char *string);
+public:
+    int failed;
+    char last_error[1024];
+    FrameBuffer(int fh, int fw, void (*er)(const char *)) {
+	m_frameHeightLines = fh;
+	m_frameWidthSamples = fw;
+	m_errorReporter = er; }
+    virtual int frameIsAvailable(void) = 0;
+    virtual int waitForFrame(int timeoutUs) = 0;
+    virtual void *getFrame(void) = 0;
+    virtual void releaseFrame(void *frame) = 0;
+    virtual double frameArrivalTime(void) = 0;
+    virtual void getStats(u_int *dropped_p, u_int *backlog_p) = 0;
+    virtual void setCCLines(int cc1, int cc2) = 0;
+    virtual void setGPIO(u_int mask, u_int bits) = 0;
+    virtual void setExtSerialBaud(int baud) = 0;
+    virtual void setExtSerialParityEven(void) = 0;
+    virtual void setExtSerialParityOdd(void) = 0;
+    virtual void setExtSerialParityNone(void) = 0;
+    virtual void setExtSerialTXInvertOff(void) = 0;
+    virtual void setExtSerialTXInvertOn(void) = 0;
+    virtual int writeExtSerial(u_char *bytes, int numBytes) = 0;
+    virtual void writeCLSerial(char *string) = 0;
+    virtual void readCLSerial(char *buffer, int maxChars) = 0;
+    virtual int fpgaVersion(void) = 0;
+    virtual int numFrameRates(void) = 0;
+    virtual double getFrameRateHz(void) = 0;
+    virtual double getFrameRateHz(int selection) = 0;
+    virtual int setFrameRate(int selection) = 0;
+    virtual void readSensors(int *numSensors_p, char ***sensorNames_p,
+	double **sensorValues_p, int **sensorRanges_p) = 0;
+    virtual u_int fpgaPPSCount(void) = 0;
+    virtual u_int fpgaBufferDepth(void) = 0;
+    virtual u_int fpgaBuffersUsed(void) = 0;
+    virtual void readFPGARegs(int *m_fpgaFrameCount_p,
+	int *m_fpgaPPSCount_p, int *m_fpga81ffCount_p,
+	int *m_fpgaFramesDropped_p, int *m_serialErrors_p,
+	int *m_serialPortCtl_p, int *m_fpgaBufferDepth,
+	int *m_fpgaMaxBuffersUsed) = 0;
+    virtual void clearSerialErrors(void) = 0;
+    virtual void clearFPGAMaxBuffersUsed(void) = 0;
+    virtual ~FrameBuffer() { }
+};
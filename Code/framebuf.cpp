@@ -15,9 +15,13 @@
    author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
 
 
+#include <unistd.h>
 #include <math.h>
 #include <string.h>
+#include <assert.h>
 #include "framebuf.h"
+#include "pipeline.h"
+#include "tracer.h"
 
 //#define TRACE_CTL_REG_WRITES
 
@@ -59,10 +63,12 @@ AlphaDataFrameBuffer::AlphaDataFrameBuffer(int fh, int fw,
     m_appRunning = true;
     m_bitDir = ADFB_BITFILE_PATH;
     m_alarmThread = NULL;
-    m_nextFreeImageBuffer = 0;
-    m_nextPopulatedImageBuffer = 0;
-    m_readyImageBuffers = 0;
     memset(m_imageBuffers, 0, sizeof(m_imageBuffers));
+    m_slotFrames = NULL;
+    m_slotLeases = NULL;
+    m_slotTimes = NULL;
+    m_lastArrival = 0.0;
+    m_leasesOutstanding = 0;
     m_fetchThread = NULL;
     m_frameServer = NULL;
     m_serverHandle = NULL;
@@ -70,8 +76,11 @@ AlphaDataFrameBuffer::AlphaDataFrameBuffer(int fh, int fw,
     m_framesPerBuffer = MAX_BUFFER_HEIGHT / fh;
     if (m_framesPerBuffer < 1)
 	m_framesPerBuffer = 1;
-    m_currentImageBuffer = NULL;
     m_framesLeftInBuffer = 0;
+    m_outIndex = 0;
+    m_releaseIndex = 0;
+    m_framesHeld = 0;
+    m_frameDone = NULL;
 
     if (fh != 1024)
 	for (i=0;i < NUM_FRAMERATES;i++)
@@ -165,6 +174,21 @@ AlphaDataFrameBuffer::AlphaDataFrameBuffer(int fh, int fw,
 	    m_camera->GetFramesInOne());
     }
 
+	/* per-frame pointers into either the buffers above or, when zero-copy
+	   leases are in use, the frame server's own buffers */
+
+    m_slotFrames = new void *[NUM_IMAGE_BUFFERS * m_framesPerBuffer];
+    (void)memset(m_slotFrames, 0,
+	NUM_IMAGE_BUFFERS * m_framesPerBuffer * sizeof(void *));
+    m_slotLeases = new FrameDataPtrT[NUM_IMAGE_BUFFERS * m_framesPerBuffer];
+    for (i=0;i < NUM_IMAGE_BUFFERS * m_framesPerBuffer;i++)
+	m_slotLeases[i] = NULL;
+    m_slotTimes = new double[NUM_IMAGE_BUFFERS * m_framesPerBuffer];
+    (void)memset(m_slotTimes, 0,
+	NUM_IMAGE_BUFFERS * m_framesPerBuffer * sizeof(double));
+    m_frameDone = new char[NUM_IMAGE_BUFFERS * m_framesPerBuffer];
+    (void)memset(m_frameDone, 0, NUM_IMAGE_BUFFERS * m_framesPerBuffer);
+
 	/* create frame server object */
 
     m_frameServer = new CFrameServer();
@@ -194,8 +218,9 @@ AlphaDataFrameBuffer::AlphaDataFrameBuffer(int fh, int fw,
 
 	/* set up helper threads */
 
-    if (sem_init(&m_fetchSem, 0, 1) == -1) {
-	strcpy(last_error, "Internal error: Can't init semaphore!");
+    if (m_ring.init(NUM_IMAGE_BUFFERS) == -1 ||
+	    m_returnRing.init(ADFB_MAX_LEASES+1) == -1) {
+	strcpy(last_error, "Internal error: Can't init frame ring!");
 	for (i=0;i < NUM_IMAGE_BUFFERS;i++) {
 	    delete[] (u_char *)m_imageBuffers[i];
 	    m_imageBuffers[i] = NULL;
@@ -449,11 +474,12 @@ AlphaDataFrameBuffer::~AlphaDataFrameBuffer()
 	m_alarmThread->Wait();
 	delete m_alarmThread;
     }
+    m_ring.shutdown();
+    m_returnRing.shutdown();
     if (m_fetchThread) {
 	m_fetchThread->Wait();
 	delete m_fetchThread;
     }
-    (void)sem_destroy(&m_fetchSem);
 
     if (m_clientHandle.IsConnected())
 	m_clientHandle.Disconnect();
@@ -482,59 +508,124 @@ AlphaDataFrameBuffer::~AlphaDataFrameBuffer()
 		delete[] (u_char *)m_imageBuffers[i];
 	}
     }
+    if (m_slotFrames)
+	delete[] m_slotFrames;
+    if (m_slotLeases)
+	delete[] m_slotLeases;
+    if (m_slotTimes)
+	delete[] m_slotTimes;
+    if (m_frameDone)
+	delete[] m_frameDone;
 }
 
 
 int AlphaDataFrameBuffer::frameIsAvailable(void)
 {
-    int result;
-
 	/* return immediately if we're not working */
 
     if (failed) return 0;
 
-	/* use semaphores to create critical section */
+	/* no lock needed -- the ring's counters are safe to read from here */
 
-    (void)sem_wait(&m_fetchSem);
-    result = (m_readyImageBuffers > 0 || m_framesLeftInBuffer);
-    (void)sem_post(&m_fetchSem);
-    return result;
+    return (m_framesLeftInBuffer || m_ring.backlog() > 0);
+}
+
+
+int AlphaDataFrameBuffer::waitForFrame(int timeoutUs)
+{
+	/* if we're not working nothing will ever show up, so just pass the
+	   time the caller was willing to wait */
+
+    if (failed) {
+	if (timeoutUs > 0)
+	    (void)usleep(timeoutUs);
+	return 0;
+    }
+
+	/* block until the fetch thread publishes a buffer (it wakes us
+	   through the ring's futex) or we time out */
+
+    if (m_framesLeftInBuffer)
+	return 1;
+    return (m_ring.waitForData(timeoutUs) == 0);
 }
 
 
 void *AlphaDataFrameBuffer::getFrame(void)
 {
     void *result;
+    int slot;
 
     if (failed) return NULL;
 
-    (void)sem_wait(&m_fetchSem);
-    if (m_readyImageBuffers == 0 && m_framesLeftInBuffer == 0) {
-	(void)sem_post(&m_fetchSem);
-	return NULL;
+	/* move on to the next filled buffer if we've handed out everything
+	   in this one.  the buffer itself isn't given back to the fetch
+	   thread until every frame in it has come back through releaseFrame */
+
+    if (m_framesLeftInBuffer == 0) {
+	if ((slot=m_ring.takeSlot(0)) == -1)
+	    return NULL;
+	m_outIndex = slot * m_framesPerBuffer;
+	m_framesLeftInBuffer = m_framesPerBuffer;
     }
-    else if (m_framesLeftInBuffer != 0) {
-	result = m_currentImageBuffer;
+    result = m_slotFrames[m_outIndex];
+    m_lastArrival = m_slotTimes[m_outIndex];
+    if (++m_outIndex == NUM_IMAGE_BUFFERS * m_framesPerBuffer)
+	m_outIndex = 0;
+    m_framesLeftInBuffer--;
+    m_framesHeld++;
+    return result;
+}
+
+
+void AlphaDataFrameBuffer::releaseFrame(void *frame)
+{
+    int index, i, r, numFrames;
+
+	/* frames may come back in any order, but getFrame and releaseFrame
+	   must not be called at the same time from different threads */
+
+    if (failed || frame == NULL)
+	return;
 
-	m_currentImageBuffer = (char *)m_currentImageBuffer +
-	    m_camera->GetFrameSize();
-	m_framesLeftInBuffer--;
+	/* find the frame among those we've handed out */
 
-	(void)sem_post(&m_fetchSem);
-	return result;
+    numFrames = NUM_IMAGE_BUFFERS * m_framesPerBuffer;
+    index = m_releaseIndex;
+    for (i=0;i < m_framesHeld;i++) {
+	if (m_slotFrames[index] == frame && !m_frameDone[index])
+	    break;
+	if (++index == numFrames)
+	    index = 0;
+    }
+    if (i == m_framesHeld)
+	return;
+    m_frameDone[index] = 1;
+
+	/* if this was a lease, queue it for the fetch thread to hand back to
+	   the frame server -- all server calls stay on that thread.  the
+	   fetch thread never has more than ADFB_MAX_LEASES out and only
+	   counts one back after taking it off the return ring, which has a
+	   slot more than that, so there's always room */
+
+    if (m_slotLeases[index] != NULL) {
+	r = m_returnRing.acquireSlot(0);
+	assert(r != -1);
+	m_returnedLeases[r] = m_slotLeases[index];
+	m_returnRing.publishSlot();
+	m_slotLeases[index] = NULL;
     }
-    else {
-	result = m_imageBuffers[m_nextPopulatedImageBuffer];
-	m_nextPopulatedImageBuffer++;
-	if (m_nextPopulatedImageBuffer == NUM_IMAGE_BUFFERS)
-	    m_nextPopulatedImageBuffer = 0;
-	m_readyImageBuffers--;
 
-	m_currentImageBuffer = (char *)result + m_camera->GetFrameSize();
-	m_framesLeftInBuffer = m_framesPerBuffer - 1;
+	/* give whole buffers back to the fetch thread, in order, once every
+	   frame in them is done */
 
-	(void)sem_post(&m_fetchSem);
-	return result;
+    while (m_framesHeld > 0 && m_frameDone[m_releaseIndex]) {
+	m_frameDone[m_releaseIndex] = 0;
+	m_framesHeld--;
+	if (++m_releaseIndex == numFrames)
+	    m_releaseIndex = 0;
+	if (m_releaseIndex % m_framesPerBuffer == 0)
+	    m_ring.releaseSlot();
     }
 }
 
@@ -550,11 +641,26 @@ void AlphaDataFrameBuffer::getStats(u_int *dropped_p, u_int *backlog_p)
     else {
 	if (dropped_p)
 	    *dropped_p = m_camera->GetDroppedFrameCount();
-	if (backlog_p) {
-	    (void)sem_wait(&m_fetchSem);
-	    *backlog_p = m_readyImageBuffers;
-	    (void)sem_post(&m_fetchSem);
-	}
+	if (backlog_p)
+	    *backlog_p = m_ring.backlog();
+    }
+}
+
+
+void AlphaDataFrameBuffer::returnLeases(void)
+{
+    u_int64_t t0;
+    int r;
+
+	/* give back to the frame server any leased buffers the consumer is
+	   done with */
+
+    while ((r=m_returnRing.takeSlot(0)) != -1) {
+	t0 = traceStart();
+	(void)m_serverHandle->ReleaseFrameChk(m_returnedLeases[r]);
+	traceEnd(TRACE_FETCH_RELEASE, t0);
+	m_returnRing.releaseSlot();
+	m_leasesOutstanding--;
     }
 }
 
@@ -563,40 +669,61 @@ void AlphaDataFrameBuffer::FetchThread(void *pArg)
 {
     EFSCResult eRes;
     FrameDataPtrT pFrameData;
-    u_int nBytes;
     AlphaDataFrameBuffer *me = (AlphaDataFrameBuffer *)pArg;
     u_int thisFrame, incr;
-
-    nBytes = me->m_camera->GetFrameSize() * me->m_camera->GetFramesInOne();
+    int slot, index;
+    void *copy;
+    u_int64_t t0;
 
     thisFrame = 0;
+    slot = -1;
     incr = me->m_camera->GetFrameSize();
     while (me->m_appRunning && me->m_clientHandle.IsConnected()) {
+	me->returnLeases();
+
+	    /* get a free buffer to fill.  if the consumer is behind and the
+	       ring is full, we block here until it gives one back; the frame
+	       server keeps buffering on the card meanwhile.  the timeout is
+	       just so we keep returning leases while we wait */
+
+	if (slot == -1) {
+	    slot = me->m_ring.acquireSlot(100000); /* 100 ms */
+	    if (slot == -1)
+		continue;
+	}
+
 	eRes = me->m_serverHandle->GetFrame(pFrameData, GFB_Normal);
 	if (eRes == FSCRes_OK) {
-	    memcpy((u_char *)me->m_imageBuffers[me->m_nextFreeImageBuffer] +
-		    thisFrame * incr,
-		pFrameData, incr);
-
-	    eRes = me->m_serverHandle->ReleaseFrameChk(pFrameData);
-	    if (eRes == FSCRes_OK) {
-		thisFrame++;
-		if (thisFrame == me->m_camera->GetFramesInOne()) {
-		    thisFrame = 0;
-		    me->m_nextFreeImageBuffer++;
-		    if (me->m_nextFreeImageBuffer == NUM_IMAGE_BUFFERS)
-			me->m_nextFreeImageBuffer = 0;
-
-		    (void)sem_wait(&me->m_fetchSem);
-		    me->m_readyImageBuffers++;
-		    while (me->m_appRunning &&
-			    me->m_readyImageBuffers == NUM_IMAGE_BUFFERS) {
-			(void)sem_post(&me->m_fetchSem);
-			usleep(10000); /* 10 ms */
-			(void)sem_wait(&me->m_fetchSem);
-		    }
-		    (void)sem_post(&me->m_fetchSem);
-		}
+	    index = slot * me->m_framesPerBuffer + thisFrame;
+	    me->m_slotTimes[index] = pipelineNow();
+
+		/* hand the server's buffer straight to the consumer if we can
+		   afford to; otherwise copy and release it as before */
+
+	    if (me->m_leasesOutstanding < ADFB_MAX_LEASES) {
+		me->m_slotFrames[index] = (void *)pFrameData;
+		me->m_slotLeases[index] = pFrameData;
+		me->m_leasesOutstanding++;
+	    }
+	    else {
+		copy = (u_char *)me->m_imageBuffers[slot] + thisFrame * incr;
+		t0 = traceStart();
+		memcpy(copy, pFrameData, incr);
+		traceEnd(TRACE_FETCH_COPY, t0);
+		t0 = traceStart();
+		eRes = me->m_serverHandle->ReleaseFrameChk(pFrameData);
+		traceEnd(TRACE_FETCH_RELEASE, t0);
+		if (eRes != FSCRes_OK)
+		    continue;
+		me->m_slotFrames[index] = copy;
+		me->m_slotLeases[index] = NULL;
+	    }
+
+	    thisFrame++;
+	    if (thisFrame == me->m_camera->GetFramesInOne()) {
+		thisFrame = 0;
+		me->m_ring.publishSlot();
+		slot = -1;
 	    }
 	}
     }
@@ -15,74 +15,31 @@
    author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
 
 
-#include <semaphore.h>
 #include <adcommon.h>
 #include <adclink.h>
 #include <adframeserver.h>
 #include <adframeclient.h>
+#include "framering.h"
 
 using namespace AlphaData::FrameServer;
 using namespace AlphaData::FrameClient;
 
 #define FB_SERIAL_BAUD	9600
 
-#define SENSOR_NOMINAL	0
-#define SENSOR_WARM	1
-#define SENSOR_HOT	2
-
-
-class FrameBuffer
-{
-protected:
-    int m_frameHeightLines;
-    int m_frameWidthSamples;
-    void (*m_errorReporter)(const char *string);
-public:
-    int failed;
-    char last_error[1024];
-    FrameBuffer(int fh, int fw, void (*er)(const char *)) {
-	m_frameHeightLines = fh;
-	m_frameWidthSamples = fw;
-	m_errorReporter = er; }
-    virtual int frameIsAvailable(void) = 0;
-    virtual void *getFrame(void) = 0;
-    virtual void getStats(u_int *dropped_p, u_int *backlog_p) = 0;
-    virtual void setCCLines(int cc1, int cc2) = 0;
-    virtual void setGPIO(u_int mask, u_int bits) = 0;
-    virtual void setExtSerialBaud(int baud) = 0;
-    virtual void setExtSerialParityEven(void) = 0;
-    virtual void setExtSerialParityOdd(void) = 0;
-    virtual void setExtSerialParityNone(void) = 0;
-    virtual void setExtSerialTXInvertOff(void) = 0;
-    virtual void setExtSerialTXInvertOn(void) = 0;
-    virtual int writeExtSerial(u_char *bytes, int numBytes) = 0;
-    virtual void writeCLSerial(char *string) = 0;
-    virtual void readCLSerial(char *buffer, int maxChars) = 0;
-    virtual int fpgaVersion(void) = 0;
-    virtual int numFrameRates(void) = 0;
-    virtual double getFrameRateHz(void) = 0;
-    virtual double getFrameRateHz(int selection) = 0;
-    virtual int setFrameRate(int selection) = 0;
-    virtual void readSensors(int *numSensors_p, char ***sensorNames_p,
-	double **sensorValues_p, int **sensorRanges_p) = 0;
-    virtual u_int fpgaPPSCount(void) = 0;
-    virtual u_int fpgaBufferDepth(void) = 0;
-    virtual u_int fpgaBuffersUsed(void) = 0;
-    virtual void readFPGARegs(int *m_fpgaFrameCount_p,
-	int *m_fpgaPPSCount_p, int *m_fpga81ffCount_p,
-	int *m_fpgaFramesDropped_p, int *m_serialErrors_p,
-	int *m_serialPortCtl_p, int *m_fpgaBufferDepth,
-	int *m_fpgaMaxBuffersUsed) = 0;
-    virtual void clearSerialErrors(void) = 0;
-    virtual void clearFPGAMaxBuffersUsed(void) = 0;
-    virtual ~FrameBuffer() { }
-};
+#include "framebase.h"
 
 
 using namespace AlphaData::CLink;
 
 #define NUM_IMAGE_BUFFERS	200
-#define NUM_FRAMERATES		7
+
+    /* max number of frame-server buffers we'll hand to the consumer
+       directly rather than copying.  the server only has so many, and if
+       the consumer sits on too many of them the card starts dropping, so
+       past this we go back to copying into our own buffers.  0 disables
+       zero-copy altogether */
+
+#define ADFB_MAX_LEASES		32
 
 #define ADFB_BITFILE_PATH		"/usr/local/lib"
 
@@ -140,11 +97,15 @@ protected:
     CFrameServerClient m_clientHandle;
     FrmSrvrCmPtrT m_serverHandle;
 
-    int m_nextFreeImageBuffer;
-    int m_nextPopulatedImageBuffer;
-    int m_readyImageBuffers;
+    FrameRing m_ring;
     void *m_imageBuffers[NUM_IMAGE_BUFFERS];
-    sem_t m_fetchSem;
+    void **m_slotFrames;
+    FrameDataPtrT *m_slotLeases;
+    double *m_slotTimes;
+    double m_lastArrival;
+    int m_leasesOutstanding;
+    FrameRing m_returnRing;
+    FrameDataPtrT m_returnedLeases[ADFB_MAX_LEASES+1];
     CThread *m_fetchThread;
 
     int m_numSensors;
@@ -158,8 +119,11 @@ protected:
     int m_currentFrameRate;
 
     int m_framesPerBuffer;
-    void *m_currentImageBuffer;
     int m_framesLeftInBuffer;
+    int m_outIndex;
+    int m_releaseIndex;
+    int m_framesHeld;
+    char *m_frameDone;
 
     u_int m_serialPortCtlReg;
 
@@ -171,11 +135,15 @@ protected:
 
     static void AlarmThread(void *pArg);
     static void FetchThread(void *pArg);
+    void returnLeases(void);
 public:
     AlphaDataFrameBuffer(int fh, int fw, void (*er)(const char *));
     ~AlphaDataFrameBuffer();
     int frameIsAvailable(void);
+    int waitForFrame(int timeoutUs);
     void *getFrame(void);
+    void releaseFrame(void *frame);
+    double frameArrivalTime(void) { return m_lastArrival; }
     void getStats(u_int *dropped_p, u_int *backlog_p);
     void setCCLines(int cc1, int cc2);
     void setGPIO(u_int mask, u_int bits);
@@ -0,0 +1,259 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/param.h>
+#include <tomcrypt.h>
+#include "pipeline.h"
+#include "manifest.h"
+#include "framehasher.h"
+
+extern const char *const framehasherDate = "$Date: 2015/12/28 15:47:31 $";
+
+    /* a lane hashes blocks index, index+HASHER_NUM_LANES, ... in turn */
+
+struct HasherLane {
+    FrameHasher *hasher;
+    hash_state state;
+    u_int block;
+    int frames;
+};
+
+
+FrameHasher::FrameHasher(FramePool *pool)
+{
+    int i;
+
+    m_pool = pool;
+    m_lanes = new HasherLane[HASHER_NUM_LANES];
+    for (i=0;i < HASHER_NUM_LANES;i++) {
+	m_lanes[i].hasher = this;
+	m_lanes[i].block = i;
+	m_lanes[i].frames = 0;
+	m_stages[i] = new PipelineStage("Hash", pool, PIPELINE_HASH_QUEUE,
+	    false, laneHandler, &m_lanes[i], PIPELINE_WAIT_FOREVER, 0, 0);
+    }
+    m_fp = NULL;
+    m_path[0] = '\0';
+    m_frameBytes = 0;
+    m_frames = 0;
+    m_digests = NULL;
+    m_maxDigests = 0;
+    m_blocks = 0;
+    m_framesQueued = 0;
+    m_framesHashed = 0;
+    m_error = 0;
+    (void)pthread_mutex_init(&m_lock, NULL);
+    (void)pthread_cond_init(&m_doneCond, NULL);
+}
+
+
+FrameHasher::~FrameHasher()
+{
+    int i;
+
+    if (m_fp != NULL)
+	(void)close();
+    for (i=0;i < HASHER_NUM_LANES;i++)
+	delete m_stages[i];
+    delete[] m_lanes;
+    delete[] m_digests;
+    (void)pthread_cond_destroy(&m_doneCond);
+    (void)pthread_mutex_destroy(&m_lock);
+}
+
+
+int FrameHasher::start(void)
+{
+    int i;
+
+    for (i=0;i < HASHER_NUM_LANES;i++)
+	if (m_stages[i]->start() == -1)
+	    return -1;
+    return 0;
+}
+
+
+void FrameHasher::stop(void)
+{
+    int i;
+
+    for (i=0;i < HASHER_NUM_LANES;i++)
+	m_stages[i]->stop();
+}
+
+
+int FrameHasher::open(const char *path, size_t frameBytes)
+{
+    int i;
+
+    if ((m_fp=fopen(path, "w")) == NULL)
+	return -1;
+    (void)strcpy(m_path, path);
+    if (writeManifestHeader(m_fp, frameBytes, MANIFEST_BLOCK_FRAMES) == -1) {
+	(void)fclose(m_fp);
+	m_fp = NULL;
+	return -1;
+    }
+    m_frameBytes = frameBytes;
+    m_frames = 0;
+    m_blocks = 0;
+    m_framesQueued = 0;
+    m_framesHashed = 0;
+    m_error = 0;
+    for (i=0;i < HASHER_NUM_LANES;i++) {
+	m_lanes[i].block = i;
+	m_lanes[i].frames = 0;
+	(void)sha256_init(&m_lanes[i].state);
+    }
+    return 0;
+}
+
+
+void FrameHasher::addFrame(FrameHandle *h)
+{
+    int lane;
+
+    if (m_fp == NULL)
+	return;
+    lane = (m_frames / MANIFEST_BLOCK_FRAMES) % HASHER_NUM_LANES;
+    if (m_stages[lane]->submit(h) == -1)
+	m_error = 1;		/* only when shutting down */
+    else m_framesQueued++;
+    m_frames++;
+}
+
+
+void FrameHasher::laneHandler(void *arg, FrameHandle *h)
+{
+    HasherLane *lane = (HasherLane *)arg;
+    FrameHasher *me = lane->hasher;
+
+    if (h == NULL)
+	return;
+    (void)sha256_process(&lane->state, (const u_char *)h->pixels,
+	(u_long)me->m_frameBytes);
+    if (++lane->frames == MANIFEST_BLOCK_FRAMES)
+	me->finishBlock(lane);
+
+    (void)pthread_mutex_lock(&me->m_lock);
+    me->m_framesHashed++;
+    (void)pthread_cond_signal(&me->m_doneCond);
+    (void)pthread_mutex_unlock(&me->m_lock);
+}
+
+
+void FrameHasher::finishBlock(HasherLane *lane)
+{
+    manifest_digest_t digest, *digests;
+    u_int max;
+
+    (void)sha256_done(&lane->state, digest);
+
+    (void)pthread_mutex_lock(&m_lock);
+    if (lane->block >= m_maxDigests) {
+	max = (m_maxDigests == 0)? 1024:m_maxDigests;
+	while (max <= lane->block)
+	    max *= 2;
+	digests = new manifest_digest_t[max];
+	if (m_maxDigests > 0)
+	    (void)memcpy(digests, m_digests,
+		m_maxDigests * sizeof(manifest_digest_t));
+	delete[] m_digests;
+	m_digests = digests;
+	m_maxDigests = max;
+    }
+    (void)memcpy(m_digests[lane->block], digest, sizeof(digest));
+    if (lane->block >= m_blocks)
+	m_blocks = lane->block + 1;
+    if (writeManifestBlock(m_fp, lane->block, digest) == -1)
+	m_error = 1;
+    (void)pthread_mutex_unlock(&m_lock);
+
+    lane->block += HASHER_NUM_LANES;
+    lane->frames = 0;
+    (void)sha256_init(&lane->state);
+}
+
+
+int FrameHasher::close(void)
+{
+    manifest_digest_t digest;
+    int i, result;
+
+    if (m_fp == NULL)
+	return 0;
+
+	/* wait for the lanes to catch up, then finish whatever partial
+	   block each has.  they're idle by then, so this is safe to do
+	   from here */
+
+    (void)pthread_mutex_lock(&m_lock);
+    while (m_framesHashed < m_framesQueued)
+	(void)pthread_cond_wait(&m_doneCond, &m_lock);
+    (void)pthread_mutex_unlock(&m_lock);
+    for (i=0;i < HASHER_NUM_LANES;i++)
+	if (m_lanes[i].frames > 0)
+	    finishBlock(&m_lanes[i]);
+
+    manifestDigest(digest, m_digests, m_blocks);
+    result = m_error? -1:0;
+    if (writeManifestTrailer(m_fp, m_frames, m_blocks, digest) == -1)
+	result = -1;
+    if (fclose(m_fp) == EOF)
+	result = -1;
+    m_fp = NULL;
+    return result;
+}
+
+
+void FrameHasher::removeFile(void)
+{
+    if (m_path[0] != '\0')
+	(void)unlink(m_path);
+}
+
+
+void FrameHasher::getStats(PipelineStats *stats_p)
+{
+    PipelineStats s;
+    double frames;
+    int i;
+
+	/* the lanes together, as though they were one stage */
+
+    (void)memset(stats_p, 0, sizeof(PipelineStats));
+    frames = 0.0;
+    for (i=0;i < HASHER_NUM_LANES;i++) {
+	m_stages[i]->getStats(&s);
+	stats_p->depth += s.depth;
+	if (s.maxDepth > stats_p->maxDepth)
+	    stats_p->maxDepth = s.maxDepth;
+	stats_p->frames += s.frames;
+	stats_p->dropped += s.dropped;
+	stats_p->avgLatencyMs += s.avgLatencyMs * s.frames;
+	frames += s.frames;
+	if (s.maxLatencyMs > stats_p->maxLatencyMs)
+	    stats_p->maxLatencyMs = s.maxLatencyMs;
+    }
+    if (frames > 0.0)
+	stats_p->avgLatencyMs /= frames;
+}
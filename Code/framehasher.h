@@ -0,0 +1,72 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* integrity hashing for recording (see manifest.h).  one SHA-256
+       thread can't quite keep up with the biggest frames at the top
+       frame rate, so blocks are dealt out round robin to HASHER_NUM_LANES
+       lanes, each a pipeline stage of its own that hashes its blocks'
+       frames as they come.  lanes never drop frames -- a gap would spoil
+       the manifest -- so if they fall behind they hold frame-pool
+       handles, the same as a slow disk would.  tools/hashbench shows
+       how much headroom there is */
+
+#define HASHER_NUM_LANES	2
+
+class FramePool;
+class PipelineStage;
+struct FrameHandle;
+struct PipelineStats;
+struct HasherLane;
+
+class FrameHasher
+{
+protected:
+    FramePool *m_pool;
+    PipelineStage *m_stages[HASHER_NUM_LANES];
+    HasherLane *m_lanes;
+    FILE *m_fp;
+    char m_path[MAXPATHLEN+sizeof(MANIFEST_SUFFIX)];
+    size_t m_frameBytes;
+    u_int m_frames;
+
+	/* finished blocks, for the whole-line digest at close */
+
+    manifest_digest_t *m_digests;
+    u_int m_maxDigests;
+    u_int m_blocks;
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_doneCond;
+    u_int m_framesQueued;
+    u_int m_framesHashed;
+    int m_error;
+
+    static void laneHandler(void *arg, FrameHandle *h);
+    void finishBlock(HasherLane *lane);
+public:
+    FrameHasher(FramePool *pool);
+    ~FrameHasher();
+    int start(void);
+    void stop(void);
+    int open(const char *path, size_t frameBytes);
+    void addFrame(FrameHandle *h);
+    int close(void);
+    void removeFile(void);
+    int isOpen(void) const { return m_fp != NULL; }
+    void getStats(PipelineStats *stats_p);
+};
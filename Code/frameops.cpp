@@ -0,0 +1,452 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FRAMEOPS_X86
+#endif
+#include "frameops.h"
+
+extern const char *const frameopsDate = "$Date: 2015/12/21 16:40:12 $";
+
+
+void assembleFrameScalar(u_short *dest, const void *src, int lines,
+    int samples)
+{
+    const u_char *ucp;
+    u_short *usp;
+    int n;
+
+    ucp = (const u_char *)src;
+    usp = dest;
+    for (n = lines * samples;n > 0;n--) {
+	*usp = (*(ucp+1) << 8) | *ucp;
+	usp++;
+	ucp += sizeof(short);
+    }
+}
+
+
+void accumulateDarkScalar(u_int *sum, u_int64_t *sumSq,
+    const u_short *pixels, int n)
+{
+    u_int x;
+
+    for (;n > 0;n--) {
+	x = *pixels++;
+	*sum++ += x;
+	*sumSq++ += x * x;
+    }
+}
+
+
+static void subtractDarkScalar(u_short *dest, const u_short *pixels,
+    const u_short *dark, int n)
+{
+    int x;
+
+    for (;n > 0;n--) {
+	x = *pixels++ - *dark++;
+	*dest++ = (x < 0)? 0:x;
+    }
+}
+
+
+#ifdef FRAMEOPS_X86
+
+	/* x86 is little-endian, same as the frame, so assembly is just a
+	   copy.  frames are always a multiple of 16 pixels wide, but handle
+	   a ragged end anyway */
+
+__attribute__((target("sse2")))
+void assembleFrameSSE2(u_short *dest, const void *src, int lines,
+    int samples)
+{
+    const __m128i *s;
+    __m128i *d, a, b;
+    int i, n;
+
+    s = (const __m128i *)src;
+    d = (__m128i *)dest;
+    n = lines * samples;
+    for (i = n / 16;i > 0;i--) {
+	a = _mm_loadu_si128(s);
+	b = _mm_loadu_si128(s+1);
+	_mm_storeu_si128(d, a);
+	_mm_storeu_si128(d+1, b);
+	s += 2;
+	d += 2;
+    }
+    if (n % 16 != 0)
+	assembleFrameScalar((u_short *)d, s, 1, n % 16);
+}
+
+
+__attribute__((target("avx2")))
+void assembleFrameAVX2(u_short *dest, const void *src, int lines,
+    int samples)
+{
+    const __m256i *s;
+    __m256i *d, a, b;
+    int i, n;
+
+    s = (const __m256i *)src;
+    d = (__m256i *)dest;
+    n = lines * samples;
+    for (i = n / 32;i > 0;i--) {
+	a = _mm256_loadu_si256(s);
+	b = _mm256_loadu_si256(s+1);
+	_mm256_storeu_si256(d, a);
+	_mm256_storeu_si256(d+1, b);
+	s += 2;
+	d += 2;
+    }
+    if (n % 32 != 0)
+	assembleFrameSSE2((u_short *)d, s, 1, n % 32);
+}
+
+
+	/* fixed-geometry versions.  with the pixel count known at compile
+	   time there's no tail to handle and the loop can be unrolled */
+
+template <int LINES, int SAMPLES>
+__attribute__((target("sse2")))
+static void assembleFixedSSE2(u_short *dest, const void *src, int, int)
+{
+    const __m128i *s;
+    __m128i *d;
+    int i;
+
+    s = (const __m128i *)src;
+    d = (__m128i *)dest;
+    for (i=0;i < LINES * SAMPLES / 8;i++)
+	_mm_storeu_si128(d+i, _mm_loadu_si128(s+i));
+}
+
+
+template <int LINES, int SAMPLES>
+__attribute__((target("avx2")))
+static void assembleFixedAVX2(u_short *dest, const void *src, int, int)
+{
+    const __m256i *s;
+    __m256i *d;
+    int i;
+
+    s = (const __m256i *)src;
+    d = (__m256i *)dest;
+    for (i=0;i < LINES * SAMPLES / 16;i++)
+	_mm256_storeu_si256(d+i, _mm256_loadu_si256(s+i));
+}
+
+	/* dark accumulation.  SSE2 has no 32-bit multiply, but the low and
+	   high halves of the 16-bit products interleave into the 32-bit
+	   squares.  a square of a 16-bit pixel always fits in 32 bits */
+
+__attribute__((target("sse2")))
+void accumulateDarkSSE2(u_int *sum, u_int64_t *sumSq, const u_short *pixels,
+    int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i x, lo, hi, sq;
+    __m128i *s, *q;
+    int i;
+
+    s = (__m128i *)sum;
+    q = (__m128i *)sumSq;
+    for (i = n / 8;i > 0;i--) {
+	x = _mm_loadu_si128((const __m128i *)pixels);
+	_mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s),
+	    _mm_unpacklo_epi16(x, zero)));
+	_mm_storeu_si128(s+1, _mm_add_epi32(_mm_loadu_si128(s+1),
+	    _mm_unpackhi_epi16(x, zero)));
+
+	lo = _mm_mullo_epi16(x, x);
+	hi = _mm_mulhi_epu16(x, x);
+	sq = _mm_unpacklo_epi16(lo, hi);
+	_mm_storeu_si128(q, _mm_add_epi64(_mm_loadu_si128(q),
+	    _mm_unpacklo_epi32(sq, zero)));
+	_mm_storeu_si128(q+1, _mm_add_epi64(_mm_loadu_si128(q+1),
+	    _mm_unpackhi_epi32(sq, zero)));
+	sq = _mm_unpackhi_epi16(lo, hi);
+	_mm_storeu_si128(q+2, _mm_add_epi64(_mm_loadu_si128(q+2),
+	    _mm_unpacklo_epi32(sq, zero)));
+	_mm_storeu_si128(q+3, _mm_add_epi64(_mm_loadu_si128(q+3),
+	    _mm_unpackhi_epi32(sq, zero)));
+
+	pixels += 8;
+	s += 2;
+	q += 4;
+    }
+    if (n % 8 != 0)
+	accumulateDarkScalar((u_int *)s, (u_int64_t *)q, pixels, n % 8);
+}
+
+
+__attribute__((target("avx2")))
+void accumulateDarkAVX2(u_int *sum, u_int64_t *sumSq, const u_short *pixels,
+    int n)
+{
+    __m256i x, sq;
+    __m256i *s, *q;
+    int i;
+
+    s = (__m256i *)sum;
+    q = (__m256i *)sumSq;
+    for (i = n / 8;i > 0;i--) {
+	x = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)pixels));
+	_mm256_storeu_si256(s, _mm256_add_epi32(_mm256_loadu_si256(s), x));
+	sq = _mm256_mullo_epi32(x, x);
+	_mm256_storeu_si256(q, _mm256_add_epi64(_mm256_loadu_si256(q),
+	    _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sq))));
+	_mm256_storeu_si256(q+1, _mm256_add_epi64(_mm256_loadu_si256(q+1),
+	    _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sq, 1))));
+	pixels += 8;
+	s++;
+	q += 2;
+    }
+    if (n % 8 != 0)
+	accumulateDarkScalar((u_int *)s, (u_int64_t *)q, pixels, n % 8);
+}
+
+
+	/* dark subtraction for rendering.  the unsigned saturating subtract
+	   does the clamp at zero for free */
+
+__attribute__((target("sse2")))
+static void subtractDarkSSE2(u_short *dest, const u_short *pixels,
+    const u_short *dark, int n)
+{
+    int i;
+
+    for (i = n / 8;i > 0;i--) {
+	_mm_storeu_si128((__m128i *)dest,
+	    _mm_subs_epu16(_mm_loadu_si128((const __m128i *)pixels),
+		_mm_loadu_si128((const __m128i *)dark)));
+	dest += 8;
+	pixels += 8;
+	dark += 8;
+    }
+    if (n % 8 != 0)
+	subtractDarkScalar(dest, pixels, dark, n % 8);
+}
+
+
+#define FIXED_ASSEMBLERS(lines, samples) \
+    { lines, samples, assembleFixedSSE2<lines,samples>, \
+	assembleFixedAVX2<lines,samples> }
+
+#else
+
+void assembleFrameSSE2(u_short *dest, const void *src, int lines,
+    int samples)
+{
+    assembleFrameScalar(dest, src, lines, samples);
+}
+
+
+void assembleFrameAVX2(u_short *dest, const void *src, int lines,
+    int samples)
+{
+    assembleFrameScalar(dest, src, lines, samples);
+}
+
+
+void accumulateDarkSSE2(u_int *sum, u_int64_t *sumSq, const u_short *pixels,
+    int n)
+{
+    accumulateDarkScalar(sum, sumSq, pixels, n);
+}
+
+
+void accumulateDarkAVX2(u_int *sum, u_int64_t *sumSq, const u_short *pixels,
+    int n)
+{
+    accumulateDarkScalar(sum, sumSq, pixels, n);
+}
+
+
+static void subtractDarkSSE2(u_short *dest, const u_short *pixels,
+    const u_short *dark, int n)
+{
+    subtractDarkScalar(dest, pixels, dark, n);
+}
+
+#endif
+
+
+	/* one entry for each of SettingsBlock's frame heights and widths */
+
+#ifdef FRAMEOPS_X86
+static const struct {
+    int lines, samples;
+    frame_assembler_t sse2, avx2;
+} fixedAssemblers[] = {
+    FIXED_ASSEMBLERS(285, 640),
+    FIXED_ASSEMBLERS(285, 1024),
+    FIXED_ASSEMBLERS(481, 640),
+    FIXED_ASSEMBLERS(481, 1024),
+    FIXED_ASSEMBLERS(1024, 640),
+    FIXED_ASSEMBLERS(1024, 1024),
+};
+#endif
+
+
+int frameOpsLevel(void)
+{
+#ifdef FRAMEOPS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+	return FRAMEOPS_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+	return FRAMEOPS_SSE2;
+#endif
+    return FRAMEOPS_SCALAR;
+}
+
+
+frame_assembler_t frameAssembler(int level, int lines, int samples,
+    const char **descr_p)
+{
+    static char descr[40];
+    const char *isa;
+    frame_assembler_t generic;
+
+	/* a negative level means the best this CPU can do */
+
+    if (level < 0 || level > frameOpsLevel())
+	level = frameOpsLevel();
+    switch (level) {
+	case FRAMEOPS_AVX2:
+	    isa = "AVX2";
+	    generic = assembleFrameAVX2;
+	    break;
+	case FRAMEOPS_SSE2:
+	    isa = "SSE2";
+	    generic = assembleFrameSSE2;
+	    break;
+	default:
+	    isa = "scalar";
+	    generic = assembleFrameScalar;
+	    break;
+    }
+
+#ifdef FRAMEOPS_X86
+    unsigned int i;
+
+    if (level != FRAMEOPS_SCALAR) {
+	for (i=0;i < sizeof(fixedAssemblers)/sizeof(fixedAssemblers[0]);i++) {
+	    if (fixedAssemblers[i].lines == lines &&
+		    fixedAssemblers[i].samples == samples) {
+		if (descr_p != NULL) {
+		    (void)sprintf(descr, "%s, fixed %dx%d", isa, lines,
+			samples);
+		    *descr_p = descr;
+		}
+		return (level == FRAMEOPS_AVX2)? fixedAssemblers[i].avx2:
+		    fixedAssemblers[i].sse2;
+	    }
+	}
+    }
+#endif
+    if (descr_p != NULL)
+	*descr_p = isa;
+    return generic;
+}
+
+
+dark_accumulator_t darkAccumulator(int level)
+{
+    if (level < 0 || level > frameOpsLevel())
+	level = frameOpsLevel();
+    switch (level) {
+	case FRAMEOPS_AVX2:
+	    return accumulateDarkAVX2;
+	case FRAMEOPS_SSE2:
+	    return accumulateDarkSSE2;
+	default:
+	    return accumulateDarkScalar;
+    }
+}
+
+
+	/* frame rendering.  lines are done a chunk at a time so the
+	   subtracted pixels stay in L1 between the two halves of the pass */
+
+#define RENDER_CHUNK	64
+
+template <int DARKSUB, int INCR, int SIMD>
+static void renderFrame(u_int *dest, int destStride, int reflect,
+    const u_short *image, const u_short *dark, const u_char *mask,
+    const u_char *lut, int lines, int samples)
+{
+    u_short diff[RENDER_CHUNK];
+    const u_short *p;
+    const u_char *m;
+    u_int *d;
+    int i, j, k, n, step, value, lastValue;
+
+	/* a decimated frame keeps its last line and sample when there's an
+	   odd number of them, same as the full-size one */
+
+    step = reflect? -1:1;
+    for (i = (lines + INCR-1) / INCR;i > 0;i--) {
+	d = reflect? dest + (samples + INCR-1)/INCR - 1:dest;
+	lastValue = 0;
+	for (j=0;j < samples;j += RENDER_CHUNK) {
+	    n = (samples - j < RENDER_CHUNK)? samples - j:RENDER_CHUNK;
+	    p = image + j;
+	    m = mask + j;
+	    if (DARKSUB) {
+		if (SIMD)
+		    subtractDarkSSE2(diff, p, dark + j, n);
+		else subtractDarkScalar(diff, p, dark + j, n);
+		p = diff;
+	    }
+	    for (k=0;k < n;k += INCR) {
+		value = p[k];
+		if (DARKSUB) {
+		    value = m[k]? lastValue:value;
+		    lastValue = value;
+		}
+		*d = lut[value] * 0x010101u;
+		d += step;
+	    }
+	}
+	dest += destStride;
+	image += INCR * samples;
+	dark += INCR * samples;
+	mask += INCR * samples;
+    }
+}
+
+
+frame_renderer_t frameRenderer(int level, int darkSub, int incr)
+{
+    static const frame_renderer_t renderers[2][2][2] = {
+	{ { renderFrame<0,1,0>, renderFrame<0,2,0> },
+	  { renderFrame<1,1,0>, renderFrame<1,2,0> } },
+	{ { renderFrame<0,1,1>, renderFrame<0,2,1> },
+	  { renderFrame<1,1,1>, renderFrame<1,2,1> } },
+    };
+
+    if (level < 0 || level > frameOpsLevel())
+	level = frameOpsLevel();
+    return renderers[level != FRAMEOPS_SCALAR][darkSub != 0][incr != 1];
+}
@@ -0,0 +1,73 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+    /* frame assembly.  the FPGA hands us frames as little-endian 16-bit
+       pixels, which we assemble into host-order u_shorts.  on x86 that's
+       a straight copy, so there are SSE2 and AVX2 kernels chosen at run
+       time, plus fixed-size versions for each supported frame geometry so
+       the compiler knows the trip count.  elsewhere we fall back to the
+       original byte-at-a-time loop, which is right for either byte order.
+
+       dark accumulation works the same way.  each pixel is widened to 32
+       bits into a running sum, and its square to 64 bits into a running
+       sum of squares, so a dark's mean and noise (standard deviation)
+       come out of the one pass.  see darkmodel.h
+
+       frame rendering takes a frame to the frame view in one pass:  dark
+       subtraction and bad-pixel masking (a masked pixel repeats its
+       neighbor along the line), the stretch lookup, and packing the gray
+       value into a Cairo RGB24 pixel (0x00RRGGBB, host order).  there's a
+       version for each combination of dark subtraction and decimation so
+       neither is tested per pixel.  the subtraction is vectorized; the
+       stretch is a table lookup and stays scalar.  dest is the first
+       pixel of the view's top row, destStride the row pitch in pixels,
+       and image, dark and mask start at the first line to show.  lines
+       and samples are of the source frame; lines/incr rows of
+       samples/incr pixels are written, mirrored left-right if reflect is
+       set */
+
+#define FRAMEOPS_SCALAR	0
+#define FRAMEOPS_SSE2	1
+#define FRAMEOPS_AVX2	2
+
+typedef void (*frame_assembler_t)(u_short *dest, const void *src, int lines,
+    int samples);
+typedef void (*dark_accumulator_t)(u_int *sum, u_int64_t *sumSq,
+    const u_short *pixels, int n);
+typedef void (*frame_renderer_t)(u_int *dest, int destStride, int reflect,
+    const u_short *image, const u_short *dark, const u_char *mask,
+    const u_char *lut, int lines, int samples);
+
+extern void assembleFrameScalar(u_short *dest, const void *src, int lines,
+    int samples);
+extern void assembleFrameSSE2(u_short *dest, const void *src, int lines,
+    int samples);
+extern void assembleFrameAVX2(u_short *dest, const void *src, int lines,
+    int samples);
+extern int frameOpsLevel(void);
+extern frame_assembler_t frameAssembler(int level, int lines, int samples,
+    const char **descr_p);
+
+extern void accumulateDarkScalar(u_int *sum, u_int64_t *sumSq,
+    const u_short *pixels, int n);
+extern void accumulateDarkSSE2(u_int *sum, u_int64_t *sumSq,
+    const u_short *pixels, int n);
+extern void accumulateDarkAVX2(u_int *sum, u_int64_t *sumSq,
+    const u_short *pixels, int n);
+extern dark_accumulator_t darkAccumulator(int level);
+
+extern frame_renderer_t frameRenderer(int level, int darkSub, int incr);
@@ -0,0 +1,234 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "framering.h"
+
+extern const char *const frameringDate = "$Date: 2015/12/10 18:02:41 $";
+
+
+static int futexWait(volatile u_int *word, u_int val,
+    const struct timespec *timeout)
+{
+    return syscall(SYS_futex, (int *)word, FUTEX_WAIT_PRIVATE, (int)val,
+	timeout, NULL, 0);
+}
+
+
+static void futexWake(volatile u_int *word, int count)
+{
+    (void)syscall(SYS_futex, (int *)word, FUTEX_WAKE_PRIVATE, count,
+	NULL, NULL, 0);
+}
+
+
+FrameRing::FrameRing()
+{
+    m_numSlots = 0;
+    m_seqs = NULL;
+    m_shutdown = 0;
+    m_head = 0;
+    m_producerWaiting = 0;
+    m_headIndex = 0;
+    m_tail = 0;
+    m_consumerWaiting = 0;
+    m_tailIndex = 0;
+    m_released = 0;
+    m_releasedIndex = 0;
+}
+
+
+FrameRing::~FrameRing()
+{
+    if (m_seqs)
+	delete[] m_seqs;
+}
+
+
+int FrameRing::init(int numSlots)
+{
+    int i;
+
+    if (numSlots < 2 || m_seqs != NULL)
+	return -1;
+    m_numSlots = numSlots;
+    m_seqs = new u_int[numSlots];
+
+	/* slot i is free for position i */
+
+    for (i=0;i < numSlots;i++)
+	m_seqs[i] = i;
+    __sync_synchronize();
+    return 0;
+}
+
+
+int FrameRing::waitForSeq(volatile u_int *word, u_int want,
+    volatile int *waiting, int timeoutUs)
+{
+    u_int cur;
+    struct timespec now, deadline, remaining;
+
+    if (timeoutUs > 0) {
+	(void)clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeoutUs / 1000000;
+	deadline.tv_nsec += (timeoutUs % 1000000) * 1000;
+	if (deadline.tv_nsec >= 1000000000) {
+	    deadline.tv_sec++;
+	    deadline.tv_nsec -= 1000000000;
+	}
+    }
+    for (;;) {
+	if (*word == want) {
+	    __sync_synchronize(); /* don't let data reads pass the check */
+	    return 0;
+	}
+	if (m_shutdown || timeoutUs == 0)
+	    return -1;
+
+	    /* advertise that we're about to sleep, then re-check.  the other
+	       side stores the sequence, fences, and then looks at our flag,
+	       so one of us is guaranteed to see the other */
+
+	*waiting = 1;
+	__sync_synchronize();
+	cur = *word;
+	if (cur != want && !m_shutdown) {
+	    if (timeoutUs < 0)
+		(void)futexWait(word, cur, NULL);
+	    else {
+		(void)clock_gettime(CLOCK_MONOTONIC, &now);
+		remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+		remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+		if (remaining.tv_nsec < 0) {
+		    remaining.tv_sec--;
+		    remaining.tv_nsec += 1000000000;
+		}
+		if (remaining.tv_sec < 0) {
+		    *waiting = 0;
+		    return (*word == want)? 0:-1;
+		}
+		(void)futexWait(word, cur, &remaining);
+	    }
+	}
+	*waiting = 0;
+    }
+}
+
+
+int FrameRing::acquireSlot(int timeoutUs)
+{
+    if (waitForSeq(&m_seqs[m_headIndex], m_head, &m_producerWaiting,
+	    timeoutUs) == -1)
+	return -1;
+    return m_headIndex;
+}
+
+
+void FrameRing::publishSlot(void)
+{
+    volatile u_int *word = &m_seqs[m_headIndex];
+
+	/* make the frame data visible before the sequence that says it's
+	   there, then check whether the consumer went to sleep on this slot */
+
+    __sync_synchronize();
+    *word = m_head + 1;
+    m_head = m_head + 1;
+    __sync_synchronize();
+    if (m_consumerWaiting)
+	futexWake(word, 1);
+
+    if (++m_headIndex == m_numSlots)
+	m_headIndex = 0;
+}
+
+
+int FrameRing::takeSlot(int timeoutUs)
+{
+    int result;
+
+    if (waitForSeq(&m_seqs[m_tailIndex], m_tail+1, &m_consumerWaiting,
+	    timeoutUs) == -1)
+	return -1;
+    result = m_tailIndex;
+    m_tail = m_tail + 1;
+    if (++m_tailIndex == m_numSlots)
+	m_tailIndex = 0;
+    return result;
+}
+
+
+int FrameRing::waitForData(int timeoutUs)
+{
+	/* like takeSlot, but leaves the slot in the ring */
+
+    return waitForSeq(&m_seqs[m_tailIndex], m_tail+1, &m_consumerWaiting,
+	timeoutUs);
+}
+
+
+void FrameRing::releaseSlot(void)
+{
+    volatile u_int *word;
+
+    if (m_released == m_tail) /* nothing held */
+	return;
+    word = &m_seqs[m_releasedIndex];
+
+	/* done reading -- free the slot for the position one lap ahead */
+
+    __sync_synchronize();
+    *word = m_released + m_numSlots;
+    m_released++;
+    __sync_synchronize();
+    if (m_producerWaiting)
+	futexWake(word, 1);
+
+    if (++m_releasedIndex == m_numSlots)
+	m_releasedIndex = 0;
+}
+
+
+u_int FrameRing::backlog(void)
+{
+    u_int head, tail;
+
+	/* published but not yet taken.  read the tail first so a concurrent
+	   take can only make the answer too large by one, never negative */
+
+    tail = m_tail;
+    __sync_synchronize();
+    head = m_head;
+    return head - tail;
+}
+
+
+void FrameRing::shutdown(void)
+{
+    int i;
+
+    m_shutdown = 1;
+    __sync_synchronize();
+    for (i=0;i < m_numSlots;i++)
+	futexWake(&m_seqs[i], INT_MAX);
+}
@@ -0,0 +1,80 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+#include <sys/types.h>
+
+    /* single-producer/single-consumer ring of slot indices.  the producer
+       (fetch thread) acquires a free slot, fills the caller's buffer for
+       that slot, and publishes it; the consumer takes published slots in
+       order and releases them when it's done with the data.  each slot
+       carries a sequence number so neither side needs a lock -- a slot is
+       free for position p when its sequence is p, and holds data for
+       position p when its sequence is p+1.  head and tail live on their
+       own cache lines so the two threads don't bounce a shared line on
+       every frame.  when the ring is full or empty the waiting side
+       blocks in a futex rather than sleeping.  a ring needs at least two
+       slots, since with one a freed slot's sequence would be the next
+       full one's */
+
+#define FRAMERING_CACHE_LINE	64
+
+#define FRAMERING_WAIT_FOREVER	-1
+
+class FrameRing
+{
+protected:
+    int m_numSlots;
+    volatile u_int *m_seqs;
+    volatile int m_shutdown;
+    char m_pad0[FRAMERING_CACHE_LINE];
+
+	/* producer side */
+
+    volatile u_int m_head;
+    volatile int m_producerWaiting;
+    int m_headIndex;
+    char m_pad1[FRAMERING_CACHE_LINE - 2*sizeof(int) - sizeof(u_int)];
+
+	/* consumer side.  m_tail counts slots taken; m_released counts slots
+	   handed back to the producer, which lags m_tail while the consumer
+	   is still using taken slots */
+
+    volatile u_int m_tail;
+    volatile int m_consumerWaiting;
+    int m_tailIndex;
+    u_int m_released;
+    int m_releasedIndex;
+    char m_pad2[FRAMERING_CACHE_LINE - 3*sizeof(int) - 2*sizeof(u_int)];
+
+    int waitForSeq(volatile u_int *word, u_int want, volatile int *waiting,
+	int timeoutUs);
+public:
+    FrameRing();
+    ~FrameRing();
+    int init(int numSlots);
+    int numSlots(void) { return m_numSlots; }
+
+    int acquireSlot(int timeoutUs);
+    void publishSlot(void);
+
+    int takeSlot(int timeoutUs);
+    int waitForData(int timeoutUs);
+    void releaseSlot(void);
+    u_int slotsHeld(void) { return m_tail - m_released; }
+
+    u_int backlog(void);
+    void shutdown(void);
+};
@@ -0,0 +1,175 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "latencyhist.h"
+
+extern const char *const latencyhistDate = "$Date: 2016/01/04 10:22:37 $";
+
+
+LatencyHistogram::LatencyHistogram()
+{
+    (void)pthread_mutex_init(&m_lock, NULL);
+    m_intervals = new u_int[LATHIST_WINDOW_INTERVALS][LATHIST_BUCKETS];
+    reset();
+}
+
+
+LatencyHistogram::~LatencyHistogram()
+{
+    delete[] m_intervals;
+    (void)pthread_mutex_destroy(&m_lock);
+}
+
+
+void LatencyHistogram::reset(void)
+{
+    (void)pthread_mutex_lock(&m_lock);
+    (void)memset(m_current, 0, sizeof(m_current));
+    m_currentMax = 0.0;
+    (void)memset(m_intervals, 0,
+	LATHIST_WINDOW_INTERVALS * sizeof(m_intervals[0]));
+    (void)memset(m_intervalMax, 0, sizeof(m_intervalMax));
+    m_nextInterval = 0;
+    (void)memset(m_window, 0, sizeof(m_window));
+    (void)pthread_mutex_unlock(&m_lock);
+}
+
+
+int LatencyHistogram::bucketFor(double secs)
+{
+    u_int us;
+    int msb, magnitude;
+
+	/* below LATHIST_SUB_BUCKETS us the buckets are 1 us wide.  above,
+	   magnitude m holds [SUB << (m-1), SUB << m) in SUB buckets */
+
+    if (secs <= 0.0)
+	return 0;
+    if (secs >= (double)(1U << 31) / 1.0e6)
+	return LATHIST_BUCKETS-1;
+    us = (u_int)(secs * 1.0e6);
+    if (us < LATHIST_SUB_BUCKETS)
+	return us;
+    msb = 31 - __builtin_clz(us);
+    magnitude = msb - LATHIST_SUB_BITS + 1;
+    if (magnitude >= LATHIST_MAGNITUDES)
+	return LATHIST_BUCKETS-1;
+    return magnitude * LATHIST_SUB_BUCKETS +
+	(int)(us >> (magnitude-1)) - LATHIST_SUB_BUCKETS;
+}
+
+
+double LatencyHistogram::bucketTopMs(int bucket)
+{
+    int magnitude, sub;
+
+    magnitude = bucket / LATHIST_SUB_BUCKETS;
+    sub = bucket % LATHIST_SUB_BUCKETS;
+    if (magnitude == 0)
+	return (sub + 1) / 1000.0;
+    return (double)((u_long)(LATHIST_SUB_BUCKETS + sub + 1) <<
+	(magnitude-1)) / 1000.0;
+}
+
+
+void LatencyHistogram::summarize(const u_int *hist, double maxSecs,
+    LatencySummary *summary_p)
+{
+    u_int total, count, target50, target99;
+    int i;
+
+    total = 0;
+    for (i=0;i < LATHIST_BUCKETS;i++)
+	total += hist[i];
+    summary_p->count = total;
+    summary_p->p50Ms = 0.0;
+    summary_p->p99Ms = 0.0;
+    summary_p->maxMs = 1000.0 * maxSecs;
+    if (total == 0)
+	return;
+
+	/* one pass finds both, by nearest rank */
+
+    target50 = (u_int)(total * 0.50 + 0.999999);
+    target99 = (u_int)(total * 0.99 + 0.999999);
+    count = 0;
+    for (i=0;i < LATHIST_BUCKETS;i++) {
+	if (hist[i] == 0)
+	    continue;
+	count += hist[i];
+	if (summary_p->p50Ms == 0.0 && count >= target50)
+	    summary_p->p50Ms = bucketTopMs(i);
+	if (count >= target99) {
+	    summary_p->p99Ms = bucketTopMs(i);
+	    break;
+	}
+    }
+
+	/* the top of a bucket can overstate the largest value in it */
+
+    if (summary_p->p99Ms > summary_p->maxMs)
+	summary_p->p99Ms = summary_p->maxMs;
+    if (summary_p->p50Ms > summary_p->maxMs)
+	summary_p->p50Ms = summary_p->maxMs;
+}
+
+
+void LatencyHistogram::record(double secs)
+{
+    int bucket;
+
+    bucket = bucketFor(secs);
+    (void)pthread_mutex_lock(&m_lock);
+    m_current[bucket]++;
+    if (secs > m_currentMax)
+	m_currentMax = secs;
+    (void)pthread_mutex_unlock(&m_lock);
+}
+
+
+void LatencyHistogram::rollover(LatencySummary *interval_p,
+    LatencySummary *window_p)
+{
+    u_int *oldest;
+    double windowMax;
+    int i;
+
+	/* the new interval takes the place of the oldest in the window */
+
+    (void)pthread_mutex_lock(&m_lock);
+    oldest = m_intervals[m_nextInterval];
+    for (i=0;i < LATHIST_BUCKETS;i++) {
+	m_window[i] += m_current[i] - oldest[i];
+	oldest[i] = m_current[i];
+    }
+    m_intervalMax[m_nextInterval] = m_currentMax;
+    if (++m_nextInterval == LATHIST_WINDOW_INTERVALS)
+	m_nextInterval = 0;
+    windowMax = 0.0;
+    for (i=0;i < LATHIST_WINDOW_INTERVALS;i++)
+	if (m_intervalMax[i] > windowMax)
+	    windowMax = m_intervalMax[i];
+    summarize(m_current, m_currentMax, interval_p);
+    summarize(m_window, windowMax, window_p);
+    (void)memset(m_current, 0, sizeof(m_current));
+    m_currentMax = 0.0;
+    (void)pthread_mutex_unlock(&m_lock);
+}
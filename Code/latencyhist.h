@@ -0,0 +1,66 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <pthread.h>
+#include <sys/types.h>
+
+    /* HDR-style latency histograms.  each power of 2 (in microseconds) is
+       split into LATHIST_SUB_BUCKETS equal buckets, so a value is kept to
+       about 3% whether it's a few microseconds of jitter or a write that
+       stalled for seconds, in a fixed few KB.  samples go into the
+       current interval; rollover() closes it, reports it, and adds it to
+       a rolling window of the last LATHIST_WINDOW_INTERVALS intervals,
+       which it reports too.  percentiles are the top of the bucket they
+       fall in, as with the raw writer's.  record() may be called from any
+       thread */
+
+#define LATHIST_SUB_BUCKETS	32	/* a power of 2 */
+#define LATHIST_SUB_BITS	5
+#define LATHIST_MAGNITUDES	27	/* up to 2^31 us, about 35 minutes */
+#define LATHIST_BUCKETS		(LATHIST_SUB_BUCKETS * LATHIST_MAGNITUDES)
+#define LATHIST_WINDOW_INTERVALS	60
+
+struct LatencySummary {
+    u_int count;
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+};
+
+class LatencyHistogram
+{
+protected:
+    pthread_mutex_t m_lock;
+    u_int m_current[LATHIST_BUCKETS];
+    double m_currentMax;		/* secs */
+    u_int (*m_intervals)[LATHIST_BUCKETS];
+    double m_intervalMax[LATHIST_WINDOW_INTERVALS];
+    int m_nextInterval;
+    u_int m_window[LATHIST_BUCKETS];	/* sum of m_intervals */
+
+    static int bucketFor(double secs);
+    static double bucketTopMs(int bucket);
+    static void summarize(const u_int *hist, double maxSecs,
+	LatencySummary *summary_p);
+public:
+    LatencyHistogram();
+    ~LatencyHistogram();
+    void record(double secs);
+    void rollover(LatencySummary *interval_p, LatencySummary *window_p);
+    void reset(void);
+};
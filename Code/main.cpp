@@ -33,7 +33,8 @@ extern const char *const mainDate = "$Date: 2015/04/24 16:48:57 $";
 
 int main(int argc, char *argv[])
 {
-    int fd, headless;
+    int fd, headless, opt;
+    char *end;
 
 	/* initialize thread support */
 
@@ -44,14 +45,33 @@ int main(int argc, char *argv[])
 	exit(1);
     }
 
-	/* init differently depending on whether or not we're headless */
-
-    if (argc == 1)
-	headless = 0;
-    else if (argc == 2 && strcmp(argv[1], "-h") == 0)
-	headless = 1;
-    else {
-	(void)fprintf(stderr, "usage: ngdcs [-h]\n");
+	/* init differently depending on whether or not we're headless.  with
+	   -r, frames come from a recorded flight line rather than the camera,
+	   at the recorded rate times -x's speed ("max" for flat out), and
+	   over again with -l */
+
+    headless = 0;
+    while ((opt=getopt(argc, argv, "hr:x:l")) != -1) {
+	if (opt == 'h')
+	    headless = 1;
+	else if (opt == 'r')
+	    appFrame::replayPath = optarg;
+	else if (opt == 'x') {
+	    if (strcmp(optarg, "max") == 0)
+		appFrame::replaySpeed = 0.0;
+	    else {
+		appFrame::replaySpeed = strtod(optarg, &end);
+		if (*end != '\0' || appFrame::replaySpeed <= 0.0)
+		    optind = argc + 1;
+	    }
+	}
+	else if (opt == 'l')
+	    appFrame::replayLoop = 1;
+	else optind = argc + 1;
+    }
+    if (optind != argc) {
+	(void)fprintf(stderr, "usage: ngdcs [-h] [-r <flightline>_raw "
+	    "[-x speed|max] [-l]]\n");
 	exit(1);
     }
     if (!headless)
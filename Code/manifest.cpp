@@ -0,0 +1,189 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tomcrypt.h>
+#include "manifest.h"
+
+extern const char *const manifestDate = "$Date: 2015/12/28 11:20:06 $";
+
+#define MANIFEST_HEADER		"NGDCS manifest\n"
+
+
+void digestToHex(char *hex, const manifest_digest_t digest)
+{
+    int i;
+
+    for (i=0;i < MANIFEST_DIGEST_BYTES;i++)
+	(void)sprintf(hex + 2*i, "%02x", digest[i]);
+}
+
+
+static int hexToDigest(manifest_digest_t digest, const char *hex)
+{
+    u_int byte;
+    int i;
+
+    for (i=0;i < MANIFEST_DIGEST_BYTES;i++) {
+	if (sscanf(hex + 2*i, "%2x", &byte) != 1)
+	    return -1;
+	digest[i] = (u_char)byte;
+    }
+    return 0;
+}
+
+
+int writeManifestHeader(FILE *fp, u_long frameBytes, int blockFrames)
+{
+    (void)fprintf(fp, MANIFEST_HEADER);
+    (void)fprintf(fp, "version = %d\n", MANIFEST_VERSION);
+    (void)fprintf(fp, "hash = sha256\n");
+    (void)fprintf(fp, "frame bytes = %lu\n", frameBytes);
+    (void)fprintf(fp, "block frames = %d\n", blockFrames);
+    return (fflush(fp) == EOF)? -1:0;
+}
+
+
+int writeManifestBlock(FILE *fp, u_int block, const manifest_digest_t digest)
+{
+    char hex[2*MANIFEST_DIGEST_BYTES+1];
+
+    digestToHex(hex, digest);
+    (void)fprintf(fp, "block %u = %s\n", block, hex);
+    return (fflush(fp) == EOF)? -1:0;
+}
+
+
+int writeManifestTrailer(FILE *fp, u_int frames, u_int blocks,
+    const manifest_digest_t digest)
+{
+    char hex[2*MANIFEST_DIGEST_BYTES+1];
+
+    digestToHex(hex, digest);
+    (void)fprintf(fp, "frames = %u\n", frames);
+    (void)fprintf(fp, "blocks = %u\n", blocks);
+    (void)fprintf(fp, "digest = %s\n", hex);
+    return (fflush(fp) == EOF)? -1:0;
+}
+
+
+void manifestDigest(manifest_digest_t digest,
+    const manifest_digest_t *digests, u_int blocks)
+{
+    hash_state state;
+
+    (void)sha256_init(&state);
+    (void)sha256_process(&state, (const u_char *)digests,
+	(u_long)blocks * MANIFEST_DIGEST_BYTES);
+    (void)sha256_done(&state, digest);
+}
+
+
+	/* grow the block arrays to hold block n */
+
+static void growManifest(manifest_t *m, u_int n, u_int *max_p)
+{
+    manifest_digest_t *digests;
+    u_char *have;
+    u_int max;
+
+    if (n < *max_p)
+	return;
+    max = (*max_p == 0)? 1024:*max_p;
+    while (max <= n)
+	max *= 2;
+    digests = new manifest_digest_t[max];
+    have = new u_char[max];
+    (void)memset(have, 0, max);
+    if (*max_p > 0) {
+	(void)memcpy(digests, m->digests, *max_p * sizeof(manifest_digest_t));
+	(void)memcpy(have, m->have, *max_p);
+    }
+    delete[] m->digests;
+    delete[] m->have;
+    m->digests = digests;
+    m->have = have;
+    *max_p = max;
+}
+
+
+int readManifest(const char *path, manifest_t *m, char *errorMsg)
+{
+    FILE *fp;
+    char buf[200], hex[2*MANIFEST_DIGEST_BYTES+1];
+    u_int block, blocks, max;
+    int haveDigest;
+
+    (void)memset(m, 0, sizeof(manifest_t));
+    if ((fp=fopen(path, "r")) == NULL) {
+	(void)sprintf(errorMsg, "Can't open manifest \"%s\".", path);
+	return -1;
+    }
+    if (fgets(buf, sizeof(buf), fp) == NULL ||
+	    strcmp(buf, MANIFEST_HEADER) != 0) {
+	(void)sprintf(errorMsg, "\"%s\" isn't a manifest.", path);
+	(void)fclose(fp);
+	return -1;
+    }
+    max = 0;
+    blocks = 0;
+    haveDigest = 0;
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+	if (sscanf(buf, "version = %d", &m->version) == 1) ;
+	else if (sscanf(buf, "frame bytes = %lu", &m->frameBytes) == 1) ;
+	else if (sscanf(buf, "block frames = %d", &m->blockFrames) == 1) ;
+	else if (sscanf(buf, "frames = %u", &m->frames) == 1) ;
+	else if (sscanf(buf, "blocks = %u", &blocks) == 1) ;
+	else if (sscanf(buf, "digest = %64s", hex) == 1)
+	    haveDigest = (hexToDigest(m->digest, hex) == 0);
+	else if (sscanf(buf, "block %u = %64s", &block, hex) == 2) {
+	    growManifest(m, block, &max);
+	    if (hexToDigest(m->digests[block], hex) == 0) {
+		m->have[block] = 1;
+		if (block >= m->blocks)
+		    m->blocks = block + 1;
+	    }
+	}
+    }
+    (void)fclose(fp);
+
+    if (m->version != MANIFEST_VERSION) {
+	(void)sprintf(errorMsg, "Unsupported manifest version %d.",
+	    m->version);
+	freeManifest(m);
+	return -1;
+    }
+    if (m->frameBytes == 0 || m->blockFrames < 1) {
+	(void)sprintf(errorMsg, "Manifest \"%s\" is incomplete.", path);
+	freeManifest(m);
+	return -1;
+    }
+    m->closed = (haveDigest && m->frames > 0 && blocks == m->blocks);
+    return 0;
+}
+
+
+void freeManifest(manifest_t *m)
+{
+    delete[] m->digests;
+    delete[] m->have;
+    m->digests = NULL;
+    m->have = NULL;
+}
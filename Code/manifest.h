@@ -0,0 +1,61 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <sys/types.h>
+
+    /* flight-line integrity manifest.  frames are taken in blocks of
+       MANIFEST_BLOCK_FRAMES, in recording order, and each block's bytes
+       (as they'd appear in the _raw file, whether or not it was striped
+       or compressed) get a SHA-256 digest.  the manifest is a small text
+       file next to the header, in the same "key = value" form as the
+       stripe index.  block lines are appended as blocks are finished, so
+       not necessarily in order, and are flushed as they go; at close the
+       frame and block counts follow, then the digest of the block
+       digests taken in order, which covers the whole flight line.  a
+       manifest without those last lines is from a recording that never
+       closed, and only its block lines can be checked */
+
+#define MANIFEST_SUFFIX		".sha256"	/* after the _raw */
+#define MANIFEST_VERSION	1
+#define MANIFEST_BLOCK_FRAMES	64
+#define MANIFEST_DIGEST_BYTES	32
+
+typedef u_char manifest_digest_t[MANIFEST_DIGEST_BYTES];
+
+typedef struct {
+    int version;
+    u_long frameBytes;
+    int blockFrames;
+    u_int frames;		/* 0 if the manifest was never closed */
+    u_int blocks;		/* as many as there are lines for */
+    manifest_digest_t *digests;	/* by block */
+    u_char *have;		/* whether each block has a line */
+    manifest_digest_t digest;	/* of all blocks, if closed */
+    int closed;
+} manifest_t;
+
+extern int writeManifestHeader(FILE *fp, u_long frameBytes, int blockFrames);
+extern int writeManifestBlock(FILE *fp, u_int block,
+    const manifest_digest_t digest);
+extern int writeManifestTrailer(FILE *fp, u_int frames, u_int blocks,
+    const manifest_digest_t digest);
+extern void manifestDigest(manifest_digest_t digest,
+    const manifest_digest_t *digests, u_int blocks);
+extern int readManifest(const char *path, manifest_t *m, char *errorMsg);
+extern void freeManifest(manifest_t *m);
+extern void digestToHex(char *hex, const manifest_digest_t digest);
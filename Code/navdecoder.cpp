@@ -0,0 +1,269 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <string.h>
+#include "navdecoder.h"
+
+extern const char *const navdecoderDate = "$Date: 2015/12/21 10:14:37 $";
+
+#define NAV_STATE_MAGIC		0
+#define NAV_STATE_ID		1
+#define NAV_STATE_COUNT		2
+#define NAV_STATE_FLAGS		3
+#define NAV_STATE_CHECKSUM	4
+#define NAV_STATE_DATA		5
+
+	/* one handler per state, in NAV_STATE_* order.  each takes the next
+	   word and returns the state to go to */
+
+const NavDecoder::state_fn_t NavDecoder::s_states[] = {
+    &NavDecoder::lookForMagic,
+    &NavDecoder::lookForId,
+    &NavDecoder::lookForCount,
+    &NavDecoder::lookForFlags,
+    &NavDecoder::lookForChecksum,
+    &NavDecoder::collectData
+};
+
+static const struct {
+    u_short id;
+    int words;
+} navMessages[NAV_NUM_MESSAGES] = {
+    { 3, GPS_MSG_3_WORDS },		/* time mark */
+    { 3500, GPS_MSG_3500_WORDS },	/* system status */
+    { 3501, GPS_MSG_3501_WORDS },	/* navigation solution */
+    { 3510, GPS_MSG_3510_WORDS },	/* initialization */
+    { 3512, GPS_MSG_3512_WORDS },	/* flight control */
+    { 3623, GPS_MSG_3623_WORDS }	/* GPS timing and status */
+};
+
+
+NavDecoder::NavDecoder()
+{
+    m_numSubscribers = 0;
+    reset();
+}
+
+
+void NavDecoder::reset(void)
+{
+    m_state = NAV_STATE_MAGIC;
+    m_msgIndex = -1;
+    m_words = 0;
+    m_sum = 0;
+    (void)memset(&m_stats, 0, sizeof(m_stats));
+}
+
+
+int NavDecoder::subscribe(u_short id, nav_handler_t handler, void *arg)
+{
+    if (m_numSubscribers >= NAV_MAX_SUBSCRIBERS ||
+	    (id != NAV_ALL_MESSAGES && messageIndex(id) < 0))
+	return -1;
+    m_subscribers[m_numSubscribers].id = id;
+    m_subscribers[m_numSubscribers].handler = handler;
+    m_subscribers[m_numSubscribers].arg = arg;
+    m_numSubscribers++;
+    return 0;
+}
+
+
+void NavDecoder::decode(const u_short *words, int count)
+{
+    int i;
+
+    for (i=0;i < count;i++)
+	step(words[i]);
+}
+
+
+void NavDecoder::getStats(nav_decoder_stats_t *stats_p) const
+{
+    *stats_p = m_stats;
+}
+
+
+int NavDecoder::messageIndex(u_short id)
+{
+    int i;
+
+    for (i=0;i < NAV_NUM_MESSAGES;i++)
+	if (navMessages[i].id == id)
+	    return i;
+    return -1;
+}
+
+
+u_short NavDecoder::messageId(int index)
+{
+    return navMessages[index].id;
+}
+
+
+int NavDecoder::messageWords(u_short id)
+{
+    int i;
+
+    i = messageIndex(id);
+    return (i < 0)? 0:navMessages[i].words;
+}
+
+
+void NavDecoder::step(u_short word)
+{
+    m_state = (this->*s_states[m_state])(word);
+}
+
+
+int NavDecoder::lookForMagic(u_short word)
+{
+    if (word != GPS_MAGIC_NUMBER) {
+	m_stats.wordsSkipped++;
+	return NAV_STATE_MAGIC;
+    }
+    m_msg[0] = word;
+    m_words = 1;
+    m_sum = word;
+    return NAV_STATE_ID;
+}
+
+
+int NavDecoder::lookForId(u_short word)
+{
+    m_msg[m_words++] = word;
+    m_sum += word;
+    if ((m_msgIndex=messageIndex(word)) < 0)
+	return resync();
+    return NAV_STATE_COUNT;
+}
+
+
+int NavDecoder::lookForCount(u_short word)
+{
+    m_msg[m_words++] = word;
+    m_sum += word;
+    if (word != navMessages[m_msgIndex].words - (NAV_HEADER_WORDS+1))
+	return resync();
+    return NAV_STATE_FLAGS;
+}
+
+
+int NavDecoder::lookForFlags(u_short word)
+{
+    m_msg[m_words++] = word;
+    m_sum += word;
+    return NAV_STATE_CHECKSUM;
+}
+
+
+int NavDecoder::lookForChecksum(u_short word)
+{
+    m_msg[m_words++] = word;
+    m_sum += word;
+    if (m_sum != 0)
+	return resync();
+
+	/* the header's good.  from here on we take words as they come */
+
+    m_sum = 0;
+    return NAV_STATE_DATA;
+}
+
+
+int NavDecoder::collectData(u_short word)
+{
+    m_msg[m_words++] = word;
+    m_sum += word;
+    if (m_words < navMessages[m_msgIndex].words)
+	return NAV_STATE_DATA;
+    deliver();
+    m_words = 0;
+    return NAV_STATE_MAGIC;
+}
+
+
+int NavDecoder::resync(void)
+{
+    u_short replay[NAV_HEADER_WORDS];
+    int i, n;
+
+	/* the magic number we started on wasn't a message after all.  look
+	   for the real one in whatever we've taken since.  this is at most a
+	   header's worth of words, and each pass through here starts one
+	   word later, so it can't go on for long */
+
+    m_stats.headerFailures++;
+    m_stats.wordsSkipped++;
+    n = m_words - 1;
+    (void)memcpy(replay, m_msg+1, n * sizeof(u_short));
+    m_state = NAV_STATE_MAGIC;
+    m_words = 0;
+    for (i=0;i < n;i++)
+	step(replay[i]);
+    return m_state;
+}
+
+
+static int combine(const u_short *usp)
+{
+    return (int)((u_int)usp[0] | ((u_int)usp[1] << 16));
+}
+
+
+void NavDecoder::deliver(void)
+{
+    nav_record_t rec;
+    int i;
+
+    rec.id = m_msg[1];
+    rec.words = m_words;
+    rec.msg = m_msg;
+    rec.dataChecksumOK = (m_sum == 0);
+    m_stats.messages[m_msgIndex]++;
+    if (!rec.dataChecksumOK)
+	m_stats.dataChecksumFailures++;
+
+	/* words 5-8 are the time tag in both of these */
+
+    switch (rec.id) {
+	case 3500:
+	    rec.u.status.mode = m_msg[9];
+	    rec.u.status.status = m_msg[10];
+	    rec.u.status.svsTracked = m_msg[11];
+	    break;
+	case 3501:
+	    rec.u.solution.latDeg = combine(m_msg+9) / 2147483648.0 * 180;
+	    rec.u.solution.lonDeg = combine(m_msg+11) / 2147483648.0 * 180;
+	    rec.u.solution.altitudeM = combine(m_msg+13) / 65536.0;
+	    rec.u.solution.velNorthMps = combine(m_msg+15) / 2097152.0;
+	    rec.u.solution.velEastMps = combine(m_msg+17) / 2097152.0;
+	    rec.u.solution.velUpMps = combine(m_msg+19) / 2097152.0;
+	    rec.u.solution.pitchDeg = combine(m_msg+21) / 2147483648.0 * 180;
+	    rec.u.solution.rollDeg = combine(m_msg+23) / 2147483648.0 * 180;
+	    rec.u.solution.headingDeg =
+		combine(m_msg+25) / 2147483648.0 * 180;
+	    break;
+	default:
+	    break;
+    }
+
+    for (i=0;i < m_numSubscribers;i++)
+	if (m_subscribers[i].id == NAV_ALL_MESSAGES ||
+		m_subscribers[i].id == rec.id)
+	    (*m_subscribers[i].handler)(m_subscribers[i].arg, &rec);
+}
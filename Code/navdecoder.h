@@ -0,0 +1,139 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <sys/types.h>
+
+    /* decoder for the INS/GPS messages embedded in the image stream.  each
+       message is a five-word header -- magic number, message id, data word
+       count, flags, header checksum -- followed by the data words and a
+       data checksum; either checksum brings the 16-bit sum of the words it
+       covers to zero.  the magic number can occur naturally in the data,
+       so a header is only believed once its id, count, and checksum all
+       agree, and if any of them doesn't the decoder rescans from the word
+       after the magic number it started on.
+
+       the state machine is driven by two tables, one of per-state word
+       handlers and one of known messages.  checksums are accumulated as
+       words arrive.  nothing is allocated after construction: messages
+       are assembled in the decoder's own buffer and handed to subscribers
+       as typed records that point into it, good only for the duration of
+       the callback.  words may be fed in pieces of any size.  a decoder
+       isn't thread-safe, but separate decoders are independent */
+
+#define GPS_MAGIC_NUMBER	0x81ff
+#define GPS_MSG_3_WORDS	    	82
+#define GPS_MSG_3500_WORDS	22
+#define GPS_MSG_3501_WORDS	28
+#define GPS_MSG_3510_WORDS	27
+#define GPS_MSG_3512_WORDS	22
+#define GPS_MSG_3623_WORDS      123
+#define GPS_MSG_MAX_WORDS	123
+
+	/* where the timing and nav data sit in a frame's header line, in
+	   bytes.  the PPS and GPS areas each start with 0xDEAD if there's
+	   nothing this frame, or a flag word and a word count if there is */
+
+#define TIMESTAMP_IMAGE_OFFSET		4
+#define OBC_STATE_IMAGE_OFFSET		640
+#define PPS_IMAGE_OFFSET		644
+#define MAX_PPSDATA_BYTES		40
+#define GPS_IMAGE_OFFSET		680
+#define MAX_GPSDATA_BYTES		600
+#define LOCAL_FRAME_COUNT_IMAGE_OFFSET	1248
+
+#define NAV_HEADER_WORDS	5
+#define NAV_NUM_MESSAGES	6
+#define NAV_MAX_SUBSCRIBERS	8
+#define NAV_ALL_MESSAGES	0	/* subscribe to everything */
+
+typedef struct {			/* 3500, system status */
+    int mode;
+    u_short status;
+    int svsTracked;
+} nav_status_t;
+
+typedef struct {			/* 3501, navigation solution */
+    double latDeg;
+    double lonDeg;
+    double altitudeM;
+    double velNorthMps;
+    double velEastMps;
+    double velUpMps;
+    double pitchDeg;
+    double rollDeg;
+    double headingDeg;
+} nav_solution_t;
+
+typedef struct {
+    u_short id;
+    int words;			/* header and data checksum included */
+    const u_short *msg;		/* the whole message, as received */
+    int dataChecksumOK;
+    union {
+	nav_status_t status;
+	nav_solution_t solution;
+    } u;			/* other messages are only available raw */
+} nav_record_t;
+
+typedef void (*nav_handler_t)(void *arg, const nav_record_t *rec);
+
+typedef struct {
+    u_int messages[NAV_NUM_MESSAGES];	/* by NavDecoder::messageIndex */
+    u_int headerFailures;
+    u_int dataChecksumFailures;
+    u_long wordsSkipped;		/* outside of any message */
+} nav_decoder_stats_t;
+
+class NavDecoder
+{
+protected:
+    typedef int (NavDecoder::*state_fn_t)(u_short word);
+
+    static const state_fn_t s_states[];
+    int m_state;
+    int m_msgIndex;
+    u_short m_msg[GPS_MSG_MAX_WORDS];
+    int m_words;
+    u_short m_sum;
+    struct {
+	u_short id;
+	nav_handler_t handler;
+	void *arg;
+    } m_subscribers[NAV_MAX_SUBSCRIBERS];
+    int m_numSubscribers;
+    nav_decoder_stats_t m_stats;
+
+    void step(u_short word);
+    int lookForMagic(u_short word);
+    int lookForId(u_short word);
+    int lookForCount(u_short word);
+    int lookForFlags(u_short word);
+    int lookForChecksum(u_short word);
+    int collectData(u_short word);
+    int resync(void);
+    void deliver(void);
+public:
+    NavDecoder();
+    void reset(void);
+    int subscribe(u_short id, nav_handler_t handler, void *arg);
+    void decode(const u_short *words, int count);
+    void getStats(nav_decoder_stats_t *stats_p) const;
+    static int messageIndex(u_short id);
+    static u_short messageId(int index);
+    static int messageWords(u_short id);
+};
@@ -0,0 +1,121 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include "navindex.h"
+
+extern const char *const navindexDate = "$Date: 2015/12/21 16:40:12 $";
+
+
+int openNavIndex(const char *path, nav_index_t *index, char *errorMsg)
+{
+    size_t bytes;
+
+    (void)memset(index, 0, sizeof(nav_index_t));
+    if ((index->fd=open(path, O_RDONLY)) == -1) {
+	(void)sprintf(errorMsg, "Can't open nav index \"%s\".", path);
+	return -1;
+    }
+    if (pread(index->fd, &index->header, sizeof(nav_index_header_t), 0) !=
+	    (ssize_t)sizeof(nav_index_header_t) ||
+	    memcmp(index->header.magic, NAVINDEX_MAGIC,
+		sizeof(index->header.magic)) != 0) {
+	(void)sprintf(errorMsg, "\"%s\" isn't a nav index.", path);
+	(void)close(index->fd);
+	return -1;
+    }
+    if (index->header.version != NAVINDEX_VERSION ||
+	    index->header.recordBytes != sizeof(nav_index_record_t)) {
+	(void)sprintf(errorMsg, "Unsupported nav index version %u.",
+	    index->header.version);
+	(void)close(index->fd);
+	return -1;
+    }
+
+	/* the PPS table is small (four bytes a second), so keep it handy */
+
+    index->ppsFrames = new u_int[index->header.ppsCount + 1];
+    bytes = index->header.ppsCount * sizeof(u_int);
+    if (pread(index->fd, index->ppsFrames, bytes,
+	    navIndexRecordOffset(index->header.frames)) != (ssize_t)bytes) {
+	(void)sprintf(errorMsg, "Nav index \"%s\" is incomplete.", path);
+	closeNavIndex(index);
+	return -1;
+    }
+    return 0;
+}
+
+
+void closeNavIndex(nav_index_t *index)
+{
+    (void)close(index->fd);
+    delete[] index->ppsFrames;
+    index->ppsFrames = NULL;
+}
+
+
+off_t navIndexRecordOffset(u_int frame)
+{
+    return sizeof(nav_index_header_t) +
+	(off_t)frame * sizeof(nav_index_record_t);
+}
+
+
+int readNavIndexRecord(const nav_index_t *index, u_int frame,
+    nav_index_record_t *rec)
+{
+    if (frame >= index->header.frames) {
+	errno = EINVAL;
+	return -1;
+    }
+    if (pread(index->fd, rec, sizeof(nav_index_record_t),
+	    navIndexRecordOffset(frame)) != sizeof(nav_index_record_t))
+	return -1;
+    return 0;
+}
+
+
+long navIndexFrameAtTime(const nav_index_t *index, double secs)
+{
+    const u_int *pps;
+    u_int n, count;
+    double frame, framesPerSec;
+
+	/* within the flight line, go from the PPS at or before the time.
+	   past the last one, go at the average rate */
+
+    pps = index->ppsFrames;
+    count = index->header.ppsCount;
+    if (secs < 0 || count == 0)
+	return -1;
+    n = (u_int)secs;
+    if (n+1 < count)
+	frame = pps[n] + (secs - n) * (pps[n+1] - pps[n]);
+    else {
+	framesPerSec = (count > 1)?
+	    (pps[count-1] - pps[0]) / (double)(count-1):0;
+	frame = pps[count-1] + (secs - (count-1)) * framesPerSec;
+    }
+    if (frame >= index->header.frames)
+	return -1;
+    return (long)frame;
+}
@@ -0,0 +1,72 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <sys/types.h>
+#include <sys/param.h>
+
+    /* per-frame navigation index for a flight line, built after the fact
+       by tools/mknavindex.  it's a fixed header, then one fixed-size record
+       per frame of the _raw file, then the frame at which each PPS was
+       seen, so finding the record for a frame, or the frame for a time,
+       takes no searching.  times are seconds from the first PPS in the
+       flight line.  position and attitude come from the 3501 messages,
+       which arrive far less often than frames; frames between two are
+       interpolated, and frames before the first or after the last just
+       take the nearest.  all values are in host byte order */
+
+#define NAVINDEX_SUFFIX		"_navindex"
+#define NAVINDEX_MAGIC		"NGDCSNAV"
+#define NAVINDEX_VERSION	1
+
+#define NAVINDEX_INTERPOLATED	0x1	/* between two nav solutions */
+#define NAVINDEX_HELD		0x2	/* nearest nav solution */
+#define NAVINDEX_PPS		0x4	/* PPS arrived with this frame */
+
+typedef struct {
+    char magic[8];
+    u_int version;
+    u_int recordBytes;
+    u_int frames;
+    u_int ppsCount;
+} nav_index_header_t;
+
+typedef struct {
+    u_int localFrameCount;
+    u_short timestamp;		/* FPIE timestamp from the header line */
+    u_short flags;		/* no position or attitude if 0 or PPS only */
+    int lat;			/* 2^31 = 180 degrees, as in 3501 */
+    int lon;
+    float altitudeM;
+    float pitchDeg;
+    float rollDeg;
+    float headingDeg;
+} nav_index_record_t;
+
+typedef struct {
+    int fd;
+    nav_index_header_t header;
+    u_int *ppsFrames;
+} nav_index_t;
+
+extern int openNavIndex(const char *path, nav_index_t *index,
+    char *errorMsg);
+extern void closeNavIndex(nav_index_t *index);
+extern int readNavIndexRecord(const nav_index_t *index, u_int frame,
+    nav_index_record_t *rec);
+extern long navIndexFrameAtTime(const nav_index_t *index, double secs);
+extern off_t navIndexRecordOffset(u_int frame);
@@ -0,0 +1,284 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "framering.h"
+#include "framebase.h"
+#include "navdecoder.h"
+#include "pacedbuf.h"
+
+extern const char *const pacedbufDate = "$Date: 2015/12/30 09:41:17 $";
+
+#define NO_PPS		0xDEAD
+
+
+static double monotonicNow(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+
+PacedFrameBuffer::PacedFrameBuffer(int fh, int fw,
+	void (*er)(const char *s)) :
+    FrameBuffer(fh, fw, er)
+{
+	/* note that we haven't had an error yet */
+
+    failed = 0;
+    *last_error = '\0';
+
+	/* init member variables.  nothing plays until the subclass has
+	   its frames ready and calls startPlaying */
+
+    m_paceRateHz = 0.0;
+    m_nominalRateHz = 0.0;
+    m_currentFrameRate = NUM_FRAMERATES-1;
+    (void)memset(m_slotFrames, 0, sizeof(m_slotFrames));
+    (void)memset(m_slotTimes, 0, sizeof(m_slotTimes));
+    m_lastArrival = 0.0;
+    (void)memset(m_frameDone, 0, sizeof(m_frameDone));
+    m_releaseIndex = 0;
+    m_framesHeld = 0;
+    m_started = false;
+    m_running = 0;
+    m_framesServed = 0;
+    m_framesDropped = 0;
+    m_ppsCount = 0;
+    m_maxBacklog = 0;
+    m_finished = 0;
+}
+
+
+PacedFrameBuffer::~PacedFrameBuffer()
+{
+    stopPlaying();
+}
+
+
+int PacedFrameBuffer::startPlaying(double paceRateHz, double nominalRateHz)
+{
+    m_paceRateHz = paceRateHz;
+    m_nominalRateHz = nominalRateHz;
+    if (m_ring.init(PACED_NUM_SLOTS) == -1) {
+	(void)strcpy(last_error, "Can't allocate frame ring.");
+	failed = 1;
+	return -1;
+    }
+    m_running = 1;
+    if (pthread_create(&m_thread, NULL, playThread, this) != 0) {
+	(void)strcpy(last_error, "Can't create frame-playing thread.");
+	m_running = 0;
+	failed = 1;
+	return -1;
+    }
+    m_started = true;
+    return 0;
+}
+
+
+void PacedFrameBuffer::stopPlaying(void)
+{
+	/* the thread calls back into the subclass, so the subclass has to
+	   stop it before its own destructor takes anything away */
+
+    m_running = 0;
+    m_ring.shutdown();
+    if (m_started)
+	(void)pthread_join(m_thread, NULL);
+    m_started = false;
+}
+
+
+void *PacedFrameBuffer::playThread(void *arg)
+{
+    PacedFrameBuffer *me = (PacedFrameBuffer *)arg;
+    const u_short *frame;
+    struct timespec due;
+    double start, dueSecs;
+    u_int n, backlog;
+    int slot, hadPPS, hasPPS;
+
+	/* frame n is due n/rate after we start, however late the ones
+	   before it were, as with a camera.  at rate 0 nothing is due; we
+	   just wait for room */
+
+    start = monotonicNow();
+    n = 0;
+    hadPPS = 0;
+    while (me->m_running) {
+	if (me->m_paceRateHz > 0.0) {
+	    dueSecs = start + n / me->m_paceRateHz;
+	    due.tv_sec = (time_t)dueSecs;
+	    due.tv_nsec = (long)((dueSecs - due.tv_sec) * 1.0e9);
+	    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due,
+		    NULL) == EINTR)
+		;
+	    slot = me->m_ring.acquireSlot(0);
+	}
+	else if ((slot=me->m_ring.acquireSlot(100000)) == -1) /* 100 ms */
+	    continue;
+	if ((frame=me->nextFrame(slot)) == NULL) {
+	    me->m_finished = 1;
+	    break;
+	}
+	n++;
+
+	    /* the card counts pulses, and a pulse marks the first of a run
+	       of frames with PPS data.  a frame with no room is lost, as on
+	       the card, but its pulse still counts */
+
+	hasPPS = (frame[PPS_IMAGE_OFFSET / sizeof(u_short)] != NO_PPS);
+	if (hasPPS && !hadPPS)
+	    me->m_ppsCount++;
+	hadPPS = hasPPS;
+	if (slot == -1) {
+	    me->m_framesDropped++;
+	    continue;
+	}
+	me->m_slotFrames[slot] = frame;
+	me->m_slotTimes[slot] = monotonicNow();
+	me->m_ring.publishSlot();
+	me->m_framesServed++;
+	backlog = me->m_ring.backlog();
+	if (backlog > me->m_maxBacklog)
+	    me->m_maxBacklog = backlog;
+    }
+    return NULL;
+}
+
+
+int PacedFrameBuffer::frameIsAvailable(void)
+{
+    if (failed) return 0;
+    return (m_ring.backlog() > 0);
+}
+
+
+int PacedFrameBuffer::waitForFrame(int timeoutUs)
+{
+	/* once we've played through there's nothing coming */
+
+    if (failed || (m_finished && m_ring.backlog() == 0)) {
+	if (timeoutUs > 0)
+	    (void)usleep(timeoutUs);
+	return 0;
+    }
+    return (m_ring.waitForData(timeoutUs) == 0);
+}
+
+
+void *PacedFrameBuffer::getFrame(void)
+{
+    int slot;
+
+    if (failed) return NULL;
+    if ((slot=m_ring.takeSlot(0)) == -1)
+	return NULL;
+    m_framesHeld++;
+    m_lastArrival = m_slotTimes[slot];
+    return (void *)m_slotFrames[slot];
+}
+
+
+void PacedFrameBuffer::releaseFrame(void *frame)
+{
+    int index, i;
+
+	/* as with the card, frames may come back in any order but go back
+	   to the ring in the order they were taken */
+
+    if (failed || frame == NULL)
+	return;
+    index = m_releaseIndex;
+    for (i=0;i < m_framesHeld;i++) {
+	if (m_slotFrames[index] == frame && !m_frameDone[index])
+	    break;
+	if (++index == PACED_NUM_SLOTS)
+	    index = 0;
+    }
+    if (i == m_framesHeld)
+	return;
+    m_frameDone[index] = 1;
+    while (m_framesHeld > 0 && m_frameDone[m_releaseIndex]) {
+	m_frameDone[m_releaseIndex] = 0;
+	m_framesHeld--;
+	if (++m_releaseIndex == PACED_NUM_SLOTS)
+	    m_releaseIndex = 0;
+	m_ring.releaseSlot();
+    }
+}
+
+
+void PacedFrameBuffer::getStats(u_int *dropped_p, u_int *backlog_p)
+{
+    if (dropped_p)
+	*dropped_p = failed? 0:m_framesDropped;
+    if (backlog_p)
+	*backlog_p = failed? 0:m_ring.backlog();
+}
+
+
+void PacedFrameBuffer::readCLSerial(char *buffer, int maxChars)
+{
+    if (maxChars > 0)
+	*buffer = '\0';
+}
+
+
+int PacedFrameBuffer::setFrameRate(int selection)
+{
+    if (selection < 0 || selection >= NUM_FRAMERATES)
+	selection = NUM_FRAMERATES-1;
+    m_currentFrameRate = selection;
+    return 0;
+}
+
+
+void PacedFrameBuffer::readSensors(int *numSensors_p, char ***sensorNames_p,
+    double **sensorValues_p, int **sensorRanges_p)
+{
+    *numSensors_p = 0;
+    *sensorNames_p = NULL;
+    *sensorValues_p = NULL;
+    *sensorRanges_p = NULL;
+}
+
+
+void PacedFrameBuffer::readFPGARegs(int *fpgaFrameCount_p,
+    int *fpgaPPSCount_p, int *fpga81ffCount_p, int *fpgaFramesDropped_p,
+    int *fpgaSerialErrors_p, int *fpgaSerialPortCtl_p, int *fpgaBufferDepth_p,
+    int *fpgaMaxBuffersUsed_p)
+{
+    *fpgaFrameCount_p = m_framesServed + m_framesDropped;
+    *fpgaPPSCount_p = m_ppsCount;
+    *fpga81ffCount_p = 0;
+    *fpgaFramesDropped_p = m_framesDropped;
+    *fpgaSerialErrors_p = 0;
+    *fpgaSerialPortCtl_p = 0;
+    *fpgaBufferDepth_p = PACED_NUM_SLOTS;
+    *fpgaMaxBuffersUsed_p = m_maxBacklog;
+}
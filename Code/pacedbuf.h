@@ -0,0 +1,107 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* base for the frame buffers that stand in for the card -- replaying
+       a flight line (replaybuf.h) or making frames up (synthbuf.h).  a
+       thread plays the part of the card's fetch thread, asking the
+       subclass for one frame after another and publishing them into a
+       ring at a steady rate.  if the consumer lets the ring fill, frames
+       are dropped and counted, as the card would.  with a rate of 0
+       there's no pacing at all; the thread just waits for room, so
+       nothing is dropped and the pipeline runs as fast as it can.
+
+       frames are handed out where the subclass keeps them, header line
+       and all.  the frame-rate selections are kept so settings carry
+       over, but they all give the one rate.  the card's serial ports,
+       GPIO, and sensors aren't there; writes are ignored and reads come
+       back empty */
+
+#define PACED_NUM_SLOTS		200	/* as many as the card has */
+
+class PacedFrameBuffer : public FrameBuffer
+{
+protected:
+    double m_paceRateHz;		/* 0 for as fast as possible */
+    double m_nominalRateHz;		/* what we tell the consumer */
+    int m_currentFrameRate;
+
+    FrameRing m_ring;
+    const u_short *m_slotFrames[PACED_NUM_SLOTS];
+    double m_slotTimes[PACED_NUM_SLOTS];
+    double m_lastArrival;
+    char m_frameDone[PACED_NUM_SLOTS];
+    int m_releaseIndex;
+    int m_framesHeld;
+    pthread_t m_thread;
+    bool m_started;
+    volatile int m_running;
+
+	/* what the card's registers would say */
+
+    volatile u_int m_framesServed;
+    volatile u_int m_framesDropped;
+    volatile u_int m_ppsCount;
+    volatile u_int m_maxBacklog;
+    volatile int m_finished;		/* nothing more coming */
+
+	/* the next frame, for ring slot slot, or NULL if there are no more.
+	   slot is -1 if the ring is full and the frame will be dropped, in
+	   which case only its header line is looked at */
+
+    virtual const u_short *nextFrame(int slot) = 0;
+    int startPlaying(double paceRateHz, double nominalRateHz);
+    void stopPlaying(void);
+    static void *playThread(void *arg);
+public:
+    PacedFrameBuffer(int fh, int fw, void (*er)(const char *));
+    virtual ~PacedFrameBuffer();
+    int frameIsAvailable(void);
+    int waitForFrame(int timeoutUs);
+    void *getFrame(void);
+    void releaseFrame(void *frame);
+    double frameArrivalTime(void) { return m_lastArrival; }
+    void getStats(u_int *dropped_p, u_int *backlog_p);
+    void setCCLines(int cc1, int cc2) { }
+    void setGPIO(u_int mask, u_int bits) { }
+    void setExtSerialBaud(int baud) { }
+    void setExtSerialParityEven(void) { }
+    void setExtSerialParityOdd(void) { }
+    void setExtSerialParityNone(void) { }
+    void setExtSerialTXInvertOff(void) { }
+    void setExtSerialTXInvertOn(void) { }
+    int writeExtSerial(u_char *bytes, int numBytes) { return numBytes; }
+    void writeCLSerial(char *string) { }
+    void readCLSerial(char *buffer, int maxChars);
+    int fpgaVersion(void) { return 0; }
+    int numFrameRates(void) { return NUM_FRAMERATES; }
+    double getFrameRateHz(void) { return m_nominalRateHz; }
+    double getFrameRateHz(int selection) { return m_nominalRateHz; }
+    int setFrameRate(int selection);
+    void readSensors(int *numSensors_p, char ***sensorNames_p,
+	double **sensorValues_p, int **sensorRanges_p);
+    u_int fpgaPPSCount(void) { return m_ppsCount; }
+    u_int fpgaBufferDepth(void) { return PACED_NUM_SLOTS; }
+    u_int fpgaBuffersUsed(void) { return m_ring.backlog(); }
+    void readFPGARegs(int *fpgaFrameCount_p, int *fpgaPPSCount_p,
+	int *fpga81ffCount_p, int *fpgaFramesDropped_p, int *serialErrors_p,
+	int *serialPortCtl_p, int *fpgaBufferDepth_p,
+	int *fpgaMaxBuffersUsed_p);
+    void clearSerialErrors(void) { }
+    void clearFPGAMaxBuffersUsed(void) { m_maxBacklog = 0; }
+    int finished(void) const { return m_finished; }
+};
@@ -0,0 +1,445 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "framebase.h"
+#include "pipeline.h"
+
+extern const char *const pipelineDate = "$Date: 2015/12/14 17:26:08 $";
+
+
+double pipelineNow(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+
+static void initMonotonicCond(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    (void)pthread_condattr_init(&attr);
+    (void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    (void)pthread_cond_init(cond, &attr);
+    (void)pthread_condattr_destroy(&attr);
+}
+
+
+static void makeDeadline(int timeoutUs, struct timespec *deadline_p)
+{
+    (void)clock_gettime(CLOCK_MONOTONIC, deadline_p);
+    deadline_p->tv_sec += timeoutUs / 1000000;
+    deadline_p->tv_nsec += (timeoutUs % 1000000) * 1000;
+    if (deadline_p->tv_nsec >= 1000000000) {
+	deadline_p->tv_sec++;
+	deadline_p->tv_nsec -= 1000000000;
+    }
+}
+
+
+FramePool::FramePool(FrameBuffer *fb, int numHandles, int frameWords)
+{
+    int i;
+
+    m_fb = fb;
+    m_numHandles = numHandles;
+    m_handles = new FrameHandle[numHandles];
+    m_freeList = new FrameHandle *[numHandles];
+    for (i=0;i < numHandles;i++) {
+	m_handles[i].storage = new u_short[frameWords];
+	(void)memset(m_handles[i].storage, 0, frameWords * sizeof(u_short));
+	m_handles[i].pixels = m_handles[i].storage;
+	m_handles[i].lease = NULL;
+	m_handles[i].frameCount = 0;
+	m_handles[i].acquireTime = 0.0;
+	m_handles[i].refs = 0;
+	m_freeList[i] = &m_handles[i];
+    }
+    m_numFree = numHandles;
+    m_shutdown = 0;
+    (void)pthread_mutex_init(&m_lock, NULL);
+    initMonotonicCond(&m_freeCond);
+}
+
+
+FramePool::~FramePool()
+{
+    int i;
+
+    for (i=0;i < m_numHandles;i++)
+	delete[] m_handles[i].storage;
+    delete[] m_handles;
+    delete[] m_freeList;
+    (void)pthread_cond_destroy(&m_freeCond);
+    (void)pthread_mutex_destroy(&m_lock);
+}
+
+
+FrameHandle *FramePool::alloc(int timeoutUs)
+{
+    FrameHandle *h;
+    struct timespec deadline;
+
+    if (timeoutUs > 0)
+	makeDeadline(timeoutUs, &deadline);
+    (void)pthread_mutex_lock(&m_lock);
+    while (m_numFree == 0 && !m_shutdown) {
+	if (timeoutUs == 0 ||
+		(timeoutUs > 0 && pthread_cond_timedwait(&m_freeCond, &m_lock,
+		    &deadline) == ETIMEDOUT)) {
+	    (void)pthread_mutex_unlock(&m_lock);
+	    return NULL;
+	}
+	else if (timeoutUs < 0)
+	    (void)pthread_cond_wait(&m_freeCond, &m_lock);
+    }
+    if (m_numFree == 0) { /* shutting down */
+	(void)pthread_mutex_unlock(&m_lock);
+	return NULL;
+    }
+    h = m_freeList[--m_numFree];
+    (void)pthread_mutex_unlock(&m_lock);
+
+    h->pixels = h->storage;
+    h->lease = NULL;
+    h->frameCount = 0;
+    h->acquireTime = pipelineNow();
+    h->refs = 1;
+    return h;
+}
+
+
+void FramePool::ref(FrameHandle *h)
+{
+    (void)__sync_add_and_fetch(&h->refs, 1);
+}
+
+
+void FramePool::unref(FrameHandle *h)
+{
+    if (__sync_sub_and_fetch(&h->refs, 1) != 0)
+	return;
+
+	/* last one out gives the framebuffer its frame back.  the
+	   framebuffer's getFrame/releaseFrame aren't thread-safe against
+	   each other, so they're only ever called under our lock */
+
+    (void)pthread_mutex_lock(&m_lock);
+    if (h->lease != NULL) {
+	m_fb->releaseFrame(h->lease);
+	h->lease = NULL;
+    }
+    m_freeList[m_numFree++] = h;
+    (void)pthread_cond_signal(&m_freeCond);
+    (void)pthread_mutex_unlock(&m_lock);
+}
+
+
+void *FramePool::getFrame(void)
+{
+    void *result;
+
+    (void)pthread_mutex_lock(&m_lock);
+    result = m_fb->getFrame();
+    (void)pthread_mutex_unlock(&m_lock);
+    return result;
+}
+
+
+void FramePool::releaseFrame(void *frame)
+{
+    (void)pthread_mutex_lock(&m_lock);
+    m_fb->releaseFrame(frame);
+    (void)pthread_mutex_unlock(&m_lock);
+}
+
+
+int FramePool::numFree(void)
+{
+    int result;
+
+    (void)pthread_mutex_lock(&m_lock);
+    result = m_numFree;
+    (void)pthread_mutex_unlock(&m_lock);
+    return result;
+}
+
+
+void FramePool::shutdown(void)
+{
+    (void)pthread_mutex_lock(&m_lock);
+    m_shutdown = 1;
+    (void)pthread_cond_broadcast(&m_freeCond);
+    (void)pthread_mutex_unlock(&m_lock);
+}
+
+
+FrameQueue::FrameQueue(int size, bool dropWhenFull)
+{
+    m_entries = new FrameHandle *[size];
+    m_size = size;
+    m_head = 0;
+    m_count = 0;
+    m_dropWhenFull = dropWhenFull;
+    m_shutdown = 0;
+    (void)pthread_mutex_init(&m_lock, NULL);
+    initMonotonicCond(&m_notEmpty);
+    initMonotonicCond(&m_notFull);
+}
+
+
+FrameQueue::~FrameQueue()
+{
+    delete[] m_entries;
+    (void)pthread_cond_destroy(&m_notEmpty);
+    (void)pthread_cond_destroy(&m_notFull);
+    (void)pthread_mutex_destroy(&m_lock);
+}
+
+
+int FrameQueue::put(FrameHandle *h)
+{
+	/* returns -1 if the frame wasn't queued, either because we drop
+	   when full or because we're shutting down */
+
+    (void)pthread_mutex_lock(&m_lock);
+    while (m_count == m_size && !m_shutdown) {
+	if (m_dropWhenFull) {
+	    (void)pthread_mutex_unlock(&m_lock);
+	    return -1;
+	}
+	(void)pthread_cond_wait(&m_notFull, &m_lock);
+    }
+    if (m_shutdown) {
+	(void)pthread_mutex_unlock(&m_lock);
+	return -1;
+    }
+    m_entries[(m_head + m_count) % m_size] = h;
+    m_count++;
+    (void)pthread_cond_signal(&m_notEmpty);
+    (void)pthread_mutex_unlock(&m_lock);
+    return 0;
+}
+
+
+FrameHandle *FrameQueue::get(int timeoutUs, int *shutdown_p)
+{
+    FrameHandle *h;
+    struct timespec deadline;
+
+	/* on shutdown we keep handing out what's queued, so the recording
+	   stage can finish writing, and only then report that we're done */
+
+    *shutdown_p = 0;
+    if (timeoutUs > 0)
+	makeDeadline(timeoutUs, &deadline);
+    (void)pthread_mutex_lock(&m_lock);
+    while (m_count == 0) {
+	if (m_shutdown) {
+	    *shutdown_p = 1;
+	    (void)pthread_mutex_unlock(&m_lock);
+	    return NULL;
+	}
+	if (timeoutUs == 0 ||
+		(timeoutUs > 0 && pthread_cond_timedwait(&m_notEmpty, &m_lock,
+		    &deadline) == ETIMEDOUT)) {
+	    (void)pthread_mutex_unlock(&m_lock);
+	    return NULL;
+	}
+	else if (timeoutUs < 0)
+	    (void)pthread_cond_wait(&m_notEmpty, &m_lock);
+    }
+    h = m_entries[m_head];
+    m_head = (m_head + 1) % m_size;
+    m_count--;
+    (void)pthread_cond_signal(&m_notFull);
+    (void)pthread_mutex_unlock(&m_lock);
+    return h;
+}
+
+
+int FrameQueue::depth(void)
+{
+    int result;
+
+    (void)pthread_mutex_lock(&m_lock);
+    result = m_count;
+    (void)pthread_mutex_unlock(&m_lock);
+    return result;
+}
+
+
+void FrameQueue::shutdown(void)
+{
+    (void)pthread_mutex_lock(&m_lock);
+    m_shutdown = 1;
+    (void)pthread_cond_broadcast(&m_notEmpty);
+    (void)pthread_cond_broadcast(&m_notFull);
+    (void)pthread_mutex_unlock(&m_lock);
+}
+
+
+PipelineStage::PipelineStage(const char *name, FramePool *pool, int queueSize,
+	bool dropWhenFull, PipelineHandler handler, void *arg, int idleUs,
+	int rtPriority, int niceness) :
+    m_queue(queueSize, dropWhenFull)
+{
+    m_name = name;
+    m_pool = pool;
+    m_handler = handler;
+    m_arg = arg;
+    m_idleUs = idleUs;
+    m_rtPriority = rtPriority;
+    m_niceness = niceness;
+    m_started = false;
+
+    (void)pthread_mutex_init(&m_statsLock, NULL);
+    m_frames = 0;
+    m_dropped = 0;
+    m_maxDepth = 0;
+    m_latencySum = 0.0;
+    m_latencyMax = 0.0;
+}
+
+
+PipelineStage::~PipelineStage()
+{
+    stop();
+    (void)pthread_mutex_destroy(&m_statsLock);
+}
+
+
+int PipelineStage::start(void)
+{
+    if (m_started)
+	return 0;
+    if (pthread_create(&m_thread, NULL, threadMain, this) != 0)
+	return -1;
+    m_started = true;
+    return 0;
+}
+
+
+void PipelineStage::stop(void)
+{
+	/* anything already queued is still handled before the thread exits */
+
+    if (!m_started)
+	return;
+    m_queue.shutdown();
+    (void)pthread_join(m_thread, NULL);
+    m_started = false;
+}
+
+
+int PipelineStage::submit(FrameHandle *h)
+{
+    int depth;
+
+	/* the queue holds its own reference, which the stage drops once
+	   it's done with the frame */
+
+    m_pool->ref(h);
+    if (m_queue.put(h) == -1) {
+	m_pool->unref(h);
+	(void)pthread_mutex_lock(&m_statsLock);
+	m_dropped++;
+	(void)pthread_mutex_unlock(&m_statsLock);
+	return -1;
+    }
+    depth = m_queue.depth();
+    (void)pthread_mutex_lock(&m_statsLock);
+    if (depth > m_maxDepth)
+	m_maxDepth = depth;
+    (void)pthread_mutex_unlock(&m_statsLock);
+    return 0;
+}
+
+
+void PipelineStage::getStats(PipelineStats *stats_p)
+{
+	/* stats cover the period since the last call */
+
+    stats_p->depth = m_queue.depth();
+    (void)pthread_mutex_lock(&m_statsLock);
+    stats_p->maxDepth = m_maxDepth;
+    stats_p->frames = m_frames;
+    stats_p->dropped = m_dropped;
+    stats_p->avgLatencyMs = (m_frames == 0)? 0.0 :
+	1000.0 * m_latencySum / m_frames;
+    stats_p->maxLatencyMs = 1000.0 * m_latencyMax;
+    m_frames = 0;
+    m_dropped = 0;
+    m_maxDepth = stats_p->depth;
+    m_latencySum = 0.0;
+    m_latencyMax = 0.0;
+    (void)pthread_mutex_unlock(&m_statsLock);
+}
+
+
+void *PipelineStage::threadMain(void *arg)
+{
+    PipelineStage *me = (PipelineStage *)arg;
+    FrameHandle *h;
+    struct sched_param param;
+    double latency;
+    int shutdown;
+
+	/* recording gets real-time priority if we're allowed it, and a
+	   better nice value if not; display runs nicer than everything */
+
+    if (me->m_rtPriority > 0) {
+	(void)memset(&param, 0, sizeof(param));
+	param.sched_priority = me->m_rtPriority;
+	if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0 &&
+		me->m_niceness != 0)
+	    (void)setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid),
+		me->m_niceness);
+    }
+    else if (me->m_niceness != 0)
+	(void)setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid),
+	    me->m_niceness);
+
+    for (;;) {
+	h = me->m_queue.get(me->m_idleUs, &shutdown);
+	if (shutdown)
+	    break;
+	(*me->m_handler)(me->m_arg, h);
+	if (h != NULL) {
+	    latency = pipelineNow() - h->acquireTime;
+	    (void)pthread_mutex_lock(&me->m_statsLock);
+	    me->m_frames++;
+	    me->m_latencySum += latency;
+	    if (latency > me->m_latencyMax)
+		me->m_latencyMax = latency;
+	    (void)pthread_mutex_unlock(&me->m_statsLock);
+	    me->m_pool->unref(h);
+	}
+    }
+    return NULL;
+}
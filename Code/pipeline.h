@@ -0,0 +1,145 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+#include <pthread.h>
+#include <sys/types.h>
+
+    /* capture pipeline.  frames are acquired into reference-counted
+       handles from a fixed pool and passed from stage to stage through
+       bounded queues, each stage running on its own thread.  a stage
+       either blocks its feeder when its queue is full (recording -- we
+       never want to lose data there) or drops the frame (display -- it
+       can always catch up with the next one).  when the last reference
+       to a handle goes away, any frame leased from the framebuffer is
+       given back */
+
+#define PIPELINE_POOL_FRAMES	48
+#define PIPELINE_PROCESS_QUEUE	16
+#define PIPELINE_RECORD_QUEUE	PIPELINE_POOL_FRAMES
+#define PIPELINE_DISPLAY_QUEUE	4
+#define PIPELINE_DARK_QUEUE	8
+#define PIPELINE_STATS_QUEUE	2
+#define PIPELINE_QUICKLOOK_QUEUE	2
+#define PIPELINE_HASH_QUEUE	16
+
+#define PIPELINE_WAIT_FOREVER	-1
+
+class FrameBuffer;
+
+struct FrameHandle {
+    u_short *pixels;		/* the frame, wherever it lives */
+    u_short *storage;		/* our own copy, if we needed one */
+    void *lease;		/* framebuffer's frame, if we're holding it */
+    u_int frameCount;
+    double acquireTime;		/* secs, monotonic */
+    int refs;
+};
+
+class FramePool
+{
+protected:
+    FrameBuffer *m_fb;
+    int m_numHandles;
+    FrameHandle *m_handles;
+    FrameHandle **m_freeList;
+    int m_numFree;
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_freeCond;
+    int m_shutdown;
+public:
+    FramePool(FrameBuffer *fb, int numHandles, int frameWords);
+    ~FramePool();
+    FrameHandle *alloc(int timeoutUs);
+    void ref(FrameHandle *h);
+    void unref(FrameHandle *h);
+    void *getFrame(void);
+    void releaseFrame(void *frame);
+    int numFree(void);
+    void shutdown(void);
+};
+
+class FrameQueue
+{
+protected:
+    FrameHandle **m_entries;
+    int m_size;
+    int m_head;
+    int m_count;
+    bool m_dropWhenFull;
+    int m_shutdown;
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_notEmpty;
+    pthread_cond_t m_notFull;
+public:
+    FrameQueue(int size, bool dropWhenFull);
+    ~FrameQueue();
+    int put(FrameHandle *h);
+    FrameHandle *get(int timeoutUs, int *shutdown_p);
+    int depth(void);
+    void shutdown(void);
+};
+
+struct PipelineStats {
+    int depth;
+    int maxDepth;
+    u_int frames;
+    u_int dropped;
+    double avgLatencyMs;	/* acquisition to end of this stage */
+    double maxLatencyMs;
+};
+
+    /* handler is called once per frame, or with a NULL handle if nothing
+       has arrived for idleUs (so the stage can do housekeeping) */
+
+typedef void (*PipelineHandler)(void *arg, FrameHandle *h);
+
+class PipelineStage
+{
+protected:
+    const char *m_name;
+    FramePool *m_pool;
+    FrameQueue m_queue;
+    PipelineHandler m_handler;
+    void *m_arg;
+    int m_idleUs;
+    int m_rtPriority;
+    int m_niceness;
+    pthread_t m_thread;
+    bool m_started;
+
+    pthread_mutex_t m_statsLock;
+    u_int m_frames;
+    u_int m_dropped;
+    int m_maxDepth;
+    double m_latencySum;
+    double m_latencyMax;
+
+    static void *threadMain(void *arg);
+public:
+    PipelineStage(const char *name, FramePool *pool, int queueSize,
+	bool dropWhenFull, PipelineHandler handler, void *arg, int idleUs,
+	int rtPriority, int niceness);
+    ~PipelineStage();
+    int start(void);
+    void stop(void);
+    int submit(FrameHandle *h);
+    int depth(void) { return m_queue.depth(); }
+    const char *name(void) const { return m_name; }
+    void getStats(PipelineStats *stats_p);
+};
+
+extern double pipelineNow(void);
@@ -0,0 +1,153 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include "quicklookwriter.h"
+
+extern const char *const quicklookwriterDate =
+    "$Date: 2015/12/22 14:52:40 $";
+
+
+QuicklookWriter::QuicklookWriter(int samples)
+{
+    m_samples = samples;
+    m_width = samples / QUICKLOOK_DECIMATION;
+    m_fp = NULL;
+    m_row = new u_char[3 * m_width];
+    (void)memset(m_row, 0, 3 * m_width);
+    m_rows = 0;
+    m_lastFrameCount = 0;
+}
+
+
+QuicklookWriter::~QuicklookWriter()
+{
+    (void)close();
+    delete[] m_row;
+}
+
+
+int QuicklookWriter::writeHeader(void)
+{
+    if (fseek(m_fp, 0, SEEK_SET) == -1 ||
+	    fprintf(m_fp, "P6\n%d %10u\n255\n", m_width, m_rows) < 0 ||
+	    fseek(m_fp, 0, SEEK_END) == -1 || fflush(m_fp) == EOF)
+	return -1;
+    return 0;
+}
+
+
+int QuicklookWriter::open(const char *path)
+{
+    (void)close();
+    if ((m_fp=fopen(path, "wb")) == NULL)
+	return -1;
+    m_rows = 0;
+    if (writeHeader() == -1) {
+	(void)close();
+	return -1;
+    }
+    return 0;
+}
+
+
+int QuicklookWriter::close(void)
+{
+    int result;
+
+    if (m_fp == NULL)
+	return 0;
+    result = writeHeader();
+    if (fclose(m_fp) == EOF)
+	result = -1;
+    m_fp = NULL;
+    return result;
+}
+
+
+int QuicklookWriter::writeRow(void)
+{
+    if (fwrite(m_row, 3, m_width, m_fp) != (size_t)m_width)
+	return -1;
+    m_rows++;
+    if (m_rows % QUICKLOOK_HEADER_ROWS == 0)
+	return writeHeader();
+    return 0;
+}
+
+
+	/* bands are lines of the frame, as in the band settings.  dark and
+	   mask are NULL for no dark subtraction; otherwise a bad pixel takes
+	   its neighbor's value, as on the display */
+
+int QuicklookWriter::addFrame(const u_short *image, u_int frameCount,
+    const int *bands, const u_short *dark, const u_char *mask,
+    const u_char *const *luts)
+{
+    const u_short *usp, *dfp;
+    const u_char *mp;
+    u_int missing;
+    int c, i, j, value, last, sum;
+
+    if (m_fp == NULL)
+	return 0;
+
+	/* frames the stage dropped get the last row again, so the
+	   quicklook keeps the flight line's proportions */
+
+    if (m_rows > 0 && frameCount > m_lastFrameCount) {
+	missing = (frameCount - m_lastFrameCount) / QUICKLOOK_DECIMATION;
+	if (missing > QUICKLOOK_MAX_FILL_ROWS)
+	    missing = QUICKLOOK_MAX_FILL_ROWS;
+	while (missing-- > 1)
+	    if (writeRow() == -1)
+		return -1;
+    }
+    m_lastFrameCount = frameCount;
+
+    for (c=0;c < 3;c++) {
+	usp = image + bands[c] * m_samples;
+	dfp = (dark == NULL)? NULL:dark + bands[c] * m_samples;
+	mp = (mask == NULL)? NULL:mask + bands[c] * m_samples;
+	last = 0;
+	for (i=0;i < m_width;i++) {
+	    sum = 0;
+	    for (j=0;j < QUICKLOOK_DECIMATION;j++,usp++) {
+		if (dfp == NULL)
+		    value = *usp;
+		else {
+		    if (*mp)
+			value = last;
+		    else {
+			value = *usp - *dfp;
+			if (value < 0)
+			    value = 0;
+		    }
+		    dfp++;
+		    mp++;
+		}
+		last = value;
+		sum += value;
+	    }
+	    m_row[3*i+c] = luts[c][sum / QUICKLOOK_DECIMATION];
+	}
+    }
+    return writeRow();
+}
@@ -0,0 +1,53 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* quicklook of a flight line, written as it's recorded.  each row is
+       one frame in QUICKLOOK_DECIMATION, with QUICKLOOK_DECIMATION samples
+       averaged into each pixel, colored with the display's bands and
+       stretch.  the file is a PPM with its height rewritten every so often
+       and at the end, so what's there so far can be looked at any time.
+       the height is padded to a fixed width for that, which PPM allows.
+       only one row is ever held, however long the flight line */
+
+#define QUICKLOOK_SUFFIX	"_quicklook.ppm"
+#define QUICKLOOK_DECIMATION	4
+#define QUICKLOOK_HEADER_ROWS	64	/* rows per height update */
+#define QUICKLOOK_MAX_FILL_ROWS	64	/* longest gap filled */
+
+class QuicklookWriter
+{
+protected:
+    int m_samples;
+    int m_width;
+    FILE *m_fp;
+    u_char *m_row;
+    u_int m_rows;
+    u_int m_lastFrameCount;
+
+    int writeHeader(void);
+    int writeRow(void);
+public:
+    QuicklookWriter(int samples);
+    ~QuicklookWriter();
+    int open(const char *path);
+    int close(void);
+    int isOpen(void) const { return m_fp != NULL; }
+    int addFrame(const u_short *image, u_int frameCount, const int *bands,
+	const u_short *dark, const u_char *mask, const u_char *const *luts);
+    u_int rows(void) const { return m_rows; }
+};
@@ -0,0 +1,500 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* for O_DIRECT */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "pipeline.h"
+#include "tracer.h"
+#include "rawwriter.h"
+
+extern const char *const rawwriterDate = "$Date: 2015/12/16 21:40:12 $";
+
+
+RawImageWriter::RawImageWriter()
+{
+    int i;
+
+    m_fd = -1;
+    m_direct = false;
+    m_frameBytes = 0;
+    m_chunkBytes = 0;
+    m_frameRateHz = 0.0;
+    for (i=0;i < RAWWRITER_NUM_CHUNKS;i++) {
+	m_chunks[i] = NULL;
+	m_chunkOffsets[i] = 0;
+	m_chunkSizes[i] = 0;
+    }
+    m_fillChunk = -1;
+    m_fillBytes = 0;
+    m_numFree = 0;
+    m_queueHead = 0;
+    m_queueCount = 0;
+    m_writesInProgress = 0;
+    m_nextOffset = 0;
+    m_allocatedTo = 0;
+    m_allocRetryAt = 0;
+    m_extendBytes = 0;
+    m_bytesAccepted = 0;
+    m_numThreads = 0;
+    m_shutdown = 0;
+    m_error = 0;
+    (void)memset(m_latencyHist, 0, sizeof(m_latencyHist));
+    m_latencyMax = 0.0;
+    m_windowBytes = 0.0;
+    m_windowStart = pipelineNow();
+    m_chunksWritten = 0;
+    (void)memset(m_totalHist, 0, sizeof(m_totalHist));
+    m_totalMax = 0.0;
+    m_totalBytes = 0.0;
+    m_openTime = m_windowStart;
+    m_totalChunks = 0;
+    (void)pthread_mutex_init(&m_lock, NULL);
+    (void)pthread_cond_init(&m_workCond, NULL);
+    (void)pthread_cond_init(&m_doneCond, NULL);
+}
+
+
+RawImageWriter::~RawImageWriter()
+{
+    int i;
+
+    if (m_fd != -1)
+	(void)close();
+    for (i=0;i < RAWWRITER_NUM_CHUNKS;i++)
+	if (m_chunks[i])
+	    free(m_chunks[i]);
+    (void)pthread_cond_destroy(&m_doneCond);
+    (void)pthread_cond_destroy(&m_workCond);
+    (void)pthread_mutex_destroy(&m_lock);
+}
+
+
+int RawImageWriter::open(const char *path, size_t frameBytes,
+    double frameRateHz, double plannedSecs)
+{
+    size_t chunkBytes;
+    off_t planned;
+    int i, saveErrno;
+
+    if (m_fd != -1) {
+	errno = EBUSY;
+	return -1;
+    }
+
+	/* chunks hold a few frames, rounded up to the alignment O_DIRECT
+	   wants.  frames don't have to line up with chunk boundaries --
+	   they're just a byte stream laid end to end */
+
+    chunkBytes = frameBytes * RAWWRITER_CHUNK_FRAMES;
+    chunkBytes = (chunkBytes + RAWWRITER_ALIGN - 1) &
+	~(size_t)(RAWWRITER_ALIGN - 1);
+    if (chunkBytes != m_chunkBytes) {
+	for (i=0;i < RAWWRITER_NUM_CHUNKS;i++) {
+	    if (m_chunks[i])
+		free(m_chunks[i]);
+	    m_chunks[i] = NULL;
+	    if (posix_memalign((void **)&m_chunks[i], RAWWRITER_ALIGN,
+		    chunkBytes) != 0) {
+		m_chunkBytes = 0;
+		errno = ENOMEM;
+		return -1;
+	    }
+	}
+	m_chunkBytes = chunkBytes;
+    }
+    m_frameBytes = frameBytes;
+    m_frameRateHz = frameRateHz;
+
+    m_fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    m_direct = true;
+    if (m_fd == -1 && errno == EINVAL) {
+	m_fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	m_direct = false;
+    }
+    if (m_fd == -1)
+	return -1;
+
+	/* preallocate for what we expect to record.  failing here isn't
+	   fatal -- not every filesystem supports it, and if we're really out
+	   of space the writes will say so */
+
+    m_extendBytes = (off_t)(frameRateHz * RAWWRITER_EXTEND_SECS) *
+	(off_t)frameBytes;
+    m_extendBytes = (m_extendBytes + m_chunkBytes - 1) / m_chunkBytes *
+	m_chunkBytes;
+    planned = (off_t)(frameRateHz * plannedSecs) * (off_t)frameBytes;
+    if (planned < m_extendBytes)
+	planned = m_extendBytes;
+    m_allocatedTo = 0;
+    m_allocRetryAt = 0;
+    m_nextOffset = 0;
+    extendAllocation(planned);
+
+    m_fillChunk = 0;
+    m_fillBytes = 0;
+    m_numFree = 0;
+    for (i=RAWWRITER_NUM_CHUNKS-1;i > 0;i--)
+	m_freeList[m_numFree++] = i;
+    m_queueHead = 0;
+    m_queueCount = 0;
+    m_writesInProgress = 0;
+    m_bytesAccepted = 0;
+    m_shutdown = 0;
+    m_error = 0;
+    (void)memset(m_latencyHist, 0, sizeof(m_latencyHist));
+    m_latencyMax = 0.0;
+    m_windowBytes = 0.0;
+    m_windowStart = pipelineNow();
+    m_chunksWritten = 0;
+    (void)memset(m_totalHist, 0, sizeof(m_totalHist));
+    m_totalMax = 0.0;
+    m_totalBytes = 0.0;
+    m_openTime = m_windowStart;
+    m_totalChunks = 0;
+
+    for (m_numThreads=0;m_numThreads < RAWWRITER_NUM_THREADS;m_numThreads++)
+	if (pthread_create(&m_threads[m_numThreads], NULL, threadMain,
+		this) != 0)
+	    break;
+    if (m_numThreads == 0) {
+	saveErrno = errno;
+	(void)::close(m_fd);
+	m_fd = -1;
+	errno = saveErrno;
+	return -1;
+    }
+    return 0;
+}
+
+
+void RawImageWriter::extendAllocation(off_t needed)
+{
+    off_t len;
+
+    if (needed <= m_allocatedTo)
+	return;
+    len = needed - m_allocatedTo;
+    if (len < m_extendBytes)
+	len = m_extendBytes;
+
+	/* keep the file size where it is, so a recording that's never
+	   closed is only as long as what was written.  if the allocation
+	   fails (perhaps the disk is briefly full) try again once another
+	   half extension has been written rather than on every chunk */
+
+    if (fallocate(m_fd, FALLOC_FL_KEEP_SIZE, m_allocatedTo, len) == 0)
+	m_allocatedTo += len;
+    else m_allocRetryAt = m_nextOffset + m_extendBytes / 2;
+}
+
+
+int RawImageWriter::writeFrame(const void *frame)
+{
+    const char *cp = (const char *)frame;
+    size_t left, n;
+
+    if (m_fd == -1 || m_error) {
+	errno = (m_fd == -1)? EBADF:m_error;
+	return -1;
+    }
+    left = m_frameBytes;
+    while (left > 0) {
+	n = m_chunkBytes - m_fillBytes;
+	if (n > left)
+	    n = left;
+	(void)memcpy(m_chunks[m_fillChunk] + m_fillBytes, cp, n);
+	m_fillBytes += n;
+	cp += n;
+	left -= n;
+	if (m_fillBytes == m_chunkBytes &&
+		queueFillChunk(m_chunkBytes) == -1)
+	    return -1;
+    }
+    m_bytesAccepted += m_frameBytes;
+    return 0;
+}
+
+
+int RawImageWriter::queueFillChunk(size_t bytes)
+{
+	/* keep the preallocation ahead of us -- by half an extension, so
+	   the fallocate happens well before the writers get there */
+
+    if (m_nextOffset + (off_t)bytes + m_extendBytes / 2 > m_allocatedTo &&
+	    m_nextOffset >= m_allocRetryAt)
+	extendAllocation(m_nextOffset + (off_t)bytes + m_extendBytes);
+
+    (void)pthread_mutex_lock(&m_lock);
+    m_chunkOffsets[m_fillChunk] = m_nextOffset;
+    m_chunkSizes[m_fillChunk] = bytes;
+    m_queue[(m_queueHead + m_queueCount) % RAWWRITER_NUM_CHUNKS] =
+	m_fillChunk;
+    m_queueCount++;
+    (void)pthread_cond_signal(&m_workCond);
+    m_nextOffset += bytes;
+
+	/* wait for a free chunk.  if the disk can't keep up this is where
+	   recording backs up, which in turn blocks the pipeline feeding us */
+
+    while (m_numFree == 0 && !m_error)
+	(void)pthread_cond_wait(&m_doneCond, &m_lock);
+    if (m_numFree == 0) {
+	m_fillChunk = -1;
+	errno = m_error;
+	(void)pthread_mutex_unlock(&m_lock);
+	return -1;
+    }
+    m_fillChunk = m_freeList[--m_numFree];
+    m_fillBytes = 0;
+    (void)pthread_mutex_unlock(&m_lock);
+    return 0;
+}
+
+
+int RawImageWriter::close(void)
+{
+    size_t padded;
+    int i, result, saveErrno;
+
+    if (m_fd == -1)
+	return 0;
+
+	/* write out the partial last chunk, padded to the alignment */
+
+    result = 0;
+    if (m_fillChunk != -1 && m_fillBytes > 0 && !m_error) {
+	padded = (m_fillBytes + RAWWRITER_ALIGN - 1) &
+	    ~(size_t)(RAWWRITER_ALIGN - 1);
+	(void)memset(m_chunks[m_fillChunk] + m_fillBytes, 0,
+	    padded - m_fillBytes);
+	if (queueFillChunk(padded) == -1)
+	    result = -1;
+    }
+
+	/* let the writers drain the queue, then stop them */
+
+    (void)pthread_mutex_lock(&m_lock);
+    while ((m_queueCount > 0 || m_writesInProgress > 0) && !m_error)
+	(void)pthread_cond_wait(&m_doneCond, &m_lock);
+    m_shutdown = 1;
+    (void)pthread_cond_broadcast(&m_workCond);
+    (void)pthread_mutex_unlock(&m_lock);
+    for (i=0;i < m_numThreads;i++)
+	(void)pthread_join(m_threads[i], NULL);
+    m_numThreads = 0;
+
+	/* trim padding, and give back the preallocation past the end.
+	   truncating only frees what's past the old size, which may be
+	   nothing, so the rest is punched out */
+
+    if (m_error)
+	result = -1;
+    if (ftruncate(m_fd, m_bytesAccepted) == -1)
+	result = -1;
+    if (m_allocatedTo > m_bytesAccepted)
+	(void)fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+	    m_bytesAccepted, m_allocatedTo - m_bytesAccepted);
+    saveErrno = m_error? m_error:errno;
+    if (::close(m_fd) == -1)
+	result = -1;
+    m_fd = -1;
+    m_fillChunk = -1;
+    if (result == -1)
+	errno = saveErrno;
+    return result;
+}
+
+
+off_t RawImageWriter::bytesWritten(void)
+{
+    bool busy[RAWWRITER_NUM_CHUNKS];
+    off_t result;
+    int i;
+
+	/* everything before the first chunk still queued or being written
+	   is in the file.  the writers finish chunks out of order, so the
+	   file size can be past a chunk that isn't there yet */
+
+    if (m_fd == -1)
+	return 0;
+    (void)pthread_mutex_lock(&m_lock);
+    for (i=0;i < RAWWRITER_NUM_CHUNKS;i++)
+	busy[i] = (i != m_fillChunk);
+    for (i=0;i < m_numFree;i++)
+	busy[m_freeList[i]] = false;
+    result = m_nextOffset;
+    for (i=0;i < RAWWRITER_NUM_CHUNKS;i++)
+	if (busy[i] && m_chunkOffsets[i] < result)
+	    result = m_chunkOffsets[i];
+    (void)pthread_mutex_unlock(&m_lock);
+    return result;
+}
+
+
+void *RawImageWriter::threadMain(void *arg)
+{
+    RawImageWriter *me = (RawImageWriter *)arg;
+    int chunk, bucket, err;
+    size_t done;
+    ssize_t n;
+    off_t offset;
+    double start, latency;
+    long usecs;
+    u_int64_t t0;
+
+    (void)pthread_mutex_lock(&me->m_lock);
+    for (;;) {
+	while (me->m_queueCount == 0 && !me->m_shutdown)
+	    (void)pthread_cond_wait(&me->m_workCond, &me->m_lock);
+	if (me->m_queueCount == 0)
+	    break;
+	chunk = me->m_queue[me->m_queueHead];
+	me->m_queueHead = (me->m_queueHead + 1) % RAWWRITER_NUM_CHUNKS;
+	me->m_queueCount--;
+	me->m_writesInProgress++;
+	(void)pthread_mutex_unlock(&me->m_lock);
+
+	    /* chunks are independent, so the writers can have several in
+	       flight at different offsets at once */
+
+	start = pipelineNow();
+	t0 = traceStart();
+	err = 0;
+	done = 0;
+	offset = me->m_chunkOffsets[chunk];
+	while (done < me->m_chunkSizes[chunk]) {
+	    n = pwrite(me->m_fd, me->m_chunks[chunk] + done,
+		me->m_chunkSizes[chunk] - done, offset + done);
+	    if (n == -1 && errno == EINTR)
+		continue;
+	    if (n <= 0) {
+		err = (n == 0)? ENOSPC:errno;
+		break;
+	    }
+	    done += n;
+	}
+	traceEnd(TRACE_WRITE, t0);
+	latency = pipelineNow() - start;
+
+	(void)pthread_mutex_lock(&me->m_lock);
+	me->m_writesInProgress--;
+	if (err != 0 && me->m_error == 0)
+	    me->m_error = err;
+	usecs = (long)(latency * 1.0e6);
+	for (bucket=0;usecs > 1 && bucket < RAWWRITER_LATENCY_BUCKETS-1;
+		bucket++)
+	    usecs >>= 1;
+	me->m_latencyHist[bucket]++;
+	me->m_totalHist[bucket]++;
+	if (latency > me->m_latencyMax)
+	    me->m_latencyMax = latency;
+	if (latency > me->m_totalMax)
+	    me->m_totalMax = latency;
+	me->m_windowBytes += done;
+	me->m_totalBytes += done;
+	me->m_chunksWritten++;
+	me->m_totalChunks++;
+	me->m_freeList[me->m_numFree++] = chunk;
+	(void)pthread_cond_broadcast(&me->m_doneCond);
+    }
+    (void)pthread_mutex_unlock(&me->m_lock);
+    return NULL;
+}
+
+
+double RawImageWriter::latencyPercentile(const u_int *hist, double pct)
+{
+    u_int total, count, target;
+    int i;
+
+	/* report the top of the bucket the percentile falls in */
+
+    total = 0;
+    for (i=0;i < RAWWRITER_LATENCY_BUCKETS;i++)
+	total += hist[i];
+    if (total == 0)
+	return 0.0;
+    target = (u_int)(total * pct / 100.0);
+    if (target == 0)
+	target = 1;
+    count = 0;
+    for (i=0;i < RAWWRITER_LATENCY_BUCKETS;i++) {
+	count += hist[i];
+	if (count >= target)
+	    break;
+    }
+    return (double)(2L << i) / 1000.0;
+}
+
+
+void RawImageWriter::getStats(RawWriterStats *stats_p)
+{
+    double now;
+
+	/* stats cover the period since the last call */
+
+    (void)pthread_mutex_lock(&m_lock);
+    now = pipelineNow();
+    stats_p->mbPerSec = (now > m_windowStart)?
+	m_windowBytes / (now - m_windowStart) / (1024.0 * 1024.0) : 0.0;
+    stats_p->p50LatencyMs = latencyPercentile(m_latencyHist, 50.0);
+    stats_p->p99LatencyMs = latencyPercentile(m_latencyHist, 99.0);
+    stats_p->maxLatencyMs = 1000.0 * m_latencyMax;
+    if (stats_p->maxLatencyMs < stats_p->p99LatencyMs)
+	stats_p->p99LatencyMs = stats_p->maxLatencyMs;
+    if (stats_p->maxLatencyMs < stats_p->p50LatencyMs)
+	stats_p->p50LatencyMs = stats_p->maxLatencyMs;
+    stats_p->chunksWritten = m_chunksWritten;
+    stats_p->chunksQueued = m_queueCount + m_writesInProgress;
+    (void)memset(m_latencyHist, 0, sizeof(m_latencyHist));
+    m_latencyMax = 0.0;
+    m_windowBytes = 0.0;
+    m_windowStart = now;
+    m_chunksWritten = 0;
+    (void)pthread_mutex_unlock(&m_lock);
+}
+
+
+void RawImageWriter::getRecordingStats(RawWriterStats *stats_p)
+{
+    double now;
+
+	/* same, but since open and without resetting anything */
+
+    (void)pthread_mutex_lock(&m_lock);
+    now = pipelineNow();
+    stats_p->mbPerSec = (now > m_openTime)?
+	m_totalBytes / (now - m_openTime) / (1024.0 * 1024.0) : 0.0;
+    stats_p->p50LatencyMs = latencyPercentile(m_totalHist, 50.0);
+    stats_p->p99LatencyMs = latencyPercentile(m_totalHist, 99.0);
+    stats_p->maxLatencyMs = 1000.0 * m_totalMax;
+    if (stats_p->maxLatencyMs < stats_p->p99LatencyMs)
+	stats_p->p99LatencyMs = stats_p->maxLatencyMs;
+    if (stats_p->maxLatencyMs < stats_p->p50LatencyMs)
+	stats_p->p50LatencyMs = stats_p->maxLatencyMs;
+    stats_p->chunksWritten = m_totalChunks;
+    stats_p->chunksQueued = m_queueCount + m_writesInProgress;
+    (void)pthread_mutex_unlock(&m_lock);
+}
@@ -0,0 +1,126 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+#include <pthread.h>
+#include <sys/types.h>
+
+    /* raw-image writer.  frames are copied into large aligned chunks which
+       a small pool of threads writes with pwrite to a file opened O_DIRECT,
+       so recording bypasses the page cache and a writeback stall can't
+       back up into acquisition.  the file is preallocated with fallocate
+       for the planned recording length and extended ahead of the write
+       position in RAWWRITER_EXTEND_SECS steps as recording goes on.  the
+       preallocation doesn't change the file size, so the size of a file
+       whose recording never closed covers only chunks written.  at close
+       the last partial chunk is padded out to the alignment and the file
+       is truncated back to the data actually written.  if the
+       filesystem won't do O_DIRECT (tmpfs, some network mounts) we fall
+       back to ordinary writes through the same threads */
+
+#define RAWWRITER_ALIGN		4096
+#define RAWWRITER_CHUNK_FRAMES	4
+#define RAWWRITER_NUM_CHUNKS	12
+#define RAWWRITER_NUM_THREADS	2
+#define RAWWRITER_EXTEND_SECS	30
+
+    /* write latencies are kept in power-of-two microsecond buckets --
+       bucket i holds [2^i, 2^(i+1)) usecs */
+
+#define RAWWRITER_LATENCY_BUCKETS	32
+
+struct RawWriterStats {
+    double mbPerSec;		/* since last getStats */
+    double p50LatencyMs;
+    double p99LatencyMs;
+    double maxLatencyMs;
+    u_int chunksWritten;
+    int chunksQueued;
+};
+
+class RawImageWriter
+{
+protected:
+    int m_fd;
+    bool m_direct;
+    size_t m_frameBytes;
+    size_t m_chunkBytes;
+    double m_frameRateHz;
+
+	/* chunk buffers.  the caller fills m_fillChunk; full chunks go onto
+	   the write queue and come back onto the free list once written */
+
+    char *m_chunks[RAWWRITER_NUM_CHUNKS];
+    off_t m_chunkOffsets[RAWWRITER_NUM_CHUNKS];
+    size_t m_chunkSizes[RAWWRITER_NUM_CHUNKS];
+    int m_fillChunk;
+    size_t m_fillBytes;
+    int m_freeList[RAWWRITER_NUM_CHUNKS];
+    int m_numFree;
+    int m_queue[RAWWRITER_NUM_CHUNKS];
+    int m_queueHead;
+    int m_queueCount;
+    int m_writesInProgress;
+
+    off_t m_nextOffset;		/* file offset of chunk being filled */
+    off_t m_allocatedTo;
+    off_t m_allocRetryAt;	/* after a failed fallocate */
+    off_t m_extendBytes;
+    off_t m_bytesAccepted;
+
+    pthread_t m_threads[RAWWRITER_NUM_THREADS];
+    int m_numThreads;
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_workCond;
+    pthread_cond_t m_doneCond;
+    int m_shutdown;
+    int m_error;		/* errno of first failed write, or 0 */
+
+	/* stats for the current window */
+
+    u_int m_latencyHist[RAWWRITER_LATENCY_BUCKETS];
+    double m_latencyMax;
+    double m_windowBytes;
+    double m_windowStart;
+    u_int m_chunksWritten;
+
+	/* and for the whole recording */
+
+    u_int m_totalHist[RAWWRITER_LATENCY_BUCKETS];
+    double m_totalMax;
+    double m_totalBytes;
+    double m_openTime;
+    u_int m_totalChunks;
+
+    static void *threadMain(void *arg);
+    int queueFillChunk(size_t bytes);
+    void extendAllocation(off_t needed);
+    static double latencyPercentile(const u_int *hist, double pct);
+public:
+    RawImageWriter();
+    ~RawImageWriter();
+    int open(const char *path, size_t frameBytes, double frameRateHz,
+	double plannedSecs);
+    int writeFrame(const void *frame);
+    int close(void);
+    int isOpen(void) const { return m_fd != -1; }
+    bool isDirect(void) const { return m_direct; }
+    off_t bytesAccepted(void) const { return m_bytesAccepted; }
+    off_t bytesWritten(void);
+    int lastError(void) const { return m_error; }
+    void getStats(RawWriterStats *stats_p);
+    void getRecordingStats(RawWriterStats *stats_p);
+};
@@ -0,0 +1,149 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "framering.h"
+#include "framebase.h"
+#include "pacedbuf.h"
+#include "stripeindex.h"
+#include "flightline.h"
+#include "navdecoder.h"
+#include "replaybuf.h"
+
+extern const char *const replaybufDate = "$Date: 2015/12/30 09:41:17 $";
+
+#define NO_PPS		0xDEAD
+
+
+ReplayFrameBuffer::ReplayFrameBuffer(int fh, int fw,
+	void (*er)(const char *s), const char *rawPath, double speed,
+	int loop) :
+    PacedFrameBuffer(fh, fw, er)
+{
+    char errorMsg[MAXPATHLEN+100];
+
+	/* init member variables */
+
+    m_reader = new FlightLineReader;
+    m_speed = speed;
+    m_loop = loop;
+    m_recordedRateHz = REPLAY_DEFAULT_RATE_HZ;
+    m_nextFrame = 0;
+
+	/* open the flight line, and make sure it's what the settings say
+	   the camera is sending */
+
+    if (m_reader->open(rawPath, errorMsg) == -1) {
+	(void)strcpy(last_error, errorMsg);
+	failed = 1;
+	return;
+    }
+    if (m_reader->lines() != fh || m_reader->samples() != fw) {
+	(void)sprintf(last_error, "Replay flight line is %d x %d, but the "
+	    "frame size is set to %d x %d.", m_reader->lines(),
+	    m_reader->samples(), fh, fw);
+	failed = 1;
+	return;
+    }
+    if (m_reader->frames() == 0) {
+	(void)sprintf(last_error, "Replay flight line \"%s\" is empty.",
+	    rawPath);
+	failed = 1;
+	return;
+    }
+    m_recordedRateHz = measureRecordedRate();
+    m_reader->adviseSequential();
+
+	/* start playing.  flat out, the rate is whatever the pipeline can
+	   manage, so the recorded rate is as good a guess as any for
+	   sizing things */
+
+    (void)startPlaying(m_recordedRateHz * m_speed,
+	(m_speed > 0.0)? m_recordedRateHz * m_speed:m_recordedRateHz);
+}
+
+
+ReplayFrameBuffer::~ReplayFrameBuffer()
+{
+    stopPlaying();
+    delete m_reader;
+}
+
+
+double ReplayFrameBuffer::measureRecordedRate(void)
+{
+    u_int f, n, first, last, count;
+    const u_short *line1;
+    int hadPPS, hasPPS;
+
+	/* frames from the first pulse to the last, over the seconds
+	   between.  a pulse starts a run of frames with PPS data.  this
+	   only touches the header lines */
+
+    n = m_reader->frames();
+    if (n > REPLAY_RATE_SCAN_FRAMES)
+	n = REPLAY_RATE_SCAN_FRAMES;
+    first = last = count = 0;
+    hadPPS = 0;
+    for (f=0;f < n;f++) {
+	line1 = m_reader->frame(f);
+	hasPPS = (line1[PPS_IMAGE_OFFSET / sizeof(u_short)] != NO_PPS);
+	if (hasPPS && !hadPPS) {
+	    if (count == 0)
+		first = f;
+	    last = f;
+	    count++;
+	}
+	hadPPS = hasPPS;
+    }
+    m_reader->release(0, n);
+    if (count < 2)
+	return REPLAY_DEFAULT_RATE_HZ;
+    return (last - first) / (double)(count - 1);
+}
+
+
+u_int ReplayFrameBuffer::recordedFrames(void) const
+{
+    return failed? 0:m_reader->frames();
+}
+
+
+const u_short *ReplayFrameBuffer::nextFrame(int slot)
+{
+    u_int f;
+
+    if (m_nextFrame == m_reader->frames()) {
+	if (!m_loop)
+	    return NULL;
+	m_nextFrame = 0;
+    }
+    f = m_nextFrame++;
+
+	/* anything a ring's worth back has been released, so its pages
+	   can go; otherwise a long flight line fills memory */
+
+    if (f >= PACED_NUM_SLOTS + REPLAY_RELEASE_FRAMES &&
+	    f % REPLAY_RELEASE_FRAMES == 0)
+	m_reader->release(f - PACED_NUM_SLOTS - REPLAY_RELEASE_FRAMES,
+	    REPLAY_RELEASE_FRAMES);
+    return m_reader->frame(f);
+}
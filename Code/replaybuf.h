@@ -0,0 +1,53 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* frame buffer that plays back a recorded flight line instead of
+       talking to the card, for reproducing field problems and timing the
+       pipeline on a desktop.  the _raw (or its stripes) is mapped through
+       a FlightLineReader and frames are handed out where they sit, so the
+       timing, PPS, and GPS words are exactly as recorded.  frames are
+       played at the recorded rate times speed (see pacedbuf.h); speed 0
+       plays them as fast as the pipeline will take them.
+
+       the recorded rate is taken from the PPS words in the first
+       frames */
+
+#define REPLAY_RATE_SCAN_FRAMES	4096	/* searched for PPS words */
+#define REPLAY_DEFAULT_RATE_HZ	100.0	/* if none are found */
+#define REPLAY_RELEASE_FRAMES	256	/* pages dropped at a time */
+
+class FlightLineReader;
+
+class ReplayFrameBuffer : public PacedFrameBuffer
+{
+protected:
+    FlightLineReader *m_reader;
+    double m_speed;			/* 0 for as fast as possible */
+    int m_loop;
+    double m_recordedRateHz;
+    u_int m_nextFrame;
+
+    double measureRecordedRate(void);
+    const u_short *nextFrame(int slot);
+public:
+    ReplayFrameBuffer(int fh, int fw, void (*er)(const char *),
+	const char *rawPath, double speed, int loop);
+    ~ReplayFrameBuffer();
+    double recordedRateHz(void) const { return m_recordedRateHz; }
+    u_int recordedFrames(void) const;
+};
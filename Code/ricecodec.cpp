@@ -0,0 +1,306 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <string.h>
+#include <sys/types.h>
+#include "ricecodec.h"
+
+extern const char *const ricecodecDate = "$Date: 2015/12/23 10:41:17 $";
+
+    /* bits go out most-significant first through a 64-bit accumulator,
+       which is flushed 32 bits at a time, so any single code of up to 32
+       bits fits.  reading is the same in reverse */
+
+typedef struct {
+    u_char *p;
+    u_int64_t acc;
+    int bits;
+} bit_writer_t;
+
+typedef struct {
+    const u_char *p;
+    const u_char *end;
+    u_int64_t acc;
+    int bits;
+} bit_reader_t;
+
+
+static inline void putBits(bit_writer_t *w, u_int value, int n)
+{
+    u_int word;
+
+    w->acc = (w->acc << n) | value;
+    w->bits += n;
+    if (w->bits >= 32) {
+	w->bits -= 32;
+	word = (u_int)(w->acc >> w->bits);
+	w->p[0] = (u_char)(word >> 24);
+	w->p[1] = (u_char)(word >> 16);
+	w->p[2] = (u_char)(word >> 8);
+	w->p[3] = (u_char)word;
+	w->p += 4;
+    }
+}
+
+
+static inline void flushBits(bit_writer_t *w)
+{
+    while (w->bits >= 8) {
+	w->bits -= 8;
+	*w->p++ = (u_char)(w->acc >> w->bits);
+    }
+    if (w->bits > 0) {
+	*w->p++ = (u_char)(w->acc << (8 - w->bits));
+	w->bits = 0;
+    }
+}
+
+
+	/* past the end of the input we read zeros, which can only decode
+	   as garbage, never run away; the caller checks we finished where
+	   we should */
+
+static inline void fillBits(bit_reader_t *r)
+{
+    if (r->bits <= 32 && r->p + 4 <= r->end) {
+	r->acc = (r->acc << 32) | ((u_int)r->p[0] << 24) |
+	    ((u_int)r->p[1] << 16) | ((u_int)r->p[2] << 8) | r->p[3];
+	r->p += 4;
+	r->bits += 32;
+	return;
+    }
+    while (r->bits <= 56) {
+	r->acc <<= 8;
+	if (r->p < r->end)
+	    r->acc |= *r->p;
+	r->p++;
+	r->bits += 8;
+    }
+}
+
+
+static inline u_int getBits(bit_reader_t *r, int n)
+{
+    if (n == 0)
+	return 0;
+    if (r->bits < n)
+	fillBits(r);
+    r->bits -= n;
+    return (u_int)(r->acc >> r->bits) & ((1u << n) - 1);
+}
+
+
+static inline int countOnes(bit_reader_t *r)
+{
+    u_int top;
+    int n;
+
+	/* leading ones, up to RICE_ESCAPE_ONES, and the terminating zero
+	   if there is one */
+
+    if (r->bits < RICE_ESCAPE_ONES + 1)
+	fillBits(r);
+    top = (u_int)(r->acc << (64 - r->bits) >> 32);
+    n = (~top == 0)? 32:__builtin_clz(~top);
+    if (n >= RICE_ESCAPE_ONES) {
+	r->bits -= RICE_ESCAPE_ONES;
+	return RICE_ESCAPE_ONES;
+    }
+    r->bits -= n + 1;
+    return n;
+}
+
+
+	/* LOCO-I median edge detector.  a is left, b above, c above-left */
+
+static inline int predict(int a, int b, int c)
+{
+    int mn, mx;
+
+    if (a < b) {
+	mn = a;
+	mx = b;
+    }
+    else {
+	mn = b;
+	mx = a;
+    }
+    if (c >= mx)
+	return mn;
+    if (c <= mn)
+	return mx;
+    return a + b - c;
+}
+
+
+	/* prediction error to a non-negative value:  0, -1, 1, -2, 2, ... go
+	   to 0, 1, 2, 3, 4, ... */
+
+static inline u_int mapError(int x, int pred)
+{
+    int e;
+
+    e = (short)(x - pred);
+    return (e >= 0)? (u_int)e << 1:((u_int)(-e) << 1) - 1;
+}
+
+
+static inline int unmapError(u_int m, int pred)
+{
+    int e;
+
+    e = (m & 1)? -(int)((m + 1) >> 1):(int)(m >> 1);
+    return (u_short)(pred + e);
+}
+
+
+static void predictionErrors(u_int *errors, const u_short *line,
+    const u_short *above, int samples)
+{
+    int i;
+
+    if (above == NULL) {
+	errors[0] = mapError(line[0], 0);
+	for (i=1;i < samples;i++)
+	    errors[i] = mapError(line[i], line[i-1]);
+    }
+    else {
+	errors[0] = mapError(line[0], above[0]);
+	for (i=1;i < samples;i++)
+	    errors[i] = mapError(line[i],
+		predict(line[i-1], above[i], above[i-1]));
+    }
+}
+
+
+static void encodeBlock(bit_writer_t *w, const u_int *errors, int n)
+{
+    u_int sum, q, m;
+    int i, k;
+
+	/* pick k so that n << k covers the sum of the errors, which is
+	   about right for a geometric distribution (JPEG-LS does the
+	   same with its running sums) */
+
+    sum = 0;
+    for (i=0;i < n;i++)
+	sum += errors[i];
+    for (k=0;k < RICE_MAX_K && ((u_int)n << k) < sum;k++) ;
+    putBits(w, k, RICE_K_BITS);
+
+    for (i=0;i < n;i++) {
+	m = errors[i];
+	q = m >> k;
+	if (q < RICE_ESCAPE_ONES)
+	    putBits(w, ((((1u << q) - 1) << 1) << k) | (m & ((1u << k) - 1)),
+		q + 1 + k);
+	else putBits(w, (0xffffu << 16) | m, RICE_ESCAPE_ONES + 16);
+    }
+}
+
+
+size_t riceMaxBytes(int lines, int samples)
+{
+    size_t blocks;
+
+	/* 32 bits per sample in the worst case, plus each line's k's */
+
+    blocks = (samples + RICE_BLOCK_SAMPLES - 1) / RICE_BLOCK_SAMPLES;
+    return (size_t)lines * (samples * 4 + blocks) + 8;
+}
+
+
+size_t riceEncodeFrame(u_char *dest, size_t destBytes,
+    const u_short *frame, int lines, int samples)
+{
+    bit_writer_t w;
+    u_int *errors;
+    const u_short *line, *above;
+    size_t lineMax;
+    int j, i, n;
+
+    errors = new u_int[samples];
+    w.p = dest;
+    w.acc = 0;
+    w.bits = 0;
+    above = NULL;
+    lineMax = riceMaxBytes(1, samples);
+    for (j=0;j < lines;j++) {
+
+	    /* stop while we're sure the next line can't run over */
+
+	if ((size_t)(w.p - dest) + lineMax > destBytes) {
+	    delete[] errors;
+	    return 0;
+	}
+	line = frame + (size_t)j * samples;
+	predictionErrors(errors, line, above, samples);
+	for (i=0;i < samples;i+=RICE_BLOCK_SAMPLES) {
+	    n = (samples - i < RICE_BLOCK_SAMPLES)?
+		samples - i:RICE_BLOCK_SAMPLES;
+	    encodeBlock(&w, errors + i, n);
+	}
+	above = line;
+    }
+    flushBits(&w);
+    delete[] errors;
+    return w.p - dest;
+}
+
+
+int riceDecodeFrame(u_short *frame, const u_char *src, size_t bytes,
+    int lines, int samples)
+{
+    bit_reader_t r;
+    u_short *line, *above;
+    u_int m;
+    int j, i, s, n, k, q, pred;
+    size_t used;
+
+    r.p = src;
+    r.end = src + bytes;
+    r.acc = 0;
+    r.bits = 0;
+    above = NULL;
+    for (j=0;j < lines;j++) {
+	line = frame + (size_t)j * samples;
+	for (i=0;i < samples;i+=n) {
+	    n = (samples - i < RICE_BLOCK_SAMPLES)?
+		samples - i:RICE_BLOCK_SAMPLES;
+	    k = getBits(&r, RICE_K_BITS);
+	    for (s=i;s < i+n;s++) {
+		q = countOnes(&r);
+		if (q == RICE_ESCAPE_ONES)
+		    m = getBits(&r, 16);
+		else m = ((u_int)q << k) | getBits(&r, k);
+		if (s == 0)
+		    pred = (above == NULL)? 0:above[0];
+		else if (above == NULL)
+		    pred = line[s-1];
+		else pred = predict(line[s-1], above[s], above[s-1]);
+		line[s] = unmapError(m, pred);
+	    }
+	}
+	above = line;
+    }
+
+	/* we should have used up the input exactly, to the byte */
+
+    used = ((r.p - src) * 8 - r.bits + 7) / 8;
+    return (used == bytes)? 0:-1;
+}
@@ -0,0 +1,49 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* lossless frame compression for recording.  each line is predicted
+       from its neighbors with the LOCO-I (JPEG-LS) median predictor --
+       the pixel to the left, the one above, and their sum less the one
+       above-left -- and the prediction errors are Rice coded in blocks of
+       RICE_BLOCK_SAMPLES, each block with its own 4-bit parameter k.  an
+       error of m codes as m>>k in unary (ones ended by a zero) and then
+       the low k bits of m; if m>>k would be RICE_ESCAPE_ONES or more, it's
+       that many ones and then m in 16 bits instead, so no sample ever
+       costs more than 32 bits.  errors are taken mod 2^16, so any 16-bit
+       data round-trips, though it's 14-bit data that this is tuned for.
+
+       every frame is coded on its own, so frames can be compressed on as
+       many threads as it takes and any frame decoded without the others.
+       the encoder gives up, returning 0, if the frame won't fit in
+       destBytes, and then the frame should be stored as is
+       (RICE_METHOD_STORED).  no frame needs more than
+       riceMaxBytes(lines, samples) */
+
+#define RICE_BLOCK_SAMPLES	32
+#define RICE_ESCAPE_ONES	16
+#define RICE_K_BITS		4
+#define RICE_MAX_K		15
+
+#define RICE_METHOD_STORED	0
+#define RICE_METHOD_RICE	1
+
+extern size_t riceMaxBytes(int lines, int samples);
+extern size_t riceEncodeFrame(u_char *dest, size_t destBytes,
+    const u_short *frame, int lines, int samples);
+extern int riceDecodeFrame(u_short *frame, const u_char *src, size_t bytes,
+    int lines, int samples);
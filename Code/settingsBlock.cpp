@@ -54,6 +54,10 @@ const char *const SettingsBlock::fmsControlOptions[NUM_FMSCONTROLOPTIONS+1] = {
 
 const char *const SettingsBlock::viewerTypes[NUM_VIEWERTYPES+1] = {
     "Frame", "Waterfall", "Combo", NULL };
+const char *const SettingsBlock::stretchModes[NUM_STRETCHMODES+1] = {
+    "Manual", "Auto", NULL };
+const char *const SettingsBlock::stretchCurves[NUM_STRETCHCURVES+1] = {
+    "Linear", "Gamma", "Log", "Equalize", NULL };
 const char *const SettingsBlock::darkSubOptions[NUM_DARKSUBOPTIONS+1] = {
     "No", "Yes", NULL };
 const char *const SettingsBlock::navDurations[NUM_NAVDURATIONS+1] = {
@@ -74,6 +78,13 @@ const double SettingsBlock::recMarginPcts[NUM_RECMARGINS] = {
     0.1, 0.2, 0.5,
     1.0, 2.0, 5.0,
     10.0, 20.0, 50.0 };
+const char *const SettingsBlock::quicklookOptions[NUM_QUICKLOOKOPTIONS+1] = {
+    "Off", "On", NULL };
+const char *const SettingsBlock::swCompressionOptions[
+	NUM_SWCOMPRESSIONOPTIONS+1] = {
+    "Off", "Both", "Only", NULL };
+const char *const SettingsBlock::manifestOptions[NUM_MANIFESTOPTIONS+1] = {
+    "Off", "On", NULL };
 
 const char *const SettingsBlock::obcInterfaces[NUM_OBCINTERFACES+1] = {
     "None", "FPGA", NULL };
@@ -115,6 +126,10 @@ const char *const SettingsBlock::gpsSims[NUM_GPSSIMS+1] = {
     "None", "All messages", "All messages except #3", NULL };
 const char *const SettingsBlock::diagOptions[NUM_DIAGOPTIONS+1] = {
     "Off", "On", NULL };
+const char *const SettingsBlock::diagsRates[NUM_DIAGSRATES+1] = {
+    "10 Hz", "5 Hz", "2 Hz", "1 Hz", "0.5 Hz", "0.2 Hz", NULL };
+const double SettingsBlock::diagsRatesHz[NUM_DIAGSRATES] = {
+    10.0, 5.0, 2.0, 1.0, 0.5, 0.2 };
 
 
 SettingsBlock::SettingsBlock(bool headless)
@@ -141,8 +156,15 @@ SettingsBlock::SettingsBlock(bool headless)
     m_downtrackSkip = 0;
     m_stretchMin = 0;
     m_stretchMax = MAX_DN;
+    m_stretchMode = STRETCHMODE_MANUAL;
     m_greenGain = 1.0;
     m_blueGain = 1.0;
+    m_redCurve = STRETCHCURVE_LINEAR;
+    m_greenCurve = STRETCHCURVE_LINEAR;
+    m_blueCurve = STRETCHCURVE_LINEAR;
+    m_redGamma = 2.2;
+    m_greenGamma = 2.2;
+    m_blueGamma = 2.2;
     m_darkSubOption = DARKSUBOPTION_NO;
     m_darkSubDirMRU = new char[MAXPATHLEN*4+1];
     strcpy(m_darkSubDirMRU, DEFAULT_DARKSUBDIR);
@@ -158,6 +180,11 @@ SettingsBlock::SettingsBlock(bool headless)
     strcpy(m_productRootDirMRU, DEFAULT_PRODUCTROOTDIR);
     for (i=1;i < 4;i++)
 	m_productRootDirMRU[i*MAXPATHLEN] = '\0';
+    m_stripeDirs = new char[strlen(DEFAULT_STRIPEDIRS)+1];
+    strcpy(m_stripeDirs, DEFAULT_STRIPEDIRS);
+    m_quicklookOption = QUICKLOOKOPTION_OFF;
+    m_swCompressionOption = SWCOMPRESSION_OFF;
+    m_manifestOption = MANIFESTOPTION_OFF;
 
     m_obcInterface = OBCINTERFACE_NONE;
     m_dark1CalPeriod = 0;
@@ -193,6 +220,7 @@ SettingsBlock::SettingsBlock(bool headless)
     m_imageSim = IMAGESIM_NONE;
     m_gpsSim = GPSSIM_NONE;
     m_diagOption = DIAGOPTION_OFF;
+    m_diagsRate = DIAGSRATE_1HZ;
 }
 
 
@@ -201,6 +229,7 @@ SettingsBlock::~SettingsBlock()
     delete[] m_darkSubDirMRU;
     delete[] m_prefix;
     delete[] m_productRootDirMRU;
+    delete[] m_stripeDirs;
     delete[] m_ecsHost;
     delete[] m_ecsUsername;
     delete[] m_ecsPassword;
@@ -246,8 +275,22 @@ void SettingsBlock::loadSettings(const char *filename)
     getIntValue(fp, "downtrackskip", &m_downtrackSkip, true, 0, 9);
     getIntValue(fp, "stretchmin", &m_stretchMin, true, 0, MAX_DN);
     getIntValue(fp, "stretchmax", &m_stretchMax, true, 0, MAX_DN);
+    getIndex(fp, "stretchmode", true, stretchModes, &m_stretchMode,
+	"stretch mode");
     getDoubleValue(fp, "greengain", &m_greenGain, true, 0.0, 10.0);
     getDoubleValue(fp, "bluegain", &m_blueGain, true, 0.0, 10.0);
+    getIndex(fp, "redcurve", true, stretchCurves, &m_redCurve,
+	"red stretch curve");
+    getIndex(fp, "greencurve", true, stretchCurves, &m_greenCurve,
+	"green stretch curve");
+    getIndex(fp, "bluecurve", true, stretchCurves, &m_blueCurve,
+	"blue stretch curve");
+    getDoubleValue(fp, "redgamma", &m_redGamma, true,
+	MIN_STRETCH_GAMMA, MAX_STRETCH_GAMMA);
+    getDoubleValue(fp, "greengamma", &m_greenGamma, true,
+	MIN_STRETCH_GAMMA, MAX_STRETCH_GAMMA);
+    getDoubleValue(fp, "bluegamma", &m_blueGamma, true,
+	MIN_STRETCH_GAMMA, MAX_STRETCH_GAMMA);
     getIndex(fp, "darksuboption", true, darkSubOptions,
 	&m_darkSubOption, "dark-subtraction option");
     getMRU(fp, "darksubdir", m_darkSubDirMRU);
@@ -260,6 +303,13 @@ void SettingsBlock::loadSettings(const char *filename)
 	"recording margin");
     (void)getValue(fp, "prefix", &m_prefix, true);
     getMRU(fp, "productrootdir", m_productRootDirMRU);
+    (void)getValue(fp, "stripedirs", &m_stripeDirs, true);
+    getIndex(fp, "quicklookoption", true, quicklookOptions,
+	&m_quicklookOption, "quicklook option");
+    getIndex(fp, "swcompressionoption", true, swCompressionOptions,
+	&m_swCompressionOption, "software compression option");
+    getIndex(fp, "manifestoption", true, manifestOptions, &m_manifestOption,
+	"integrity manifest option");
 
     getIndex(fp, "obcinterface", true, obcInterfaces, &m_obcInterface,
 	"OBC interface");
@@ -313,6 +363,8 @@ void SettingsBlock::loadSettings(const char *filename)
     getIndex(fp, "gpssim", true, gpsSims, &m_gpsSim, "GPS sim");
     getIndex(fp, "diagoption", true, diagOptions,
 	&m_diagOption, "diagnostics option");
+    getIndex(fp, "diagsrate", true, diagsRates, &m_diagsRate,
+	"diagnostics sampling rate");
 
 	/* we're done */
 
@@ -351,8 +403,15 @@ int SettingsBlock::saveSettings(const char *filename)
     fprintf(fp, "downtrackskip = %d\n", m_downtrackSkip);
     fprintf(fp, "stretchmin = %d\n", m_stretchMin);
     fprintf(fp, "stretchmax = %d\n", m_stretchMax);
+    fprintf(fp, "stretchmode = %s\n", stretchModes[m_stretchMode]);
     fprintf(fp, "greengain = %g\n", m_greenGain);
     fprintf(fp, "bluegain = %g\n", m_blueGain);
+    fprintf(fp, "redcurve = %s\n", stretchCurves[m_redCurve]);
+    fprintf(fp, "greencurve = %s\n", stretchCurves[m_greenCurve]);
+    fprintf(fp, "bluecurve = %s\n", stretchCurves[m_blueCurve]);
+    fprintf(fp, "redgamma = %g\n", m_redGamma);
+    fprintf(fp, "greengamma = %g\n", m_greenGamma);
+    fprintf(fp, "bluegamma = %g\n", m_blueGamma);
     fprintf(fp, "darksuboption = %s\n", darkSubOptions[m_darkSubOption]);
     for (i=0;i < 4;i++)
 	fprintf(fp, "darksubdir%d = %s\n", i, m_darkSubDirMRU+i*MAXPATHLEN);
@@ -365,6 +424,12 @@ int SettingsBlock::saveSettings(const char *filename)
     for (i=0;i < 4;i++)
 	fprintf(fp, "productrootdir%d = %s\n",
 	    i, m_productRootDirMRU+i*MAXPATHLEN);
+    fprintf(fp, "stripedirs = %s\n", m_stripeDirs);
+    fprintf(fp, "quicklookoption = %s\n",
+	quicklookOptions[m_quicklookOption]);
+    fprintf(fp, "swcompressionoption = %s\n",
+	swCompressionOptions[m_swCompressionOption]);
+    fprintf(fp, "manifestoption = %s\n", manifestOptions[m_manifestOption]);
 
     fprintf(fp, "obcinterface = %s\n", obcInterfaces[m_obcInterface]);
     fprintf(fp, "dark1calperiod = %s\n", calPeriods[m_dark1CalPeriod]);
@@ -398,6 +463,7 @@ int SettingsBlock::saveSettings(const char *filename)
     fprintf(fp, "imagesim = %s\n", imageSims[m_imageSim]);
     fprintf(fp, "gpssim = %s\n", gpsSims[m_gpsSim]);
     fprintf(fp, "diagoption = %s\n", diagOptions[m_diagOption]);
+    fprintf(fp, "diagsrate = %s\n", diagsRates[m_diagsRate]);
     fclose(fp);
     return 0;
 }
@@ -422,8 +488,15 @@ void SettingsBlock::logSettings(FILE *fp)
     fprintf(fp, "Downtrack skip = %d\n", m_downtrackSkip);
     fprintf(fp, "Stretch min = %d DN\n", m_stretchMin);
     fprintf(fp, "Stretch max = %d DN\n", m_stretchMax);
+    fprintf(fp, "Stretch mode = %s\n", stretchModes[m_stretchMode]);
     fprintf(fp, "Green gain = %g\n", m_greenGain);
     fprintf(fp, "Blue gain = %g\n", m_blueGain);
+    fprintf(fp, "Red stretch curve = %s\n", stretchCurves[m_redCurve]);
+    fprintf(fp, "Green stretch curve = %s\n", stretchCurves[m_greenCurve]);
+    fprintf(fp, "Blue stretch curve = %s\n", stretchCurves[m_blueCurve]);
+    fprintf(fp, "Red gamma = %g\n", m_redGamma);
+    fprintf(fp, "Green gamma = %g\n", m_greenGamma);
+    fprintf(fp, "Blue gamma = %g\n", m_blueGamma);
     fprintf(fp, "Dark subtraction = %s\n", darkSubOptions[m_darkSubOption]);
     fprintf(fp, "Dark subtraction dir = %s\n", m_darkSubDirMRU);
     fprintf(fp, "Nav-plot duration = %s\n", navDurations[m_navDuration]);
@@ -433,6 +506,12 @@ void SettingsBlock::logSettings(FILE *fp)
     fprintf(fp, "Recording margin = %s\n", recMargins[m_recMargin]);
     fprintf(fp, "Data product prefix = %s\n", currentPrefix());
     fprintf(fp, "Product root directory = %s\n", m_productRootDirMRU);
+    fprintf(fp, "Stripe directories = %s\n", m_stripeDirs);
+    fprintf(fp, "Quicklook = %s\n", quicklookOptions[m_quicklookOption]);
+    fprintf(fp, "Software compression = %s\n",
+	swCompressionOptions[m_swCompressionOption]);
+    fprintf(fp, "Integrity manifest = %s\n",
+	manifestOptions[m_manifestOption]);
 
     fprintf(fp, "OBC interface = %s\n", obcInterfaces[m_obcInterface]);
     fprintf(fp, "Dark 1 cal period = %s\n", calPeriods[m_dark1CalPeriod]);
@@ -466,6 +545,7 @@ void SettingsBlock::logSettings(FILE *fp)
     fprintf(fp, "Image simulation = %s\n", imageSims[m_imageSim]);
     fprintf(fp, "GPS simulation = %s\n", gpsSims[m_gpsSim]);
     fprintf(fp, "Diag option = %s\n", diagOptions[m_diagOption]);
+    fprintf(fp, "Diagnostics sampling rate = %s\n", diagsRates[m_diagsRate]);
 }
 
 
@@ -868,6 +948,24 @@ void SettingsBlock::setStretchMax(int value)
 }
 
 
+const char *const *SettingsBlock::availableStretchModes(void)
+{
+    return stretchModes;
+}
+
+
+int SettingsBlock::currentStretchMode(void) const
+{
+    return m_stretchMode;
+}
+
+
+void SettingsBlock::setStretchMode(int value)
+{
+    m_stretchMode = value;
+}
+
+
 double SettingsBlock::currentGreenGain(void) const
 {
     return m_greenGain;
@@ -892,6 +990,84 @@ void SettingsBlock::setBlueGain(double value)
 }
 
 
+const char *const *SettingsBlock::availableStretchCurves(void)
+{
+    return stretchCurves;
+}
+
+
+int SettingsBlock::currentRedCurve(void) const
+{
+    return m_redCurve;
+}
+
+
+void SettingsBlock::setRedCurve(int value)
+{
+    m_redCurve = value;
+}
+
+
+int SettingsBlock::currentGreenCurve(void) const
+{
+    return m_greenCurve;
+}
+
+
+void SettingsBlock::setGreenCurve(int value)
+{
+    m_greenCurve = value;
+}
+
+
+int SettingsBlock::currentBlueCurve(void) const
+{
+    return m_blueCurve;
+}
+
+
+void SettingsBlock::setBlueCurve(int value)
+{
+    m_blueCurve = value;
+}
+
+
+double SettingsBlock::currentRedGamma(void) const
+{
+    return m_redGamma;
+}
+
+
+void SettingsBlock::setRedGamma(double value)
+{
+    m_redGamma = value;
+}
+
+
+double SettingsBlock::currentGreenGamma(void) const
+{
+    return m_greenGamma;
+}
+
+
+void SettingsBlock::setGreenGamma(double value)
+{
+    m_greenGamma = value;
+}
+
+
+double SettingsBlock::currentBlueGamma(void) const
+{
+    return m_blueGamma;
+}
+
+
+void SettingsBlock::setBlueGamma(double value)
+{
+    m_blueGamma = value;
+}
+
+
 const char *const *SettingsBlock::availableDarkSubOptions(void)
 {
     return darkSubOptions;
@@ -1424,6 +1600,30 @@ void SettingsBlock::setDiagOption(int value)
 }
 
 
+const char *const *SettingsBlock::availableDiagsRates(void)
+{
+    return diagsRates;
+}
+
+
+int SettingsBlock::currentDiagsRate(void) const
+{
+    return m_diagsRate;
+}
+
+
+void SettingsBlock::setDiagsRate(int value)
+{
+    m_diagsRate = value;
+}
+
+
+double SettingsBlock::currentDiagsRateHz(void) const
+{
+    return diagsRatesHz[m_diagsRate];
+}
+
+
 char *SettingsBlock::currentPrefix(void) const
 {
     char *prefix;
@@ -1442,6 +1642,78 @@ void SettingsBlock::setPrefix(const char *prefix)
 }
 
 
+char *SettingsBlock::currentStripeDirs(void) const
+{
+    char *dirs;
+
+    dirs = new char[strlen(m_stripeDirs)+1];
+    strcpy(dirs, m_stripeDirs);
+    return dirs;
+}
+
+
+void SettingsBlock::setStripeDirs(const char *dirs)
+{
+    delete[] m_stripeDirs;
+    m_stripeDirs = new char[strlen(dirs)+1];
+    strcpy(m_stripeDirs, dirs);
+}
+
+
+const char *const *SettingsBlock::availableQuicklookOptions(void)
+{
+    return quicklookOptions;
+}
+
+
+int SettingsBlock::currentQuicklookOption(void) const
+{
+    return m_quicklookOption;
+}
+
+
+void SettingsBlock::setQuicklookOption(int value)
+{
+    m_quicklookOption = value;
+}
+
+
+const char *const *SettingsBlock::availableSWCompressionOptions(void)
+{
+    return swCompressionOptions;
+}
+
+
+int SettingsBlock::currentSWCompressionOption(void) const
+{
+    return m_swCompressionOption;
+}
+
+
+void SettingsBlock::setSWCompressionOption(int value)
+{
+    m_swCompressionOption = value;
+}
+
+
+const char *const *SettingsBlock::availableManifestOptions(void)
+{
+    return manifestOptions;
+}
+
+
+int SettingsBlock::currentManifestOption(void) const
+{
+    return m_manifestOption;
+}
+
+
+void SettingsBlock::setManifestOption(int value)
+{
+    m_manifestOption = value;
+}
+
+
 char *SettingsBlock::currentProductRootDir(void) const
 {
     char *dir;
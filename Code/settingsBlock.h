@@ -42,6 +42,18 @@
 #define VIEWERTYPE_COMBO    	2
 #define NUM_VIEWERTYPES	    	3
 
+#define STRETCHMODE_MANUAL	0
+#define STRETCHMODE_AUTO	1
+#define NUM_STRETCHMODES	2
+
+#define STRETCHCURVE_LINEAR	0
+#define STRETCHCURVE_GAMMA	1
+#define STRETCHCURVE_LOG	2
+#define STRETCHCURVE_EQUALIZE	3
+#define NUM_STRETCHCURVES	4
+#define MIN_STRETCH_GAMMA	0.1
+#define MAX_STRETCH_GAMMA	5.0
+
 #define DARKSUBOPTION_NO	0
 #define DARKSUBOPTION_YES	1
 #define NUM_DARKSUBOPTIONS      2
@@ -69,8 +81,22 @@
 #define RECMARGIN_50PCT		9
 #define NUM_RECMARGINS		10
 
+#define QUICKLOOKOPTION_OFF	0
+#define QUICKLOOKOPTION_ON	1
+#define NUM_QUICKLOOKOPTIONS	2
+
+#define SWCOMPRESSION_OFF	0
+#define SWCOMPRESSION_BOTH	1
+#define SWCOMPRESSION_ONLY	2
+#define NUM_SWCOMPRESSIONOPTIONS	3
+
+#define MANIFESTOPTION_OFF	0
+#define MANIFESTOPTION_ON	1
+#define NUM_MANIFESTOPTIONS	2
+
 #define DEFAULT_PREFIX          "NGDCS"
 #define DEFAULT_PRODUCTROOTDIR  "/data"
+#define DEFAULT_STRIPEDIRS	""
 
 #define OBCINTERFACE_NONE   	0
 #define OBCINTERFACE_FPGA   	1
@@ -134,6 +160,16 @@
 #define DIAGOPTION_ON		1
 #define NUM_DIAGOPTIONS         2
 
+    /* how often the end-to-end diagnostics file is sampled */
+
+#define DIAGSRATE_10HZ		0
+#define DIAGSRATE_5HZ		1
+#define DIAGSRATE_2HZ		2
+#define DIAGSRATE_1HZ		3
+#define DIAGSRATE_0PT5HZ	4
+#define DIAGSRATE_0PT2HZ	5
+#define NUM_DIAGSRATES		6
+
 #define MAX_NGDCS_LINE_LEN	256
 
 #define MAX_DN			((1<<14)-1)
@@ -177,14 +213,23 @@ protected:
     int m_downtrackSkip;
     int m_stretchMin;
     int m_stretchMax;
+    int m_stretchMode;
     double m_greenGain;
     double m_blueGain;
+    int m_redCurve;
+    int m_greenCurve;
+    int m_blueCurve;
+    double m_redGamma;
+    double m_greenGamma;
+    double m_blueGamma;
     int m_darkSubOption;
     char *m_darkSubDirMRU;
     int m_navDuration;
     int m_reflectionOption;
 
     static const char *const viewerTypes[NUM_VIEWERTYPES+1];
+    static const char *const stretchModes[NUM_STRETCHMODES+1];
+    static const char *const stretchCurves[NUM_STRETCHCURVES+1];
     static const char *const darkSubOptions[NUM_DARKSUBOPTIONS+1];
     static const char *const navDurations[NUM_NAVDURATIONS+1];
     static const int navDurationSkips[NUM_NAVDURATIONS];
@@ -195,9 +240,17 @@ protected:
     int m_recMargin;
     char *m_prefix;
     char *m_productRootDirMRU;
+    char *m_stripeDirs;
+    int m_quicklookOption;
+    int m_swCompressionOption;
+    int m_manifestOption;
 
     static const char *const recMargins[NUM_RECMARGINS+1];
     static const double recMarginPcts[NUM_RECMARGINS];
+    static const char *const quicklookOptions[NUM_QUICKLOOKOPTIONS+1];
+    static const char *const swCompressionOptions[
+	NUM_SWCOMPRESSIONOPTIONS+1];
+    static const char *const manifestOptions[NUM_MANIFESTOPTIONS+1];
 
 	/* calibration variables */
 
@@ -258,10 +311,13 @@ protected:
     int m_imageSim;
     int m_gpsSim;
     int m_diagOption;
+    int m_diagsRate;
 
     static const char *const imageSims[NUM_IMAGESIMS+1];
     static const char *const gpsSims[NUM_GPSSIMS+1];
     static const char *const diagOptions[NUM_DIAGOPTIONS+1];
+    static const char *const diagsRates[NUM_DIAGSRATES+1];
+    static const double diagsRatesHz[NUM_DIAGSRATES];
 
 	/* private support routines */
 
@@ -335,10 +391,26 @@ public:
     void setStretchMin(int value);
     int currentStretchMax(void) const;
     void setStretchMax(int value);
+    const char *const *availableStretchModes(void);
+    int currentStretchMode(void) const;
+    void setStretchMode(int value);
     double currentGreenGain(void) const;
     void setGreenGain(double value);
     double currentBlueGain(void) const;
     void setBlueGain(double value);
+    const char *const *availableStretchCurves(void);
+    int currentRedCurve(void) const;
+    void setRedCurve(int value);
+    int currentGreenCurve(void) const;
+    void setGreenCurve(int value);
+    int currentBlueCurve(void) const;
+    void setBlueCurve(int value);
+    double currentRedGamma(void) const;
+    void setRedGamma(double value);
+    double currentGreenGamma(void) const;
+    void setGreenGamma(double value);
+    double currentBlueGamma(void) const;
+    void setBlueGamma(double value);
     const char *const *availableDarkSubOptions(void);
     int currentDarkSubOption(void) const;
     void setDarkSubOption(int value);
@@ -363,6 +435,17 @@ public:
     char *currentProductRootDir(void) const;
     char *currentProductRootDirMRU(void) const;
     void insertInProductRootDirMRU(const char *dir);
+    char *currentStripeDirs(void) const;
+    void setStripeDirs(const char *dirs);
+    const char *const *availableQuicklookOptions(void);
+    int currentQuicklookOption(void) const;
+    void setQuicklookOption(int value);
+    const char *const *availableSWCompressionOptions(void);
+    int currentSWCompressionOption(void) const;
+    void setSWCompressionOption(int value);
+    const char *const *availableManifestOptions(void);
+    int currentManifestOption(void) const;
+    void setManifestOption(int value);
 
     const char *const *availableOBCInterfaces(void);
     int currentOBCInterface(void) const;
@@ -434,6 +517,10 @@ public:
     const char *const *availableDiagOptions(void);
     int currentDiagOption(void) const;
     void setDiagOption(int value);
+    const char *const *availableDiagsRates(void);
+    int currentDiagsRate(void) const;
+    void setDiagsRate(int value);
+    double currentDiagsRateHz(void) const;
 
 	/* misc public routines */
 
@@ -47,15 +47,15 @@ SettingsTab::SettingsTab(SettingsBlock *b, appFrame *af, DisplayTab *dd,
 	DiagTab *dt, PlotsTab *pt, ECSDataTab *tdd, FrameBuffer *fb) :
     m_modeTable(1, 2, false),
     m_acquisitionTable(5, 2, false),
-    m_displayTable(11, 2, false),
-    m_dataStorageTable(3, 2, false),
+    m_displayTable(20, 2, false),
+    m_dataStorageTable(7, 2, false),
     m_calibrationTable(6, 2, false),
     m_shutterTable(1, 2, false),
     m_gpsTable(4, 2, false),
     m_ecsconnectionTable(6, 2, false),
     m_mountTable(2, 2, false),
     m_headlessTable(1, 2, false),
-    m_simTable(3, 2, false)
+    m_simTable(4, 2, false)
 {
     int i;
 
@@ -241,7 +241,13 @@ SettingsTab::SettingsTab(SettingsBlock *b, appFrame *af, DisplayTab *dd,
 	sigc::mem_fun(*this, &SettingsTab::onStretchMaxChange));
     m_stretchMaxSpinButton.set_increments(1.0, 1.0);
 
-    addFloatSpinSetting(m_displayTable, 7, "Green Gain",
+    addComboSetting(m_displayTable, 7, "Stretch Mode",
+	m_stretchModeCombo, m_block->availableStretchModes(),
+	m_block->currentStretchMode(), &SettingsBlock::setStretchMode, true);
+    (void)m_stretchModeCombo.signal_changed().connect(sigc::mem_fun(*this,
+        &SettingsTab::onStretchModeChange));
+
+    addFloatSpinSetting(m_displayTable, 8, "Green Gain",
 	m_greenGainSpinButton,
 	0.0, 10.0, m_block->currentGreenGain(), &SettingsBlock::setGreenGain,
 	true);
@@ -249,7 +255,7 @@ SettingsTab::SettingsTab(SettingsBlock *b, appFrame *af, DisplayTab *dd,
 	sigc::mem_fun(*this, &SettingsTab::onGreenGainChange));
     m_greenGainSpinButton.set_increments(0.01, 0.1);
 
-    addFloatSpinSetting(m_displayTable, 8, "Blue Gain",
+    addFloatSpinSetting(m_displayTable, 9, "Blue Gain",
 	m_blueGainSpinButton,
 	0.0, 10.0, m_block->currentBlueGain(), &SettingsBlock::setBlueGain,
 	true);
@@ -257,14 +263,53 @@ SettingsTab::SettingsTab(SettingsBlock *b, appFrame *af, DisplayTab *dd,
 	sigc::mem_fun(*this, &SettingsTab::onBlueGainChange));
     m_blueGainSpinButton.set_increments(0.01, 0.1);
 
-    addComboSetting(m_displayTable, 9, "Dark Subtraction",
+    addComboSetting(m_displayTable, 10, "Red Curve",
+	m_redCurveCombo, m_block->availableStretchCurves(),
+	m_block->currentRedCurve(), &SettingsBlock::setRedCurve, true);
+    (void)m_redCurveCombo.signal_changed().connect(sigc::mem_fun(*this,
+        &SettingsTab::onRedCurveChange));
+
+    addComboSetting(m_displayTable, 11, "Green Curve",
+	m_greenCurveCombo, m_block->availableStretchCurves(),
+	m_block->currentGreenCurve(), &SettingsBlock::setGreenCurve, true);
+    (void)m_greenCurveCombo.signal_changed().connect(sigc::mem_fun(*this,
+        &SettingsTab::onGreenCurveChange));
+
+    addComboSetting(m_displayTable, 12, "Blue Curve",
+	m_blueCurveCombo, m_block->availableStretchCurves(),
+	m_block->currentBlueCurve(), &SettingsBlock::setBlueCurve, true);
+    (void)m_blueCurveCombo.signal_changed().connect(sigc::mem_fun(*this,
+        &SettingsTab::onBlueCurveChange));
+
+    addFloatSpinSetting(m_displayTable, 13, "Red Gamma",
+	m_redGammaSpinButton,
+	MIN_STRETCH_GAMMA, MAX_STRETCH_GAMMA, m_block->currentRedGamma(),
+	&SettingsBlock::setRedGamma, true);
+    (void)m_redGammaSpinButton.signal_value_changed().connect(
+	sigc::mem_fun(*this, &SettingsTab::onRedGammaChange));
+
+    addFloatSpinSetting(m_displayTable, 14, "Green Gamma",
+	m_greenGammaSpinButton,
+	MIN_STRETCH_GAMMA, MAX_STRETCH_GAMMA, m_block->currentGreenGamma(),
+	&SettingsBlock::setGreenGamma, true);
+    (void)m_greenGammaSpinButton.signal_value_changed().connect(
+	sigc::mem_fun(*this, &SettingsTab::onGreenGammaChange));
+
+    addFloatSpinSetting(m_displayTable, 15, "Blue Gamma",
+	m_blueGammaSpinButton,
+	MIN_STRETCH_GAMMA, MAX_STRETCH_GAMMA, m_block->currentBlueGamma(),
+	&SettingsBlock::setBlueGamma, true);
+    (void)m_blueGammaSpinButton.signal_value_changed().connect(
+	sigc::mem_fun(*this, &SettingsTab::onBlueGammaChange));
+
+    addComboSetting(m_displayTable, 16, "Dark Subtraction",
 	m_darkSubOptionCombo, m_block->availableDarkSubOptions(),
 	m_block->currentDarkSubOption(), &SettingsBlock::setDarkSubOption,
 	true);
     (void)m_darkSubOptionCombo.signal_changed().connect(sigc::mem_fun(*this,
         &SettingsTab::onDarkSubOptionChange));
 
-    addDataLocationSetting(m_displayTable, 10, "Dark-frame Dir",
+    addDataLocationSetting(m_displayTable, 17, "Dark-frame Dir",
 	m_darkSubDirCombo, m_darkSubDirButton,
 	m_block->currentDarkSubDirMRU(),
 	(m_block->currentDarkSubOption() == DARKSUBOPTION_YES));
@@ -273,14 +318,14 @@ SettingsTab::SettingsTab(SettingsBlock *b, appFrame *af, DisplayTab *dd,
     (void)m_darkSubDirButton.signal_clicked().connect(sigc::mem_fun(*this,
 	&SettingsTab::onDarkSubDirBrowseButton));
 
-    addComboSetting(m_displayTable, 11, "Nav-plot duration",
+    addComboSetting(m_displayTable, 18, "Nav-plot duration",
 	m_navDurationCombo, m_block->availableNavDurations(),
 	m_block->currentNavDuration(), &SettingsBlock::setNavDuration,
 	true);
     (void)m_navDurationCombo.signal_changed().connect(sigc::mem_fun(*this,
         &SettingsTab::onNavDurationChange));
 
-    addComboSetting(m_displayTable, 12, "Reflection",
+    addComboSetting(m_displayTable, 19, "Reflection",
 	m_reflectionOptionCombo, m_block->availableReflectionOptions(),
 	m_block->currentReflectionOption(),
 	&SettingsBlock::setReflectionOption, true);
@@ -315,6 +360,32 @@ SettingsTab::SettingsTab(SettingsBlock *b, appFrame *af, DisplayTab *dd,
     (void)m_productRootDirButton.signal_clicked().connect(sigc::mem_fun(*this,
 	&SettingsTab::onProductRootDirBrowseButton));
 
+    addEntrySetting(m_dataStorageTable, 3, "Stripe Dirs",
+	m_stripeDirsEntry, m_block->currentStripeDirs(), true);
+    (void)m_stripeDirsEntry.signal_focus_out_event().connect(
+	sigc::mem_fun(*this, &SettingsTab::onStripeDirsChange));
+
+    addComboSetting(m_dataStorageTable, 4, "Quicklook",
+	m_quicklookOptionCombo, m_block->availableQuicklookOptions(),
+	m_block->currentQuicklookOption(), &SettingsBlock::setQuicklookOption,
+	true);
+    (void)m_quicklookOptionCombo.signal_changed().connect(sigc::mem_fun(
+	*this, &SettingsTab::onQuicklookOptionChange));
+
+    addComboSetting(m_dataStorageTable, 5, "SW compression",
+	m_swCompressionOptionCombo, m_block->availableSWCompressionOptions(),
+	m_block->currentSWCompressionOption(),
+	&SettingsBlock::setSWCompressionOption, true);
+    (void)m_swCompressionOptionCombo.signal_changed().connect(sigc::mem_fun(
+	*this, &SettingsTab::onSWCompressionOptionChange));
+
+    addComboSetting(m_dataStorageTable, 6, "Manifest",
+	m_manifestOptionCombo, m_block->availableManifestOptions(),
+	m_block->currentManifestOption(), &SettingsBlock::setManifestOption,
+	true);
+    (void)m_manifestOptionCombo.signal_changed().connect(sigc::mem_fun(
+	*this, &SettingsTab::onManifestOptionChange));
+
     m_dataStorageFrame.add(m_dataStorageTable);
     m_dataStorageFrame.set_label("Data Storage");
     m_v2box.pack_start(m_dataStorageFrame, Gtk::PACK_SHRINK);
@@ -532,6 +603,12 @@ SettingsTab::SettingsTab(SettingsBlock *b, appFrame *af, DisplayTab *dd,
     (void)m_diagOptionCombo.signal_changed().connect(sigc::mem_fun(*this,
         &SettingsTab::onDiagOptionChange));
 
+    addComboSetting(m_simTable, 3, "Diags Sampling",
+	m_diagsRateCombo, m_block->availableDiagsRates(),
+	m_block->currentDiagsRate(), &SettingsBlock::setDiagsRate, true);
+    (void)m_diagsRateCombo.signal_changed().connect(sigc::mem_fun(*this,
+        &SettingsTab::onDiagsRateChange));
+
     m_simFrame.add(m_simTable);
     m_simFrame.set_label("Simulation and Diagnostics");
     m_v1box.pack_start(m_simFrame, Gtk::PACK_SHRINK);
@@ -1036,6 +1113,18 @@ void SettingsTab::onStretchMaxChange(void)
 }
 
 
+void SettingsTab::onStretchModeChange(void)
+{
+	/* in auto mode the display tab's band statistics take over the
+	   stretch; going back to manual restores the min and max */
+
+    comboEntryToIndex(&m_stretchModeCombo,
+	m_block->availableStretchModes(), &SettingsBlock::setStretchMode,
+	"stretch mode");
+    m_displayTab->updateStretch();
+}
+
+
 void SettingsTab::onGreenGainChange(void)
 {
     char logmsg[200];
@@ -1070,6 +1159,88 @@ void SettingsTab::onBlueGainChange(void)
 }
 
 
+void SettingsTab::onRedCurveChange(void)
+{
+	/* red's curve is also the frame view's */
+
+    comboEntryToIndex(&m_redCurveCombo,
+	m_block->availableStretchCurves(), &SettingsBlock::setRedCurve,
+	"red stretch curve");
+    m_displayTab->updateStretch();
+}
+
+
+void SettingsTab::onGreenCurveChange(void)
+{
+    comboEntryToIndex(&m_greenCurveCombo,
+	m_block->availableStretchCurves(), &SettingsBlock::setGreenCurve,
+	"green stretch curve");
+    m_displayTab->updateStretch();
+}
+
+
+void SettingsTab::onBlueCurveChange(void)
+{
+    comboEntryToIndex(&m_blueCurveCombo,
+	m_block->availableStretchCurves(), &SettingsBlock::setBlueCurve,
+	"blue stretch curve");
+    m_displayTab->updateStretch();
+}
+
+
+void SettingsTab::onRedGammaChange(void)
+{
+    char logmsg[200];
+
+	/* red's gamma is also the frame view's */
+
+    if (m_silentChange)
+	m_silentChange = false;
+    else {
+	sprintf(logmsg, "User changed red gamma to %g.",
+	    m_redGammaSpinButton.get_value());
+	m_displayTab->log(logmsg);
+    }
+
+    m_block->setRedGamma(m_redGammaSpinButton.get_value());
+    m_displayTab->updateStretch();
+}
+
+
+void SettingsTab::onGreenGammaChange(void)
+{
+    char logmsg[200];
+
+    if (m_silentChange)
+	m_silentChange = false;
+    else {
+	sprintf(logmsg, "User changed green gamma to %g.",
+	    m_greenGammaSpinButton.get_value());
+	m_displayTab->log(logmsg);
+    }
+
+    m_block->setGreenGamma(m_greenGammaSpinButton.get_value());
+    m_displayTab->updateStretch();
+}
+
+
+void SettingsTab::onBlueGammaChange(void)
+{
+    char logmsg[200];
+
+    if (m_silentChange)
+	m_silentChange = false;
+    else {
+	sprintf(logmsg, "User changed blue gamma to %g.",
+	    m_blueGammaSpinButton.get_value());
+	m_displayTab->log(logmsg);
+    }
+
+    m_block->setBlueGamma(m_blueGammaSpinButton.get_value());
+    m_displayTab->updateStretch();
+}
+
+
 void SettingsTab::onDarkSubOptionChange(void)
 {
     comboEntryToIndex(&m_darkSubOptionCombo,
@@ -1159,6 +1330,31 @@ void SettingsTab::onRecMarginChange(void)
 }
 
 
+void SettingsTab::onQuicklookOptionChange(void)
+{
+    comboEntryToIndex(&m_quicklookOptionCombo,
+	m_block->availableQuicklookOptions(),
+	&SettingsBlock::setQuicklookOption, "quicklook option");
+}
+
+
+void SettingsTab::onSWCompressionOptionChange(void)
+{
+    comboEntryToIndex(&m_swCompressionOptionCombo,
+	m_block->availableSWCompressionOptions(),
+	&SettingsBlock::setSWCompressionOption,
+	"software compression option");
+}
+
+
+void SettingsTab::onManifestOptionChange(void)
+{
+    comboEntryToIndex(&m_manifestOptionCombo,
+	m_block->availableManifestOptions(),
+	&SettingsBlock::setManifestOption, "integrity manifest option");
+}
+
+
 bool SettingsTab::onPrefixChange(GdkEventFocus *event)
 {
     char logmsg[200];
@@ -1176,6 +1372,24 @@ bool SettingsTab::onPrefixChange(GdkEventFocus *event)
 }
 
 
+bool SettingsTab::onStripeDirsChange(GdkEventFocus *event)
+{
+    char logmsg[200+MAXPATHLEN];
+
+    if (m_silentChange)
+	m_silentChange = false;
+    else {
+	sprintf(logmsg, "User changed stripe dirs to \"%.*s\".", MAXPATHLEN,
+	    m_stripeDirsEntry.get_text().c_str());
+	m_displayTab->log(logmsg);
+    }
+
+    m_block->setStripeDirs(m_stripeDirsEntry.get_text().c_str());
+    m_displayTab->updateResourcesDisplay();
+    return false;
+}
+
+
 void SettingsTab::onProductRootDirChange(void)
 {
     char errorMsg[MAXPATHLEN + 60];
@@ -1560,6 +1774,14 @@ void SettingsTab::onDiagOptionChange(void)
 }
 
 
+void SettingsTab::onDiagsRateChange(void)
+{
+    comboEntryToIndex(&m_diagsRateCombo,
+	m_block->availableDiagsRates(), &SettingsBlock::setDiagsRate,
+	"diagnostics sampling rate");
+}
+
+
 void SettingsTab::disableSettingsChanges(void)
 {
     if (dialogInitialized) {
@@ -1588,8 +1810,15 @@ void SettingsTab::disableSettingsChanges(void)
 	}
 	m_stretchMinSpinButton.set_sensitive(true);
 	m_stretchMaxSpinButton.set_sensitive(true);
+	m_stretchModeCombo.set_sensitive(true);
 	m_greenGainSpinButton.set_sensitive(true);
 	m_blueGainSpinButton.set_sensitive(true);
+	m_redCurveCombo.set_sensitive(true);
+	m_greenCurveCombo.set_sensitive(true);
+	m_blueCurveCombo.set_sensitive(true);
+	m_redGammaSpinButton.set_sensitive(true);
+	m_greenGammaSpinButton.set_sensitive(true);
+	m_blueGammaSpinButton.set_sensitive(true);
         m_darkSubOptionCombo.set_sensitive(false);
         m_darkSubDirCombo.set_sensitive(false);
         m_darkSubDirButton.set_sensitive(false);
@@ -1600,6 +1829,10 @@ void SettingsTab::disableSettingsChanges(void)
 
         m_recMarginCombo.set_sensitive(false);
         m_prefixEntry.set_sensitive(false);
+        m_stripeDirsEntry.set_sensitive(false);
+        m_quicklookOptionCombo.set_sensitive(false);
+        m_swCompressionOptionCombo.set_sensitive(false);
+        m_manifestOptionCombo.set_sensitive(false);
         m_productRootDirCombo.set_sensitive(false);
         m_productRootDirButton.set_sensitive(false);
 
@@ -1648,6 +1881,7 @@ void SettingsTab::disableSettingsChanges(void)
 	m_imageSimCombo.set_sensitive(true);
 	m_gpsSimCombo.set_sensitive(true);
         m_diagOptionCombo.set_sensitive(true);
+        m_diagsRateCombo.set_sensitive(true);
     }
 }
 
@@ -1680,8 +1914,15 @@ void SettingsTab::enableSettingsChanges(void)
 	}
 	m_stretchMinSpinButton.set_sensitive(true);
 	m_stretchMaxSpinButton.set_sensitive(true);
+	m_stretchModeCombo.set_sensitive(true);
 	m_greenGainSpinButton.set_sensitive(true);
 	m_blueGainSpinButton.set_sensitive(true);
+	m_redCurveCombo.set_sensitive(true);
+	m_greenCurveCombo.set_sensitive(true);
+	m_blueCurveCombo.set_sensitive(true);
+	m_redGammaSpinButton.set_sensitive(true);
+	m_greenGammaSpinButton.set_sensitive(true);
+	m_blueGammaSpinButton.set_sensitive(true);
         m_darkSubOptionCombo.set_sensitive(true);
 	if (m_block->currentDarkSubOption() == DARKSUBOPTION_YES) {
 	    m_darkSubDirCombo.set_sensitive(true);
@@ -1694,6 +1935,10 @@ void SettingsTab::enableSettingsChanges(void)
 
         m_recMarginCombo.set_sensitive(true);
         m_prefixEntry.set_sensitive(true);
+        m_stripeDirsEntry.set_sensitive(true);
+        m_quicklookOptionCombo.set_sensitive(true);
+        m_swCompressionOptionCombo.set_sensitive(true);
+        m_manifestOptionCombo.set_sensitive(true);
         m_productRootDirCombo.set_sensitive(true);
         m_productRootDirButton.set_sensitive(true);
 
@@ -1745,6 +1990,7 @@ void SettingsTab::enableSettingsChanges(void)
 	m_imageSimCombo.set_sensitive(true);
 	m_gpsSimCombo.set_sensitive(true);
         m_diagOptionCombo.set_sensitive(true);
+        m_diagsRateCombo.set_sensitive(true);
     }
 }
 
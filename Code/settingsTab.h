@@ -85,8 +85,15 @@ protected:
     Gtk::SpinButton m_downtrackSkipSpinButton;
     Gtk::SpinButton m_stretchMinSpinButton;
     Gtk::SpinButton m_stretchMaxSpinButton;
+    Gtk::ComboBoxText m_stretchModeCombo;
     Gtk::SpinButton m_greenGainSpinButton;
     Gtk::SpinButton m_blueGainSpinButton;
+    Gtk::ComboBoxText m_redCurveCombo;
+    Gtk::ComboBoxText m_greenCurveCombo;
+    Gtk::ComboBoxText m_blueCurveCombo;
+    Gtk::SpinButton m_redGammaSpinButton;
+    Gtk::SpinButton m_greenGammaSpinButton;
+    Gtk::SpinButton m_blueGammaSpinButton;
     Gtk::ComboBoxText m_darkSubOptionCombo;
     Gtk::ComboBoxText m_darkSubDirCombo;
     Gtk::Button m_darkSubDirButton;
@@ -97,6 +104,10 @@ protected:
     Gtk::Entry m_prefixEntry;
     Gtk::ComboBoxText m_productRootDirCombo;
     Gtk::Button m_productRootDirButton;
+    Gtk::Entry m_stripeDirsEntry;
+    Gtk::ComboBoxText m_quicklookOptionCombo;
+    Gtk::ComboBoxText m_swCompressionOptionCombo;
+    Gtk::ComboBoxText m_manifestOptionCombo;
 
     Gtk::ComboBoxText m_obcInterfaceCombo;
     Gtk::ComboBoxText m_dark1CalPeriodCombo;
@@ -127,6 +138,7 @@ protected:
     Gtk::ComboBoxText m_imageSimCombo;
     Gtk::ComboBoxText m_gpsSimCombo;
     Gtk::ComboBoxText m_diagOptionCombo;
+    Gtk::ComboBoxText m_diagsRateCombo;
 
 	/* handlers */
 
@@ -145,8 +157,15 @@ protected:
     void onDowntrackSkipChange(void);
     void onStretchMinChange(void);
     void onStretchMaxChange(void);
+    void onStretchModeChange(void);
     void onGreenGainChange(void);
     void onBlueGainChange(void);
+    void onRedCurveChange(void);
+    void onGreenCurveChange(void);
+    void onBlueCurveChange(void);
+    void onRedGammaChange(void);
+    void onGreenGammaChange(void);
+    void onBlueGammaChange(void);
     void onDarkSubOptionChange(void);
     void onDarkSubDirChange(void);
     void onDarkSubDirBrowseButton(void);
@@ -154,9 +173,13 @@ protected:
     void onReflectionOptionChange(void);
 
     void onRecMarginChange(void);
+    void onQuicklookOptionChange(void);
+    void onSWCompressionOptionChange(void);
+    void onManifestOptionChange(void);
     bool onPrefixChange(GdkEventFocus *event);
     void onProductRootDirChange(void);
     void onProductRootDirBrowseButton(void);
+    bool onStripeDirsChange(GdkEventFocus *event);
 
     void onOBCInterfaceChange(void);
     void onDark1CalPeriodChange(void);
@@ -187,6 +210,7 @@ protected:
     void onImageSimChange(void);
     void onGPSSimChange(void);
     void onDiagOptionChange(void);
+    void onDiagsRateChange(void);
 
 	/* misc */
 
@@ -0,0 +1,140 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+#include <sys/types.h>
+#include "stretchlut.h"
+
+extern const char *const stretchlutDate = "$Date: 2015/12/22 16:05:48 $";
+
+
+StretchLUT::StretchLUT()
+{
+    int i;
+
+    for (i=0;i < 2;i++) {
+	m_tables[i] = new u_char[STRETCHLUT_ENTRIES];
+	(void)memset(m_tables[i], 255, STRETCHLUT_ENTRIES);
+	m_readers[i] = 0;
+    }
+    m_front = 0;
+    (void)pthread_mutex_init(&m_buildLock, NULL);
+}
+
+
+StretchLUT::~StretchLUT()
+{
+    delete[] m_tables[0];
+    delete[] m_tables[1];
+    (void)pthread_mutex_destroy(&m_buildLock);
+}
+
+
+void StretchLUT::build(int curve, int min, int max, double gain,
+    double gamma, const u_int *hist)
+{
+    u_char *table;
+    double range, t, v, scale, invGamma, logNorm, total, sum;
+    int back, i;
+
+	/* builders take turns.  wait out anyone still drawing with the back
+	   table -- that's at most a frame's worth of lookups */
+
+    (void)pthread_mutex_lock(&m_buildLock);
+    back = 1 - m_front;
+    while (m_readers[back] != 0)
+	(void)sched_yield();
+    table = m_tables[back];
+
+	/* work out what the curve needs up front so the table is one pass */
+
+    if (max < min)
+	max = min;
+    range = (max > min)? (double)(max - min):1.0;
+    scale = 255.0 * gain;
+    invGamma = (gamma > 0.0)? 1.0 / gamma:1.0;
+    logNorm = 1.0 / log(1.0 + STRETCHLUT_LOG_SCALE);
+    total = 0.0;
+    if (curve == STRETCHLUT_EQUALIZE) {
+	if (hist != NULL)
+	    for (i=(min > 0)? min:0;i <= max && i <= STRETCHLUT_MAX_DN;i++)
+		total += hist[i];
+	if (total == 0.0)
+	    curve = STRETCHLUT_LINEAR;
+    }
+
+    sum = 0.0;
+    for (i=0;i < STRETCHLUT_ENTRIES;i++) {
+	if (i < min)
+	    t = 0.0;
+	else if (i > max || i > STRETCHLUT_MAX_DN || max == min)
+	    t = 1.0;
+	else t = (i - min) / range;
+	switch (curve) {
+	    case STRETCHLUT_GAMMA:
+		v = pow(t, invGamma);
+		break;
+	    case STRETCHLUT_LOG:
+		v = log(1.0 + STRETCHLUT_LOG_SCALE * t) * logNorm;
+		break;
+	    case STRETCHLUT_EQUALIZE:
+		if (i >= min && i <= max && i <= STRETCHLUT_MAX_DN) {
+		    sum += hist[i];
+		    v = sum / total;
+		}
+		else v = t;
+		break;
+	    default:
+		v = t;
+		break;
+	}
+	v = v * scale + 0.5;
+	table[i] = (v >= 255.0)? 255:(u_char)v;
+    }
+
+	/* make sure the table is all there before anyone can see it */
+
+    __sync_synchronize();
+    m_front = back;
+    (void)pthread_mutex_unlock(&m_buildLock);
+}
+
+
+const u_char *StretchLUT::acquire(void)
+{
+    int front;
+
+	/* count ourselves a reader of the front table, then make sure it
+	   didn't get swapped out from under us before we were counted */
+
+    for (;;) {
+	front = m_front;
+	(void)__sync_fetch_and_add(&m_readers[front], 1);
+	if (front == m_front)
+	    return m_tables[front];
+	(void)__sync_fetch_and_sub(&m_readers[front], 1);
+    }
+}
+
+
+void StretchLUT::release(const u_char *table)
+{
+    (void)__sync_fetch_and_sub(&m_readers[(table == m_tables[0])? 0:1], 1);
+}
@@ -0,0 +1,61 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <pthread.h>
+#include <sys/types.h>
+
+    /* display stretch tables, one per channel.  a table maps every DN to
+       an 8-bit display value along the chosen curve between min and max
+       (0 below min, 255 above).  gamma and log brighten the low end;
+       equalization follows the channel's histogram (see bandstats.h) so
+       that each display level covers about the same number of pixels,
+       and falls back to linear until there's a histogram to go on.
+
+       tables are double-buffered.  a new table is built in the back
+       buffer and swapped in whole, so a frame being drawn always sees
+       one table from start to finish.  the renderer never waits:  it
+       takes the front table with acquire() and gives it back with
+       release(), and it's the builder that waits, if it must, for the
+       last reader of the back buffer to finish with it */
+
+#define STRETCHLUT_ENTRIES	65536	/* any 16-bit pixel can be looked up */
+#define STRETCHLUT_MAX_DN	((1<<14)-1)
+#define STRETCHLUT_LOG_SCALE	100.0
+
+    /* curves, in the order of SettingsBlock's stretch-curve choices */
+
+#define STRETCHLUT_LINEAR	0
+#define STRETCHLUT_GAMMA	1
+#define STRETCHLUT_LOG		2
+#define STRETCHLUT_EQUALIZE	3
+
+class StretchLUT
+{
+protected:
+    u_char *m_tables[2];
+    volatile int m_front;
+    volatile int m_readers[2];
+    pthread_mutex_t m_buildLock;
+public:
+    StretchLUT();
+    ~StretchLUT();
+    void build(int curve, int min, int max, double gain, double gamma,
+	const u_int *hist);
+    const u_char *acquire(void);
+    void release(const u_char *table);
+};
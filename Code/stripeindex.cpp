@@ -0,0 +1,128 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stripeindex.h"
+
+extern const char *const stripeindexDate = "$Date: 2015/12/18 19:02:55 $";
+
+
+int writeStripeIndex(const char *path, const stripe_index_t *index)
+{
+    FILE *fp;
+    char temp[MAXPATHLEN+10];
+    int i;
+
+	/* write to a temporary and rename, so a reader never sees half an
+	   index */
+
+    (void)sprintf(temp, "%s.tmp", path);
+    if ((fp=fopen(temp, "w")) == NULL)
+	return -1;
+    (void)fprintf(fp, "NGDCS stripe index\n");
+    (void)fprintf(fp, "version = %d\n", index->version);
+    (void)fprintf(fp, "frame bytes = %lu\n", index->frameBytes);
+    (void)fprintf(fp, "block frames = %d\n", index->blockFrames);
+    (void)fprintf(fp, "stripes = %d\n", index->numStripes);
+    (void)fprintf(fp, "frames = %u\n", index->frames);
+    (void)fprintf(fp, "written = %u\n", index->written);
+    for (i=0;i < index->numStripes;i++)
+	(void)fprintf(fp, "stripe %d = %s\n", i, index->paths[i]);
+    if (fclose(fp) == EOF || rename(temp, path) == -1) {
+	(void)remove(temp);
+	return -1;
+    }
+    return 0;
+}
+
+
+int readStripeIndex(const char *path, stripe_index_t *index, char *errorMsg)
+{
+    FILE *fp;
+    char buf[MAXPATHLEN+40], *p;
+    int n, haveStripes;
+
+    (void)memset(index, 0, sizeof(stripe_index_t));
+    if ((fp=fopen(path, "r")) == NULL) {
+	(void)sprintf(errorMsg, "Can't open stripe index \"%s\".", path);
+	return -1;
+    }
+    if (fgets(buf, sizeof(buf), fp) == NULL ||
+	    strcmp(buf, "NGDCS stripe index\n") != 0) {
+	(void)sprintf(errorMsg, "\"%s\" isn't a stripe index.", path);
+	(void)fclose(fp);
+	return -1;
+    }
+    haveStripes = 0;
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+	if ((p=strchr(buf, '\n')) != NULL)
+	    *p = '\0';
+	if (sscanf(buf, "version = %d", &index->version) == 1) ;
+	else if (sscanf(buf, "frame bytes = %lu", &index->frameBytes) == 1) ;
+	else if (sscanf(buf, "block frames = %d", &index->blockFrames) == 1) ;
+	else if (sscanf(buf, "stripes = %d", &index->numStripes) == 1) ;
+	else if (sscanf(buf, "frames = %u", &index->frames) == 1) ;
+	else if (sscanf(buf, "written = %u", &index->written) == 1) ;
+	else if (sscanf(buf, "stripe %d = ", &n) == 1 &&
+		(p=strstr(buf, " = ")) != NULL && n >= 0 &&
+		n < STRIPE_MAX_STRIPES) {
+	    (void)strncpy(index->paths[n], p+3, MAXPATHLEN-1);
+	    haveStripes++;
+	}
+    }
+    (void)fclose(fp);
+
+    if (index->version != STRIPE_INDEX_VERSION) {
+	(void)sprintf(errorMsg, "Unsupported stripe index version %d.",
+	    index->version);
+	return -1;
+    }
+    if (index->frameBytes == 0 || index->blockFrames < 1 ||
+	    index->numStripes < 1 || index->numStripes > STRIPE_MAX_STRIPES ||
+	    haveStripes != index->numStripes) {
+	(void)sprintf(errorMsg, "Stripe index \"%s\" is incomplete.", path);
+	return -1;
+    }
+    return 0;
+}
+
+
+int stripeForFrame(const stripe_index_t *index, u_int frame, off_t *offset_p)
+{
+    u_int block;
+
+	/* which stripe holds this frame of the flight line, and where */
+
+    block = frame / index->blockFrames;
+    *offset_p = ((off_t)(block / index->numStripes) * index->blockFrames +
+	frame % index->blockFrames) * (off_t)index->frameBytes;
+    return block % index->numStripes;
+}
+
+
+u_int stripeFirstMissing(const stripe_index_t *index, int stripe,
+    u_int stripeFrames)
+{
+	/* given that a stripe holds its first stripeFrames frames, the
+	   first frame of the flight line it doesn't have */
+
+    return (stripeFrames / index->blockFrames) * index->blockFrames *
+	index->numStripes + stripe * index->blockFrames +
+	stripeFrames % index->blockFrames;
+}
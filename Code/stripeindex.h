@@ -0,0 +1,56 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+#include <sys/types.h>
+#include <sys/param.h>
+
+    /* striped flight lines.  frames are dealt out to the stripe files in
+       blocks of blockFrames, round robin -- block b of the flight line is
+       block b/numStripes of stripe b%numStripes.  the index is a small
+       text file (same "key = value" form as the ENVI header) next to the
+       header in the daily directory, naming the stripe files in order.
+       frames is filled in when the recording is closed.  while recording,
+       written is brought up to date every STRIPE_CHECKPOINT_SECS or so
+       with the number of frames known to be in the stripe files, so an
+       index left with frames = 0 by a crash can be reassembled that far.
+       the stripe sizes aren't to be trusted for that -- a chunk can be
+       written past one that isn't there yet */
+
+#define STRIPE_INDEX_SUFFIX	".stripes"
+#define STRIPE_FILE_SUFFIX	".stripe"
+#define STRIPE_INDEX_VERSION	1
+#define STRIPE_MAX_STRIPES	8
+#define STRIPE_BLOCK_FRAMES	16
+#define STRIPE_CHECKPOINT_SECS	5
+
+typedef struct {
+    int version;
+    u_long frameBytes;
+    int blockFrames;
+    int numStripes;
+    u_int frames;
+    u_int written;
+    char paths[STRIPE_MAX_STRIPES][MAXPATHLEN];
+} stripe_index_t;
+
+extern int writeStripeIndex(const char *path, const stripe_index_t *index);
+extern int readStripeIndex(const char *path, stripe_index_t *index,
+    char *errorMsg);
+extern int stripeForFrame(const stripe_index_t *index, u_int frame,
+    off_t *offset_p);
+extern u_int stripeFirstMissing(const stripe_index_t *index, int stripe,
+    u_int stripeFrames);
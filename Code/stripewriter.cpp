@@ -0,0 +1,290 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "rawwriter.h"
+#include "stripeindex.h"
+#include "stripewriter.h"
+
+extern const char *const stripewriterDate = "$Date: 2015/12/18 19:02:55 $";
+
+
+StripedImageWriter::StripedImageWriter()
+{
+    int i;
+
+    for (i=0;i < STRIPE_MAX_STRIPES;i++)
+	m_writers[i] = NULL;
+    m_numWriters = 0;
+    m_numStripes = 0;
+    (void)memset(&m_index, 0, sizeof(m_index));
+    m_imagePath[0] = '\0';
+    m_indexPath[0] = '\0';
+    m_frameBytes = 0;
+    m_frames = 0;
+    m_checkpointFrames = 0;
+    m_open = false;
+}
+
+
+StripedImageWriter::~StripedImageWriter()
+{
+    int i;
+
+    if (m_open)
+	(void)close();
+    for (i=0;i < m_numWriters;i++)
+	delete m_writers[i];
+}
+
+
+int StripedImageWriter::open(const char *imagePath,
+    char (*stripePaths)[MAXPATHLEN], int numStripes, size_t frameBytes,
+    double frameRateHz, double plannedSecs)
+{
+    int i, n, saveErrno;
+
+    if (m_open) {
+	errno = EBUSY;
+	return -1;
+    }
+    if (numStripes < 0 || numStripes > STRIPE_MAX_STRIPES) {
+	errno = EINVAL;
+	return -1;
+    }
+
+	/* writers hang onto their chunk buffers between recordings, so keep
+	   them around rather than making new ones each time */
+
+    n = (numStripes == 0)? 1:numStripes;
+    while (m_numWriters < n) {
+	m_writers[m_numWriters] = new RawImageWriter;
+	m_numWriters++;
+    }
+    (void)strcpy(m_imagePath, imagePath);
+    m_numStripes = numStripes;
+    m_frameBytes = frameBytes;
+    m_frames = 0;
+
+    if (numStripes == 0) {
+	if (m_writers[0]->open(imagePath, frameBytes, frameRateHz,
+		plannedSecs) == -1)
+	    return -1;
+	m_open = true;
+	return 0;
+    }
+
+	/* each stripe sees 1/n of the data rate */
+
+    for (i=0;i < numStripes;i++) {
+	(void)sprintf(m_index.paths[i], "%s", stripePaths[i]);
+	if (m_writers[i]->open(stripePaths[i], frameBytes,
+		frameRateHz / numStripes, plannedSecs) == -1) {
+	    saveErrno = errno;
+	    while (--i >= 0) {
+		(void)m_writers[i]->close();
+		(void)unlink(stripePaths[i]);
+	    }
+	    errno = saveErrno;
+	    return -1;
+	}
+    }
+    m_index.version = STRIPE_INDEX_VERSION;
+    m_index.frameBytes = frameBytes;
+    m_index.blockFrames = STRIPE_BLOCK_FRAMES;
+    m_index.numStripes = numStripes;
+    m_index.frames = 0;
+    m_index.written = 0;
+    m_checkpointFrames = (u_int)(frameRateHz * STRIPE_CHECKPOINT_SECS);
+    m_checkpointFrames = (m_checkpointFrames / STRIPE_BLOCK_FRAMES + 1) *
+	STRIPE_BLOCK_FRAMES;
+    (void)sprintf(m_indexPath, "%s%s", imagePath, STRIPE_INDEX_SUFFIX);
+    if (writeStripeIndex(m_indexPath, &m_index) == -1) {
+	saveErrno = errno;
+	for (i=0;i < numStripes;i++) {
+	    (void)m_writers[i]->close();
+	    (void)unlink(stripePaths[i]);
+	}
+	errno = saveErrno;
+	return -1;
+    }
+    m_open = true;
+    return 0;
+}
+
+
+int StripedImageWriter::writeFrame(const void *frame)
+{
+    int stripe;
+
+    if (!m_open) {
+	errno = EBADF;
+	return -1;
+    }
+    stripe = (m_numStripes == 0)? 0:
+	(m_frames / STRIPE_BLOCK_FRAMES) % m_numStripes;
+    if (m_writers[stripe]->writeFrame(frame) == -1)
+	return -1;
+    m_frames++;
+    if (m_numStripes > 0 && m_frames % m_checkpointFrames == 0)
+	checkpoint();
+    return 0;
+}
+
+
+u_int StripedImageWriter::framesWritten(void)
+{
+    u_int written, missing;
+    int i;
+
+	/* frames of the flight line known to be in the file(s) */
+
+    if (!m_open)
+	return 0;
+    if (m_numStripes == 0)
+	return (u_int)(m_writers[0]->bytesWritten() / m_frameBytes);
+    written = m_frames;
+    for (i=0;i < m_numStripes;i++) {
+	missing = stripeFirstMissing(&m_index, i,
+	    (u_int)(m_writers[i]->bytesWritten() / m_frameBytes));
+	if (missing < written)
+	    written = missing;
+    }
+    return written;
+}
+
+
+void StripedImageWriter::checkpoint(void)
+{
+    u_int written;
+
+	/* note in the index how far the stripes are known to be written, for
+	   reassembling them if we never get to close.  failing here costs
+	   only that, so it's not an error */
+
+    written = framesWritten();
+    if (written > m_index.written) {
+	m_index.written = written;
+	(void)writeStripeIndex(m_indexPath, &m_index);
+    }
+}
+
+
+int StripedImageWriter::close(void)
+{
+    int i, n, result, saveErrno;
+
+    if (!m_open)
+	return 0;
+    result = 0;
+    saveErrno = 0;
+    n = (m_numStripes == 0)? 1:m_numStripes;
+    for (i=0;i < n;i++)
+	if (m_writers[i]->close() == -1 && result == 0) {
+	    saveErrno = errno;
+	    result = -1;
+	}
+
+	/* now that we know the length, record it */
+
+    if (m_numStripes > 0) {
+	m_index.frames = m_frames;
+	m_index.written = m_frames;
+	if (writeStripeIndex(m_indexPath, &m_index) == -1 && result == 0) {
+	    saveErrno = errno;
+	    result = -1;
+	}
+    }
+    m_open = false;
+    if (result == -1)
+	errno = saveErrno;
+    return result;
+}
+
+
+void StripedImageWriter::removeFiles(void)
+{
+    int i;
+
+    if (m_numStripes == 0)
+	(void)unlink(m_imagePath);
+    else {
+	for (i=0;i < m_numStripes;i++)
+	    (void)unlink(m_index.paths[i]);
+	(void)unlink(m_indexPath);
+    }
+}
+
+
+bool StripedImageWriter::isDirect(void) const
+{
+    int i, n;
+
+    n = (m_numStripes == 0)? 1:m_numStripes;
+    for (i=0;i < n;i++)
+	if (!m_writers[i]->isDirect())
+	    return false;
+    return true;
+}
+
+
+static void combineStats(RawWriterStats *total_p, const RawWriterStats *s)
+{
+	/* throughput adds up across disks.  for latency, the slowest disk
+	   is the one that matters */
+
+    total_p->mbPerSec += s->mbPerSec;
+    if (s->p50LatencyMs > total_p->p50LatencyMs)
+	total_p->p50LatencyMs = s->p50LatencyMs;
+    if (s->p99LatencyMs > total_p->p99LatencyMs)
+	total_p->p99LatencyMs = s->p99LatencyMs;
+    if (s->maxLatencyMs > total_p->maxLatencyMs)
+	total_p->maxLatencyMs = s->maxLatencyMs;
+    total_p->chunksWritten += s->chunksWritten;
+    total_p->chunksQueued += s->chunksQueued;
+}
+
+
+void StripedImageWriter::getStats(RawWriterStats *stats_p)
+{
+    RawWriterStats s;
+    int i, n;
+
+    (void)memset(stats_p, 0, sizeof(RawWriterStats));
+    n = (m_numStripes == 0)? 1:m_numStripes;
+    for (i=0;i < n && i < m_numWriters;i++) {
+	m_writers[i]->getStats(&s);
+	combineStats(stats_p, &s);
+    }
+}
+
+
+void StripedImageWriter::getRecordingStats(RawWriterStats *stats_p)
+{
+    RawWriterStats s;
+    int i, n;
+
+    (void)memset(stats_p, 0, sizeof(RawWriterStats));
+    n = (m_numStripes == 0)? 1:m_numStripes;
+    for (i=0;i < n && i < m_numWriters;i++) {
+	m_writers[i]->getRecordingStats(&s);
+	combineStats(stats_p, &s);
+    }
+}
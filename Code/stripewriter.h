@@ -0,0 +1,56 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+    /* flight-line image writer.  with no stripes this is just a raw-image
+       writer on the _raw file.  with stripes, each stripe file gets its own
+       raw-image writer (and so its own write threads, one set per disk)
+       and frames are dealt out in blocks as described in stripeindex.h */
+
+class RawImageWriter;
+struct RawWriterStats;
+
+class StripedImageWriter
+{
+protected:
+    RawImageWriter *m_writers[STRIPE_MAX_STRIPES];
+    int m_numWriters;
+    int m_numStripes;		/* 0 if not striping */
+    stripe_index_t m_index;
+    char m_imagePath[MAXPATHLEN];
+    char m_indexPath[MAXPATHLEN+sizeof(STRIPE_INDEX_SUFFIX)];
+    size_t m_frameBytes;
+    u_int m_frames;
+    u_int m_checkpointFrames;
+    bool m_open;
+
+    void checkpoint(void);
+public:
+    StripedImageWriter();
+    ~StripedImageWriter();
+    int open(const char *imagePath, char (*stripePaths)[MAXPATHLEN],
+	int numStripes, size_t frameBytes, double frameRateHz,
+	double plannedSecs);
+    int writeFrame(const void *frame);
+    int close(void);
+    void removeFiles(void);
+    int isOpen(void) const { return m_open; }
+    bool isDirect(void) const;
+    int numStripes(void) const { return m_numStripes; }
+    u_int framesWritten(void);
+    void getStats(RawWriterStats *stats_p);
+    void getRecordingStats(RawWriterStats *stats_p);
+};
@@ -0,0 +1,231 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "framering.h"
+#include "framebase.h"
+#include "pacedbuf.h"
+#include "navdecoder.h"
+#include "synthbuf.h"
+
+extern const char *const synthbufDate = "$Date: 2015/12/30 09:41:17 $";
+
+#define NO_DATA		0xDEAD	/* an empty PPS or GPS area */
+#define AREA_FLAGS	0x0001	/* ahead of an area's count */
+
+
+SyntheticFrameBuffer::SyntheticFrameBuffer(int fh, int fw,
+	void (*er)(const char *s), double rateHz, double speed) :
+    PacedFrameBuffer(fh, fw, er)
+{
+    size_t frameWords;
+    u_short *usp;
+    u_int seed;
+    int slot, i, j;
+
+	/* init member variables */
+
+    m_rateHz = rateHz;
+    m_framesPerSec = (int)(rateHz + 0.5);
+    if (m_framesPerSec < 1)
+	m_framesPerSec = 1;
+    m_storage = NULL;
+    m_dropLine = NULL;
+    m_navStream = NULL;
+    m_navWords = 0;
+    m_frameCount = 0;
+    m_navSent = 0;
+
+	/* the header line has to reach the local frame count */
+
+    if (fh < 2 || fw * sizeof(u_short) <
+	    LOCAL_FRAME_COUNT_IMAGE_OFFSET + 2 * sizeof(u_short)) {
+	(void)sprintf(last_error, "Can't make %d x %d frames; the header "
+	    "line needs %d samples.", fh, fw,
+	    (int)(LOCAL_FRAME_COUNT_IMAGE_OFFSET / sizeof(u_short) + 2));
+	failed = 1;
+	return;
+    }
+    frameWords = (size_t)fh * fw;
+    m_storage = (u_short *)malloc(PACED_NUM_SLOTS * frameWords *
+	sizeof(u_short));
+    m_dropLine = (u_short *)malloc(fw * sizeof(u_short));
+    if (m_storage == NULL || m_dropLine == NULL) {
+	(void)strcpy(last_error, "Can't allocate synthetic frames.");
+	failed = 1;
+	return;
+    }
+    makeNavStream();
+    if (m_navStream == NULL) {
+	(void)strcpy(last_error, "Can't allocate synthetic nav stream.");
+	failed = 1;
+	return;
+    }
+
+	/* a scene for each slot.  the noise is a plain LCG; rand() would
+	   take longer than everything else here */
+
+    seed = 12345;
+    for (slot=0;slot < PACED_NUM_SLOTS;slot++) {
+	usp = m_storage + slot * frameWords + fw;
+	for (i=1;i < fh;i++)
+	    for (j=0;j < fw;j++) {
+		seed = seed * 1103515245 + 12345;
+		*usp++ = (1000 + j * 12000 / fw + ((i + slot) % 64) * 8 +
+		    ((seed >> 16) & 0x3f)) & 0x3fff;
+	    }
+    }
+
+    (void)startPlaying(m_rateHz * speed, m_rateHz);
+}
+
+
+SyntheticFrameBuffer::~SyntheticFrameBuffer()
+{
+    stopPlaying();
+    free(m_storage);
+    free(m_dropLine);
+    free(m_navStream);
+}
+
+
+static u_short *addMessage(u_short *usp, u_short id, u_int *seed_p)
+{
+    int words, count, i;
+    u_short sum;
+
+	/* header, made-up data, and checksums bringing each part's sum to
+	   zero */
+
+    words = NavDecoder::messageWords(id);
+    count = words - (NAV_HEADER_WORDS+1);
+    *usp++ = GPS_MAGIC_NUMBER;
+    *usp++ = id;
+    *usp++ = count;
+    *usp++ = 0x8000;
+    *usp++ = (u_short)(-(GPS_MAGIC_NUMBER + id + count + 0x8000));
+    sum = 0;
+    for (i=NAV_HEADER_WORDS;i < words-1;i++) {
+	*seed_p = *seed_p * 1103515245 + 12345;
+	*usp = (*seed_p >> 16) & 0xffff;
+	sum += *usp++;
+    }
+    *usp++ = (u_short)-sum;
+    return usp;
+}
+
+
+void SyntheticFrameBuffer::makeNavStream(void)
+{
+    u_short *usp;
+    u_int seed;
+    int i, n;
+
+	/* the once-a-second messages lead, then the faster ones are spread
+	   over the second in turn */
+
+    n = SYNTH_NAV_TIME_HZ * GPS_MSG_3_WORDS +
+	SYNTH_NAV_STATUS_HZ * GPS_MSG_3500_WORDS +
+	SYNTH_NAV_SOLUTION_HZ * GPS_MSG_3501_WORDS +
+	SYNTH_NAV_CONTROL_HZ * GPS_MSG_3512_WORDS +
+	SYNTH_NAV_TIMING_HZ * GPS_MSG_3623_WORDS;
+    if ((m_navStream=(u_short *)malloc(n * sizeof(u_short))) == NULL)
+	return;
+    seed = 54321;
+    usp = m_navStream;
+    for (i=0;i < SYNTH_NAV_TIME_HZ;i++)
+	usp = addMessage(usp, 3, &seed);
+    for (i=0;i < SYNTH_NAV_TIMING_HZ;i++)
+	usp = addMessage(usp, 3623, &seed);
+    for (i=0;i < SYNTH_NAV_STATUS_HZ;i++)
+	usp = addMessage(usp, 3500, &seed);
+    for (i=0;i < SYNTH_NAV_SOLUTION_HZ || i < SYNTH_NAV_CONTROL_HZ;i++) {
+	if (i < SYNTH_NAV_SOLUTION_HZ)
+	    usp = addMessage(usp, 3501, &seed);
+	if (i < SYNTH_NAV_CONTROL_HZ)
+	    usp = addMessage(usp, 3512, &seed);
+    }
+    m_navWords = n;
+}
+
+
+void SyntheticFrameBuffer::makeHeader(u_short *line1)
+{
+    u_short *usp;
+    u_long due;
+    int words, i;
+
+    (void)memset(line1, 0, m_frameWidthSamples * sizeof(u_short));
+
+	/* never 0, which the consumer takes as a dead timestamp */
+
+    line1[TIMESTAMP_IMAGE_OFFSET / sizeof(u_short)] =
+	(u_short)(m_frameCount % 0xffff + 1);
+
+	/* PPS data on the first frame of the second */
+
+    usp = line1 + PPS_IMAGE_OFFSET / sizeof(u_short);
+    if (m_frameCount % m_framesPerSec == 0) {
+	*usp++ = AREA_FLAGS;
+	*usp++ = 2;
+	*usp++ = (m_frameCount / m_framesPerSec) >> 16;
+	*usp++ = (m_frameCount / m_framesPerSec) & 0xffff;
+    }
+    else *usp = NO_DATA;
+
+	/* whatever's due of the nav stream, as much as fits */
+
+    usp = line1 + GPS_IMAGE_OFFSET / sizeof(u_short);
+    due = (u_long)(m_frameCount + 1) * m_navWords / m_framesPerSec;
+    words = due - m_navSent;
+    if (words > (int)(MAX_GPSDATA_BYTES / sizeof(u_short)) - 2)
+	words = MAX_GPSDATA_BYTES / sizeof(u_short) - 2;
+    if (words <= 0)
+	*usp = NO_DATA;
+    else {
+	*usp++ = AREA_FLAGS;
+	*usp++ = words;
+	for (i=0;i < words;i++)
+	    *usp++ = m_navStream[(m_navSent + i) % m_navWords];
+	m_navSent += words;
+    }
+
+	/* local frame count, high word first */
+
+    usp = line1 + LOCAL_FRAME_COUNT_IMAGE_OFFSET / sizeof(u_short);
+    *usp++ = m_frameCount >> 16;
+    *usp = m_frameCount & 0xffff;
+    m_frameCount++;
+}
+
+
+const u_short *SyntheticFrameBuffer::nextFrame(int slot)
+{
+    u_short *frame;
+
+    if (slot == -1)
+	frame = m_dropLine;
+    else frame = m_storage + (size_t)slot * m_frameHeightLines *
+	m_frameWidthSamples;
+    makeHeader(frame);
+    return frame;
+}
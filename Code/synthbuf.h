@@ -0,0 +1,61 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* frame buffer that makes frames up, for timing the capture pipeline
+       at any rate and frame size without a camera (see pipebench).
+       frames are played at rateHz times speed, or as fast as the
+       pipeline will take them with speed 0 (see pacedbuf.h).
+
+       each ring slot gets a scene of its own when we start -- a ramp
+       across the samples plus noise, in 14 bits -- so the pixels come
+       from memory the CPU hasn't touched lately, as they would after DMA.
+       only the header line is written as frames go out.  it carries what
+       the camera's would:  a timestamp that changes every frame, the
+       local frame count, PPS data on the first frame of each second, and
+       a nav message stream cut up among the frames.  the stream is one
+       second of messages at SYNTH_NAV_* rates, valid checksums and
+       made-up data, repeated every second.  frames lost to a full ring
+       take their share of the stream with them, as on the card */
+
+#define SYNTH_NAV_TIME_HZ	1	/* message 3 */
+#define SYNTH_NAV_STATUS_HZ	1	/* 3500 */
+#define SYNTH_NAV_SOLUTION_HZ	10	/* 3501 */
+#define SYNTH_NAV_CONTROL_HZ	10	/* 3512 */
+#define SYNTH_NAV_TIMING_HZ	1	/* 3623 */
+
+class SyntheticFrameBuffer : public PacedFrameBuffer
+{
+protected:
+    double m_rateHz;
+    int m_framesPerSec;
+    u_short *m_storage;		/* PACED_NUM_SLOTS frames */
+    u_short *m_dropLine;	/* header for frames we can't keep */
+    u_short *m_navStream;	/* one second's worth */
+    int m_navWords;
+    u_int m_frameCount;
+    u_long m_navSent;		/* words of the stream so far */
+
+    void makeNavStream(void);
+    void makeHeader(u_short *line1);
+    const u_short *nextFrame(int slot);
+public:
+    SyntheticFrameBuffer(int fh, int fw, void (*er)(const char *),
+	double rateHz, double speed);
+    ~SyntheticFrameBuffer();
+    u_int navWordsPerSec(void) const { return m_navWords; }
+};
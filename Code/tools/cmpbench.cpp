@@ -0,0 +1,219 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* cmpbench -- times the recording compressor (see ricecodec.h) and
+       checks that what it writes decodes back exactly.
+
+	   cmpbench [-n frames] [-t threads] [<flightline>_raw lines samples]
+
+       with no flight line, frames are made up:  a smooth scene with a
+       few counts of noise, in 14 bits.  each frame is encoded and
+       decoded on one thread, then encoded on 1 to threads threads at
+       once (each taking every n'th frame, as the writer's encoders do)
+       to show how many it takes to keep up with the camera.  the
+       compression ratio counts the per-frame record header */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "../ricecodec.h"
+#include "../cmpwriter.h"
+
+#define NUM_SOURCE_FRAMES	16
+#define CAMERA_RATE_HZ		100.0
+
+typedef struct {
+    const u_short *frames;
+    int numFrames;
+    int lines;
+    int samples;
+    int first;
+    int step;
+    int count;
+    u_char *packed;
+    size_t maxBytes;
+} bench_job_t;
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+
+static void makeFrames(u_short *frames, int numFrames, int lines,
+    int samples)
+{
+    int f, j, i;
+    double v;
+
+    for (f=0;f < numFrames;f++)
+	for (j=0;j < lines;j++)
+	    for (i=0;i < samples;i++) {
+		v = 6000.0 + 3000.0 * sin((i + 3 * f) / 40.0) *
+		    cos(j / 90.0) + 500.0 * sin(i / 7.0 + j / 11.0) +
+		    rand() % 24;
+		frames[((size_t)f * lines + j) * samples + i] =
+		    (u_short)v & 0x3fff;
+	    }
+}
+
+
+static void *encodeJob(void *arg)
+{
+    bench_job_t *job = (bench_job_t *)arg;
+    const u_short *frame;
+    int n;
+
+    for (n=job->first;n < job->count;n+=job->step) {
+	frame = job->frames +
+	    (size_t)(n % job->numFrames) * job->lines * job->samples;
+	(void)riceEncodeFrame(job->packed, job->maxBytes, frame, job->lines,
+	    job->samples);
+    }
+    return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    bench_job_t jobs[CMPWRITER_NUM_THREADS * 2];
+    pthread_t threads[CMPWRITER_NUM_THREADS * 2];
+    u_short *frames, *decoded;
+    u_char *packed;
+    size_t frameBytes, maxBytes, bytes, total;
+    int lines, samples, numFrames, count, maxThreads, opt, n, t, bad;
+    double start, encodeSecs, decodeSecs, fps;
+    FILE *fp;
+
+	/* check invocation */
+
+    count = 200;
+    maxThreads = CMPWRITER_NUM_THREADS;
+    while ((opt=getopt(argc, argv, "n:t:")) != -1) {
+	if (opt == 'n')
+	    count = atoi(optarg);
+	else if (opt == 't')
+	    maxThreads = atoi(optarg);
+	else optind = argc + 1;
+    }
+    if ((argc - optind != 0 && argc - optind != 3) || count < 1 ||
+	    maxThreads < 1 || maxThreads > CMPWRITER_NUM_THREADS * 2) {
+	(void)fprintf(stderr, "Usage: %s [-n frames] [-t threads (1-%d)] "
+	    "[<flightline>_raw lines samples]\n", argv[0],
+	    CMPWRITER_NUM_THREADS * 2);
+	exit(1);
+    }
+
+	/* get frames, real or made up */
+
+    lines = (argc - optind == 3)? atoi(argv[optind+1]):1024;
+    samples = (argc - optind == 3)? atoi(argv[optind+2]):1024;
+    frameBytes = (size_t)lines * samples * sizeof(u_short);
+    numFrames = NUM_SOURCE_FRAMES;
+    frames = new u_short[(size_t)numFrames * lines * samples];
+    if (argc - optind == 3) {
+	if ((fp=fopen(argv[optind], "rb")) == NULL) {
+	    (void)fprintf(stderr, "Can't open \"%s\".\n", argv[optind]);
+	    exit(1);
+	}
+	numFrames = fread(frames, frameBytes, NUM_SOURCE_FRAMES, fp);
+	(void)fclose(fp);
+	if (numFrames == 0) {
+	    (void)fprintf(stderr, "No frames in \"%s\".\n", argv[optind]);
+	    exit(1);
+	}
+    }
+    else makeFrames(frames, numFrames, lines, samples);
+    maxBytes = riceMaxBytes(lines, samples);
+    packed = new u_char[maxBytes];
+    decoded = new u_short[(size_t)lines * samples];
+
+	/* one thread, both ways, checking as we go */
+
+    total = 0;
+    bad = 0;
+    encodeSecs = decodeSecs = 0.0;
+    for (n=0;n < count;n++) {
+	start = now();
+	bytes = riceEncodeFrame(packed, frameBytes,
+	    frames + (size_t)(n % numFrames) * lines * samples, lines,
+	    samples);
+	encodeSecs += now() - start;
+	if (bytes == 0) {
+	    total += frameBytes + sizeof(cmp_record_t);
+	    continue;
+	}
+	total += bytes + sizeof(cmp_record_t);
+	start = now();
+	if (riceDecodeFrame(decoded, packed, bytes, lines, samples) == -1 ||
+		memcmp(decoded,
+		    frames + (size_t)(n % numFrames) * lines * samples,
+		    frameBytes) != 0)
+	    bad++;
+	decodeSecs += now() - start;
+    }
+    (void)printf("%d x %d, %d frames:  ratio %.2f:1, %s\n", lines, samples,
+	count, (double)count * frameBytes / total,
+	bad? "DECODE MISMATCH":"all decode exactly");
+    (void)printf("1 thread:  encode %.1f frames/s, decode %.1f frames/s\n",
+	count / encodeSecs, count / decodeSecs);
+
+	/* and encoding on several at once */
+
+    for (t=1;t <= maxThreads;t++) {
+	for (n=0;n < t;n++) {
+	    jobs[n].frames = frames;
+	    jobs[n].numFrames = numFrames;
+	    jobs[n].lines = lines;
+	    jobs[n].samples = samples;
+	    jobs[n].first = n;
+	    jobs[n].step = t;
+	    jobs[n].count = count;
+	    jobs[n].maxBytes = frameBytes;
+	    jobs[n].packed = new u_char[frameBytes];
+	}
+	start = now();
+	for (n=0;n < t;n++)
+	    if (pthread_create(&threads[n], NULL, encodeJob, &jobs[n]) != 0) {
+		(void)fprintf(stderr, "Can't create threads.\n");
+		exit(1);
+	    }
+	for (n=0;n < t;n++)
+	    (void)pthread_join(threads[n], NULL);
+	fps = count / (now() - start);
+	(void)printf("%d encoder%s:  %.1f frames/s (%s %.0f Hz)\n", t,
+	    (t == 1)? "":"s", fps, (fps >= CAMERA_RATE_HZ)? "keeps up at":
+	    "short of", CAMERA_RATE_HZ);
+	for (n=0;n < t;n++)
+	    delete[] jobs[n].packed;
+    }
+
+    delete[] frames;
+    delete[] decoded;
+    delete[] packed;
+    exit(bad? 1:0);
+}
@@ -0,0 +1,261 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* diagsconv -- turns an end-to-end diagnostics file (_diags.bin) into
+       the CSV the diags used to be logged as.
+
+	   diagsconv [-e] [-c column,column,...] <flightline>_diags.bin
+		[output]
+
+       output defaults to the input name with .csv in place of .bin; "-"
+       is standard output.  with -c, only the named columns are written,
+       in the order given, and the rest are skipped over rather than read.
+       times are UTC time of day to the second, as the old log had them,
+       unless -e is given, in which case they're seconds since 1970 to the
+       millisecond.  a file whose last block was cut off converts
+       up to that block */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include "../diagsrecorder.h"
+
+#define MAX_COLUMNS	1024
+
+
+static void printValue(FILE *out, const diags_column_t *column,
+    const u_char *values, u_int record, bool epoch)
+{
+    double d;
+    float f;
+    int i;
+    time_t secs;
+    struct tm *tm;
+    char ascii[80];
+
+    switch (column->type) {
+	case DIAGS_TYPE_TIME:
+	    (void)memcpy(&d, values + record * sizeof(double), sizeof(d));
+	    if (epoch) {
+		(void)fprintf(out, "%.3f,", d);
+		break;
+	    }
+	    secs = (time_t)floor(d);
+	    tm = gmtime(&secs);
+	    (void)strftime(ascii, sizeof(ascii), "%H:%M:%S", tm);
+	    (void)fprintf(out, "%s,", ascii);
+	    break;
+	case DIAGS_TYPE_COLOR:
+	    i = values[record];
+	    (void)fprintf(out, "%s,",
+		diagsColorNames[(i < DIAGS_NUM_COLORS)? i:0]);
+	    break;
+	case DIAGS_TYPE_INT:
+	    (void)memcpy(&i, values + record * sizeof(int), sizeof(i));
+	    (void)fprintf(out, "%d,", i);
+	    break;
+	case DIAGS_TYPE_FLOAT:
+	    (void)memcpy(&f, values + record * sizeof(float), sizeof(f));
+	    (void)fprintf(out, "%.*f,", column->decimals, f);
+	    break;
+	case DIAGS_TYPE_DOUBLE:
+	    (void)memcpy(&d, values + record * sizeof(double), sizeof(d));
+	    (void)fprintf(out, "%.*f,", column->decimals, d);
+	    break;
+	default:
+	    (void)fprintf(out, ",");
+	    break;
+    }
+}
+
+
+static int findColumn(const diags_column_t *columns, int numColumns,
+    const char *name)
+{
+    int i;
+
+    for (i=0;i < numColumns;i++)
+	if (strcmp(columns[i].name, name) == 0)
+	    return i;
+    return -1;
+}
+
+
+int main(int argc, char *argv[])
+{
+    diags_header_t header;
+    diags_column_t columns[MAX_COLUMNS];
+    diags_block_t block;
+    u_char *values[MAX_COLUMNS];
+    int selected[MAX_COLUMNS];
+    int wanted[MAX_COLUMNS];
+    char output[MAXPATHLEN];
+    char *list, *name;
+    FILE *in, *out;
+    struct stat st;
+    off_t fileSize;
+    bool epoch, truncated;
+    u_int records, r;
+    int opt, len, i, c, numSelected, size;
+
+	/* check invocation */
+
+    epoch = false;
+    list = NULL;
+    while ((opt=getopt(argc, argv, "ec:")) != -1) {
+	if (opt == 'e')
+	    epoch = true;
+	else if (opt == 'c')
+	    list = optarg;
+	else optind = argc;
+    }
+    if (argc - optind != 1 && argc - optind != 2) {
+	(void)fprintf(stderr, "Usage: %s [-e] [-c column,column,...] "
+	    "<flightline>_diags.bin [output]\n", argv[0]);
+	exit(1);
+    }
+    if (argc - optind == 2)
+	(void)strcpy(output, argv[optind+1]);
+    else {
+	len = strlen(argv[optind]) - strlen(".bin");
+	if (len <= 0 || strcmp(argv[optind]+len, ".bin") != 0) {
+	    (void)fprintf(stderr, "Can't derive output name from \"%s\".\n",
+		argv[optind]);
+	    exit(1);
+	}
+	(void)memcpy(output, argv[optind], (size_t)len);
+	(void)strcpy(output+len, ".csv");
+    }
+
+    if ((in=fopen(argv[optind], "rb")) == NULL ||
+	    fstat(fileno(in), &st) == -1) {
+	(void)fprintf(stderr, "Can't open \"%s\".\n", argv[optind]);
+	exit(1);
+    }
+    fileSize = st.st_size;
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+	    memcmp(header.magic, DIAGS_MAGIC, sizeof(header.magic)) != 0) {
+	(void)fprintf(stderr, "\"%s\" isn't a diagnostics file.\n",
+	    argv[optind]);
+	exit(1);
+    }
+    if (header.version != DIAGS_VERSION) {
+	(void)fprintf(stderr, "Unsupported version %u.\n", header.version);
+	exit(1);
+    }
+    if (header.numColumns > MAX_COLUMNS ||
+	    fread(columns, sizeof(diags_column_t), header.numColumns,
+		in) != header.numColumns) {
+	(void)fprintf(stderr, "Bad column list in \"%s\".\n",
+	    argv[optind]);
+	exit(1);
+    }
+    for (i=0;i < (int)header.numColumns;i++) {
+	columns[i].name[DIAGS_NAME_LEN-1] = '\0';
+	if (diagsTypeSize(columns[i].type) == 0) {
+	    (void)fprintf(stderr, "Column \"%s\" has unknown type %d.\n",
+		columns[i].name, columns[i].type);
+	    exit(1);
+	}
+    }
+
+	/* pick the columns to write, all of them by default */
+
+    numSelected = 0;
+    if (list == NULL)
+	for (i=0;i < (int)header.numColumns;i++)
+	    selected[numSelected++] = i;
+    else for (name=strtok(list, ",");name != NULL;name=strtok(NULL, ",")) {
+	if ((c=findColumn(columns, header.numColumns, name)) == -1) {
+	    (void)fprintf(stderr, "No column \"%s\" in \"%s\".\n", name,
+		argv[optind]);
+	    exit(1);
+	}
+	if (numSelected < MAX_COLUMNS)
+	    selected[numSelected++] = c;
+    }
+    for (i=0;i < (int)header.numColumns;i++) {
+	wanted[i] = 0;
+	values[i] = new u_char[DIAGS_BLOCK_RECORDS * sizeof(double)];
+    }
+    for (i=0;i < numSelected;i++)
+	wanted[selected[i]] = 1;
+
+    if (strcmp(output, "-") == 0)
+	out = stdout;
+    else if ((out=fopen(output, "w")) == NULL) {
+	(void)fprintf(stderr, "Can't create \"%s\".\n", output);
+	exit(1);
+    }
+    for (i=0;i < numSelected;i++)
+	(void)fprintf(out, "%s,", columns[selected[i]].name);
+    (void)fprintf(out, "\n");
+
+	/* convert block by block.  each block is all of one column, then
+	   all of the next, so the columns we don't want are seeked past.
+	   seeking past the end of the file doesn't fail, so those are
+	   checked against its size */
+
+    records = 0;
+    truncated = false;
+    while (fread(&block, sizeof(block), 1, in) == 1) {
+	if (block.magic != DIAGS_BLOCK_MAGIC ||
+		block.records > DIAGS_BLOCK_RECORDS) {
+	    (void)fprintf(stderr, "Bad block after record %u.\n", records);
+	    exit(1);
+	}
+	for (i=0;i < (int)header.numColumns && !truncated;i++) {
+	    size = diagsTypeSize(columns[i].type);
+	    if (!wanted[i])
+		truncated = (fseeko(in, (off_t)block.records * size,
+		    SEEK_CUR) == -1 || ftello(in) > fileSize);
+	    else truncated = (fread(values[i], size, block.records, in) !=
+		block.records);
+	}
+	if (truncated)
+	    break;
+	for (r=0;r < block.records;r++) {
+	    for (i=0;i < numSelected;i++)
+		printValue(out, &columns[selected[i]], values[selected[i]],
+		    r, epoch);
+	    (void)fprintf(out, "\n");
+	}
+	records += block.records;
+    }
+
+    if (truncated)
+	(void)fprintf(stderr, "Truncated after record %u; stopping.\n",
+	    records);
+    if (fclose(out) == EOF) {
+	(void)fprintf(stderr, "Write to \"%s\" failed.\n", output);
+	exit(1);
+    }
+    (void)fclose(in);
+    for (i=0;i < (int)header.numColumns;i++)
+	delete[] values[i];
+
+    (void)fprintf(stderr, "%s: %u records, %d columns.\n", output,
+	records, numSelected);
+    return 0;
+}
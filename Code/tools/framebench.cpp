@@ -0,0 +1,359 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+    /* framebench -- times frame assembly (FPGA frame to host-order pixels)
+       for each supported frame geometry, in cycles per frame.
+
+	   framebench [frames]
+
+       "scalar" is the original byte-at-a-time loop, the SIMD rows are the
+       general kernels, and "selected" is what DisplayTab will use on this
+       machine.  dark accumulation (run on every frame of a dark period)
+       is timed the same way, as is frame rendering for the frame view
+       against the old per-pixel loop plus pixbuf copy it replaced.
+       source frames rotate through a set bigger than the cache, as DMA
+       buffers would.  on a little-endian host with GPS simulation
+       off none of this runs at all -- frames are used where they sit */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "../frameops.h"
+
+#define NUM_SOURCE_FRAMES	16
+#define NUM_TRIALS		5
+
+static const int heights[] = { 285, 481, 1024 };
+static const int widths[] = { 640, 1024 };
+
+
+static unsigned long long ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
+	/* best of several trials, each averaged over the requested number of
+	   frames */
+
+static double timeAssembler(frame_assembler_t assemble, u_char **src,
+    u_short *dest, int lines, int samples, int frames)
+{
+    unsigned long long start, elapsed, best;
+    int trial, i;
+
+    best = 0;
+    for (trial=0;trial < NUM_TRIALS;trial++) {
+	start = ticks();
+	for (i=0;i < frames;i++)
+	    (*assemble)(dest, src[i % NUM_SOURCE_FRAMES], lines, samples);
+	elapsed = ticks() - start;
+	if (trial == 0 || elapsed < best)
+	    best = elapsed;
+    }
+    return (double)best / frames;
+}
+
+
+static double timeAccumulator(dark_accumulator_t accumulate, u_char **src,
+    u_int *sum, u_int64_t *sumSq, int n, int frames)
+{
+    unsigned long long start, elapsed, best;
+    int trial, i;
+
+    best = 0;
+    for (trial=0;trial < NUM_TRIALS;trial++) {
+	start = ticks();
+	for (i=0;i < frames;i++)
+	    (*accumulate)(sum, sumSq, (u_short *)src[i % NUM_SOURCE_FRAMES],
+		n);
+	elapsed = ticks() - start;
+	if (trial == 0 || elapsed < best)
+	    best = elapsed;
+    }
+    return (double)best / frames;
+}
+
+
+	/* what the frame view did before frame rendering was fused:  an
+	   RGB buffer built a pixel at a time, testing for dark subtraction
+	   as it went, then copied onto the surface */
+
+static void renderFrameOld(u_int *dest, int destStride, int reflect,
+    const u_short *image, const u_short *dark, const u_char *mask,
+    const u_char *lut, int lines, int samples, int darkSub, int incr,
+    u_char *rgb)
+{
+    const u_char *ucp;
+    u_char *cp;
+    u_int *d;
+    int i, j, pixel, lastPixel, width;
+
+    cp = rgb;
+    for (i = (lines + incr-1) / incr;i > 0;i--) {
+	lastPixel = 0;
+	for (j=0;j < samples;j += incr) {
+	    pixel = image[j];
+	    if (darkSub) {
+		if (mask[j])
+		    pixel = lastPixel;
+		else {
+		    pixel -= dark[j];
+		    if (pixel < 0) pixel = 0;
+		}
+		lastPixel = pixel;
+	    }
+	    *cp++ = lut[pixel];
+	    *cp++ = lut[pixel];
+	    *cp++ = lut[pixel];
+	}
+	image += incr * samples;
+	dark += incr * samples;
+	mask += incr * samples;
+    }
+
+    width = (samples + incr-1) / incr;
+    ucp = rgb;
+    for (i = (lines + incr-1) / incr;i > 0;i--) {
+	d = reflect? dest + width - 1:dest;
+	for (j=0;j < width;j++) {
+	    *d = (ucp[0] << 16) | (ucp[1] << 8) | ucp[2];
+	    d += reflect? -1:1;
+	    ucp += 3;
+	}
+	dest += destStride;
+    }
+}
+
+
+static double timeRenderer(frame_renderer_t render, u_char **src,
+    u_int *dest, const u_short *dark, const u_char *mask, const u_char *lut,
+    int lines, int samples, int darkSub, int incr, u_char *rgb, int frames)
+{
+    unsigned long long start, elapsed, best;
+    int trial, i;
+
+    best = 0;
+    for (trial=0;trial < NUM_TRIALS;trial++) {
+	start = ticks();
+	for (i=0;i < frames;i++) {
+	    if (render != NULL)
+		(*render)(dest, samples, 0,
+		    (u_short *)src[i % NUM_SOURCE_FRAMES], dark, mask, lut,
+		    lines, samples);
+	    else renderFrameOld(dest, samples, 0,
+		(u_short *)src[i % NUM_SOURCE_FRAMES], dark, mask, lut,
+		lines, samples, darkSub, incr, rgb);
+	}
+	elapsed = ticks() - start;
+	if (trial == 0 || elapsed < best)
+	    best = elapsed;
+    }
+    return (double)best / frames;
+}
+
+
+int main(int argc, char *argv[])
+{
+    u_char *src[NUM_SOURCE_FRAMES];
+    u_short *dest, *check;
+    u_short *dark;
+    u_int *sum, *pixels, *pixelsCheck;
+    u_int64_t *sumSq;
+    u_char *mask, *lut, *rgb;
+    frame_assembler_t assemble;
+    frame_renderer_t render;
+    char name[40];
+    const char *descr;
+    double scalar, t;
+    int frames, level, h, w, lines, samples, i, darkSub, incr, reflect;
+    size_t j, frameBytes;
+
+    frames = (argc == 2)? atoi(argv[1]):200;
+    if (argc > 2 || frames <= 0) {
+	(void)fprintf(stderr, "Usage: %s [frames]\n", argv[0]);
+	exit(1);
+    }
+    level = frameOpsLevel();
+
+    frameBytes = 1024 * 1024 * sizeof(short);
+    for (i=0;i < NUM_SOURCE_FRAMES;i++) {
+	src[i] = (u_char *)malloc(frameBytes);
+	for (j=0;j < frameBytes;j++)
+	    src[i][j] = (u_char)rand();
+    }
+    dest = (u_short *)malloc(frameBytes);
+    check = (u_short *)malloc(frameBytes);
+    sum = (u_int *)calloc(1024 * 1024, sizeof(u_int));
+    sumSq = (u_int64_t *)calloc(1024 * 1024, sizeof(u_int64_t));
+    dark = (u_short *)malloc(frameBytes);
+    mask = (u_char *)malloc(1024 * 1024);
+    lut = (u_char *)malloc(65536);
+    rgb = (u_char *)malloc(1024 * 1024 * 3);
+    pixels = (u_int *)malloc(1024 * 1024 * sizeof(u_int));
+    pixelsCheck = (u_int *)malloc(1024 * 1024 * sizeof(u_int));
+    if (dest == NULL || check == NULL || sum == NULL || sumSq == NULL ||
+	    dark == NULL || mask == NULL || lut == NULL || rgb == NULL ||
+	    pixels == NULL || pixelsCheck == NULL) {
+	(void)fprintf(stderr, "Out of memory.\n");
+	exit(1);
+    }
+    for (j=0;j < 1024 * 1024;j++) {
+	dark[j] = (u_short)(rand() % 4096);
+	mask[j] = (rand() % 1000 == 0);
+    }
+    for (j=0;j < 65536;j++)
+	lut[j] = (u_char)(j >> 8);
+
+#if defined(__x86_64__) || defined(__i386__)
+    (void)printf("cycles per frame, %d frames\n\n", frames);
+#else
+    (void)printf("ns per frame, %d frames\n\n", frames);
+#endif
+    (void)printf("%-10s %-22s %12s %8s\n", "geometry", "kernel", "per frame",
+	"speedup");
+    for (h=0;h < (int)(sizeof(heights)/sizeof(heights[0]));h++) {
+	for (w=0;w < (int)(sizeof(widths)/sizeof(widths[0]));w++) {
+	    lines = heights[h];
+	    samples = widths[w];
+	    assembleFrameScalar(check, src[0], lines, samples);
+
+	    scalar = timeAssembler(assembleFrameScalar, src, dest, lines,
+		samples, frames);
+	    (void)printf("%4dx%-5d %-22s %12.0f %8s\n", lines, samples,
+		"scalar", scalar, "");
+	    if (level >= FRAMEOPS_SSE2) {
+		t = timeAssembler(assembleFrameSSE2, src, dest, lines,
+		    samples, frames);
+		(void)printf("%10s %-22s %12.0f %7.1fx\n", "", "SSE2", t,
+		    scalar / t);
+	    }
+	    if (level >= FRAMEOPS_AVX2) {
+		t = timeAssembler(assembleFrameAVX2, src, dest, lines,
+		    samples, frames);
+		(void)printf("%10s %-22s %12.0f %7.1fx\n", "", "AVX2", t,
+		    scalar / t);
+	    }
+
+	    assemble = frameAssembler(-1, lines, samples, &descr);
+	    t = timeAssembler(assemble, src, dest, lines, samples, frames);
+	    (void)printf("%10s %-22s %12.0f %7.1fx\n", "", descr, t,
+		scalar / t);
+
+		/* make sure the fast path still gets it right */
+
+	    (*assemble)(dest, src[0], lines, samples);
+	    if (memcmp(dest, check, lines * samples * sizeof(short)) != 0) {
+		(void)fprintf(stderr, "%s gave the wrong answer for %dx%d.\n",
+		    descr, lines, samples);
+		exit(1);
+	    }
+	}
+    }
+
+    (void)printf("\n%-10s %-22s %12s %8s\n", "geometry", "dark accumulation",
+	"per frame", "speedup");
+    for (h=0;h < (int)(sizeof(heights)/sizeof(heights[0]));h++) {
+	for (w=0;w < (int)(sizeof(widths)/sizeof(widths[0]));w++) {
+	    lines = heights[h];
+	    samples = widths[w];
+	    scalar = timeAccumulator(accumulateDarkScalar, src, sum, sumSq,
+		lines * samples, frames);
+	    (void)printf("%4dx%-5d %-22s %12.0f %8s\n", lines, samples,
+		"scalar", scalar, "");
+	    if (level >= FRAMEOPS_SSE2) {
+		t = timeAccumulator(accumulateDarkSSE2, src, sum, sumSq,
+		    lines * samples, frames);
+		(void)printf("%10s %-22s %12.0f %7.1fx\n", "", "SSE2", t,
+		    scalar / t);
+	    }
+	    if (level >= FRAMEOPS_AVX2) {
+		t = timeAccumulator(accumulateDarkAVX2, src, sum, sumSq,
+		    lines * samples, frames);
+		(void)printf("%10s %-22s %12.0f %7.1fx\n", "", "AVX2", t,
+		    scalar / t);
+	    }
+	}
+    }
+
+    (void)printf("\n%-10s %-22s %12s %8s\n", "geometry", "frame rendering",
+	"per frame", "speedup");
+    for (h=0;h < (int)(sizeof(heights)/sizeof(heights[0]));h++) {
+	for (w=0;w < (int)(sizeof(widths)/sizeof(widths[0]));w++) {
+	    lines = heights[h];
+	    samples = widths[w];
+	    for (darkSub=0;darkSub < 2;darkSub++) {
+		for (incr=1;incr <= 2;incr++) {
+		    scalar = timeRenderer(NULL, src, pixels, dark, mask, lut,
+			lines, samples, darkSub, incr, rgb, frames);
+		    (void)sprintf(name, "old, dark %s, 1/%d",
+			darkSub? "on":"off", incr);
+		    if (darkSub == 0 && incr == 1)
+			(void)printf("%4dx%-5d %-22s %12.0f %8s\n", lines,
+			    samples, name, scalar, "");
+		    else (void)printf("%10s %-22s %12.0f %8s\n", "", name,
+			scalar, "");
+		    render = frameRenderer(FRAMEOPS_SCALAR, darkSub, incr);
+		    t = timeRenderer(render, src, pixels, dark, mask, lut,
+			lines, samples, darkSub, incr, rgb, frames);
+		    (void)printf("%10s %-22s %12.0f %7.1fx\n", "", "fused",
+			t, scalar / t);
+		    if (level >= FRAMEOPS_SSE2) {
+			render = frameRenderer(FRAMEOPS_SSE2, darkSub, incr);
+			t = timeRenderer(render, src, pixels, dark, mask, lut,
+			    lines, samples, darkSub, incr, rgb, frames);
+			(void)printf("%10s %-22s %12.0f %7.1fx\n", "",
+			    "fused SSE2", t, scalar / t);
+		    }
+
+			/* check both orientations against the old way */
+
+		    for (reflect=0;reflect < 2;reflect++) {
+			renderFrameOld(pixelsCheck, samples, reflect,
+			    (u_short *)src[0], dark, mask, lut, lines,
+			    samples, darkSub, incr, rgb);
+			(*render)(pixels, samples, reflect, (u_short *)src[0],
+			    dark, mask, lut, lines, samples);
+			for (i=0;i < (lines + incr-1) / incr;i++)
+			    if (memcmp(pixels + i * samples,
+				    pixelsCheck + i * samples,
+				    (samples + incr-1) / incr *
+					sizeof(u_int)) != 0) {
+				(void)fprintf(stderr,
+				    "Rendering is wrong for %dx%d.\n",
+				    lines, samples);
+				exit(1);
+			    }
+		    }
+		}
+	    }
+	}
+    }
+    return 0;
+}
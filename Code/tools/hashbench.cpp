@@ -0,0 +1,142 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* hashbench -- times the recording's integrity hashing (see
+       manifest.h and framehasher.h) to show how many hash lanes it takes
+       to keep up with the camera.
+
+	   hashbench [-n frames] [-t threads] [lines samples]
+
+       frames default to 1024 x 1024.  each of 1 to threads threads hashes
+       its own blocks of MANIFEST_BLOCK_FRAMES frames, as the lanes do.
+       the frame contents don't matter to SHA-256, so they're just
+       noise */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <tomcrypt.h>
+#include "../manifest.h"
+
+#define NUM_SOURCE_FRAMES	16
+#define CAMERA_RATE_HZ		100.0
+#define MAX_THREADS		16
+
+typedef struct {
+    const u_char *frames;
+    size_t frameBytes;
+    int first;
+    int step;
+    int count;
+} bench_job_t;
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+
+static void *hashJob(void *arg)
+{
+    bench_job_t *job = (bench_job_t *)arg;
+    hash_state state;
+    manifest_digest_t digest;
+    int block, n;
+
+    for (block=job->first;block * MANIFEST_BLOCK_FRAMES < job->count;
+	    block+=job->step) {
+	(void)sha256_init(&state);
+	for (n=block * MANIFEST_BLOCK_FRAMES;n < job->count &&
+		n < (block+1) * MANIFEST_BLOCK_FRAMES;n++)
+	    (void)sha256_process(&state, job->frames +
+		(n % NUM_SOURCE_FRAMES) * job->frameBytes, job->frameBytes);
+	(void)sha256_done(&state, digest);
+    }
+    return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    bench_job_t jobs[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    u_char *frames;
+    size_t frameBytes, i;
+    int lines, samples, count, maxThreads, opt, n, t;
+    double start, fps;
+
+	/* check invocation */
+
+    count = 4 * MANIFEST_BLOCK_FRAMES;
+    maxThreads = 4;
+    while ((opt=getopt(argc, argv, "n:t:")) != -1) {
+	if (opt == 'n')
+	    count = atoi(optarg);
+	else if (opt == 't')
+	    maxThreads = atoi(optarg);
+	else optind = argc + 1;
+    }
+    if ((argc - optind != 0 && argc - optind != 2) || count < 1 ||
+	    maxThreads < 1 || maxThreads > MAX_THREADS) {
+	(void)fprintf(stderr, "Usage: %s [-n frames] [-t threads (1-%d)] "
+	    "[lines samples]\n", argv[0], MAX_THREADS);
+	exit(1);
+    }
+    lines = (argc - optind == 2)? atoi(argv[optind]):1024;
+    samples = (argc - optind == 2)? atoi(argv[optind+1]):1024;
+    frameBytes = (size_t)lines * samples * sizeof(u_short);
+    frames = new u_char[NUM_SOURCE_FRAMES * frameBytes];
+    for (i=0;i < NUM_SOURCE_FRAMES * frameBytes;i++)
+	frames[i] = (u_char)rand();
+
+    (void)printf("%d x %d, %d frames (%.1f MB/s at %.0f Hz)\n", lines,
+	samples, count, frameBytes * CAMERA_RATE_HZ / 1.0e6, CAMERA_RATE_HZ);
+    for (t=1;t <= maxThreads;t++) {
+	for (n=0;n < t;n++) {
+	    jobs[n].frames = frames;
+	    jobs[n].frameBytes = frameBytes;
+	    jobs[n].first = n;
+	    jobs[n].step = t;
+	    jobs[n].count = count;
+	}
+	start = now();
+	for (n=0;n < t;n++)
+	    if (pthread_create(&threads[n], NULL, hashJob, &jobs[n]) != 0) {
+		(void)fprintf(stderr, "Can't create threads.\n");
+		exit(1);
+	    }
+	for (n=0;n < t;n++)
+	    (void)pthread_join(threads[n], NULL);
+	fps = count / (now() - start);
+	(void)printf("%d lane%s:  %.1f frames/s, %.1f MB/s (%s %.0f Hz)\n",
+	    t, (t == 1)? "":"s", fps, fps * frameBytes / 1.0e6,
+	    (fps >= CAMERA_RATE_HZ)? "keeps up at":"short of",
+	    CAMERA_RATE_HZ);
+    }
+
+    delete[] frames;
+    exit(0);
+}
@@ -0,0 +1,326 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* mknavindex -- builds the per-frame nav index (see navindex.h) for a
+       recorded flight line.
+
+	   mknavindex <flightline>_raw [output]
+
+       output defaults to <flightline>_navindex.  the _gps and _pps files
+       are plain streams of whatever words came in, with nothing to say
+       which frame they came with, but each frame's header line in the
+       _raw file carries the same words, so only the header line of each
+       frame is read, and the streams are checked against it as they go.
+       striped recordings work too, through FlightLineReader */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../stripeindex.h"
+#include "../flightline.h"
+#include "../navdecoder.h"
+#include "../navindex.h"
+
+#define MAX_PENDING_FRAMES	100000	/* longest nav gap we wait out */
+
+typedef struct {
+    u_int frame;
+    nav_solution_t solution;
+} fix_t;
+
+typedef struct {
+    int haveFix;		/* a solution came in on the current frame */
+    fix_t fix;
+    u_long solutions;
+} nav_state_t;
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void solutionHandler(void *arg, const nav_record_t *rec)
+{
+    nav_state_t *state;
+
+    state = (nav_state_t *)arg;
+    state->haveFix = 1;
+    state->fix.solution = rec->u.solution;
+    state->solutions++;
+}
+
+
+static double wrapDegrees(double deg)
+{
+    while (deg >= 180)
+	deg -= 360;
+    while (deg < -180)
+	deg += 360;
+    return deg;
+}
+
+
+static int toFixed(double deg)
+{
+    double fixed;
+
+    fixed = floor(wrapDegrees(deg) / 180 * 2147483648.0 + 0.5);
+    return (fixed > 2147483647.0)? 2147483647:(int)fixed;
+}
+
+
+	/* w of the way from a to b.  longitude and heading go the short way
+	   around */
+
+static void fillRecord(nav_index_record_t *rec, const nav_solution_t *a,
+    const nav_solution_t *b, double w, int flag)
+{
+    rec->lat = toFixed(a->latDeg + w * (b->latDeg - a->latDeg));
+    rec->lon = toFixed(a->lonDeg +
+	w * wrapDegrees(b->lonDeg - a->lonDeg));
+    rec->altitudeM = a->altitudeM + w * (b->altitudeM - a->altitudeM);
+    rec->pitchDeg = a->pitchDeg + w * (b->pitchDeg - a->pitchDeg);
+    rec->rollDeg = a->rollDeg + w * (b->rollDeg - a->rollDeg);
+    rec->headingDeg = wrapDegrees(a->headingDeg +
+	w * wrapDegrees(b->headingDeg - a->headingDeg));
+    rec->flags |= flag;
+}
+
+
+	/* write out the frames waiting on a nav solution.  with one on
+	   either side they're interpolated; otherwise they take the one they
+	   have, if any */
+
+static void flushPending(FILE *out, nav_index_record_t *pending, int n,
+    u_int firstFrame, const fix_t *before, const fix_t *after)
+{
+    int i;
+    double w;
+
+    for (i=0;i < n;i++) {
+	if (before != NULL && after != NULL) {
+	    w = (after->frame == before->frame)? 1.0:
+		(firstFrame + i - before->frame) /
+		    (double)(after->frame - before->frame);
+	    fillRecord(&pending[i], &before->solution, &after->solution, w,
+		NAVINDEX_INTERPOLATED);
+	}
+	else if (before != NULL)
+	    fillRecord(&pending[i], &before->solution, &before->solution, 0,
+		NAVINDEX_HELD);
+	else if (after != NULL)
+	    fillRecord(&pending[i], &after->solution, &after->solution, 0,
+		NAVINDEX_HELD);
+    }
+    if (n > 0 && fwrite(pending, sizeof(nav_index_record_t), n, out) !=
+	    (size_t)n) {
+	(void)fprintf(stderr, "Write of nav index failed.\n");
+	exit(1);
+    }
+}
+
+
+	/* this frame's words from the _gps or _pps stream, which should
+	   match what's in the header line.  returns the word count, or -1 if
+	   the frame had nothing */
+
+static int frameWords(const u_short *line, int offset, int maxBytes,
+    FILE *fp, u_short *streamWords, u_long *mismatches_p)
+{
+    const u_short *usp;
+    int count;
+
+    usp = line + offset / sizeof(short);
+    if (usp[0] == 0xDEAD || usp[1] > maxBytes / sizeof(short))
+	return -1;
+    count = usp[1];
+    if ((int)fread(streamWords, sizeof(short), count, fp) != count ||
+	    memcmp(streamWords, usp+2, count * sizeof(short)) != 0)
+	(*mismatches_p)++;
+    return count;
+}
+
+
+int main(int argc, char *argv[])
+{
+    FlightLineReader reader;
+    char gpsPath[MAXPATHLEN], ppsPath[MAXPATHLEN], output[MAXPATHLEN];
+    char errorMsg[2*MAXPATHLEN+100];
+    int len, count;
+    u_int frames, frame, pendingStart, ppsCount, ppsMax;
+    u_int *ppsFrames, *bigger;
+    u_long gpsMismatches, ppsMismatches;
+    FILE *gpsFP, *ppsFP, *out;
+    const u_short *line;
+    u_short streamWords[MAX_GPSDATA_BYTES / sizeof(short)];
+    const u_char *ucp;
+    nav_index_header_t header;
+    nav_index_record_t *pending, *rec;
+    NavDecoder decoder;
+    nav_state_t state;
+    fix_t last;
+    int havePrev, lastHadPPS;
+    double start, elapsed;
+
+	/* check invocation and find the pieces of the flight line */
+
+    if (argc != 2 && argc != 3) {
+	(void)fprintf(stderr, "Usage: %s <flightline>_raw [output]\n",
+	    argv[0]);
+	exit(1);
+    }
+    len = strlen(argv[1]);
+    if (len < 4 || len >= MAXPATHLEN ||
+	    strcmp(argv[1] + len - 4, "_raw") != 0) {
+	(void)fprintf(stderr, "\"%s\" isn't a _raw file.\n", argv[1]);
+	exit(1);
+    }
+    (void)sprintf(gpsPath, "%.*s_gps", len-4, argv[1]);
+    (void)sprintf(ppsPath, "%.*s_pps", len-4, argv[1]);
+    if (argc == 3)
+	(void)strcpy(output, argv[2]);
+    else (void)sprintf(output, "%.*s%s", len-4, argv[1], NAVINDEX_SUFFIX);
+
+    if (reader.open(argv[1], errorMsg) == -1) {
+	(void)fprintf(stderr, "%s\n", errorMsg);
+	exit(1);
+    }
+    if ((u_long)reader.samples() * sizeof(short) <
+	    LOCAL_FRAME_COUNT_IMAGE_OFFSET + 4) {
+	(void)fprintf(stderr, "Frames are too narrow to hold nav data.\n");
+	exit(1);
+    }
+    frames = reader.frames();
+    if ((gpsFP=fopen(gpsPath, "rb")) == NULL ||
+	    (ppsFP=fopen(ppsPath, "rb")) == NULL) {
+	(void)fprintf(stderr, "Can't open \"%s\" or \"%s\".\n", gpsPath,
+	    ppsPath);
+	exit(1);
+    }
+    if ((out=fopen(output, "wb")) == NULL) {
+	(void)fprintf(stderr, "Can't create \"%s\".\n", output);
+	exit(1);
+    }
+
+	/* the header's rewritten at the end with the real counts */
+
+    (void)memset(&header, 0, sizeof(header));
+    (void)memcpy(header.magic, NAVINDEX_MAGIC, sizeof(header.magic));
+    header.version = NAVINDEX_VERSION;
+    header.recordBytes = sizeof(nav_index_record_t);
+    (void)fwrite(&header, sizeof(header), 1, out);
+
+    pending = new nav_index_record_t[MAX_PENDING_FRAMES];
+    ppsMax = 4096;
+    ppsFrames = new u_int[ppsMax];
+    ppsCount = 0;
+    (void)memset(&state, 0, sizeof(state));
+    (void)decoder.subscribe(3501, solutionHandler, &state);
+    havePrev = lastHadPPS = 0;
+    pendingStart = 0;
+    gpsMismatches = ppsMismatches = 0;
+    start = now();
+
+	/* we only want the first line of each frame, so don't read ahead */
+
+    reader.adviseRandom();
+
+    for (frame=0;frame < frames;frame++) {
+	line = reader.frame(frame);
+
+	    /* frame count and timestamp, as DisplayTab::processFrame and
+	       processImageTimingData read them */
+
+	rec = &pending[frame - pendingStart];
+	(void)memset(rec, 0, sizeof(*rec));
+	ucp = (const u_char *)line + LOCAL_FRAME_COUNT_IMAGE_OFFSET;
+	rec->localFrameCount = (*(ucp+1) << 24) + (*ucp << 16) +
+	    (*(ucp+3) << 8) + *(ucp+2);
+	rec->timestamp = line[TIMESTAMP_IMAGE_OFFSET / sizeof(short)];
+
+	    /* a PPS is the first frame of a run with PPS data */
+
+	if (frameWords(line, PPS_IMAGE_OFFSET, MAX_PPSDATA_BYTES, ppsFP,
+		streamWords, &ppsMismatches) != -1) {
+	    if (!lastHadPPS) {
+		rec->flags |= NAVINDEX_PPS;
+		if (ppsCount == ppsMax) {
+		    bigger = new u_int[2 * ppsMax];
+		    (void)memcpy(bigger, ppsFrames, ppsMax * sizeof(u_int));
+		    delete[] ppsFrames;
+		    ppsFrames = bigger;
+		    ppsMax *= 2;
+		}
+		ppsFrames[ppsCount++] = frame;
+	    }
+	    lastHadPPS = 1;
+	}
+	else lastHadPPS = 0;
+
+	    /* nav solutions go with the frame they finish in */
+
+	count = frameWords(line, GPS_IMAGE_OFFSET, MAX_GPSDATA_BYTES, gpsFP,
+	    streamWords, &gpsMismatches);
+	if (count > 0)
+	    decoder.decode(line + GPS_IMAGE_OFFSET / sizeof(short) + 2,
+		count);
+	if (state.haveFix) {
+	    state.haveFix = 0;
+	    state.fix.frame = frame;
+	    flushPending(out, pending, frame - pendingStart + 1, pendingStart,
+		havePrev? &last:NULL, &state.fix);
+	    last = state.fix;
+	    havePrev = 1;
+	    pendingStart = frame + 1;
+	}
+	else if (frame - pendingStart + 1 == MAX_PENDING_FRAMES) {
+	    flushPending(out, pending, MAX_PENDING_FRAMES, pendingStart,
+		havePrev? &last:NULL, NULL);
+	    pendingStart = frame + 1;
+	}
+    }
+    flushPending(out, pending, frames - pendingStart, pendingStart,
+	havePrev? &last:NULL, NULL);
+
+    header.frames = frames;
+    header.ppsCount = ppsCount;
+    if (fwrite(ppsFrames, sizeof(u_int), ppsCount, out) != ppsCount ||
+	    fseeko(out, 0, SEEK_SET) == -1 ||
+	    fwrite(&header, sizeof(header), 1, out) != 1 ||
+	    fclose(out) == EOF) {
+	(void)fprintf(stderr, "Write of nav index failed.\n");
+	exit(1);
+    }
+    elapsed = now() - start;
+
+    (void)printf("%u frames, %u PPS, %lu nav solutions in %.1f secs "
+	"(%.0f MB/s of flight line)\n", frames, ppsCount, state.solutions,
+	elapsed, (double)frames * reader.samples() * reader.lines() *
+	    sizeof(short) / 1e6 / elapsed);
+    if (gpsMismatches != 0 || ppsMismatches != 0)
+	(void)printf("%lu frames disagree with %s, %lu with %s\n",
+	    gpsMismatches, gpsPath, ppsMismatches, ppsPath);
+    return 0;
+}
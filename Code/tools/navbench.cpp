@@ -0,0 +1,293 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* navbench -- runs recorded nav message streams through the decoder,
+       for throughput and for robustness against damaged data.
+
+	   navbench [-n fuzz-trials] [<flightline>_allgps ...]
+
+       with no files, an hour of synthetic traffic at the nominal message
+       rates is used instead.  for throughput, each stream is decoded
+       repeatedly and the best rate reported.  each fuzz trial then damages
+       a copy of the stream -- flipped bits, dropped words, stray magic
+       numbers -- and decodes it, checking that every message delivered
+       is well-formed and counting how much was recovered */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "../navdecoder.h"
+
+#define NUM_TRIALS		5
+#define DEFAULT_FUZZ_TRIALS	20
+#define SYNTHETIC_SECS		3600
+#define FUZZ_DAMAGE_RATE	0.001	/* per word */
+
+typedef struct {
+    u_long delivered;
+    u_long malformed;
+} check_t;
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static u_short *readStream(const char *path, long *words_p)
+{
+    FILE *fp;
+    struct stat statbuf;
+    u_short *words;
+
+    if ((fp=fopen(path, "rb")) == NULL || fstat(fileno(fp), &statbuf) == -1) {
+	(void)fprintf(stderr, "Can't open \"%s\".\n", path);
+	exit(1);
+    }
+    *words_p = statbuf.st_size / sizeof(u_short);
+    words = new u_short[*words_p + 1];
+    if ((long)fread(words, sizeof(u_short), *words_p, fp) != *words_p) {
+	(void)fprintf(stderr, "Can't read \"%s\".\n", path);
+	exit(1);
+    }
+    (void)fclose(fp);
+    return words;
+}
+
+
+static u_short *addMessage(u_short *usp, u_short id)
+{
+    u_short sum;
+    int words, i;
+
+    words = NavDecoder::messageWords(id);
+    *usp++ = GPS_MAGIC_NUMBER;
+    *usp++ = id;
+    *usp++ = words - (NAV_HEADER_WORDS+1);
+    *usp++ = 0x8000;
+    *usp++ = (u_short)(-(GPS_MAGIC_NUMBER + id + words -
+	(NAV_HEADER_WORDS+1) + 0x8000));
+    sum = 0;
+    for (i=NAV_HEADER_WORDS;i < words-1;i++) {
+	*usp = rand() & 0xffff;
+	if (rand() % 50 == 0)
+	    *usp = GPS_MAGIC_NUMBER;	/* as happens in real data */
+	sum += *usp++;
+    }
+    *usp++ = (u_short)-sum;
+    return usp;
+}
+
+
+	/* per second, as in GPS_WORDS_PER_SECOND */
+
+static u_short *synthesize(int secs, long *words_p)
+{
+    u_short *words, *usp;
+    int sec, i;
+
+    words = new u_short[(long)secs * (GPS_MSG_3_WORDS + GPS_MSG_3500_WORDS +
+	10 * GPS_MSG_3501_WORDS + 100 * GPS_MSG_3512_WORDS +
+	GPS_MSG_3623_WORDS)];
+    usp = words;
+    for (sec=0;sec < secs;sec++) {
+	usp = addMessage(usp, 3);
+	usp = addMessage(usp, 3500);
+	usp = addMessage(usp, 3623);
+	for (i=0;i < 100;i++) {
+	    if (i % 10 == 0)
+		usp = addMessage(usp, 3501);
+	    usp = addMessage(usp, 3512);
+	}
+    }
+    *words_p = usp - words;
+    return words;
+}
+
+
+static void countMessage(void *arg, const nav_record_t *rec)
+{
+    ((check_t *)arg)->delivered++;
+}
+
+
+	/* anything delivered has to be a known message of the right length
+	   whose header checks out */
+
+static void checkMessage(void *arg, const nav_record_t *rec)
+{
+    check_t *check;
+    u_short sum;
+    int i;
+
+    check = (check_t *)arg;
+    check->delivered++;
+    sum = 0;
+    for (i=0;i < NAV_HEADER_WORDS;i++)
+	sum += rec->msg[i];
+    if (rec->msg[0] != GPS_MAGIC_NUMBER || rec->msg[1] != rec->id ||
+	    rec->words != NavDecoder::messageWords(rec->id) || sum != 0)
+	check->malformed++;
+}
+
+
+static void printStats(const nav_decoder_stats_t *stats)
+{
+    int i;
+
+    for (i=0;i < NAV_NUM_MESSAGES;i++)
+	(void)printf("  %-5u %10u\n", NavDecoder::messageId(i),
+	    stats->messages[i]);
+    (void)printf("  header failures %u, data checksum failures %u, "
+	"words skipped %lu\n", stats->headerFailures,
+	stats->dataChecksumFailures, stats->wordsSkipped);
+}
+
+
+static void benchmark(const u_short *words, long count)
+{
+    NavDecoder decoder;
+    nav_decoder_stats_t stats;
+    check_t check;
+    double start, elapsed, best;
+    int trial;
+
+    (void)memset(&check, 0, sizeof(check));
+    (void)decoder.subscribe(NAV_ALL_MESSAGES, countMessage, &check);
+    best = 0;
+    for (trial=0;trial < NUM_TRIALS;trial++) {
+	decoder.reset();
+	start = now();
+	decoder.decode(words, count);
+	elapsed = now() - start;
+	if (trial == 0 || elapsed < best)
+	    best = elapsed;
+    }
+    decoder.getStats(&stats);
+    (void)printf("%ld words: %.1f Mwords/s (%.0f MB/s), %.1f ns/word\n",
+	count, count / best / 1e6, count * sizeof(u_short) / best / 1e6,
+	best / count * 1e9);
+    printStats(&stats);
+}
+
+
+static void fuzz(const u_short *words, long count, int trials)
+{
+    NavDecoder decoder;
+    nav_decoder_stats_t stats;
+    check_t check;
+    u_short *damaged;
+    u_long clean, delivered, malformed;
+    long i, n;
+    int trial, bit;
+
+	/* the undamaged stream is the baseline for recovery */
+
+    (void)memset(&check, 0, sizeof(check));
+    (void)decoder.subscribe(NAV_ALL_MESSAGES, checkMessage, &check);
+    decoder.decode(words, count);
+    clean = check.delivered;
+
+    damaged = new u_short[count];
+    delivered = malformed = 0;
+    for (trial=0;trial < trials;trial++) {
+	n = 0;
+	for (i=0;i < count;i++) {
+	    if (rand() >= FUZZ_DAMAGE_RATE * RAND_MAX) {
+		damaged[n++] = words[i];
+		continue;
+	    }
+	    switch (rand() % 3) {
+		case 0:
+		    bit = rand() % 16;
+		    damaged[n++] = words[i] ^ (1 << bit);
+		    break;
+		case 1:
+		    break;	/* dropped */
+		case 2:
+		    damaged[n++] = GPS_MAGIC_NUMBER;
+		    break;
+	    }
+	}
+
+	    /* feed it in frame-sized pieces, as DisplayTab does */
+
+	check.delivered = check.malformed = 0;
+	decoder.reset();
+	for (i=0;i < n;i+=21)
+	    decoder.decode(damaged+i, (n-i < 21)? n-i:21);
+	delivered += check.delivered;
+	malformed += check.malformed;
+    }
+    decoder.getStats(&stats);
+    delete[] damaged;
+
+    (void)printf("fuzz: %d trials at %g damage/word, %.1f%% of %lu "
+	"messages recovered, %lu malformed\n", trials, FUZZ_DAMAGE_RATE,
+	(trials > 0 && clean > 0)? 100.0 * delivered / trials / clean:0.0,
+	clean, malformed);
+    if (trials > 0) {
+	(void)printf("last trial:\n");
+	printStats(&stats);
+    }
+    if (malformed != 0)
+	exit(1);
+}
+
+
+int main(int argc, char *argv[])
+{
+    u_short *words;
+    long count;
+    int trials, i;
+
+    trials = DEFAULT_FUZZ_TRIALS;
+    i = 1;
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+	trials = atoi(argv[2]);
+	i = 3;
+    }
+    if (trials < 0 || (i < argc && argv[i][0] == '-')) {
+	(void)fprintf(stderr, "Usage: %s [-n fuzz-trials] "
+	    "[<flightline>_allgps ...]\n", argv[0]);
+	exit(1);
+    }
+    srand(1);
+
+    if (i == argc) {
+	(void)printf("synthetic, %d secs\n", SYNTHETIC_SECS);
+	words = synthesize(SYNTHETIC_SECS, &count);
+	benchmark(words, count);
+	fuzz(words, count, trials);
+	delete[] words;
+    }
+    for (;i < argc;i++) {
+	(void)printf("%s\n", argv[i]);
+	words = readStream(argv[i], &count);
+	benchmark(words, count);
+	fuzz(words, count, trials);
+	delete[] words;
+    }
+    return 0;
+}
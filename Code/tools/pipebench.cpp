@@ -0,0 +1,623 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* pipebench -- runs the capture pipeline headless against synthetic
+       frames, to find out what rate a machine can sustain without flying.
+
+	   pipebench [-g lines x samples] [-r Hz] [-x] [-t secs]
+		     [-o dir | -n] [-d] [-T trace.json]
+
+       frames come from a SyntheticFrameBuffer (see synthbuf.h) at the
+       given rate, or as fast as the pipeline takes them with -x.  they
+       go through the same stages as in DisplayTab, set up the same way:
+       process (timing words, local frame count, nav decoding), record
+       (a raw-image writer in dir, removed afterwards, or nothing with
+       -n), and dark (a dark model, as though the shutter were closed
+       the whole time, finished every BENCH_DARK_FRAMES frames).  -d adds
+       the display kernels -- frame rendering and the stretch statistics.
+       -T turns on span tracing (see tracer.h) for the run and dumps the
+       rings to the given file at the end.
+
+       the report, on stdout, is JSON:  throughput, each stage's latency
+       from acquisition to the end of the stage (p50/p99/p99.9/max, ms),
+       frames dropped by the frame buffer (the card's ring overflowing)
+       and by the stages that drop, the writer's rate, the nav decoder's
+       counts, and CPU use for the process and for each core over the
+       run.  at a paced rate, any camera drops mean the rate can't be
+       sustained */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "../framering.h"
+#include "../framebase.h"
+#include "../pacedbuf.h"
+#include "../synthbuf.h"
+#include "../pipeline.h"
+#include "../frameops.h"
+#include "../darkmodel.h"
+#include "../bandstats.h"
+#include "../stretchlut.h"
+#include "../navdecoder.h"
+#include "../rawwriter.h"
+#include "../tracer.h"
+
+#define DEFAULT_LINES		481
+#define DEFAULT_SAMPLES		640
+#define DEFAULT_RATE_HZ		100.0
+#define DEFAULT_SECS		10.0
+#define BENCH_WAIT_USECS	10000
+#define BENCH_DARK_FRAMES	128
+#define BENCH_STRETCH_FRAMES	16	/* as STRETCH_CHECK_FRAMES */
+#define BENCH_MAX_SAMPLES	(1<<22)	/* latencies kept per stage */
+#define BENCH_MAX_CPUS		256
+
+    /* the stages, in the order they're stopped -- upstream first, so
+       each drains into the next */
+
+#define STAGE_PROCESS		0
+#define STAGE_RECORD		1
+#define STAGE_DARK		2
+#define STAGE_DISPLAY		3
+#define STAGE_STATS		4
+#define NUM_STAGES		5
+
+typedef struct {
+    PipelineStage *stage;
+    float *latencies;		/* ms, in arrival order */
+    u_int numLatencies;
+    u_int maxLatencies;
+    PipelineStats stats;
+} bench_stage_t;
+
+typedef struct {
+    u_long busy;
+    u_long total;
+} cpu_times_t;
+
+static int lines, samples, display;
+static bench_stage_t stages[NUM_STAGES];
+static FramePool *pool;
+static RawImageWriter *writer;
+static NavDecoder navDecoder;
+static DarkModel *darkModel;
+static BandStats *bandStats;
+static StretchLUT stretchLUT;
+static frame_renderer_t render;
+static u_short *darkFrame;
+static u_char *darkMask;
+static u_int *canvas;
+
+	/* what the process stage sees in the header lines */
+
+static u_short lastTimeStamp;
+static u_int stalledTimeStamps, ppsFrames, gpsFrames, lastLocalCount;
+static u_int frameCountGaps, localCounts;
+static u_int writeErrors, darkModels;
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void noteLatency(int stage, FrameHandle *h)
+{
+    bench_stage_t *s;
+
+	/* each stage is one thread, so nothing to lock */
+
+    s = &stages[stage];
+    if (s->numLatencies < s->maxLatencies)
+	s->latencies[s->numLatencies++] =
+	    (float)((pipelineNow() - h->acquireTime) * 1000.0);
+}
+
+
+static void processHandler(void *arg, FrameHandle *h)
+{
+    const u_short *usp;
+    const u_char *ucp;
+    u_short timeStamp, wordCount;
+    u_int localCount;
+    u_int64_t t0;
+
+    if (h == NULL)
+	return;
+
+	/* timing words, as processImageTimingData */
+
+    t0 = traceStart();
+    timeStamp = h->pixels[TIMESTAMP_IMAGE_OFFSET / sizeof(u_short)];
+    if (timeStamp == 0 || timeStamp == lastTimeStamp)
+	stalledTimeStamps++;
+    lastTimeStamp = timeStamp;
+    if (h->pixels[PPS_IMAGE_OFFSET / sizeof(u_short)] != 0xDEAD)
+	ppsFrames++;
+
+	/* a jump in the local frame count is a frame lost upstream */
+
+    ucp = (const u_char *)h->pixels + LOCAL_FRAME_COUNT_IMAGE_OFFSET;
+    localCount = *(ucp+1) << 24;
+    localCount += *ucp << 16;
+    localCount += *(ucp+3) << 8;
+    localCount += *(ucp+2);
+    if (localCounts > 0 && localCount != lastLocalCount + 1)
+	frameCountGaps += localCount - lastLocalCount - 1;
+    lastLocalCount = localCount;
+    localCounts++;
+    traceEnd(TRACE_TIMING, t0);
+
+	/* and the nav stream, as processImageGPSData */
+
+    t0 = traceStart();
+    usp = h->pixels + GPS_IMAGE_OFFSET / sizeof(u_short);
+    if (*usp++ != 0xDEAD) {
+	gpsFrames++;
+	wordCount = *usp++;
+	if (wordCount > MAX_GPSDATA_BYTES / sizeof(u_short))
+	    wordCount = MAX_GPSDATA_BYTES / sizeof(u_short);
+	navDecoder.decode(usp, wordCount);
+    }
+    traceEnd(TRACE_GPS, t0);
+
+    (void)stages[STAGE_RECORD].stage->submit(h);
+    if (display)
+	(void)stages[STAGE_DISPLAY].stage->submit(h);
+    noteLatency(STAGE_PROCESS, h);
+}
+
+
+static void recordHandler(void *arg, FrameHandle *h)
+{
+    u_int64_t t0;
+
+    if (h == NULL)
+	return;
+    t0 = traceStart();
+    if (writer != NULL && writer->writeFrame(h->pixels) == -1)
+	writeErrors++;
+    traceEnd(TRACE_RECORD, t0);
+    (void)stages[STAGE_DARK].stage->submit(h);
+    noteLatency(STAGE_RECORD, h);
+}
+
+
+static void darkHandler(void *arg, FrameHandle *h)
+{
+    u_int64_t t0;
+
+	/* finish a model every so often, as at the end of a dark period,
+	   or when the frames stop coming */
+
+    if (h != NULL) {
+	t0 = traceStart();
+	darkModel->addFrame(h->pixels);
+	traceEnd(TRACE_DARK, t0);
+	noteLatency(STAGE_DARK, h);
+    }
+    if (darkModel->framesAdded() > 0 && (h == NULL ||
+	    darkModel->framesAdded() == BENCH_DARK_FRAMES)) {
+	if (darkModel->finish() == 0)
+	    darkModels++;
+	darkModel->reset();
+    }
+}
+
+
+static void displayHandler(void *arg, FrameHandle *h)
+{
+    const u_char *lut;
+    u_int64_t t0;
+
+    if (h == NULL)
+	return;
+    (void)stages[STAGE_STATS].stage->submit(h);
+
+	/* as displayFrame, the frame is only drawn once we've caught up */
+
+    if (stages[STAGE_DISPLAY].stage->depth() == 0) {
+	t0 = traceStart();
+	lut = stretchLUT.acquire();
+	(*render)(canvas, samples, 0, h->pixels + samples,
+	    darkFrame + samples, darkMask + samples, lut, lines-1, samples);
+	stretchLUT.release(lut);
+	traceEnd(TRACE_RENDER, t0);
+    }
+    noteLatency(STAGE_DISPLAY, h);
+}
+
+
+static void statsHandler(void *arg, FrameHandle *h)
+{
+    if (h == NULL)
+	return;
+    bandStats->addFrame(h->pixels, darkFrame, darkMask, lines/4, lines/2,
+	3*lines/4);
+    if (bandStats->frames() % BENCH_STRETCH_FRAMES == 0)
+	stretchLUT.build(STRETCHLUT_LINEAR,
+	    bandStats->percentile(BANDSTATS_FRAME, 2.0),
+	    bandStats->percentile(BANDSTATS_FRAME, 98.0), 1.0, 1.0,
+	    bandStats->histogram(BANDSTATS_FRAME));
+    noteLatency(STAGE_STATS, h);
+}
+
+
+static int readCPUTimes(cpu_times_t *times)
+{
+    FILE *fp;
+    char buf[512];
+    u_long user, nice, sys, idle, iowait, irq, softirq, steal;
+    int cpu, n;
+
+	/* busy and total jiffies for each cpu, from /proc/stat */
+
+    if ((fp=fopen("/proc/stat", "r")) == NULL)
+	return 0;
+    n = 0;
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+	steal = 0;
+	if (sscanf(buf, "cpu%d %lu %lu %lu %lu %lu %lu %lu %lu", &cpu,
+		&user, &nice, &sys, &idle, &iowait, &irq, &softirq,
+		&steal) < 8 || cpu < 0 || cpu >= BENCH_MAX_CPUS)
+	    continue;
+	times[cpu].busy = user + nice + sys + irq + softirq + steal;
+	times[cpu].total = times[cpu].busy + idle + iowait;
+	if (cpu >= n)
+	    n = cpu + 1;
+    }
+    (void)fclose(fp);
+    return n;
+}
+
+
+static double rusageSecs(void)
+{
+    struct rusage ru;
+
+    (void)getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+	ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+
+static int compareFloats(const void *a, const void *b)
+{
+    float fa = *(const float *)a, fb = *(const float *)b;
+
+    return (fa < fb)? -1:(fa > fb)? 1:0;
+}
+
+
+static double percentile(const float *sorted, u_int n, double pct)
+{
+    u_int i;
+
+	/* nearest rank */
+
+    if (n == 0)
+	return 0.0;
+    i = (u_int)(pct / 100.0 * n + 0.999999);
+    if (i < 1)
+	i = 1;
+    if (i > n)
+	i = n;
+    return sorted[i-1];
+}
+
+
+static void printStage(const char *name, int stage, int last)
+{
+    bench_stage_t *s;
+    u_int n;
+
+    s = &stages[stage];
+    n = s->numLatencies;
+    qsort(s->latencies, n, sizeof(float), compareFloats);
+    (void)printf("    \"%s\": { \"frames\": %u, \"dropped\": %u, "
+	"\"max_depth\": %d, \"latency_samples\": %u,\n", name,
+	s->stats.frames, s->stats.dropped, s->stats.maxDepth, n);
+    (void)printf("      \"p50_ms\": %.3f, \"p99_ms\": %.3f, "
+	"\"p999_ms\": %.3f, \"max_ms\": %.3f }%s\n",
+	percentile(s->latencies, n, 50.0), percentile(s->latencies, n, 99.0),
+	percentile(s->latencies, n, 99.9), (n > 0)? s->latencies[n-1]:0.0,
+	last? "":",");
+}
+
+
+static void reportError(const char *string)
+{
+    (void)fprintf(stderr, "%s\n", string);
+}
+
+
+int main(int argc, char *argv[])
+{
+    SyntheticFrameBuffer *fb;
+    FrameHandle *h;
+    RawWriterStats writerStats;
+    nav_decoder_stats_t navStats;
+    frame_assembler_t assemble;
+    static cpu_times_t cpuStart[BENCH_MAX_CPUS], cpuEnd[BENCH_MAX_CPUS];
+    char rawPath[MAXPATHLEN], errorMsg[MAXPATHLEN+80];
+    const char *outDir, *tracePath, *assembleDescr;
+    double rateHz, secs, start, elapsed, cpuSecs, total;
+    u_int frames, camDropped, maxSamples, messages;
+    int opt, unpaced, record, leaseFrames, numCPUs, i, failed, spans;
+    void *frame;
+    u_int64_t t0, t1;
+
+	/* check invocation */
+
+    lines = DEFAULT_LINES;
+    samples = DEFAULT_SAMPLES;
+    rateHz = DEFAULT_RATE_HZ;
+    secs = DEFAULT_SECS;
+    outDir = "/tmp";
+    tracePath = NULL;
+    unpaced = 0;
+    record = 1;
+    display = 0;
+    failed = 0;
+    while ((opt=getopt(argc, argv, "g:r:xt:o:ndT:")) != -1) {
+	switch (opt) {
+	    case 'g':
+		if (sscanf(optarg, "%dx%d", &lines, &samples) != 2)
+		    failed = 1;
+		break;
+	    case 'r':
+		rateHz = atof(optarg);
+		break;
+	    case 'x':
+		unpaced = 1;
+		break;
+	    case 't':
+		secs = atof(optarg);
+		break;
+	    case 'o':
+		outDir = optarg;
+		break;
+	    case 'n':
+		record = 0;
+		break;
+	    case 'd':
+		display = 1;
+		break;
+	    case 'T':
+		tracePath = optarg;
+		break;
+	    default:
+		failed = 1;
+		break;
+	}
+    }
+    if (failed || optind != argc || lines < 2 || samples < 1 ||
+	    rateHz <= 0.0 || secs <= 0.0) {
+	(void)fprintf(stderr, "Usage: %s [-g lines x samples] [-r Hz] [-x] "
+	    "[-t secs]\n", argv[0]);
+	(void)fprintf(stderr, "           [-o dir | -n] [-d] "
+	    "[-T trace.json]\n");
+	exit(1);
+    }
+
+	/* set up the pipeline as DisplayTab does */
+
+    fb = new SyntheticFrameBuffer(lines, samples, reportError, rateHz,
+	unpaced? 0.0:1.0);
+    if (fb->failed) {
+	(void)fprintf(stderr, "%s\n", fb->last_error);
+	exit(1);
+    }
+    pool = new FramePool(fb, PIPELINE_POOL_FRAMES, lines * samples);
+    assemble = frameAssembler(-1, lines, samples, &assembleDescr);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    leaseFrames = 1;
+#else
+    leaseFrames = 0;
+#endif
+    darkModel = new DarkModel(lines, samples);
+    bandStats = new BandStats(lines, samples);
+    render = frameRenderer(frameOpsLevel(), 1, 1);
+    darkFrame = (u_short *)calloc(lines * samples, sizeof(u_short));
+    darkMask = (u_char *)calloc(lines * samples, 1);
+    canvas = (u_int *)malloc(lines * samples * sizeof(u_int));
+    stretchLUT.build(STRETCHLUT_LINEAR, 0, STRETCHLUT_MAX_DN, 1.0, 1.0,
+	NULL);
+
+    writer = NULL;
+    rawPath[0] = '\0';
+    if (record) {
+	(void)sprintf(rawPath, "%s/pipebench%d_raw", outDir, (int)getpid());
+	writer = new RawImageWriter;
+	if (writer->open(rawPath, lines * samples * sizeof(u_short),
+		rateHz, secs) == -1) {
+	    (void)fprintf(stderr, "Can't create \"%s\":  %s\n", rawPath,
+		strerror(errno));
+	    exit(1);
+	}
+    }
+
+    maxSamples = unpaced? BENCH_MAX_SAMPLES:
+	(u_int)(rateHz * secs * 1.1) + PIPELINE_POOL_FRAMES;
+    if (maxSamples > BENCH_MAX_SAMPLES)
+	maxSamples = BENCH_MAX_SAMPLES;
+    for (i=0;i < NUM_STAGES;i++) {
+	stages[i].latencies = (float *)malloc(maxSamples * sizeof(float));
+	stages[i].maxLatencies = maxSamples;
+	stages[i].numLatencies = 0;
+    }
+    stages[STAGE_PROCESS].stage = new PipelineStage("Process", pool,
+	PIPELINE_PROCESS_QUEUE, false, processHandler, NULL,
+	PIPELINE_WAIT_FOREVER, 0, 0);
+    stages[STAGE_RECORD].stage = new PipelineStage("Record", pool,
+	PIPELINE_RECORD_QUEUE, false, recordHandler, NULL,
+	PIPELINE_WAIT_FOREVER, 10, -10);
+    stages[STAGE_DARK].stage = new PipelineStage("Dark", pool,
+	PIPELINE_DARK_QUEUE, true, darkHandler, NULL, 1000000, 0, 15);
+    stages[STAGE_DISPLAY].stage = new PipelineStage("Display", pool,
+	PIPELINE_DISPLAY_QUEUE, true, displayHandler, NULL,
+	PIPELINE_WAIT_FOREVER, 0, 10);
+    stages[STAGE_STATS].stage = new PipelineStage("Stats", pool,
+	PIPELINE_STATS_QUEUE, true, statsHandler, NULL,
+	PIPELINE_WAIT_FOREVER, 0, 15);
+    for (i=0;i < NUM_STAGES;i++)
+	if (stages[i].stage->start() == -1) {
+	    (void)fprintf(stderr, "Can't create pipeline threads.\n");
+	    exit(1);
+	}
+
+	/* acquire as the data thread does, until time's up.  as there, a
+	   little-endian host works on frames where they sit */
+
+    if (tracePath != NULL)
+	traceEnable(1);
+    numCPUs = readCPUTimes(cpuStart);
+    cpuSecs = rusageSecs();
+    start = now();
+    frames = 0;
+    while (now() - start < secs) {
+	(void)fb->waitForFrame(BENCH_WAIT_USECS);
+	while (fb->frameIsAvailable() && now() - start < secs) {
+	    if ((h=pool->alloc(PIPELINE_WAIT_FOREVER)) == NULL)
+		break;
+	    h->frameCount = ++frames;
+	    t0 = traceStart();
+	    if ((frame=pool->getFrame()) == NULL)
+		traceEnd(TRACE_FETCH, t0);
+	    else if (leaseFrames) {
+		traceEnd(TRACE_FETCH, t0);
+		h->lease = frame;
+		h->pixels = (u_short *)frame;
+	    }
+	    else {
+		traceEnd(TRACE_FETCH, t0);
+		t1 = traceStart();
+		(*assemble)(h->storage, frame, lines, samples);
+		pool->releaseFrame(frame);
+		traceEnd(TRACE_ASSEMBLE, t1);
+	    }
+	    (void)stages[STAGE_PROCESS].stage->submit(h);
+	    pool->unref(h);
+	}
+    }
+    elapsed = now() - start;
+    fb->getStats(&camDropped, NULL);
+
+	/* drain the pipeline before taking the end-of-run numbers, so the
+	   latencies include everything acquired */
+
+    for (i=0;i < NUM_STAGES;i++) {
+	stages[i].stage->stop();
+	stages[i].stage->getStats(&stages[i].stats);
+    }
+    total = now() - start;
+    cpuSecs = rusageSecs() - cpuSecs;
+    (void)readCPUTimes(cpuEnd);
+    (void)memset(&writerStats, 0, sizeof(writerStats));
+    if (writer != NULL) {
+	if (writer->close() == -1)
+	    writeErrors++;
+	writer->getRecordingStats(&writerStats);
+	(void)unlink(rawPath);
+    }
+    spans = 0;
+    if (tracePath != NULL) {
+	traceEnable(0);
+	if ((spans=traceDump(tracePath, errorMsg)) == -1) {
+	    (void)fprintf(stderr, "%s\n", errorMsg);
+	    failed = 1;
+	}
+    }
+    navDecoder.getStats(&navStats);
+    messages = 0;
+    for (i=0;i < NAV_NUM_MESSAGES;i++)
+	messages += navStats.messages[i];
+
+	/* report */
+
+    (void)printf("{\n");
+    (void)printf("  \"lines\": %d, \"samples\": %d, ", lines, samples);
+    if (unpaced)
+	(void)printf("\"requested_hz\": null,\n");
+    else (void)printf("\"requested_hz\": %.2f,\n", rateHz);
+    (void)printf("  \"seconds\": %.3f, \"frames\": %u, \"fps\": %.2f, "
+	"\"mb_per_sec\": %.2f,\n", elapsed, frames, frames / elapsed,
+	frames * (double)lines * samples * sizeof(u_short) / elapsed / 1e6);
+    (void)printf("  \"kernels\": \"%s\",\n", assembleDescr);
+    (void)printf("  \"drops\": { \"camera\": %u, \"frame_count_gaps\": %u, "
+	"\"dark\": %u, \"display\": %u, \"stats\": %u },\n", camDropped,
+	frameCountGaps, stages[STAGE_DARK].stats.dropped,
+	stages[STAGE_DISPLAY].stats.dropped,
+	stages[STAGE_STATS].stats.dropped);
+    (void)printf("  \"stages\": {\n");
+    printStage("process", STAGE_PROCESS, 0);
+    printStage("record", STAGE_RECORD, 0);
+    printStage("dark", STAGE_DARK, !display);
+    if (display) {
+	printStage("display", STAGE_DISPLAY, 0);
+	printStage("stats", STAGE_STATS, 1);
+    }
+    (void)printf("  },\n");
+    (void)printf("  \"writer\": { \"enabled\": %s, \"direct\": %s, "
+	"\"errors\": %u, \"mb_per_sec\": %.2f,\n", record? "true":"false",
+	(writer != NULL && writer->isDirect())? "true":"false", writeErrors,
+	writerStats.mbPerSec);
+    (void)printf("    \"p50_ms\": %.3f, \"p99_ms\": %.3f, "
+	"\"max_ms\": %.3f },\n", writerStats.p50LatencyMs,
+	writerStats.p99LatencyMs, writerStats.maxLatencyMs);
+    (void)printf("  \"timing\": { \"stalled_timestamps\": %u, "
+	"\"pps_frames\": %u, \"pps_count\": %u },\n", stalledTimeStamps,
+	ppsFrames, fb->fpgaPPSCount());
+    (void)printf("  \"nav\": { \"frames\": %u, \"messages\": %u, "
+	"\"header_failures\": %u, \"checksum_failures\": %u },\n", gpsFrames,
+	messages, navStats.headerFailures, navStats.dataChecksumFailures);
+    (void)printf("  \"dark_models\": %u,\n", darkModels);
+    if (tracePath != NULL)
+	(void)printf("  \"trace\": { \"path\": \"%s\", \"spans\": %d },\n",
+	    tracePath, spans);
+    (void)printf("  \"cpu\": { \"process_pct\": %.1f, \"cores_pct\": [",
+	100.0 * cpuSecs / total);
+    for (i=0;i < numCPUs;i++)
+	(void)printf("%s%.1f", (i == 0)? "":", ",
+	    (cpuEnd[i].total > cpuStart[i].total)?
+		100.0 * (cpuEnd[i].busy - cpuStart[i].busy) /
+		    (cpuEnd[i].total - cpuStart[i].total):0.0);
+    (void)printf("] }\n");
+    (void)printf("}\n");
+
+	/* the frame buffer goes last; the pool may still hold leases */
+
+    delete writer;
+    for (i=0;i < NUM_STAGES;i++)
+	delete stages[i].stage;
+    delete pool;
+    delete fb;
+    exit((camDropped > 0 || writeErrors > 0 || failed)? 2:0);
+}
@@ -0,0 +1,182 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* quicklook -- makes a color waterfall of a recorded flight line, one
+       row per frame, as a PPM image.
+
+	   quicklook [-s step] [-t threads] <flightline>_raw red green blue
+	       [output]
+
+       red, green, and blue are band numbers as in the settings.  with a
+       step, only every step'th frame is used.  output defaults to
+       <flightline>_quicklook.ppm.  each color is stretched linearly from
+       its 2nd to its 98th percentile, as the display's automatic stretch
+       does */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../stripeindex.h"
+#include "../flightline.h"
+
+#define QUICKLOOK_BINS		(1<<16)
+#define LOW_PERCENTILE		2.0
+#define HIGH_PERCENTILE		98.0
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void buildStretch(const u_short *pixels, size_t n, u_char *lut)
+{
+    u_int *hist;
+    size_t i, sum, lowCount, highCount;
+    int low, high, dn;
+
+    hist = new u_int[QUICKLOOK_BINS];
+    (void)memset(hist, 0, QUICKLOOK_BINS * sizeof(u_int));
+    for (i=0;i < n;i++)
+	hist[pixels[i]]++;
+    lowCount = (size_t)(n * LOW_PERCENTILE / 100);
+    highCount = (size_t)(n * HIGH_PERCENTILE / 100);
+    low = high = -1;
+    sum = 0;
+    for (i=0;i < QUICKLOOK_BINS && high < 0;i++) {
+	sum += hist[i];
+	if (low < 0 && sum > lowCount)
+	    low = i;
+	if (sum > highCount)
+	    high = i;
+    }
+    delete[] hist;
+    if (low < 0)
+	low = 0;
+    if (high <= low)
+	high = low + 1;
+    for (i=0;i < QUICKLOOK_BINS;i++) {
+	if ((int)i <= low)
+	    dn = 0;
+	else if ((int)i >= high)
+	    dn = 255;
+	else dn = 255 * ((int)i - low) / (high - low);
+	lut[i] = (u_char)dn;
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    FlightLineReader reader;
+    char errorMsg[2*MAXPATHLEN+100], output[MAXPATHLEN+20];
+    int lines[3], step, threads, opt, len, k;
+    u_int rows, row, col;
+    u_short *bands[3];
+    u_char *luts[3], *rgb;
+    FILE *fp;
+    double start, elapsed;
+
+	/* check invocation */
+
+    step = 1;
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt=getopt(argc, argv, "s:t:")) != -1) {
+	if (opt == 's')
+	    step = atoi(optarg);
+	else if (opt == 't')
+	    threads = atoi(optarg);
+	else step = 0;
+    }
+    if ((argc - optind != 4 && argc - optind != 5) || step < 1) {
+	(void)fprintf(stderr, "Usage: %s [-s step] [-t threads] "
+	    "<flightline>_raw red green blue [output]\n", argv[0]);
+	exit(1);
+    }
+    if (reader.open(argv[optind], errorMsg) == -1) {
+	(void)fprintf(stderr, "%s\n", errorMsg);
+	exit(1);
+    }
+    for (k=0;k < 3;k++) {
+	lines[k] = atoi(argv[optind+1+k]);
+	if (lines[k] < 1 || lines[k] >= reader.lines()) {
+	    (void)fprintf(stderr, "Bands run from 1 to %d.\n",
+		reader.lines() - 1);
+	    exit(1);
+	}
+    }
+    if (argc - optind == 5)
+	(void)strcpy(output, argv[optind+4]);
+    else {
+	len = strlen(argv[optind]);
+	if (len > 4 && strcmp(argv[optind] + len - 4, "_raw") == 0)
+	    len -= 4;
+	(void)sprintf(output, "%.*s_quicklook.ppm", len, argv[optind]);
+    }
+    rows = (reader.frames() + step - 1) / step;
+    if (rows == 0) {
+	(void)fprintf(stderr, "No frames in \"%s\".\n", argv[optind]);
+	exit(1);
+    }
+
+	/* pull the three bands out, stretch, and write */
+
+    start = now();
+    reader.adviseSequential();
+    for (k=0;k < 3;k++)
+	bands[k] = new u_short[(size_t)rows * reader.samples()];
+    if (reader.extractBands(lines, 3, 0, rows, step, bands, threads) == -1) {
+	(void)fprintf(stderr, "Can't extract bands.\n");
+	exit(1);
+    }
+    elapsed = now() - start;
+
+    for (k=0;k < 3;k++) {
+	luts[k] = new u_char[QUICKLOOK_BINS];
+	buildStretch(bands[k], (size_t)rows * reader.samples(), luts[k]);
+    }
+    if ((fp=fopen(output, "wb")) == NULL) {
+	(void)fprintf(stderr, "Can't create \"%s\".\n", output);
+	exit(1);
+    }
+    (void)fprintf(fp, "P6\n%d %u\n255\n", reader.samples(), rows);
+    rgb = new u_char[3 * reader.samples()];
+    for (row=0;row < rows;row++) {
+	for (col=0;col < (u_int)reader.samples();col++)
+	    for (k=0;k < 3;k++)
+		rgb[3*col+k] = luts[k][bands[k][(size_t)row *
+		    reader.samples() + col]];
+	(void)fwrite(rgb, 3, reader.samples(), fp);
+    }
+    if (fclose(fp) == EOF) {
+	(void)fprintf(stderr, "Write of \"%s\" failed.\n", output);
+	exit(1);
+    }
+
+    (void)printf("%u of %u frames in %.2f secs with %d threads (%.0f MB/s "
+	"of flight line)\n", rows, reader.frames(), elapsed, threads,
+	(double)rows * step * reader.samples() * reader.lines() *
+	    sizeof(u_short) / 1e6 / elapsed);
+    return 0;
+}
@@ -0,0 +1,203 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* uncmp -- decompresses a _raw.cmp flight line back into the usual
+       BIL _raw file.
+
+	   uncmp [-f first] [-n frames] <flightline>_raw.cmp [output]
+
+       output defaults to the input name without the .cmp suffix; "-" is
+       standard output, so frames can be piped on as they're decoded.
+       reading is straight through the frame records, so a file whose
+       recording never closed (and so has no index) decodes as far as it
+       got.  with -f, the index is used to find the first frame if there
+       is one; otherwise the records are skipped through to it */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include "../ricecodec.h"
+#include "../cmpwriter.h"
+
+
+static int seekToFrame(FILE *fp, u_int first)
+{
+    cmp_trailer_t trailer;
+    cmp_record_t record;
+    u_int64_t offset;
+    off_t start;
+
+	/* by the index if we have one... */
+
+    start = ftello(fp);
+    if (fseeko(fp, -(off_t)sizeof(trailer), SEEK_END) == 0 &&
+	    fread(&trailer, sizeof(trailer), 1, fp) == 1 &&
+	    memcmp(trailer.magic, CMP_INDEX_MAGIC,
+		sizeof(trailer.magic)) == 0) {
+	if (first >= trailer.frames)
+	    return -1;
+	if (fseeko(fp, (off_t)trailer.indexOffset + sizeof(record) +
+		first * sizeof(u_int64_t), SEEK_SET) == -1 ||
+		fread(&offset, sizeof(offset), 1, fp) != 1)
+	    return -1;
+	return fseeko(fp, (off_t)offset, SEEK_SET);
+    }
+
+	/* ...else by skipping records */
+
+    if (fseeko(fp, start, SEEK_SET) == -1)
+	return -1;
+    for (;;) {
+	start = ftello(fp);
+	if (fread(&record, sizeof(record), 1, fp) != 1 ||
+		record.sync != CMP_RECORD_SYNC ||
+		record.method == CMP_METHOD_INDEX)
+	    return -1;
+	if (record.frame == first)
+	    return fseeko(fp, start, SEEK_SET);
+	if (fseeko(fp, record.bytes, SEEK_CUR) == -1)
+	    return -1;
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    cmp_header_t header;
+    cmp_record_t record;
+    char output[MAXPATHLEN];
+    FILE *in, *out;
+    u_short *frame;
+    u_char *packed;
+    size_t frameBytes, maxBytes;
+    u_int first, count, frames, stored;
+    int opt, len;
+
+	/* check invocation */
+
+    first = 0;
+    count = 0;
+    while ((opt=getopt(argc, argv, "f:n:")) != -1) {
+	if (opt == 'f')
+	    first = atoi(optarg);
+	else if (opt == 'n')
+	    count = atoi(optarg);
+	else optind = argc;
+    }
+    if (argc - optind != 1 && argc - optind != 2) {
+	(void)fprintf(stderr, "Usage: %s [-f first] [-n frames] "
+	    "<flightline>_raw%s [output]\n", argv[0], CMP_FILE_SUFFIX);
+	exit(1);
+    }
+    if (argc - optind == 2)
+	(void)strcpy(output, argv[optind+1]);
+    else {
+	len = strlen(argv[optind]) - strlen(CMP_FILE_SUFFIX);
+	if (len <= 0 || strcmp(argv[optind]+len, CMP_FILE_SUFFIX) != 0) {
+	    (void)fprintf(stderr, "Can't derive output name from \"%s\".\n",
+		argv[optind]);
+	    exit(1);
+	}
+	(void)memcpy(output, argv[optind], (size_t)len);
+	output[len] = '\0';
+    }
+
+    if ((in=fopen(argv[optind], "rb")) == NULL) {
+	(void)fprintf(stderr, "Can't open \"%s\".\n", argv[optind]);
+	exit(1);
+    }
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+	    memcmp(header.magic, CMP_MAGIC, sizeof(header.magic)) != 0) {
+	(void)fprintf(stderr, "\"%s\" isn't a compressed flight line.\n",
+	    argv[optind]);
+	exit(1);
+    }
+    if (header.version != CMP_VERSION) {
+	(void)fprintf(stderr, "Unsupported version %u.\n", header.version);
+	exit(1);
+    }
+    if (first > 0 && seekToFrame(in, first) == -1) {
+	(void)fprintf(stderr, "No frame %u in \"%s\".\n", first,
+	    argv[optind]);
+	exit(1);
+    }
+    if (strcmp(output, "-") == 0)
+	out = stdout;
+    else if ((out=fopen(output, "wb")) == NULL) {
+	(void)fprintf(stderr, "Can't create \"%s\".\n", output);
+	exit(1);
+    }
+
+    frameBytes = (size_t)header.lines * header.samples * sizeof(u_short);
+    maxBytes = riceMaxBytes(header.lines, header.samples);
+    if (maxBytes < frameBytes)
+	maxBytes = frameBytes;
+    frame = new u_short[(size_t)header.lines * header.samples];
+    packed = new u_char[maxBytes];
+
+	/* decode frames until the index, the end of the file, or as many
+	   as were asked for */
+
+    frames = 0;
+    stored = 0;
+    while ((count == 0 || frames < count) &&
+	    fread(&record, sizeof(record), 1, in) == 1) {
+	if (record.sync != CMP_RECORD_SYNC) {
+	    (void)fprintf(stderr, "Bad record after frame %u.\n",
+		first + frames);
+	    exit(1);
+	}
+	if (record.method == CMP_METHOD_INDEX)
+	    break;
+	if (record.bytes > maxBytes ||
+		fread(packed, record.bytes, 1, in) != 1) {
+	    (void)fprintf(stderr, "Truncated at frame %u; stopping.\n",
+		record.frame);
+	    break;
+	}
+	if (record.method == RICE_METHOD_STORED &&
+		record.bytes == frameBytes) {
+	    (void)memcpy(frame, packed, frameBytes);
+	    stored++;
+	}
+	else if (record.method != RICE_METHOD_RICE ||
+		riceDecodeFrame(frame, packed, record.bytes, header.lines,
+		    header.samples) == -1) {
+	    (void)fprintf(stderr, "Frame %u doesn't decode.\n", record.frame);
+	    exit(1);
+	}
+	if (fwrite(frame, frameBytes, 1, out) != 1) {
+	    (void)fprintf(stderr, "Write to \"%s\" failed.\n", output);
+	    exit(1);
+	}
+	frames++;
+    }
+    if (fclose(out) == EOF) {
+	(void)fprintf(stderr, "Write to \"%s\" failed.\n", output);
+	exit(1);
+    }
+    (void)fclose(in);
+    delete[] frame;
+    delete[] packed;
+
+    (void)fprintf(stderr, "%s: %u frames (%u stored uncompressed).\n",
+	output, frames, stored);
+    exit(0);
+}
@@ -0,0 +1,126 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+    /* unstripe -- reassembles a striped flight line into the usual BIL
+       _raw file next to its header.
+
+	   unstripe <flightline>_raw.stripes [output]
+
+       output defaults to the index name without the .stripes suffix.  if
+       the recording never closed (frames = 0 in the index), the frames
+       the index last recorded as written are recovered, as far as the
+       stripe files hold them */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../stripeindex.h"
+
+
+int main(int argc, char *argv[])
+{
+    stripe_index_t index;
+    char errorMsg[MAXPATHLEN+100];
+    char output[MAXPATHLEN];
+    FILE *in[STRIPE_MAX_STRIPES], *out;
+    struct stat statbuf;
+    u_int frame, frames, available;
+    off_t offset;
+    char *buf;
+    int i, stripe, len;
+
+	/* check invocation */
+
+    if (argc != 2 && argc != 3) {
+	(void)fprintf(stderr, "Usage: %s <flightline>_raw%s [output]\n",
+	    argv[0], STRIPE_INDEX_SUFFIX);
+	exit(1);
+    }
+    if (readStripeIndex(argv[1], &index, errorMsg) == -1) {
+	(void)fprintf(stderr, "%s\n", errorMsg);
+	exit(1);
+    }
+    if (argc == 3)
+	(void)strcpy(output, argv[2]);
+    else {
+	len = strlen(argv[1]) - strlen(STRIPE_INDEX_SUFFIX);
+	if (len <= 0 || strcmp(argv[1]+len, STRIPE_INDEX_SUFFIX) != 0) {
+	    (void)fprintf(stderr, "Can't derive output name from \"%s\".\n",
+		argv[1]);
+	    exit(1);
+	}
+	(void)memcpy(output, argv[1], (size_t)len);
+	output[len] = '\0';
+    }
+
+	/* open stripes.  if we don't know how long the flight line is, go by
+	   what was last checkpointed, but no further than the first frame
+	   that some stripe doesn't have */
+
+    frames = (index.frames != 0)? index.frames:index.written;
+    for (i=0;i < index.numStripes;i++) {
+	if ((in[i]=fopen(index.paths[i], "rb")) == NULL ||
+		fstat(fileno(in[i]), &statbuf) == -1) {
+	    (void)fprintf(stderr, "Can't open stripe \"%s\".\n",
+		index.paths[i]);
+	    exit(1);
+	}
+	if (index.frames == 0) {
+	    available = stripeFirstMissing(&index, i,
+		(u_int)(statbuf.st_size / index.frameBytes));
+	    if (available < frames)
+		frames = available;
+	}
+    }
+
+    if ((out=fopen(output, "wb")) == NULL) {
+	(void)fprintf(stderr, "Can't create \"%s\".\n", output);
+	exit(1);
+    }
+    if ((buf=(char *)malloc(index.frameBytes)) == NULL) {
+	(void)fprintf(stderr, "Out of memory.\n");
+	exit(1);
+    }
+
+	/* copy frames back into flight-line order */
+
+    for (frame=0;frame < frames;frame++) {
+	stripe = stripeForFrame(&index, frame, &offset);
+	if (fseeko(in[stripe], offset, SEEK_SET) == -1 ||
+		fread(buf, index.frameBytes, 1, in[stripe]) != 1) {
+	    (void)fprintf(stderr, "Short read on \"%s\" at frame %u.\n",
+		index.paths[stripe], frame);
+	    exit(1);
+	}
+	if (fwrite(buf, index.frameBytes, 1, out) != 1) {
+	    (void)fprintf(stderr, "Write to \"%s\" failed.\n", output);
+	    exit(1);
+	}
+    }
+    if (fclose(out) == EOF) {
+	(void)fprintf(stderr, "Write to \"%s\" failed.\n", output);
+	exit(1);
+    }
+    for (i=0;i < index.numStripes;i++)
+	(void)fclose(in[i]);
+    free(buf);
+
+    (void)printf("%s: %u frames from %d stripes.\n", output, frames,
+	index.numStripes);
+    exit(0);
+}
@@ -0,0 +1,300 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+    /* verifyfl -- checks a recorded flight line against its integrity
+       manifest (see manifest.h).
+
+	   verifyfl [-t threads] <flightline>_raw [manifest]
+
+       the manifest defaults to <flightline>_raw.sha256.  blocks are
+       hashed on several threads at once, each taking every n'th block,
+       straight out of the mapped _raw or stripe files.  every block is
+       reported that doesn't match, or that the manifest has no line for
+       (the recording may have died before it got that far).  if the
+       manifest was closed, the frame count and the digest over all the
+       blocks are checked too.  a recording kept only compressed can be
+       checked by decompressing it into a pipe:
+
+	   uncmp <flightline>_raw.cmp - | verifyfl - <flightline>_raw.sha256
+
+       exit status is 0 only if everything checks */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <tomcrypt.h>
+#include "../stripeindex.h"
+#include "../flightline.h"
+#include "../manifest.h"
+
+#define VERIFY_MAX_THREADS	FLIGHTLINE_MAX_THREADS
+
+#define BLOCK_OK		0
+#define BLOCK_MISMATCH		1
+#define BLOCK_NOT_IN_MANIFEST	2
+
+typedef struct {
+    FlightLineReader *reader;
+    const manifest_t *manifest;
+    u_int numBlocks;
+    u_int first;
+    u_int step;
+    manifest_digest_t *digests;
+    u_char *status;
+} verify_job_t;
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void checkBlock(const manifest_t *m, u_int block,
+    manifest_digest_t *digests, u_char *status)
+{
+    if (block >= m->blocks || !m->have[block])
+	status[block] = BLOCK_NOT_IN_MANIFEST;
+    else if (memcmp(digests[block], m->digests[block],
+	    MANIFEST_DIGEST_BYTES) != 0)
+	status[block] = BLOCK_MISMATCH;
+    else status[block] = BLOCK_OK;
+}
+
+
+static void *verifyJob(void *arg)
+{
+    verify_job_t *job = (verify_job_t *)arg;
+    const manifest_t *m = job->manifest;
+    hash_state state;
+    u_int block, first, count, f;
+
+    for (block=job->first;block < job->numBlocks;block+=job->step) {
+	first = block * m->blockFrames;
+	count = job->reader->frames() - first;
+	if (count > (u_int)m->blockFrames)
+	    count = m->blockFrames;
+	job->reader->adviseWillNeed(first, count);
+	(void)sha256_init(&state);
+	for (f=first;f < first+count;f++)
+	    (void)sha256_process(&state,
+		(const u_char *)job->reader->frame(f), m->frameBytes);
+	(void)sha256_done(&state, job->digests[block]);
+	job->reader->release(first, count);
+	checkBlock(m, block, job->digests, job->status);
+    }
+    return NULL;
+}
+
+
+static void growBlocks(manifest_digest_t **digests_p, u_char **status_p,
+    u_int *max_p, u_int n)
+{
+    manifest_digest_t *digests;
+    u_char *status;
+    u_int max;
+
+    if (n < *max_p)
+	return;
+    max = 2 * *max_p;
+    digests = new manifest_digest_t[max];
+    status = new u_char[max];
+    (void)memcpy(digests, *digests_p, *max_p * sizeof(manifest_digest_t));
+    (void)memcpy(status, *status_p, *max_p);
+    delete[] *digests_p;
+    delete[] *status_p;
+    *digests_p = digests;
+    *status_p = status;
+    *max_p = max;
+}
+
+
+	/* frames from a pipe can only be taken in order, on this thread */
+
+static u_int hashStream(FILE *fp, const manifest_t *m,
+    manifest_digest_t **digests_p, u_char **status_p)
+{
+    hash_state state;
+    u_char *frame;
+    u_int frames, block, max;
+
+    frame = new u_char[m->frameBytes];
+    max = m->blocks + 1;
+    *digests_p = new manifest_digest_t[max];
+    *status_p = new u_char[max];
+    frames = 0;
+    block = 0;
+    (void)sha256_init(&state);
+    for (;;) {
+	if (fread(frame, m->frameBytes, 1, fp) == 1) {
+	    (void)sha256_process(&state, frame, m->frameBytes);
+	    if (++frames % m->blockFrames != 0)
+		continue;
+	}
+	else if (frames % m->blockFrames == 0)
+	    break;
+	growBlocks(digests_p, status_p, &max, block);
+	(void)sha256_done(&state, (*digests_p)[block]);
+	checkBlock(m, block, *digests_p, *status_p);
+	block++;
+	if (frames % m->blockFrames != 0)
+	    break;			/* the partial block at the end */
+	(void)sha256_init(&state);
+    }
+    delete[] frame;
+    return frames;
+}
+
+
+int main(int argc, char *argv[])
+{
+    FlightLineReader reader;
+    manifest_t m;
+    verify_job_t jobs[VERIFY_MAX_THREADS];
+    pthread_t threads[VERIFY_MAX_THREADS];
+    manifest_digest_t *digests, digest;
+    u_char *status;
+    char manifestPath[MAXPATHLEN+sizeof(MANIFEST_SUFFIX)];
+    char errorMsg[MAXPATHLEN+100], hex[2*MANIFEST_DIGEST_BYTES+1];
+    const char *rawPath;
+    u_int frames, numBlocks, block, bad, missing;
+    int numThreads, opt, i, fromPipe, failed;
+    double start, secs;
+
+	/* check invocation */
+
+    numThreads = 4;
+    while ((opt=getopt(argc, argv, "t:")) != -1) {
+	if (opt == 't')
+	    numThreads = atoi(optarg);
+	else optind = argc + 1;
+    }
+    if ((argc - optind != 1 && argc - optind != 2) || numThreads < 1 ||
+	    numThreads > VERIFY_MAX_THREADS ||
+	    (strcmp(argv[optind], "-") == 0 && argc - optind != 2)) {
+	(void)fprintf(stderr, "Usage: %s [-t threads (1-%d)] "
+	    "<flightline>_raw [manifest]\n", argv[0], VERIFY_MAX_THREADS);
+	(void)fprintf(stderr, "       %s - manifest   (frames on stdin)\n",
+	    argv[0]);
+	exit(1);
+    }
+    rawPath = argv[optind];
+    fromPipe = (strcmp(rawPath, "-") == 0);
+    if (argc - optind == 2)
+	(void)strcpy(manifestPath, argv[optind+1]);
+    else (void)sprintf(manifestPath, "%s%s", rawPath, MANIFEST_SUFFIX);
+    if (readManifest(manifestPath, &m, errorMsg) == -1) {
+	(void)fprintf(stderr, "%s\n", errorMsg);
+	exit(1);
+    }
+
+	/* hash the flight line */
+
+    start = now();
+    if (fromPipe) {
+	frames = hashStream(stdin, &m, &digests, &status);
+	numBlocks = (frames + m.blockFrames - 1) / m.blockFrames;
+    }
+    else {
+	if (reader.open(rawPath, errorMsg) == -1) {
+	    (void)fprintf(stderr, "%s\n", errorMsg);
+	    exit(1);
+	}
+	if ((size_t)reader.samples() * reader.lines() * sizeof(u_short) !=
+		m.frameBytes) {
+	    (void)fprintf(stderr, "Manifest is for %lu-byte frames, but "
+		"\"%s\" has %d x %d.\n", m.frameBytes, rawPath,
+		reader.lines(), reader.samples());
+	    exit(1);
+	}
+	frames = reader.frames();
+	numBlocks = (frames + m.blockFrames - 1) / m.blockFrames;
+	digests = new manifest_digest_t[numBlocks+1];
+	status = new u_char[numBlocks+1];
+	if ((u_int)numThreads > numBlocks)
+	    numThreads = (numBlocks == 0)? 1:numBlocks;
+	for (i=0;i < numThreads;i++) {
+	    jobs[i].reader = &reader;
+	    jobs[i].manifest = &m;
+	    jobs[i].numBlocks = numBlocks;
+	    jobs[i].first = i;
+	    jobs[i].step = numThreads;
+	    jobs[i].digests = digests;
+	    jobs[i].status = status;
+	    if (pthread_create(&threads[i], NULL, verifyJob, &jobs[i]) != 0) {
+		(void)fprintf(stderr, "Can't create threads.\n");
+		exit(1);
+	    }
+	}
+	for (i=0;i < numThreads;i++)
+	    (void)pthread_join(threads[i], NULL);
+    }
+    secs = now() - start;
+
+	/* and report */
+
+    bad = missing = 0;
+    for (block=0;block < numBlocks;block++)
+	if (status[block] == BLOCK_MISMATCH) {
+	    (void)printf("block %u (frames %u-%u) doesn't match\n", block,
+		block * m.blockFrames, (block+1) * m.blockFrames - 1);
+	    bad++;
+	}
+	else if (status[block] == BLOCK_NOT_IN_MANIFEST) {
+	    (void)printf("block %u (frames %u-%u) isn't in the manifest\n",
+		block, block * m.blockFrames, (block+1) * m.blockFrames - 1);
+	    missing++;
+	}
+    failed = (bad > 0 || missing > 0);
+    for (block=numBlocks;block < m.blocks;block++)
+	if (m.have[block]) {
+	    (void)printf("block %u is in the manifest but not the flight "
+		"line\n", block);
+	    failed = 1;
+	}
+    (void)printf("%u frames in %u blocks, %.1f MB/s:  %u bad, %u not in "
+	"manifest\n", frames, numBlocks,
+	(double)frames * m.frameBytes / 1.0e6 / secs, bad, missing);
+    if (!m.closed)
+	(void)printf("manifest was never closed; blocks checked only\n");
+    else {
+	if (frames != m.frames) {
+	    (void)printf("manifest says %u frames\n", m.frames);
+	    failed = 1;
+	}
+	manifestDigest(digest, digests, numBlocks);
+	digestToHex(hex, digest);
+	if (memcmp(digest, m.digest, MANIFEST_DIGEST_BYTES) != 0) {
+	    (void)printf("flight-line digest %s doesn't match\n", hex);
+	    failed = 1;
+	}
+	else (void)printf("flight-line digest %s matches\n", hex);
+    }
+
+    reader.close();
+    delete[] digests;
+    delete[] status;
+    freeManifest(&m);
+    exit(failed? 1:0);
+}
@@ -0,0 +1,267 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/syscall.h>
+#include "tracer.h"
+
+extern const char *const tracerDate = "$Date: 2015/12/31 11:06:52 $";
+
+volatile int traceEnabled = 0;
+__thread trace_ring_t *traceRing = NULL;
+
+const char *const traceSpanNames[NUM_TRACE_SPANS] = {
+    "fetch memcpy",
+    "fetch release",
+    "fetch",
+    "assemble",
+    "timing",
+    "GPS",
+    "record",
+    "write",
+    "dark",
+    "waterfall",
+    "frame render",
+    "acquire"
+};
+
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+static trace_ring_t *rings[TRACE_MAX_THREADS];
+static int numRings = 0;
+static u_int64_t numRetired = 0;
+static trace_ring_t overflowRing;	/* written, never dumped */
+static pthread_key_t ringKey;
+static pthread_once_t ringKeyOnce = PTHREAD_ONCE_INIT;
+static u_int64_t baseTicks;
+static double baseSecs;
+static int calibrated = 0;
+
+
+static double monotonicNow(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+
+static void retireRing(void *arg)
+{
+    trace_ring_t *r = (trace_ring_t *)arg;
+
+	/* at thread exit.  the ring stays in the dump until it's handed to
+	   another thread, and anything traced on the way out goes to the
+	   overflow ring */
+
+    (void)pthread_mutex_lock(&traceLock);
+    r->retired = ++numRetired;
+    (void)pthread_mutex_unlock(&traceLock);
+    traceRing = &overflowRing;
+}
+
+
+static void makeRingKey(void)
+{
+    (void)pthread_key_create(&ringKey, retireRing);
+}
+
+
+trace_ring_t *traceRegisterThread(void)
+{
+    trace_ring_t *r;
+    int i;
+
+	/* once per thread.  once there are TRACE_MAX_THREADS rings we take
+	   over the one that's been idle longest.  past that many running
+	   at once, threads share a ring that's never dumped, so they still
+	   don't need to check */
+
+    (void)pthread_once(&ringKeyOnce, makeRingKey);
+    (void)pthread_mutex_lock(&traceLock);
+    r = NULL;
+    if (numRings < TRACE_MAX_THREADS) {
+	if ((r=(trace_ring_t *)calloc(1, sizeof(trace_ring_t))) != NULL)
+	    rings[numRings++] = r;
+    } else {
+	for (i=0;i < numRings;i++)
+	    if (rings[i]->retired != 0 &&
+		    (r == NULL || rings[i]->retired < r->retired))
+		r = rings[i];
+    }
+    if (r != NULL) {
+	r->base = r->head;
+	r->retired = 0;
+	r->tid = (int)syscall(SYS_gettid);
+    }
+    (void)pthread_mutex_unlock(&traceLock);
+    if (r == NULL)
+	r = &overflowRing;
+    else (void)pthread_setspecific(ringKey, r);
+    traceRing = r;
+    return r;
+}
+
+
+void traceEnable(int on)
+{
+	/* ticks are tied to the clock from the first time we're turned on */
+
+    (void)pthread_mutex_lock(&traceLock);
+    if (on && !calibrated) {
+	baseSecs = monotonicNow();
+	baseTicks = traceTicks();
+	calibrated = 1;
+    }
+    (void)pthread_mutex_unlock(&traceLock);
+    traceEnabled = on;
+}
+
+
+static void threadName(int tid, char *name, int maxChars)
+{
+    char path[MAXPATHLEN], *p;
+    FILE *fp;
+
+    (void)sprintf(path, "/proc/self/task/%d/comm", tid);
+    *name = '\0';
+    if ((fp=fopen(path, "r")) != NULL) {
+	if (fgets(name, maxChars, fp) == NULL)
+	    *name = '\0';
+	(void)fclose(fp);
+    }
+    for (p=name;*p != '\0';p++)
+	if (*p == '\n' || *p == '"' || *p == '\\')
+	    *p = '\0';
+    if (*name == '\0')
+	(void)sprintf(name, "thread %d", tid);
+}
+
+
+int traceDump(const char *path, char *errorMsg)
+{
+    trace_ring_t *ringList[TRACE_MAX_THREADS];
+    u_int64_t bases[TRACE_MAX_THREADS];
+    int tids[TRACE_MAX_THREADS];
+    trace_event_t *copy, *e;
+    u_int64_t head, first, validFrom, i, ticksNow;
+    double ticksPerUs, secs;
+    char name[64];
+    int n, t, pid, count, saveErrno;
+    FILE *fp;
+
+    (void)pthread_mutex_lock(&traceLock);
+    n = numRings;
+    for (t=0;t < n;t++) {
+	ringList[t] = rings[t];
+	bases[t] = rings[t]->base;
+	tids[t] = rings[t]->tid;
+    }
+    (void)pthread_mutex_unlock(&traceLock);
+    if (!calibrated) {
+	(void)strcpy(errorMsg, "Tracing has never been turned on.");
+	return -1;
+    }
+
+	/* ticks per usec, over as long as we've been going */
+
+    if (monotonicNow() - baseSecs < 0.01)
+	(void)usleep(10000);
+    secs = monotonicNow() - baseSecs;
+    ticksNow = traceTicks();
+    ticksPerUs = (ticksNow - baseTicks) / (secs * 1.0e6);
+
+    if ((copy=(trace_event_t *)malloc(TRACE_RING_EVENTS *
+	    sizeof(trace_event_t))) == NULL) {
+	(void)strcpy(errorMsg, "Can't allocate trace buffer.");
+	return -1;
+    }
+    if ((fp=fopen(path, "w")) == NULL) {
+	(void)sprintf(errorMsg, "Can't create \"%s\":  %s.", path,
+	    strerror(errno));
+	free(copy);
+	return -1;
+    }
+    pid = (int)getpid();
+    (void)fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    (void)fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+	"\"args\":{\"name\":\"ngdcs\"}}", pid);
+    count = 0;
+    for (t=0;t < n;t++) {
+	threadName(tids[t], name, sizeof(name));
+	(void)fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+	    "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", pid,
+	    tids[t], name);
+
+	    /* the thread keeps recording while we copy, so take a little
+	       less than the whole ring, and then throw out whatever it
+	       got around to overwriting */
+
+	head = ringList[t]->head;
+	traceFence();
+	first = (head > TRACE_RING_EVENTS - TRACE_DUMP_MARGIN)?
+	    head - (TRACE_RING_EVENTS - TRACE_DUMP_MARGIN):0;
+	if (first < bases[t])
+	    first = bases[t];
+	for (i=first;i < head;i++)
+	    copy[i & (TRACE_RING_EVENTS-1)] =
+		ringList[t]->events[i & (TRACE_RING_EVENTS-1)];
+	traceFence();
+	validFrom = ringList[t]->head + 1;
+	validFrom = (validFrom > TRACE_RING_EVENTS)?
+	    validFrom - TRACE_RING_EVENTS:0;
+	if (first < validFrom)
+	    first = validFrom;
+
+	    /* and if another thread took the ring over meanwhile, its
+	       spans aren't this thread's */
+
+	(void)pthread_mutex_lock(&traceLock);
+	if (ringList[t]->base != bases[t] && head > ringList[t]->base)
+	    head = ringList[t]->base;
+	(void)pthread_mutex_unlock(&traceLock);
+
+	for (i=first;i < head;i++) {
+	    e = &copy[i & (TRACE_RING_EVENTS-1)];
+	    if (e->span >= NUM_TRACE_SPANS || e->start < baseTicks)
+		continue;
+	    (void)fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,"
+		"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+		traceSpanNames[e->span], pid, tids[t],
+		(e->start - baseTicks) / ticksPerUs, e->ticks / ticksPerUs);
+	    count++;
+	}
+    }
+    (void)fprintf(fp, "\n]}\n");
+    free(copy);
+    if (fclose(fp) == EOF) {
+	saveErrno = errno;
+	(void)sprintf(errorMsg, "Can't write \"%s\":  %s.", path,
+	    strerror(saveErrno));
+	return -1;
+    }
+    return count;
+}
@@ -0,0 +1,144 @@
+/* Copyright 2015, by the California Institute of Technology.  ALL RIGHTS
+   RESERVED.  United States Government Sponsorship acknowledged.  Any
+   commercial use must be negotiated with the Office of Technology Transfer
+   at the California Institute of Technology.
+
+   This software may be subject to U.S. export control laws.  By accepting
+   this software, the user agrees to comply with all applicable U.S. export
+   laws and regulations.  User has the responsibility to obtain export
+   licenses, or other export authority as may be required before exporting
+   such information to foreign countries or providing access to foreign
+   persons.
+
+   Please do not redistribute this file separate from the NGDCS source
+   distribution.  For questions regarding this software, please contact the
+   author, Alan Mazer, alan.s.mazer@jpl.nasa.gov */
+
+
+
+#include <sys/types.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+    /* hot-path tracing.  a span is timed with traceStart() at the top and
+       traceEnd() at the bottom:
+
+	   u_int64_t t0;
+
+	   t0 = traceStart();
+	   ...
+	   traceEnd(TRACE_ASSEMBLE, t0);
+
+       while tracing is off traceStart() is one load and traceEnd() one
+       test.  while it's on each span costs two TSC reads and a store
+       into the calling thread's own ring, which is made the first time
+       the thread records anything, so there's no lock and nothing shared
+       on the way.  when a thread exits its ring is kept, and dumped,
+       until a new thread needs one, so the writer threads started for
+       each flight line don't use up TRACE_MAX_THREADS.  rings hold the
+       last TRACE_RING_EVENTS spans of each thread and just wrap, so
+       tracing can be left on and dumped after something goes wrong.  the
+       dump is Chrome trace-event JSON, which Perfetto (ui.perfetto.dev)
+       and chrome://tracing both open; ticks are converted to time
+       against the monotonic clock between the first enable and the
+       dump.  where there's no TSC the ticks are monotonic nanoseconds
+       instead */
+
+#define TRACE_RING_EVENTS	16384	/* a power of 2 */
+#define TRACE_MAX_THREADS	64
+#define TRACE_DUMP_MARGIN	64	/* newest spans not trusted in a dump */
+
+    /* spans.  keep traceSpanNames in tracer.cpp in the same order */
+
+#define TRACE_FETCH_COPY	0	/* card frame to our buffer */
+#define TRACE_FETCH_RELEASE	1	/* card frame back to the server */
+#define TRACE_FETCH		2	/* framebuffer frame into a handle */
+#define TRACE_ASSEMBLE		3
+#define TRACE_TIMING		4	/* timestamp and PPS checks */
+#define TRACE_GPS		5
+#define TRACE_RECORD		6	/* frame into the writer's chunk */
+#define TRACE_WRITE		7	/* one chunk write, on a writer thread */
+#define TRACE_DARK		8
+#define TRACE_WATERFALL		9
+#define TRACE_RENDER		10	/* frame view */
+#define TRACE_ACQUIRE		11	/* one pass of the data thread */
+#define NUM_TRACE_SPANS		12
+
+typedef struct {
+    u_int64_t start;		/* ticks */
+    u_int ticks;
+    u_short span;
+} trace_event_t;
+
+typedef struct {
+    trace_event_t events[TRACE_RING_EVENTS];
+    volatile u_int64_t head;	/* events ever recorded */
+    u_int64_t base;		/* head when this thread took the ring */
+    u_int64_t retired;		/* when its thread exited, 0 if running */
+    int tid;
+} trace_ring_t;
+
+extern volatile int traceEnabled;
+extern __thread trace_ring_t *traceRing;
+extern const char *const traceSpanNames[NUM_TRACE_SPANS];
+
+extern trace_ring_t *traceRegisterThread(void);
+extern void traceEnable(int on);
+extern int traceDump(const char *path, char *errorMsg);
+
+
+static inline u_int64_t traceTicks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
+static inline void traceFence(void)
+{
+	/* x86 keeps stores in order, and loads, so only the compiler needs
+	   holding back there */
+
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("" : : : "memory");
+#else
+    __sync_synchronize();
+#endif
+}
+
+
+static inline u_int64_t traceStart(void)
+{
+    return traceEnabled? traceTicks():0;
+}
+
+
+static inline void traceEnd(int span, u_int64_t start)
+{
+    trace_ring_t *r;
+    trace_event_t *e;
+    u_int64_t ticks;
+
+    if (start == 0)
+	return;
+    ticks = traceTicks() - start;
+    if ((r=traceRing) == NULL)
+	r = traceRegisterThread();
+    e = &r->events[r->head & (TRACE_RING_EVENTS-1)];
+    e->start = start;
+    e->ticks = (ticks > 0xffffffffULL)? 0xffffffff:(u_int)ticks;
+    e->span = span;
+
+	/* the event has to be in place before the dump can see it counted */
+
+    traceFence();
+    r->head++;
+}